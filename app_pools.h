@@ -0,0 +1,46 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: app_pools.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Block pools shared by the application modules. All payload
+ * buffers come from here; the newlib heap is not used.
+*******************************************************************************/
+#ifndef APP_POOLS_H__
+#define APP_POOLS_H__
+
+#include "block_pool.h"
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Outgoing notification payloads (one ATT_MTU worth each)
+#define APP_POOL_NOTIF_SIZE (NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3)
+#define APP_POOL_NOTIF_COUNT 12
+// Event records handed between interrupt and main loop context (two
+// pointers and two words: 16 bytes on the target, 32 on a 64-bit host)
+#define APP_POOL_EVENT_SIZE (4 * sizeof(void*))
+#define APP_POOL_EVENT_COUNT 16
+// L2CAP SDUs (both directions of the bulk channel plus one spare)
+#define APP_POOL_SDU_SIZE 256
+#define APP_POOL_SDU_COUNT 6
+// Keep notified characteristic values in pool blocks (BLE_GATTS_VLOC_USER)
+// so they are built in place. The diagnostics summary is notified straight
+// from its attribute; the button state is copied into a block for every
+// notification, as each press and release must be sent as it was
+#define APP_USER_VALUES 1
+
+extern block_pool_t g_notif_pool;
+extern block_pool_t g_event_pool;
+extern block_pool_t g_sdu_pool;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // APP_POOLS_H__
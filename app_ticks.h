@@ -0,0 +1,21 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: app_ticks.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Conversions between app_timer ticks and real time.
+*******************************************************************************/
+#ifndef APP_TICKS_H__
+#define APP_TICKS_H__
+
+#include <stdint.h>
+#include "app_timer.h"
+
+// Frequency of the app_timer counter
+#define APP_TICKS_FREQ (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+// Converts app_timer ticks to microseconds
+#define APP_TICKS_TO_US(ticks) ((uint32_t)(((uint64_t)(ticks) * 1000000) / APP_TICKS_FREQ))
+// Converts microseconds to app_timer ticks
+#define APP_TICKS_FROM_US(us) ((uint32_t)(((uint64_t)(us) * APP_TICKS_FREQ) / 1000000))
+
+#endif // APP_TICKS_H__
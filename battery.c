@@ -0,0 +1,327 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: battery.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Supply monitoring.
+ *
+ *  Measurements are started by hardware: RTC2 compare channel 1 (the timer
+ *  wheel uses channel 0 and never clears the counter) triggers the SAADC
+ *  SAMPLE task through PPI. The channel runs in burst mode with 16x
+ *  oversampling, so one trigger takes all sixteen samples and averages
+ *  them without the CPU, and a second PPI channel re-arms the result
+ *  buffer at END. The CPU only wakes for END, once per measurement, to
+ *  take the result and set the next compare; filtering and publishing run
+ *  in the next radio gap.
+ *
+ *  The level comes from a discharge curve: a coin cell on VDD, or a
+ *  single Li-ion cell on VDDH when the chip runs in high voltage mode.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <string.h>
+#include "battery.h"
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_sdh_ble.h"
+#include "ble_srv_common.h"
+#include "app_util_platform.h"
+#include "timer_wheel.h"
+#include "radio_sched.h"
+#include "app_pools.h"
+#include "tx_sched.h"
+#include "trace_ring.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE priority value
+#define BATTERY_BLE_OBSERVER_PRIO 2
+// Measurement trigger: RTC2 compare channel and PPI channels
+#define BATTERY_RTC NRF_RTC2
+#define BATTERY_RTC_CC 1
+#define BATTERY_PPI_SAMPLE 0
+#define BATTERY_PPI_REARM 1
+#define BATTERY_IRQ_PRIORITY APP_IRQ_PRIORITY_LOW
+// First measurement after calibration, then the interval
+#define BATTERY_FIRST_DELAY TIMER_WHEEL_TICKS(100)
+#define BATTERY_INTERVAL TIMER_WHEEL_TICKS(BATTERY_INTERVAL_MS)
+// Cost of filtering and publishing one measurement
+#define BATTERY_JOB_COST_US 100
+// SAADC: 12 bit, gain 1/6 against the 0.6 V reference (3.6 V full scale)
+#define SAADC_FULL_SCALE_MV 3600
+#define SAADC_RANGE 4096
+#define VDDH_DIVIDER 5
+// Exponential filter, a new measurement is weighted 1/2^FILTER_SHIFT
+#define FILTER_SHIFT 2
+
+typedef struct {
+    uint16_t mv;
+    uint8_t percent;
+} curve_point_t;
+
+// CR2032 on VDD (flat until the knee below 2.9 V)
+static const curve_point_t m_coin_cell[] = {
+    {3000, 100}, {2900, 80}, {2800, 60}, {2700, 40}, {2600, 20}, {2500, 10}, {2300, 5}, {2000, 0}
+};
+// Single Li-ion cell on VDDH
+static const curve_point_t m_li_ion[] = {
+    {4200, 100}, {4000, 80}, {3850, 60}, {3750, 40}, {3650, 20}, {3500, 5}, {3300, 0}
+};
+
+static battery_state_handler_t m_state_handler;
+static bool m_vddh;
+// Written by EasyDMA, copied at END
+static volatile int16_t m_result;
+static int16_t m_raw;
+static uint32_t m_filtered;             // mV << FILTER_SHIFT, 0 before the first measurement
+static uint8_t m_level;
+static uint8_t m_published_level;
+static bool m_published;
+static battery_state_t m_state;
+static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;
+static ble_gatts_char_handles_t m_level_handles;
+
+
+/****************************************************************
+ * Function: level_from_mv()
+ * Description: Interpolates the level on a discharge curve.
+****************************************************************/
+static uint8_t level_from_mv(curve_point_t const* p_curve, uint32_t count, uint32_t mv) {
+    if (mv >= p_curve[0].mv) {
+        return p_curve[0].percent;
+    }
+    for (uint32_t i = 1; i < count; i++) {
+        if (mv >= p_curve[i].mv) {
+            uint32_t span_mv = p_curve[i - 1].mv - p_curve[i].mv;
+            uint32_t span_pct = p_curve[i - 1].percent - p_curve[i].percent;
+            return p_curve[i].percent + (mv - p_curve[i].mv) * span_pct / span_mv;
+        }
+    }
+    return p_curve[count - 1].percent;
+}
+
+
+/****************************************************************
+ * Function: state_next()
+ * Description: Returns the state for a level, leaving low and
+ *  critical only above their thresholds plus the hysteresis.
+****************************************************************/
+static battery_state_t state_next(battery_state_t state, uint8_t level) {
+    if (level <= BATTERY_CRITICAL_PERCENT) {
+        return BATTERY_CRITICAL;
+    }
+    if (state == BATTERY_CRITICAL && level < BATTERY_CRITICAL_PERCENT + BATTERY_HYSTERESIS_PERCENT) {
+        return BATTERY_CRITICAL;
+    }
+    if (level <= BATTERY_LOW_PERCENT) {
+        return BATTERY_LOW;
+    }
+    if (state != BATTERY_OK && level < BATTERY_LOW_PERCENT + BATTERY_HYSTERESIS_PERCENT) {
+        return BATTERY_LOW;
+    }
+    return BATTERY_OK;
+}
+
+
+/****************************************************************
+ * Function: level_publish()
+ * Description: Stores the level for reads and notifies it.
+****************************************************************/
+static void level_publish(void) {
+    m_published_level = m_level;
+    m_published = true;
+    ble_gatts_value_t value = {
+        .len = sizeof(m_level),
+        .offset = 0,
+        .p_value = &m_level
+    };
+    sd_ble_gatts_value_set(BLE_CONN_HANDLE_INVALID, m_level_handles.value_handle, &value);
+    if (m_conn_handle == BLE_CONN_HANDLE_INVALID) {
+        return;
+    }
+    uint8_t* p_payload = block_pool_alloc(&g_notif_pool);
+    if (p_payload == NULL) {
+        return;
+    }
+    p_payload[0] = m_level;
+    tx_sched_notify(m_conn_handle, m_level_handles.value_handle, TX_SCHED_TELEMETRY,
+                    p_payload, sizeof(m_level));
+}
+
+
+/****************************************************************
+ * Function: measure_job()
+ * Description: Filters a measurement, publishes the level if it
+ *  moved by a step and reports state changes.
+****************************************************************/
+static void measure_job(void* p_context) {
+    uint32_t raw = (m_raw > 0) ? (uint32_t)m_raw : 0;
+    uint32_t mv = raw * SAADC_FULL_SCALE_MV / SAADC_RANGE * (m_vddh ? VDDH_DIVIDER : 1);
+    m_filtered = m_filtered ? m_filtered - (m_filtered >> FILTER_SHIFT) + mv : mv << FILTER_SHIFT;
+
+    uint32_t filtered_mv = m_filtered >> FILTER_SHIFT;
+    m_level = m_vddh ? level_from_mv(m_li_ion, ARRAY_SIZE(m_li_ion), filtered_mv)
+                     : level_from_mv(m_coin_cell, ARRAY_SIZE(m_coin_cell), filtered_mv);
+    battery_state_t state = state_next(m_state, m_level);
+    uint8_t moved = (m_level > m_published_level) ? m_level - m_published_level
+                                                  : m_published_level - m_level;
+    if (!m_published || moved >= BATTERY_PUBLISH_STEP || state != m_state) {
+        level_publish();
+    }
+    if (state != m_state) {
+        m_state = state;
+        if (m_state_handler != NULL) {
+            m_state_handler(state);
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: compare_set()
+ * Description: Sets when the next measurement starts.
+****************************************************************/
+static void compare_set(uint32_t ticks) {
+    BATTERY_RTC->CC[BATTERY_RTC_CC] = (BATTERY_RTC->COUNTER + ticks) & RTC_COUNTER_COUNTER_Msk;
+    BATTERY_RTC->EVENTS_COMPARE[BATTERY_RTC_CC] = 0;
+}
+
+
+/****************************************************************
+ * Function: SAADC_IRQHandler()
+ * Description: Arms the first measurement once calibration is
+ *  done, then takes each result and sets the next compare.
+****************************************************************/
+void SAADC_IRQHandler(void) {
+    uint32_t trace_mark = trace_ring_enter(TRACE_HANDLER_SAADC);
+    if (NRF_SAADC->EVENTS_CALIBRATEDONE) {
+        NRF_SAADC->EVENTS_CALIBRATEDONE = 0;
+        NRF_SAADC->TASKS_START = 1;
+        compare_set(BATTERY_FIRST_DELAY);
+    }
+    if (NRF_SAADC->EVENTS_END) {
+        NRF_SAADC->EVENTS_END = 0;
+        m_raw = m_result;
+        compare_set(BATTERY_INTERVAL);
+        radio_sched_post(measure_job, NULL, BATTERY_JOB_COST_US);
+    }
+    trace_ring_exit(TRACE_HANDLER_SAADC, trace_mark);
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Tracks the connection the level is notified on.
+ *  BLE_GAP_EVT_CONNECTED    - Connected to peer
+ *  BLE_GAP_EVT_DISCONNECTED - Disconnected from peer
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    switch (p_ble_evt->header.evt_id) {
+        case BLE_GAP_EVT_CONNECTED:
+            m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            break;
+        case BLE_GAP_EVT_DISCONNECTED:
+            m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: saadc_init()
+ * Description: Sets up the supply channel and starts offset
+ *  calibration; the interrupt arms sampling when it is done.
+****************************************************************/
+static void saadc_init(void) {
+    m_vddh = (NRF_POWER->MAINREGSTATUS & POWER_MAINREGSTATUS_MAINREGSTATUS_Msk) ==
+             (POWER_MAINREGSTATUS_MAINREGSTATUS_High << POWER_MAINREGSTATUS_MAINREGSTATUS_Pos);
+    NRF_SAADC->RESOLUTION = SAADC_RESOLUTION_VAL_12bit;
+    NRF_SAADC->OVERSAMPLE = SAADC_OVERSAMPLE_OVERSAMPLE_Over16x;
+    NRF_SAADC->CH[0].CONFIG = (SAADC_CH_CONFIG_GAIN_Gain1_6 << SAADC_CH_CONFIG_GAIN_Pos) |
+                              (SAADC_CH_CONFIG_REFSEL_Internal << SAADC_CH_CONFIG_REFSEL_Pos) |
+                              (SAADC_CH_CONFIG_TACQ_10us << SAADC_CH_CONFIG_TACQ_Pos) |
+                              (SAADC_CH_CONFIG_MODE_SE << SAADC_CH_CONFIG_MODE_Pos) |
+                              (SAADC_CH_CONFIG_BURST_Enabled << SAADC_CH_CONFIG_BURST_Pos);
+    NRF_SAADC->CH[0].PSELN = SAADC_CH_PSELN_PSELN_NC;
+    NRF_SAADC->CH[0].PSELP = m_vddh ? SAADC_CH_PSELP_PSELP_VDDHDIV5 : SAADC_CH_PSELP_PSELP_VDD;
+    NRF_SAADC->RESULT.PTR = (uintptr_t)&m_result;
+    NRF_SAADC->RESULT.MAXCNT = 1;
+    NRF_SAADC->INTENSET = SAADC_INTENSET_END_Msk | SAADC_INTENSET_CALIBRATEDONE_Msk;
+    NVIC_SetPriority(SAADC_IRQn, BATTERY_IRQ_PRIORITY);
+    NVIC_ClearPendingIRQ(SAADC_IRQn);
+    NVIC_EnableIRQ(SAADC_IRQn);
+    NRF_SAADC->ENABLE = SAADC_ENABLE_ENABLE_Enabled;
+    NRF_SAADC->TASKS_CALIBRATEOFFSET = 1;
+
+    // PPI belongs to the SoftDevice while it is enabled
+    sd_ppi_channel_assign(BATTERY_PPI_SAMPLE, &BATTERY_RTC->EVENTS_COMPARE[BATTERY_RTC_CC],
+                          &NRF_SAADC->TASKS_SAMPLE);
+    sd_ppi_channel_assign(BATTERY_PPI_REARM, &NRF_SAADC->EVENTS_END, &NRF_SAADC->TASKS_START);
+    sd_ppi_channel_enable_set((1UL << BATTERY_PPI_SAMPLE) | (1UL << BATTERY_PPI_REARM));
+    BATTERY_RTC->EVTENSET = RTC_EVTENSET_COMPARE1_Msk;
+}
+
+
+/****************************************************************
+ * Function: battery_init()
+ * Description: Adds the Battery Service with its read/notify
+ *  level characteristic and starts measuring.
+****************************************************************/
+void battery_init(battery_state_handler_t state_handler) {
+    m_state_handler = state_handler;
+
+    // Add service
+    ble_uuid_t ble_uuid;
+    ble_add_char_params_t add_char_params;
+    uint16_t service_handle;
+    ble_uuid.type = BLE_UUID_TYPE_BLE;
+    ble_uuid.uuid = BATTERY_UUID_SERVICE;
+    sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &service_handle);
+
+    // Add level characteristic
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid                = BATTERY_UUID_LEVEL_CHAR;
+    add_char_params.uuid_type           = BLE_UUID_TYPE_BLE;
+    add_char_params.init_len            = sizeof(uint8_t);
+    add_char_params.max_len             = sizeof(uint8_t);
+    add_char_params.char_props.read     = 1;
+    add_char_params.char_props.notify   = 1;
+    add_char_params.read_access         = SEC_OPEN;
+    add_char_params.cccd_write_access   = SEC_OPEN;
+    characteristic_add(service_handle, &add_char_params, &m_level_handles);
+
+    saadc_init();
+}
+
+
+/****************************************************************
+ * Function: battery_mv()
+ * Description: Returns the filtered supply voltage.
+****************************************************************/
+uint16_t battery_mv(void) {
+    return (uint16_t)(m_filtered >> FILTER_SHIFT);
+}
+
+
+/****************************************************************
+ * Function: battery_level()
+ * Description: Returns the battery level.
+****************************************************************/
+uint8_t battery_level(void) {
+    return m_level;
+}
+
+
+/****************************************************************
+ * Function: battery_state()
+ * Description: Returns the battery state.
+****************************************************************/
+battery_state_t battery_state(void) {
+    return m_state;
+}
+
+NRF_SDH_BLE_OBSERVER(m_battery_observer, BATTERY_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: battery.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Supply monitoring. Measures VDD (or VDDH in high voltage
+ * mode) with the SAADC on an RTC schedule, filters it, publishes the level
+ * in the Battery Service when it moves by a step and reports low and
+ * critical states to the application.
+*******************************************************************************/
+#ifndef BATTERY_H__
+#define BATTERY_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Battery Service and Battery Level characteristic (Bluetooth SIG)
+#define BATTERY_UUID_SERVICE 0x180F
+#define BATTERY_UUID_LEVEL_CHAR 0x2A19
+// Time between measurements
+#define BATTERY_INTERVAL_MS 60000
+// Smallest level change (percent) that is published
+#define BATTERY_PUBLISH_STEP 5
+// State thresholds (percent); a state is left this much above its threshold
+#define BATTERY_LOW_PERCENT 20
+#define BATTERY_CRITICAL_PERCENT 5
+#define BATTERY_HYSTERESIS_PERCENT 3
+
+typedef enum {
+    BATTERY_OK,
+    BATTERY_LOW,
+    BATTERY_CRITICAL
+} battery_state_t;
+
+// Called from the main loop when the state changes
+typedef void (*battery_state_handler_t)(battery_state_t state);
+
+
+/***************************************
+ * Functions
+***************************************/
+// Adds the Battery Service and starts measuring (call after timer_wheel_init())
+void battery_init(battery_state_handler_t state_handler);
+// Returns the filtered supply voltage in mV, 0 before the first measurement
+uint16_t battery_mv(void);
+// Returns the battery level in percent
+uint8_t battery_level(void);
+// Returns the battery state
+battery_state_t battery_state(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BATTERY_H__
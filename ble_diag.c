@@ -0,0 +1,438 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: ble_diag.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Link diagnostics service. RSSI is sampled on every link at a
+ * fixed interval and the QoS channel survey runs for the device's lifetime;
+ * the results are aggregated per link and published as a compact summary
+ * every few seconds so throughput drops can be matched against the RF
+ * environment.
+ *
+ * NOTE: the SoftDevice does not expose link layer retransmissions, so
+ *  notification backpressure (TX queue full) and completed notifications
+ *  are tracked instead.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <string.h>
+#include "ble_diag.h"
+#include "nrf_sdh_ble.h"
+#include "ble_srv_common.h"
+#include "timer_wheel.h"
+#include "radio_sched.h"
+#include "app_pools.h"
+#include "tx_sched.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE priority value (before the application so stats are fresh)
+#define DIAG_BLE_OBSERVER_PRIO 2
+// RSSI sample interval
+#define DIAG_RSSI_SAMPLE_INTERVAL TIMER_WHEEL_TICKS(500)
+// Samples between summary publishes (10 s)
+#define DIAG_PUBLISH_SAMPLES 20
+// Channel survey report interval
+#define DIAG_SURVEY_INTERVAL_US 1000000
+// Expected cost of publishing all summaries
+#define DIAG_PUBLISH_COST_US 150
+// Weight of a new survey report in the channel energy average (1/2^N)
+#define DIAG_ENERGY_EWMA_SHIFT 3
+// Fractional bits of the averaged channel energy, so that changes smaller
+// than 2^DIAG_ENERGY_EWMA_SHIFT dB still move the average
+#define DIAG_ENERGY_FRAC_BITS 8
+#define DIAG_ENERGY_INVALID ((int16_t)(BLE_GAP_POWER_LEVEL_INVALID * (1 << DIAG_ENERGY_FRAC_BITS)))
+
+TIMER_WHEEL_DEF(m_diag_timer);
+
+// Per-link statistics
+static ble_diag_link_t m_links[NRF_SDH_BLE_TOTAL_LINK_COUNT];
+// Averaged channel energy in dBm, fixed point with DIAG_ENERGY_FRAC_BITS
+static int16_t m_ch_energy[BLE_GAP_CHANNEL_COUNT];
+// RSSI samples since the last publish
+static uint8_t m_publish_samples;
+// Disconnect reasons seen since boot
+static ble_diag_disc_t m_disc[BLE_DIAG_DISC_REASONS];
+static uint8_t m_last_disc_reason;
+static uint16_t m_disc_count;
+// Summary characteristic
+static ble_gatts_char_handles_t m_summary_handles;
+#if APP_USER_VALUES
+// Summary attribute value, in application memory
+static ble_diag_summary_t* m_summary_value;
+#endif
+
+
+/****************************************************************
+ * Function: link_find()
+ * Description: Returns the statistics slot of a connection, or
+ *  NULL if the connection is not tracked.
+****************************************************************/
+static ble_diag_link_t* link_find(uint16_t conn_handle) {
+    for (uint32_t i = 0; i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++) {
+        if (m_links[i].conn_handle == conn_handle) {
+            return &m_links[i];
+        }
+    }
+    return NULL;
+}
+
+
+/****************************************************************
+ * Function: link_open()
+ * Description: Claims and resets a statistics slot for a new
+ *  connection and starts RSSI measurement on it.
+****************************************************************/
+static void link_open(uint16_t conn_handle) {
+    ble_diag_link_t* p_link = link_find(BLE_CONN_HANDLE_INVALID);
+    if (p_link == NULL) {
+        return;
+    }
+    memset(p_link, 0, sizeof(*p_link));
+    p_link->conn_handle = conn_handle;
+    p_link->rssi_min = INT8_MAX;
+    p_link->rssi_max = INT8_MIN;
+    // No threshold: no change events, the RSSI is read with sd_ble_gap_rssi_get()
+    sd_ble_gap_rssi_start(conn_handle, BLE_GAP_RSSI_THRESHOLD_INVALID, 0);
+}
+
+
+/****************************************************************
+ * Function: rssi_add()
+ * Description: Adds an RSSI sample to a link's statistics.
+****************************************************************/
+static void rssi_add(ble_diag_link_t* p_link, int8_t rssi, uint8_t ch_index) {
+    int32_t bin = (rssi - BLE_DIAG_RSSI_FLOOR) / BLE_DIAG_RSSI_BIN_WIDTH;
+    if (bin < 0) {
+        bin = 0;
+    }
+    else if (bin >= BLE_DIAG_RSSI_BINS) {
+        bin = BLE_DIAG_RSSI_BINS - 1;
+    }
+    if (p_link->rssi_hist[bin] == UINT16_MAX) {
+        // Halves the history so a long connection keeps its proportions
+        for (uint32_t i = 0; i < BLE_DIAG_RSSI_BINS; i++) {
+            p_link->rssi_hist[i] /= 2;
+        }
+        p_link->rssi_samples /= 2;
+        p_link->rssi_sum /= 2;
+    }
+    p_link->rssi_hist[bin]++;
+    p_link->rssi_samples++;
+    p_link->rssi_sum += rssi;
+    p_link->rssi_last = rssi;
+    if (rssi < p_link->rssi_min) {
+        p_link->rssi_min = rssi;
+    }
+    if (rssi > p_link->rssi_max) {
+        p_link->rssi_max = rssi;
+    }
+    if (ch_index < BLE_GAP_CHANNEL_COUNT) {
+        p_link->ch_rssi[ch_index] = rssi;
+    }
+}
+
+
+/****************************************************************
+ * Function: survey_add()
+ * Description: Folds a channel survey report into the averaged
+ *  channel energy.
+****************************************************************/
+static void survey_add(int8_t const* p_energy) {
+    for (uint32_t i = 0; i < BLE_GAP_CHANNEL_COUNT; i++) {
+        if (p_energy[i] == BLE_GAP_POWER_LEVEL_INVALID) {
+            continue;
+        }
+        int32_t energy = p_energy[i] * (1 << DIAG_ENERGY_FRAC_BITS);
+        if (m_ch_energy[i] == DIAG_ENERGY_INVALID) {
+            m_ch_energy[i] = (int16_t)energy;
+        }
+        else {
+            int32_t delta = energy - m_ch_energy[i];
+            m_ch_energy[i] += (int16_t)(delta / (1 << DIAG_ENERGY_EWMA_SHIFT));
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: energy_dbm()
+ * Description: Returns the averaged energy of a channel rounded
+ *  to whole dBm, or BLE_GAP_POWER_LEVEL_INVALID if it has not
+ *  been surveyed.
+****************************************************************/
+static int8_t energy_dbm(uint32_t channel) {
+    int32_t energy = m_ch_energy[channel];
+    int32_t half = 1 << (DIAG_ENERGY_FRAC_BITS - 1);
+    if (energy == DIAG_ENERGY_INVALID) {
+        return BLE_GAP_POWER_LEVEL_INVALID;
+    }
+    return (int8_t)((energy + ((energy < 0) ? -half : half)) / (1 << DIAG_ENERGY_FRAC_BITS));
+}
+
+
+/****************************************************************
+ * Function: disc_add()
+ * Description: Counts a disconnect reason.
+****************************************************************/
+static void disc_add(uint8_t reason) {
+    m_last_disc_reason = reason;
+    if (m_disc_count < UINT16_MAX) {
+        m_disc_count++;
+    }
+    for (uint32_t i = 0; i < BLE_DIAG_DISC_REASONS; i++) {
+        if (m_disc[i].count == 0 || m_disc[i].reason == reason) {
+            m_disc[i].reason = reason;
+            m_disc[i].count++;
+            return;
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: summary_build()
+ * Description: Packs the statistics of a link into the compact
+ *  over-the-air format.
+****************************************************************/
+static void summary_build(ble_diag_link_t const* p_link, ble_diag_summary_t* p_summary) {
+    memset(p_summary, 0, sizeof(*p_summary));
+    p_summary->version = BLE_DIAG_SUMMARY_VERSION;
+    if (p_link->rssi_samples > 0) {
+        p_summary->rssi_last = p_link->rssi_last;
+        p_summary->rssi_min = p_link->rssi_min;
+        p_summary->rssi_max = p_link->rssi_max;
+        p_summary->rssi_mean = (int8_t)(p_link->rssi_sum / (int32_t)p_link->rssi_samples);
+        for (uint32_t i = 0; i < BLE_DIAG_RSSI_BINS; i++) {
+            p_summary->rssi_hist[i] = (uint8_t)((p_link->rssi_hist[i] * 255UL) / p_link->rssi_samples);
+        }
+    }
+    p_summary->worst_energy = INT8_MIN;
+    for (uint32_t i = 0; i < BLE_GAP_CHANNEL_COUNT; i++) {
+        int8_t energy = energy_dbm(i);
+        if (energy != BLE_GAP_POWER_LEVEL_INVALID && energy > p_summary->worst_energy) {
+            p_summary->worst_energy = energy;
+            p_summary->worst_channel = i;
+        }
+    }
+    p_summary->last_disc_reason = m_last_disc_reason;
+    p_summary->disc_count = (m_disc_count > UINT8_MAX) ? UINT8_MAX : m_disc_count;
+    p_summary->hvx_busy = (p_link->hvx_busy > UINT8_MAX) ? UINT8_MAX : p_link->hvx_busy;
+    p_summary->hvx_complete = (p_link->hvx_complete > UINT16_MAX) ? UINT16_MAX : p_link->hvx_complete;
+}
+
+
+/****************************************************************
+ * Function: ble_diag_publish()
+ * Description: Publishes the summary of a link. It is stored
+ *  so it can be read and queued as telemetry, which is notified
+ *  if the peer has enabled notifications.
+****************************************************************/
+void ble_diag_publish(uint16_t conn_handle) {
+    ble_diag_link_t const* p_link = link_find(conn_handle);
+    if (p_link == NULL || conn_handle == BLE_CONN_HANDLE_INVALID) {
+        return;
+    }
+#if APP_USER_VALUES
+    // Built in the attribute itself: reads see it straight away and the
+    // notification sends the current value (no payload) without a copy
+    summary_build(p_link, m_summary_value);
+    tx_sched_notify(conn_handle, m_summary_handles.value_handle, TX_SCHED_TELEMETRY,
+                    NULL, sizeof(*m_summary_value));
+#else
+    ble_diag_summary_t* p_summary = block_pool_alloc(&g_notif_pool);
+    if (p_summary == NULL) {
+        return;
+    }
+    summary_build(p_link, p_summary);
+
+    // Stored for reads, then queued (the block is handed over)
+    ble_gatts_value_t value = {
+        .len = sizeof(*p_summary),
+        .offset = 0,
+        .p_value = (uint8_t*)p_summary
+    };
+    sd_ble_gatts_value_set(conn_handle, m_summary_handles.value_handle, &value);
+    tx_sched_notify(conn_handle, m_summary_handles.value_handle, TX_SCHED_TELEMETRY,
+                    (uint8_t*)p_summary, sizeof(*p_summary));
+#endif
+}
+
+
+/****************************************************************
+ * Function: publish_job()
+ * Description: Publishes the summary of every connected link.
+****************************************************************/
+static void publish_job(void* p_context) {
+    for (uint32_t i = 0; i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++) {
+        ble_diag_publish(m_links[i].conn_handle);
+    }
+}
+
+
+/****************************************************************
+ * Function: diag_timeout_handler()
+ * Description: Samples the RSSI of every connected link and
+ *  periodically schedules publishing in the next radio gap.
+****************************************************************/
+static void diag_timeout_handler(void* p_context) {
+    for (uint32_t i = 0; i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++) {
+        int8_t rssi;
+        uint8_t ch_index;
+        if (m_links[i].conn_handle != BLE_CONN_HANDLE_INVALID &&
+            sd_ble_gap_rssi_get(m_links[i].conn_handle, &rssi, &ch_index) == NRF_SUCCESS) {
+            rssi_add(&m_links[i], rssi, ch_index);
+        }
+    }
+    if (++m_publish_samples >= DIAG_PUBLISH_SAMPLES) {
+        m_publish_samples = 0;
+        radio_sched_post(publish_job, NULL, DIAG_PUBLISH_COST_US);
+    }
+}
+
+
+/****************************************************************
+ * Function: ble_diag_on_hvx()
+ * Description: Records the result of a notification queued by
+ *  the application.
+****************************************************************/
+void ble_diag_on_hvx(uint16_t conn_handle, uint32_t err_code) {
+    ble_diag_link_t* p_link = link_find(conn_handle);
+    if (p_link == NULL || conn_handle == BLE_CONN_HANDLE_INVALID) {
+        return;
+    }
+    if (err_code == NRF_SUCCESS) {
+        p_link->hvx_queued++;
+    }
+    else if (err_code == NRF_ERROR_RESOURCES) {
+        p_link->hvx_busy++;
+    }
+}
+
+
+/****************************************************************
+ * Function: ble_diag_link_get()
+ * Description: Returns the statistics of a connected link.
+****************************************************************/
+ble_diag_link_t const* ble_diag_link_get(uint16_t conn_handle) {
+    if (conn_handle == BLE_CONN_HANDLE_INVALID) {
+        return NULL;
+    }
+    return link_find(conn_handle);
+}
+
+
+/****************************************************************
+ * Function: ble_diag_channel_energy_get()
+ * Description: Returns the averaged energy of a channel, or
+ *  BLE_GAP_POWER_LEVEL_INVALID if it has not been surveyed.
+****************************************************************/
+int8_t ble_diag_channel_energy_get(uint8_t channel) {
+    if (channel >= BLE_GAP_CHANNEL_COUNT) {
+        return BLE_GAP_POWER_LEVEL_INVALID;
+    }
+    return energy_dbm(channel);
+}
+
+
+/****************************************************************
+ * Function: ble_diag_disc_get()
+ * Description: Returns a disconnect reason counter, or NULL if
+ *  fewer reasons have been seen.
+****************************************************************/
+ble_diag_disc_t const* ble_diag_disc_get(uint8_t index) {
+    if (index >= BLE_DIAG_DISC_REASONS || m_disc[index].count == 0) {
+        return NULL;
+    }
+    return &m_disc[index];
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Function to process BLE events.
+ *  BLE_GAP_EVT_CONNECTED                   - Start tracking link
+ *  BLE_GAP_EVT_DISCONNECTED                - Count reason
+ *  BLE_GAP_EVT_QOS_CHANNEL_SURVEY_REPORT   - Channel energy
+ *  BLE_GATTS_EVT_HVN_TX_COMPLETE           - Notifications sent
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    uint16_t conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    ble_diag_link_t* p_link;
+
+    switch (p_ble_evt->header.evt_id) {
+        case BLE_GAP_EVT_CONNECTED:
+            link_open(conn_handle);
+            break;
+        case BLE_GAP_EVT_DISCONNECTED:
+            disc_add(p_ble_evt->evt.gap_evt.params.disconnected.reason);
+            p_link = link_find(conn_handle);
+            if (p_link != NULL) {
+                p_link->conn_handle = BLE_CONN_HANDLE_INVALID;
+            }
+            break;
+        case BLE_GAP_EVT_QOS_CHANNEL_SURVEY_REPORT:
+            survey_add(p_ble_evt->evt.gap_evt.params.qos_channel_survey_report.channel_energy);
+            break;
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+            p_link = link_find(p_ble_evt->evt.gatts_evt.conn_handle);
+            if (p_link != NULL) {
+                p_link->hvx_complete += p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count;
+            }
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: ble_diag_init()
+ * Description: Adds the diagnostics service and summary
+ *  characteristic, starts the channel survey and the periodic
+ *  RSSI sampling and publishing timer.
+****************************************************************/
+void ble_diag_init(uint8_t uuid_type) {
+    for (uint32_t i = 0; i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++) {
+        m_links[i].conn_handle = BLE_CONN_HANDLE_INVALID;
+    }
+    for (uint32_t i = 0; i < BLE_GAP_CHANNEL_COUNT; i++) {
+        m_ch_energy[i] = DIAG_ENERGY_INVALID;
+    }
+
+    // Add service
+    ble_uuid_t ble_uuid;
+    ble_add_char_params_t add_char_params;
+    uint16_t service_handle;
+    ble_uuid.type = uuid_type;
+    ble_uuid.uuid = UUID_DIAG_SERVICE;
+    sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &service_handle);
+
+    // Add summary characteristic
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid                = UUID_DIAG_SUMMARY_CHAR;
+    add_char_params.uuid_type           = uuid_type;
+    add_char_params.init_len            = sizeof(ble_diag_summary_t);
+    add_char_params.max_len             = sizeof(ble_diag_summary_t);
+    add_char_params.char_props.read     = 1;
+    add_char_params.char_props.notify   = 1;
+    add_char_params.read_access         = SEC_OPEN;
+    add_char_params.cccd_write_access   = SEC_OPEN;
+#if APP_USER_VALUES
+    // Taken for the lifetime of the attribute
+    m_summary_value = block_pool_alloc(&g_notif_pool);
+    memset(m_summary_value, 0, sizeof(*m_summary_value));
+    add_char_params.is_value_user       = true;
+    add_char_params.p_init_value        = (uint8_t*)m_summary_value;
+#endif
+    characteristic_add(service_handle, &add_char_params, &m_summary_handles);
+
+    // The survey only uses radio idle time, so it can run for the device's lifetime
+    sd_ble_gap_qos_channel_survey_start(DIAG_SURVEY_INTERVAL_US);
+
+    timer_wheel_start(&m_diag_timer, DIAG_RSSI_SAMPLE_INTERVAL, DIAG_RSSI_SAMPLE_INTERVAL, diag_timeout_handler, NULL);
+}
+
+NRF_SDH_BLE_OBSERVER(m_diag_observer, DIAG_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
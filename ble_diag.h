@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: ble_diag.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Link diagnostics service. Tracks RSSI, channel energy,
+ * notification backpressure and disconnect reasons for each link and
+ * publishes a compact summary through a read/notify characteristic.
+*******************************************************************************/
+#ifndef BLE_DIAG_H__
+#define BLE_DIAG_H__
+
+#include <stdint.h>
+#include "ble.h"
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Diagnostics service and characteristic UUIDs (on the application base UUID)
+#define UUID_DIAG_SERVICE 0x1300
+#define UUID_DIAG_SUMMARY_CHAR 0x1301
+// RSSI histogram: BLE_DIAG_RSSI_BINS bins of BLE_DIAG_RSSI_BIN_WIDTH dB,
+// starting at BLE_DIAG_RSSI_FLOOR dBm (everything below lands in bin 0)
+#define BLE_DIAG_RSSI_BINS 8
+#define BLE_DIAG_RSSI_BIN_WIDTH 8
+#define BLE_DIAG_RSSI_FLOOR (-100)
+// Distinct disconnect reasons remembered per device
+#define BLE_DIAG_DISC_REASONS 8
+// Summary format version, bump when ble_diag_summary_t changes
+#define BLE_DIAG_SUMMARY_VERSION 1
+
+// Per-link statistics, reset on every new connection
+typedef struct {
+    uint16_t conn_handle;
+    uint32_t rssi_samples;
+    int32_t  rssi_sum;
+    int8_t   rssi_last;
+    int8_t   rssi_min;
+    int8_t   rssi_max;
+    uint16_t rssi_hist[BLE_DIAG_RSSI_BINS];
+    int8_t   ch_rssi[BLE_GAP_CHANNEL_COUNT];   // Last RSSI seen per data channel
+    uint32_t hvx_queued;                       // Notifications accepted by the SoftDevice
+    uint32_t hvx_busy;                         // Notifications refused (TX queue full)
+    uint32_t hvx_complete;                     // Notifications acknowledged on air
+} ble_diag_link_t;
+
+// Disconnect reason counter
+typedef struct {
+    uint8_t  reason;
+    uint16_t count;
+} ble_diag_disc_t;
+
+// Compact summary sent over the air (fits a 20-byte notification)
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    int8_t   rssi_last;
+    int8_t   rssi_min;
+    int8_t   rssi_max;
+    int8_t   rssi_mean;
+    uint8_t  rssi_hist[BLE_DIAG_RSSI_BINS];    // Share of samples per bin, 0-255
+    uint8_t  worst_channel;                    // Channel with the highest energy
+    int8_t   worst_energy;                     // Its energy in dBm
+    uint8_t  last_disc_reason;
+    uint8_t  disc_count;                       // Saturating
+    uint8_t  hvx_busy;                         // Saturating
+    uint16_t hvx_complete;                     // Saturating
+} ble_diag_summary_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Adds the diagnostics service using the application's vendor UUID type
+void ble_diag_init(uint8_t uuid_type);
+// Records the result of an sd_ble_gatts_hvx() call made by the application
+void ble_diag_on_hvx(uint16_t conn_handle, uint32_t err_code);
+// Returns the statistics of a connected link (NULL if unknown)
+ble_diag_link_t const* ble_diag_link_get(uint16_t conn_handle);
+// Returns the averaged energy of a channel in dBm from the channel survey
+int8_t ble_diag_channel_energy_get(uint8_t channel);
+// Returns a disconnect reason counter, in first seen order (NULL past the
+// last reason seen)
+ble_diag_disc_t const* ble_diag_disc_get(uint8_t index);
+// Builds and publishes the summary of a link
+void ble_diag_publish(uint16_t conn_handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_DIAG_H__
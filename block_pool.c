@@ -0,0 +1,177 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: block_pool.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Lock-free fixed-size block pools.
+ *
+ *  Free blocks form a singly linked stack whose link lives in the block
+ *  itself. Links are byte offsets from the start of the pool rather than
+ *  pointers, so they stay 32 bits wide on 64-bit host builds as well.
+ *  Push and pop are LDREX/STREX loops on the head offset. The
+ *  Cortex-M4 clears the exclusive monitor on every exception entry and
+ *  return, so an interrupt that touches the pool between the load and the
+ *  store makes the store fail and the loop retry. That also rules out the
+ *  ABA problem of compare-and-swap stacks.
+ *
+ *  A block pushed twice would link the stack into a loop and hand the block
+ *  out twice, so frees are checked against a bit per block that is set
+ *  while it is allocated, and changed with the same LDREX/STREX loops.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stddef.h>
+#include "block_pool.h"
+#include "nrf.h"
+#include "app_error.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// End of the free list
+#define FREE_END 0xFFFFFFFFUL
+
+typedef struct {
+    uint32_t next;                      // Offset of the next free block
+} free_block_t;
+
+
+/****************************************************************
+ * Function: block_at()
+ * Description: Returns the block at an offset into the pool.
+****************************************************************/
+static free_block_t* block_at(block_pool_t const* p_pool, uint32_t offset) {
+    return (free_block_t*)((uint8_t*)p_pool->p_mem + offset);
+}
+
+
+/****************************************************************
+ * Function: atomic_add()
+ * Description: Adds to a counter and returns the new value.
+****************************************************************/
+static uint32_t atomic_add(volatile uint32_t* p_value, int32_t delta) {
+    uint32_t value;
+    do {
+        value = __LDREXW(p_value) + delta;
+    } while (__STREXW(value, p_value) != 0);
+    return value;
+}
+
+
+/****************************************************************
+ * Function: atomic_max()
+ * Description: Raises a counter to value if it is lower.
+****************************************************************/
+static void atomic_max(volatile uint32_t* p_value, uint32_t value) {
+    do {
+        if (__LDREXW(p_value) >= value) {
+            __CLREX();
+            return;
+        }
+    } while (__STREXW(value, p_value) != 0);
+}
+
+
+/****************************************************************
+ * Function: used_set()
+ * Description: Sets or clears the in-use bit of a block and
+ *  returns whether it was set.
+****************************************************************/
+static bool used_set(block_pool_t* p_pool, uint32_t index, bool used) {
+    volatile uint32_t* p_word = &p_pool->p_used[index / 32];
+    uint32_t mask = 1UL << (index % 32);
+    uint32_t word;
+    do {
+        word = __LDREXW(p_word);
+    } while (__STREXW(used ? (word | mask) : (word & ~mask), p_word) != 0);
+    return (word & mask) != 0;
+}
+
+
+/****************************************************************
+ * Function: block_pool_init()
+ * Description: Links all blocks of a pool into its free list.
+****************************************************************/
+void block_pool_init(block_pool_t* p_pool) {
+    uint32_t next = FREE_END;
+    // Link backwards so blocks are handed out in address order
+    for (uint32_t i = p_pool->block_count; i > 0; i--) {
+        uint32_t offset = (i - 1) * p_pool->block_size;
+        block_at(p_pool, offset)->next = next;
+        next = offset;
+    }
+    p_pool->free_head = next;
+    for (uint32_t i = 0; i < BLOCK_POOL_USED_WORDS(p_pool->block_count); i++) {
+        p_pool->p_used[i] = 0;
+    }
+    p_pool->in_use = 0;
+    p_pool->high_water = 0;
+    p_pool->exhausted = 0;
+    p_pool->bad_frees = 0;
+}
+
+
+/****************************************************************
+ * Function: block_pool_alloc()
+ * Description: Pops a block from the free list. Returns NULL
+ *  and counts the failure if the pool is exhausted.
+****************************************************************/
+void* block_pool_alloc(block_pool_t* p_pool) {
+    uint32_t offset;
+    do {
+        offset = __LDREXW(&p_pool->free_head);
+        if (offset == FREE_END) {
+            __CLREX();
+            atomic_add(&p_pool->exhausted, 1);
+            return NULL;
+        }
+    } while (__STREXW(block_at(p_pool, offset)->next, &p_pool->free_head) != 0);
+
+    used_set(p_pool, offset / p_pool->block_size, true);
+    atomic_max(&p_pool->high_water, atomic_add(&p_pool->in_use, 1));
+    return block_at(p_pool, offset);
+}
+
+
+/****************************************************************
+ * Function: block_pool_free()
+ * Description: Pushes a block back on the free list. A block
+ *  that is not in use, or a pointer that is not the start of a
+ *  block of this pool, is refused: counted, and reported in
+ *  DEBUG builds.
+****************************************************************/
+void block_pool_free(block_pool_t* p_pool, void* p_block) {
+    if (p_block == NULL) {
+        return;
+    }
+    // Compared as addresses, the pointer may not point into the pool
+    uint32_t offset = (uint32_t)((uintptr_t)p_block - (uintptr_t)p_pool->p_mem);
+    if (offset >= (uint32_t)p_pool->block_size * p_pool->block_count ||
+        (offset % p_pool->block_size) != 0 ||
+        !used_set(p_pool, offset / p_pool->block_size, false)) {
+        atomic_add(&p_pool->bad_frees, 1);
+#ifdef DEBUG
+        APP_ERROR_HANDLER(NRF_ERROR_INVALID_ADDR);
+#endif
+        return;
+    }
+
+    free_block_t* p_free = (free_block_t*)p_block;
+    do {
+        p_free->next = __LDREXW(&p_pool->free_head);
+    } while (__STREXW(offset, &p_pool->free_head) != 0);
+
+    atomic_add(&p_pool->in_use, -1);
+}
+
+
+/****************************************************************
+ * Function: block_pool_available()
+ * Description: Returns the number of free blocks.
+****************************************************************/
+uint32_t block_pool_available(block_pool_t const* p_pool) {
+    return p_pool->block_count - p_pool->in_use;
+}
@@ -0,0 +1,71 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: block_pool.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Fixed-size block pools. Allocation and release are O(1) and
+ * lock-free (LDREX/STREX), so they are safe from any interrupt priority and
+ * never fragment. Each pool tracks its high-water mark and exhaustion count,
+ * and which blocks are in use, so a double or foreign free is refused.
+ * Builds with DEBUG defined also report one through APP_ERROR_HANDLER.
+*******************************************************************************/
+#ifndef BLOCK_POOL_H__
+#define BLOCK_POOL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Words per block (a free block holds the free list link)
+#define BLOCK_POOL_WORDS(_block_size) (((_block_size) < 4) ? 1 : (((_block_size) + 3) / 4))
+// Words of the in-use bitmap
+#define BLOCK_POOL_USED_WORDS(_block_count) (((_block_count) + 31) / 32)
+
+typedef struct {
+    volatile uint32_t free_head;        // Offset of the first free block
+    uint32_t* p_mem;
+    volatile uint32_t* p_used;          // Bit per block, set while allocated
+    uint16_t block_size;                // Bytes, word aligned
+    uint16_t block_count;
+    volatile uint32_t in_use;
+    volatile uint32_t high_water;       // Most blocks ever in use
+    volatile uint32_t exhausted;        // Allocations refused
+    volatile uint32_t bad_frees;        // Frees refused (double, foreign, misaligned)
+} block_pool_t;
+
+// Defines a pool (use block_pool_init() before the first allocation)
+#define BLOCK_POOL_DEF(_name, _block_size, _block_count)                        \
+    static uint32_t _name##_mem[(_block_count) * BLOCK_POOL_WORDS(_block_size)]; \
+    static uint32_t _name##_used[BLOCK_POOL_USED_WORDS(_block_count)];          \
+    block_pool_t _name = {                                                      \
+        .p_mem = _name##_mem,                                                   \
+        .p_used = _name##_used,                                                 \
+        .block_size = BLOCK_POOL_WORDS(_block_size) * 4,                        \
+        .block_count = (_block_count)                                           \
+    }
+
+
+/***************************************
+ * Functions
+***************************************/
+// Links all blocks of a pool into its free list
+void block_pool_init(block_pool_t* p_pool);
+// Takes a block; NULL if the pool is exhausted
+void* block_pool_alloc(block_pool_t* p_pool);
+// Returns a block to its pool (NULL is ignored; a block that is not in use
+// or a pointer that is not a block of the pool is refused and counted)
+void block_pool_free(block_pool_t* p_pool, void* p_block);
+// Returns the number of free blocks
+uint32_t block_pool_available(block_pool_t const* p_pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLOCK_POOL_H__
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: boot_time.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Boot phase timestamps.
+ *
+ *  The RTCs need the LFCLK, which is one of the things being waited for,
+ *  and the DWT cycle counter stops while main() sleeps waiting for FDS,
+ *  so boot is timed with TIMER3 at 1 MHz. It runs from the HFCLK through
+ *  sleep and is stopped as soon as the first advertising event has been
+ *  seen, so it costs nothing after boot. The start-up code before main()
+ *  (RAM initialization) is not covered; it takes well under a millisecond.
+ *
+ *  The first advertising event is taken from the radio notification that
+ *  precedes it, plus the notification lead time.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stdbool.h>
+#include "boot_time.h"
+#include "nrf.h"
+#include "radio_sched.h"
+#include "trace_ring.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Boot timer, capture channels for main and the radio notification
+#define BOOT_TIMER NRF_TIMER3
+#define CAPTURE_MAIN 0
+#define CAPTURE_RADIO 1
+
+static uint32_t m_phase_us[BOOT_PHASE_COUNT];
+static bool m_done;
+
+
+/****************************************************************
+ * Function: timer_capture()
+ * Description: Returns the boot timer value.
+****************************************************************/
+static uint32_t timer_capture(uint8_t channel) {
+    BOOT_TIMER->TASKS_CAPTURE[channel] = 1;
+    return BOOT_TIMER->CC[channel];
+}
+
+
+/****************************************************************
+ * Function: radio_listener()
+ * Description: Records the first radio event after advertising
+ *  started and stops the boot timer.
+****************************************************************/
+static void radio_listener(bool radio_active) {
+    if (!radio_active || m_done || m_phase_us[BOOT_PHASE_ADV_STARTED] == 0) {
+        return;
+    }
+    m_phase_us[BOOT_PHASE_FIRST_ADV] = timer_capture(CAPTURE_RADIO) + RADIO_SCHED_LEAD_US;
+    BOOT_TIMER->TASKS_STOP = 1;
+    m_done = true;
+    trace_ring_add(TRACE_BOOT_TIME, m_phase_us[BOOT_PHASE_FIRST_ADV]);
+}
+
+
+/****************************************************************
+ * Function: boot_time_init()
+ * Description: Starts the boot timer at 1 MHz.
+****************************************************************/
+void boot_time_init(void) {
+    BOOT_TIMER->MODE = TIMER_MODE_MODE_Timer;
+    BOOT_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    BOOT_TIMER->PRESCALER = 4;
+    BOOT_TIMER->TASKS_CLEAR = 1;
+    BOOT_TIMER->TASKS_START = 1;
+    radio_sched_listener_add(radio_listener);
+}
+
+
+/****************************************************************
+ * Function: boot_time_mark()
+ * Description: Records the end of a phase.
+****************************************************************/
+void boot_time_mark(boot_phase_t phase) {
+    if (!m_done) {
+        m_phase_us[phase] = timer_capture(CAPTURE_MAIN);
+    }
+}
+
+
+/****************************************************************
+ * Function: boot_time_get()
+ * Description: Returns the phase times.
+****************************************************************/
+uint32_t const* boot_time_get(void) {
+    return m_phase_us;
+}
@@ -0,0 +1,48 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: boot_time.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Boot phase timestamps. Measures the time from main() to
+ * each step of the start-up sequence and to the first advertising event.
+*******************************************************************************/
+#ifndef BOOT_TIME_H__
+#define BOOT_TIME_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Boot phases, in the order main() completes them
+typedef enum {
+    BOOT_PHASE_CORE,                    // Clocks requested, pools, timers, buttons
+    BOOT_PHASE_SD_ENABLED,              // SoftDevice enabled (LFCLK running)
+    BOOT_PHASE_BLE_ENABLED,             // BLE stack enabled
+    BOOT_PHASE_SERVICES,                // Modules and GATT table built
+    BOOT_PHASE_CFG_LOADED,              // FDS ready, radio profile loaded
+    BOOT_PHASE_ADV_STARTED,             // sd_ble_gap_adv_start() returned
+    BOOT_PHASE_FIRST_ADV,               // First advertising packet on air
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Starts the boot timer (call first in main)
+void boot_time_init(void);
+// Records the end of a phase
+void boot_time_mark(boot_phase_t phase);
+// Returns the phase times in microseconds since main(), 0 if not reached
+uint32_t const* boot_time_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_TIME_H__
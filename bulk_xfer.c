@@ -0,0 +1,488 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: bulk_xfer.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Bulk transfer over an L2CAP connection oriented channel.
+ *
+ *  A notification costs 3 bytes of ATT header per 20 bytes of payload and
+ *  is not flow controlled. On the channel an SDU of up to APP_POOL_SDU_SIZE
+ *  bytes costs 4 + 2 bytes of L2CAP header, and the peer hands out credits
+ *  for the PDUs it can take. Received SDUs are reassembled by the
+ *  SoftDevice straight into pool blocks; if no block is free the credits
+ *  are withheld until one is. Sent SDUs are copied from the blob into pool
+ *  blocks, so blobs may live in flash.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <string.h>
+#include "bulk_xfer.h"
+#include "nrf_sdh_ble.h"
+#include "ble_srv_common.h"
+#include "app_util_platform.h"
+#include "app_timer.h"
+#include "app_ticks.h"
+#include "app_pools.h"
+#include "tx_sched.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE priority value (after tx_sched so completions are counted)
+#define BULK_BLE_OBSERVER_PRIO 3
+
+typedef struct {
+    bool active;
+    bulk_xfer_path_t path;
+    uint16_t conn_handle;
+    uint32_t len;
+    uint32_t offset;                // Bytes handed on
+    bulk_xfer_read_t read;
+    void* p_context;
+    uint32_t started;               // app_timer ticks
+    uint8_t sdus_out;               // L2CAP SDUs held by the SoftDevice
+    uint32_t chunks;                // GATT notifications queued
+    uint32_t chunks_base;           // tx_sched bulk completions at start
+    uint32_t dropped_base;          // tx_sched bulk drops at start
+} transfer_t;
+
+static transfer_t m_xfer;
+// Channel state
+static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;
+static uint16_t m_cid = BLE_L2CAP_CID_INVALID;
+static uint16_t m_tx_mtu;
+static uint8_t m_rx_queued;
+static bool m_rx_paused;
+// GATT path
+static ble_gatts_char_handles_t m_data_handles;
+static bulk_xfer_rx_handler_t m_rx_handler;
+// Benchmark in progress
+static bool m_bench;
+static bulk_xfer_stats_t m_stats;
+
+static void pump(void);
+
+
+/****************************************************************
+ * Function: bench_read()
+ * Description: Fills benchmark blocks with a counting pattern.
+****************************************************************/
+static void bench_read(uint32_t offset, uint8_t* p_dst, uint16_t len, void* p_context) {
+    for (uint16_t i = 0; i < len; i++) {
+        p_dst[i] = (uint8_t)(offset + i);
+    }
+}
+
+
+/****************************************************************
+ * Function: gatt_completed()
+ * Description: Returns the number of GATT chunks of the current
+ *  transfer that went out on air.
+****************************************************************/
+static uint32_t gatt_completed(void) {
+    return tx_sched_stats_get(TX_SCHED_BULK)->sent - m_xfer.chunks_base;
+}
+
+
+/****************************************************************
+ * Function: gatt_dropped()
+ * Description: Returns true if the scheduler dropped a chunk of
+ *  the current transfer (notifications disabled, link going
+ *  down) instead of sending it.
+****************************************************************/
+static bool gatt_dropped(void) {
+    return tx_sched_stats_get(TX_SCHED_BULK)->dropped != m_xfer.dropped_base;
+}
+
+
+/****************************************************************
+ * Function: rx_refill()
+ * Description: Keeps the SoftDevice supplied with SDU buffers.
+ *  Credits are withheld while the pool has nothing to offer.
+****************************************************************/
+static void rx_refill(void) {
+    if (m_cid == BLE_L2CAP_CID_INVALID) {
+        return;
+    }
+    while (m_rx_queued < BULK_XFER_RX_QUEUE_SIZE) {
+        uint8_t* p_block = block_pool_alloc(&g_sdu_pool);
+        if (p_block == NULL) {
+            if (!m_rx_paused) {
+                sd_ble_l2cap_ch_flow_control(m_conn_handle, m_cid, 0, NULL);
+                m_rx_paused = true;
+                m_stats.rx_paused++;
+            }
+            return;
+        }
+        ble_data_t sdu_buf = {.p_data = p_block, .len = APP_POOL_SDU_SIZE};
+        if (sd_ble_l2cap_ch_rx(m_conn_handle, m_cid, &sdu_buf) != NRF_SUCCESS) {
+            block_pool_free(&g_sdu_pool, p_block);
+            return;
+        }
+        m_rx_queued++;
+    }
+    if (m_rx_paused) {
+        sd_ble_l2cap_ch_flow_control(m_conn_handle, m_cid, BLE_L2CAP_CREDITS_DEFAULT, NULL);
+        m_rx_paused = false;
+    }
+}
+
+
+/****************************************************************
+ * Function: transfer_start()
+ * Description: Sets up a blob transfer on the given path.
+****************************************************************/
+static void transfer_start(bulk_xfer_path_t path, uint16_t conn_handle, uint32_t len,
+                           bulk_xfer_read_t read, void* p_context) {
+    memset(&m_xfer, 0, sizeof(m_xfer));
+    m_xfer.active = true;
+    m_xfer.path = path;
+    m_xfer.conn_handle = conn_handle;
+    m_xfer.len = len;
+    m_xfer.read = read;
+    m_xfer.p_context = p_context;
+    m_xfer.started = app_timer_cnt_get();
+    m_xfer.chunks_base = tx_sched_stats_get(TX_SCHED_BULK)->sent;
+    m_xfer.dropped_base = tx_sched_stats_get(TX_SCHED_BULK)->dropped;
+}
+
+
+/****************************************************************
+ * Function: transfer_done()
+ * Description: Records the throughput of a finished blob and
+ *  moves the benchmark on to the GATT path.
+****************************************************************/
+static void transfer_done(void) {
+    uint32_t elapsed_us = APP_TICKS_TO_US(app_timer_cnt_diff_compute(app_timer_cnt_get(), m_xfer.started));
+    bulk_xfer_path_t path = m_xfer.path;
+    m_stats.blobs_sent[path]++;
+    m_stats.kbps_last[path] = (elapsed_us == 0) ? 0 :
+                              (uint32_t)(((uint64_t)m_xfer.len * 8 * 1000) / elapsed_us);
+    m_xfer.active = false;
+
+    if (m_bench && path == BULK_XFER_PATH_L2CAP) {
+        // Started at once, so that only its own time is counted
+        transfer_start(BULK_XFER_PATH_GATT, m_xfer.conn_handle, BULK_XFER_BENCH_BYTES, bench_read, NULL);
+        pump();
+    }
+    else {
+        m_bench = false;
+    }
+}
+
+
+/****************************************************************
+ * Function: transfer_fail()
+ * Description: Ends a blob the SoftDevice or the scheduler
+ *  refused, recording why, and the benchmark with it.
+****************************************************************/
+static void transfer_fail(uint32_t err_code) {
+    m_stats.blobs_failed++;
+    m_stats.err_last = err_code;
+    m_xfer.active = false;
+    m_bench = false;
+}
+
+
+/****************************************************************
+ * Function: pump_l2cap()
+ * Description: Queues SDUs on the channel until the SoftDevice
+ *  holds BULK_XFER_TX_QUEUE_SIZE of them.
+****************************************************************/
+static void pump_l2cap(void) {
+    uint16_t sdu_size = (m_tx_mtu < APP_POOL_SDU_SIZE) ? m_tx_mtu : APP_POOL_SDU_SIZE;
+    while (m_xfer.offset < m_xfer.len && m_xfer.sdus_out < BULK_XFER_TX_QUEUE_SIZE) {
+        uint8_t* p_block = block_pool_alloc(&g_sdu_pool);
+        if (p_block == NULL) {
+            return;
+        }
+        uint32_t remaining = m_xfer.len - m_xfer.offset;
+        uint16_t len = (remaining < sdu_size) ? (uint16_t)remaining : sdu_size;
+        m_xfer.read(m_xfer.offset, p_block, len, m_xfer.p_context);
+
+        ble_data_t sdu_buf = {.p_data = p_block, .len = len};
+        uint32_t err_code = sd_ble_l2cap_ch_tx(m_conn_handle, m_cid, &sdu_buf);
+        if (err_code != NRF_SUCCESS) {
+            block_pool_free(&g_sdu_pool, p_block);
+            if (err_code == NRF_ERROR_RESOURCES) {
+                // Resumed on the next SDU released by the SoftDevice
+                m_stats.tx_stalls++;
+            }
+            else {
+                transfer_fail(err_code);
+            }
+            return;
+        }
+        m_xfer.offset += len;
+        m_xfer.sdus_out++;
+        m_stats.tx_bytes[BULK_XFER_PATH_L2CAP] += len;
+    }
+    if (m_xfer.offset >= m_xfer.len && m_xfer.sdus_out == 0) {
+        transfer_done();
+    }
+}
+
+
+/****************************************************************
+ * Function: pump_gatt()
+ * Description: Queues notifications in the scheduler's bulk
+ *  class, keeping no more outstanding than it will accept. Only
+ *  chunks sent on air count; one the scheduler dropped fails the
+ *  blob.
+****************************************************************/
+static void pump_gatt(void) {
+    if (gatt_dropped()) {
+        transfer_fail(tx_sched_stats_get(TX_SCHED_BULK)->err_last);
+        return;
+    }
+    uint32_t completed = gatt_completed();
+    while (m_xfer.offset < m_xfer.len && (m_xfer.chunks - completed) < TX_SCHED_QUEUED_BULK) {
+        uint8_t* p_block = block_pool_alloc(&g_notif_pool);
+        if (p_block == NULL) {
+            return;
+        }
+        uint32_t remaining = m_xfer.len - m_xfer.offset;
+        uint16_t len = (remaining < APP_POOL_NOTIF_SIZE) ? (uint16_t)remaining : APP_POOL_NOTIF_SIZE;
+        m_xfer.read(m_xfer.offset, p_block, len, m_xfer.p_context);
+        uint32_t err_code = tx_sched_notify(m_xfer.conn_handle, m_data_handles.value_handle,
+                                            TX_SCHED_BULK, p_block, len);
+        if (err_code != NRF_SUCCESS) {
+            transfer_fail(err_code);
+            return;
+        }
+        if (gatt_dropped()) {
+            // Rejected by the SoftDevice as soon as it was queued
+            transfer_fail(tx_sched_stats_get(TX_SCHED_BULK)->err_last);
+            return;
+        }
+        m_xfer.offset += len;
+        m_xfer.chunks++;
+        m_stats.tx_bytes[BULK_XFER_PATH_GATT] += len;
+    }
+    if (m_xfer.offset >= m_xfer.len && completed >= m_xfer.chunks) {
+        transfer_done();
+    }
+}
+
+
+/****************************************************************
+ * Function: pump()
+ * Description: Advances the running transfer, if any.
+****************************************************************/
+static void pump(void) {
+    if (!m_xfer.active) {
+        return;
+    }
+    if (m_xfer.path == BULK_XFER_PATH_L2CAP) {
+        pump_l2cap();
+    }
+    else {
+        pump_gatt();
+    }
+}
+
+
+/****************************************************************
+ * Function: on_ch_setup_request()
+ * Description: Accepts a channel on BULK_XFER_LE_PSM when none
+ *  is open yet. Buffers are supplied once it is set up.
+****************************************************************/
+static void on_ch_setup_request(ble_l2cap_evt_t const* p_evt) {
+    ble_l2cap_ch_setup_params_t params;
+    uint16_t cid = p_evt->local_cid;
+    memset(&params, 0, sizeof(params));
+    params.rx_params.rx_mtu = APP_POOL_SDU_SIZE;
+    params.rx_params.rx_mps = BULK_XFER_MPS;
+    params.rx_params.sdu_buf.p_data = NULL;
+    if (p_evt->params.ch_setup_request.le_psm == BULK_XFER_LE_PSM && m_cid == BLE_L2CAP_CID_INVALID) {
+        params.status = BLE_L2CAP_CH_STATUS_CODE_SUCCESS;
+    }
+    else {
+        params.status = BLE_L2CAP_CH_STATUS_CODE_LE_PSM_NOT_SUPPORTED;
+    }
+    sd_ble_l2cap_ch_setup(p_evt->conn_handle, &cid, &params);
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Runs the channel and both transfer paths.
+ *  BLE_GAP_EVT_DISCONNECTED        - Abort the transfer
+ *  BLE_L2CAP_EVT_CH_SETUP_REQUEST  - Accept/refuse a channel
+ *  BLE_L2CAP_EVT_CH_SETUP          - Channel open, supply buffers
+ *  BLE_L2CAP_EVT_CH_RELEASED       - Channel closed
+ *  BLE_L2CAP_EVT_CH_SDU_BUF_RELEASED - Buffer returned on close
+ *  BLE_L2CAP_EVT_CH_RX             - SDU received
+ *  BLE_L2CAP_EVT_CH_TX             - SDU sent, buffer returned
+ *  BLE_L2CAP_EVT_CH_CREDIT         - Peer granted credits
+ *  BLE_GATTS_EVT_HVN_TX_COMPLETE   - Notifications sent
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    ble_l2cap_evt_t const* p_l2cap = &p_ble_evt->evt.l2cap_evt;
+    CRITICAL_REGION_ENTER();
+    switch (p_ble_evt->header.evt_id) {
+        case BLE_GAP_EVT_DISCONNECTED:
+            if (m_xfer.active && p_ble_evt->evt.gap_evt.conn_handle == m_xfer.conn_handle) {
+                transfer_fail(BLE_ERROR_INVALID_CONN_HANDLE);
+            }
+            break;
+        case BLE_L2CAP_EVT_CH_SETUP_REQUEST:
+            on_ch_setup_request(p_l2cap);
+            break;
+        case BLE_L2CAP_EVT_CH_SETUP:
+            m_conn_handle = p_l2cap->conn_handle;
+            m_cid = p_l2cap->local_cid;
+            m_tx_mtu = p_l2cap->params.ch_setup.tx_params.tx_mtu;
+            m_rx_queued = 0;
+            m_rx_paused = false;
+            rx_refill();
+            break;
+        case BLE_L2CAP_EVT_CH_RELEASED:
+            if (p_l2cap->local_cid == m_cid) {
+                m_cid = BLE_L2CAP_CID_INVALID;
+                m_conn_handle = BLE_CONN_HANDLE_INVALID;
+                if (m_xfer.active && m_xfer.path == BULK_XFER_PATH_L2CAP) {
+                    transfer_fail(NRF_ERROR_INVALID_STATE);
+                }
+            }
+            break;
+        case BLE_L2CAP_EVT_CH_SDU_BUF_RELEASED:
+            block_pool_free(&g_sdu_pool, p_l2cap->params.ch_sdu_buf_released.sdu_buf.p_data);
+            break;
+        case BLE_L2CAP_EVT_CH_RX:
+            m_rx_queued--;
+            m_stats.rx_sdus++;
+            m_stats.rx_bytes += p_l2cap->params.rx.sdu_len;
+            if (m_rx_handler != NULL) {
+                m_rx_handler(p_l2cap->params.rx.sdu_buf.p_data, p_l2cap->params.rx.sdu_len);
+            }
+            block_pool_free(&g_sdu_pool, p_l2cap->params.rx.sdu_buf.p_data);
+            rx_refill();
+            break;
+        case BLE_L2CAP_EVT_CH_TX:
+            block_pool_free(&g_sdu_pool, p_l2cap->params.tx.sdu_buf.p_data);
+            if (m_xfer.active && m_xfer.path == BULK_XFER_PATH_L2CAP) {
+                m_xfer.sdus_out--;
+            }
+            // A block came back, receiving may resume
+            rx_refill();
+            pump();
+            break;
+        case BLE_L2CAP_EVT_CH_CREDIT:
+            m_stats.credits_received += p_l2cap->params.credit.credits;
+            pump();
+            break;
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+            pump();
+            break;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+/****************************************************************
+ * Function: bulk_xfer_cfg_set()
+ * Description: Configures one L2CAP channel per link with
+ *  BULK_XFER_MPS sized PDUs.
+****************************************************************/
+void bulk_xfer_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start) {
+    ble_cfg_t ble_cfg;
+    memset(&ble_cfg, 0, sizeof(ble_cfg));
+    ble_cfg.conn_cfg.conn_cfg_tag = conn_cfg_tag;
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.rx_mps = BULK_XFER_MPS;
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.tx_mps = BULK_XFER_MPS;
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.rx_queue_size = BULK_XFER_RX_QUEUE_SIZE;
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.tx_queue_size = BULK_XFER_TX_QUEUE_SIZE;
+    ble_cfg.conn_cfg.params.l2cap_conn_cfg.ch_count = 1;
+    sd_ble_cfg_set(BLE_CONN_CFG_L2CAP, &ble_cfg, ram_start);
+}
+
+
+/****************************************************************
+ * Function: bulk_xfer_init()
+ * Description: Adds the bulk service with its data
+ *  characteristic (the GATT path).
+****************************************************************/
+void bulk_xfer_init(uint8_t uuid_type, bulk_xfer_rx_handler_t rx_handler) {
+    m_rx_handler = rx_handler;
+
+    // Add service
+    ble_uuid_t ble_uuid;
+    ble_add_char_params_t add_char_params;
+    uint16_t service_handle;
+    ble_uuid.type = uuid_type;
+    ble_uuid.uuid = UUID_BULK_SERVICE;
+    sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &service_handle);
+
+    // Add data characteristic
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid                = UUID_BULK_DATA_CHAR;
+    add_char_params.uuid_type           = uuid_type;
+    add_char_params.init_len            = 0;
+    add_char_params.max_len             = APP_POOL_NOTIF_SIZE;
+    add_char_params.is_var_len          = true;
+    add_char_params.char_props.notify   = 1;
+    add_char_params.cccd_write_access   = SEC_OPEN;
+    characteristic_add(service_handle, &add_char_params, &m_data_handles);
+}
+
+
+/****************************************************************
+ * Function: bulk_xfer_send()
+ * Description: Starts sending a blob, over the channel if the
+ *  central has opened one on this link.
+****************************************************************/
+bool bulk_xfer_send(uint16_t conn_handle, uint32_t len, bulk_xfer_read_t read, void* p_context) {
+    bool started = false;
+    CRITICAL_REGION_ENTER();
+    if (!m_xfer.active && conn_handle != BLE_CONN_HANDLE_INVALID && len > 0) {
+        bulk_xfer_path_t path = (m_cid != BLE_L2CAP_CID_INVALID && m_conn_handle == conn_handle) ?
+                                BULK_XFER_PATH_L2CAP : BULK_XFER_PATH_GATT;
+        transfer_start(path, conn_handle, len, read, p_context);
+        pump();
+        started = true;
+    }
+    CRITICAL_REGION_EXIT();
+    return started;
+}
+
+
+/****************************************************************
+ * Function: bulk_xfer_busy()
+ * Description: Returns true while a blob is being sent.
+****************************************************************/
+bool bulk_xfer_busy(void) {
+    return m_xfer.active;
+}
+
+
+/****************************************************************
+ * Function: bulk_xfer_bench_start()
+ * Description: Sends the benchmark blob over the channel and
+ *  then over GATT (or over GATT only if no channel is open).
+****************************************************************/
+bool bulk_xfer_bench_start(uint16_t conn_handle) {
+    bool started = false;
+    CRITICAL_REGION_ENTER();
+    if (!m_xfer.active) {
+        m_bench = true;
+        started = bulk_xfer_send(conn_handle, BULK_XFER_BENCH_BYTES, bench_read, NULL);
+        m_bench = started;
+    }
+    CRITICAL_REGION_EXIT();
+    return started;
+}
+
+
+/****************************************************************
+ * Function: bulk_xfer_stats_get()
+ * Description: Returns the transfer statistics.
+****************************************************************/
+bulk_xfer_stats_t const* bulk_xfer_stats_get(void) {
+    return &m_stats;
+}
+
+NRF_SDH_BLE_OBSERVER(m_bulk_observer, BULK_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: bulk_xfer.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Bulk transfer of large blobs (journal dumps, crash records).
+ * Blobs go over an L2CAP connection oriented channel with credit based flow
+ * control when the central has opened one, and over notifications of a bulk
+ * data characteristic otherwise.
+*******************************************************************************/
+#ifndef BULK_XFER_H__
+#define BULK_XFER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Bulk service and data characteristic UUIDs (on the application base UUID)
+#define UUID_BULK_SERVICE 0x1400
+#define UUID_BULK_DATA_CHAR 0x1401
+// LE protocol/service multiplexer the central connects the channel to
+#define BULK_XFER_LE_PSM 0x0080
+// Largest L2CAP PDU (an SDU is split into PDUs of this size)
+#define BULK_XFER_MPS 247
+// SDU buffers the SoftDevice may hold per direction
+#define BULK_XFER_RX_QUEUE_SIZE 2
+#define BULK_XFER_TX_QUEUE_SIZE 3
+// Blob size used by the throughput benchmark
+#define BULK_XFER_BENCH_BYTES 16384
+
+typedef enum {
+    BULK_XFER_PATH_L2CAP,
+    BULK_XFER_PATH_GATT,
+    BULK_XFER_PATH_COUNT
+} bulk_xfer_path_t;
+
+// Copies len bytes of the blob starting at offset to p_dst
+typedef void (*bulk_xfer_read_t)(uint32_t offset, uint8_t* p_dst, uint16_t len, void* p_context);
+// Receives an SDU from the central; the data is only valid during the call
+typedef void (*bulk_xfer_rx_handler_t)(uint8_t const* p_data, uint16_t len);
+
+// Transfer statistics
+typedef struct {
+    uint32_t tx_bytes[BULK_XFER_PATH_COUNT];
+    uint32_t blobs_sent[BULK_XFER_PATH_COUNT];
+    uint32_t kbps_last[BULK_XFER_PATH_COUNT];   // Throughput of the last blob
+    uint32_t rx_bytes;
+    uint32_t rx_sdus;
+    uint32_t tx_stalls;                         // SDU refused, SoftDevice queue full
+    uint32_t rx_paused;                         // Credits withheld, no free buffer
+    uint32_t credits_received;
+    uint32_t blobs_failed;
+    uint32_t err_last;                          // Error that ended the last failed blob
+} bulk_xfer_stats_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Reserves SoftDevice memory for the channel (call before nrf_sdh_ble_enable)
+void bulk_xfer_cfg_set(uint8_t conn_cfg_tag, uint32_t ram_start);
+// Adds the bulk service; rx_handler may be NULL
+void bulk_xfer_init(uint8_t uuid_type, bulk_xfer_rx_handler_t rx_handler);
+// Starts sending a blob; false if a transfer is running or there is no link
+bool bulk_xfer_send(uint16_t conn_handle, uint32_t len, bulk_xfer_read_t read, void* p_context);
+// Returns true while a blob is being sent
+bool bulk_xfer_busy(void);
+// Sends BULK_XFER_BENCH_BYTES over the channel (if open), then over GATT;
+// the throughput of each path ends up in kbps_last
+bool bulk_xfer_bench_start(uint16_t conn_handle);
+// Returns the transfer statistics
+bulk_xfer_stats_t const* bulk_xfer_stats_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BULK_XFER_H__
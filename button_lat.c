@@ -0,0 +1,175 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: button_lat.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Button latency probes.
+ *
+ *  app_button senses the button pin, so each edge raises the GPIOTE PORT
+ *  event. A PPI channel starts TIMER2 (1 MHz) on that event; the timer is
+ *  stopped and cleared between measurements, so it only runs (and holds
+ *  the HFCLK) from an edge until the handler has dealt with it. Starting a
+ *  running timer does nothing, so contact bounce keeps the first edge.
+ *
+ *  The handler entry probe captures the time since the edge. Taking off
+ *  app_button's detection delay leaves what the software stack added:
+ *  GPIOTE interrupt latency, app_timer tick rounding and the wait for the
+ *  RTC1 interrupt behind the SoftDevice. That wait is binned separately
+ *  for entries while the radio is active (radio_sched's notification
+ *  window), to show what radio events cost. The probe after
+ *  send_button() captures the handler's own time. An edge that app_button
+ *  filters out leaves the timer running with no handler to stop it; a
+ *  timer wheel check stops it once it has run for STALE_US, and a stale
+ *  value an entry sees before that is dropped.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stdbool.h>
+#include "button_lat.h"
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "radio_sched.h"
+#include "timer_wheel.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+#define PROBE_TIMER NRF_TIMER2
+// Timer prescaler (1 MHz)
+#define PROBE_TIMER_PRESCALER 4
+// Capture channels
+#define CAPTURE_ENTER 0
+#define CAPTURE_SENT 1
+#define CAPTURE_CHECK 2
+// PPI channel from the button edge to the timer (battery uses 0 and 1)
+#define BUTTON_LAT_PPI 2
+// Longer edge to handler times come from an edge no handler followed
+#define STALE_US 1000000
+// Interval of the check for a timer left running by a stale edge
+#define STALE_CHECK_INTERVAL TIMER_WHEEL_TICKS(STALE_US / 1000)
+
+TIMER_WHEEL_DEF(m_stale_timer);
+
+static button_lat_hist_t m_hists[BUTTON_LAT_HIST_COUNT];
+static uint32_t m_debounce_us;
+static uint32_t m_enter_us;
+static bool m_measuring;
+
+
+/****************************************************************
+ * Function: timer_capture()
+ * Description: Returns the time since the edge.
+****************************************************************/
+static uint32_t timer_capture(uint8_t channel) {
+    PROBE_TIMER->TASKS_CAPTURE[channel] = 1;
+    return PROBE_TIMER->CC[channel];
+}
+
+
+/****************************************************************
+ * Function: timer_reset()
+ * Description: Stops and clears the timer for the next edge.
+****************************************************************/
+static void timer_reset(void) {
+    PROBE_TIMER->TASKS_STOP = 1;
+    PROBE_TIMER->TASKS_CLEAR = 1;
+}
+
+
+/****************************************************************
+ * Function: stale_timeout_handler()
+ * Description: Stops the timer if an edge started it and no
+ *  handler followed, so it does not hold the HFCLK until the
+ *  next press.
+****************************************************************/
+static void stale_timeout_handler(void* p_context) {
+    if (!m_measuring && timer_capture(CAPTURE_CHECK) >= STALE_US) {
+        timer_reset();
+    }
+}
+
+
+/****************************************************************
+ * Function: hist_add()
+ * Description: Adds a latency to a histogram.
+****************************************************************/
+static void hist_add(button_lat_hist_id_t id, uint32_t latency_us) {
+    button_lat_hist_t* p_hist = &m_hists[id];
+    uint32_t bin = 0;
+    uint32_t bound = BUTTON_LAT_BIN0_US;
+    while (bin < BUTTON_LAT_BINS - 1 && latency_us >= bound) {
+        bin++;
+        bound <<= 1;
+    }
+    if (p_hist->bins[bin] < UINT16_MAX) {
+        p_hist->bins[bin]++;
+    }
+    p_hist->count++;
+    p_hist->sum_us += latency_us;
+    if (latency_us > p_hist->max_us) {
+        p_hist->max_us = latency_us;
+    }
+}
+
+
+/****************************************************************
+ * Function: button_lat_init()
+ * Description: Sets up the timer, stopped, the PPI channel from
+ *  the GPIOTE PORT event to its start task and the stale edge
+ *  check.
+****************************************************************/
+void button_lat_init(uint32_t debounce_us) {
+    m_debounce_us = debounce_us;
+    PROBE_TIMER->MODE = TIMER_MODE_MODE_Timer;
+    PROBE_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    PROBE_TIMER->PRESCALER = PROBE_TIMER_PRESCALER;
+    timer_reset();
+    sd_ppi_channel_assign(BUTTON_LAT_PPI, &NRF_GPIOTE->EVENTS_PORT, &PROBE_TIMER->TASKS_START);
+    sd_ppi_channel_enable_set(1UL << BUTTON_LAT_PPI);
+    timer_wheel_start(&m_stale_timer, STALE_CHECK_INTERVAL, STALE_CHECK_INTERVAL, stale_timeout_handler, NULL);
+}
+
+
+/****************************************************************
+ * Function: button_lat_enter()
+ * Description: Bins the edge to handler time beyond the debounce
+ *  delay and starts the handler measurement.
+****************************************************************/
+void button_lat_enter(void) {
+    uint32_t since_edge_us = timer_capture(CAPTURE_ENTER);
+    m_measuring = since_edge_us != 0 && since_edge_us < STALE_US;
+    if (!m_measuring) {
+        timer_reset();
+        return;
+    }
+    m_enter_us = since_edge_us;
+    uint32_t excess_us = (since_edge_us > m_debounce_us) ? since_edge_us - m_debounce_us : 0;
+    hist_add(radio_sched_radio_active() ? BUTTON_LAT_DISPATCH_RADIO : BUTTON_LAT_DISPATCH, excess_us);
+}
+
+
+/****************************************************************
+ * Function: button_lat_sent()
+ * Description: Bins the handler time and readies the timer for
+ *  the next edge.
+****************************************************************/
+void button_lat_sent(void) {
+    if (!m_measuring) {
+        return;
+    }
+    hist_add(BUTTON_LAT_HANDLER, timer_capture(CAPTURE_SENT) - m_enter_us);
+    timer_reset();
+    m_measuring = false;
+}
+
+
+/****************************************************************
+ * Function: button_lat_hist_get()
+ * Description: Returns a histogram.
+****************************************************************/
+button_lat_hist_t const* button_lat_hist_get(button_lat_hist_id_t id) {
+    return &m_hists[id];
+}
@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: button_lat.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Button latency probes. The button edge is timestamped in
+ * hardware (GPIOTE PORT event through PPI), and again on entry to the
+ * button handler and after the notification is queued; the deltas are
+ * binned into histograms that are read back over RPC.
+*******************************************************************************/
+#ifndef BUTTON_LAT_H__
+#define BUTTON_LAT_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Histogram bins: bin 0 holds latencies below BUTTON_LAT_BIN0_US, every
+// further bin twice the range of the one before, the last one is open ended
+#define BUTTON_LAT_BINS 12
+#define BUTTON_LAT_BIN0_US 16
+// RPC page size of a histogram
+#define BUTTON_LAT_PAGE_SIZE 16
+
+// Histograms
+typedef enum {
+    BUTTON_LAT_DISPATCH,                // Edge to handler beyond the debounce delay, radio quiet
+    BUTTON_LAT_DISPATCH_RADIO,          // The same with the radio active at handler entry
+    BUTTON_LAT_HANDLER,                 // Handler entry to the notification queued
+    BUTTON_LAT_HIST_COUNT
+} button_lat_hist_id_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t sum_us;
+    uint32_t max_us;
+    uint16_t bins[BUTTON_LAT_BINS];
+} button_lat_hist_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Connects the button edge to the probe timer; debounce_us is app_button's
+// detection delay (call after app_button_init())
+void button_lat_init(uint32_t debounce_us);
+// Probe at button handler entry
+void button_lat_enter(void);
+// Probe after the button state has been queued for sending
+void button_lat_sent(void);
+// Returns a histogram
+button_lat_hist_t const* button_lat_hist_get(button_lat_hist_id_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BUTTON_LAT_H__
@@ -0,0 +1,149 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: coro.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Stackless coroutines.
+ *
+ *  Running coroutines are kept in a small table. A step that yields is
+ *  queued as a radio_sched job, so it runs from the main loop in a gap
+ *  between radio events. A step that awaits an event is resumed from the
+ *  BLE observer while the event is being dispatched, as the event data is
+ *  only valid there; a flow therefore runs at thread level after a yield
+ *  and in the SoftDevice event interrupt after an await. The two never
+ *  overlap: a waiting coroutine has no job queued, a yielded one waits for
+ *  no event. The only window is an await's return, after the event id is
+ *  published, where the event may resume the flow first; the thread level
+ *  step then has nothing left to do but return.
+ *
+ *  If the scheduler queue is full a yielded coroutine is resumed by the
+ *  next SoftDevice event of any kind instead.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stddef.h>
+#include "coro.h"
+#include "nrf_sdh_ble.h"
+#include "app_util_platform.h"
+#include "radio_sched.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE observer priority (after the modules that track connection state)
+#define CORO_BLE_OBSERVER_PRIO 3
+// Awaited "event" of a yield the scheduler could not take
+#define EVT_ANY 0xFFFF
+
+static coro_t* m_coros[CORO_MAX];
+
+static void coro_job(void* p_context);
+
+
+/****************************************************************
+ * Function: coro_step()
+ * Description: Runs a coroutine to its next await, yield or end.
+****************************************************************/
+static void coro_step(coro_t* p_coro, ble_evt_t const* p_ble_evt) {
+    switch (p_coro->fn(p_coro, p_ble_evt)) {
+        case CORO_YIELDED:
+            if (!radio_sched_post(coro_job, p_coro, CORO_STEP_COST_US)) {
+                p_coro->evt_id = EVT_ANY;
+            }
+            break;
+        case CORO_DONE:
+            for (uint32_t i = 0; i < CORO_MAX; i++) {
+                if (m_coros[i] == p_coro) {
+                    m_coros[i] = NULL;
+                }
+            }
+            p_coro->fn = NULL;
+            break;
+        case CORO_WAITING:
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: coro_job()
+ * Description: Scheduler job of a starting or yielded coroutine.
+****************************************************************/
+static void coro_job(void* p_context) {
+    coro_step(p_context, NULL);
+}
+
+
+/****************************************************************
+ * Function: coro_start()
+ * Description: Registers a coroutine and queues its first step.
+****************************************************************/
+bool coro_start(coro_t* p_coro, coro_fn_t fn) {
+    bool started = false;
+    CRITICAL_REGION_ENTER();
+    if (p_coro->fn == NULL) {
+        for (uint32_t i = 0; i < CORO_MAX; i++) {
+            if (m_coros[i] == NULL) {
+                p_coro->fn = fn;
+                p_coro->resume = 0;
+                p_coro->evt_id = 0;
+                m_coros[i] = p_coro;
+                started = true;
+                break;
+            }
+        }
+    }
+    CRITICAL_REGION_EXIT();
+    if (started && !radio_sched_post(coro_job, p_coro, CORO_STEP_COST_US)) {
+        p_coro->evt_id = EVT_ANY;
+    }
+    return started;
+}
+
+
+/****************************************************************
+ * Function: coro_running()
+ * Description: Returns true until the flow has ended.
+****************************************************************/
+bool coro_running(coro_t const* p_coro) {
+    return p_coro->fn != NULL;
+}
+
+
+/****************************************************************
+ * Function: coro_ble_evt()
+ * Description: Resumes the coroutines waiting for this event, or
+ *  for any while disconnecting.
+****************************************************************/
+void coro_ble_evt(ble_evt_t const* p_ble_evt) {
+    uint16_t evt_id = p_ble_evt->header.evt_id;
+    for (uint32_t i = 0; i < CORO_MAX; i++) {
+        coro_t* p_coro = m_coros[i];
+        if (p_coro == NULL || p_coro->evt_id == 0) {
+            continue;
+        }
+        if (p_coro->evt_id == EVT_ANY) {
+            // A yield, it does not expect an event
+            p_coro->evt_id = 0;
+            coro_step(p_coro, NULL);
+        }
+        else if (p_coro->evt_id == evt_id || evt_id == BLE_GAP_EVT_DISCONNECTED) {
+            p_coro->evt_id = 0;
+            coro_step(p_coro, p_ble_evt);
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: BLE observer.
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    coro_ble_evt(p_ble_evt);
+}
+
+NRF_SDH_BLE_OBSERVER(m_coro_observer, CORO_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
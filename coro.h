@@ -0,0 +1,106 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: coro.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Stackless coroutines for multi-step application flows. A flow
+ * is written top to bottom and awaits SoftDevice events or yields to the
+ * radio scheduler between steps; it keeps no stack of its own, only its
+ * resume point and the event it waits for.
+ *
+ *  A flow is a function with the body between CORO_BEGIN() and CORO_END().
+ *  Locals do not survive an await or a yield (the function returns), so
+ *  state that must is kept in a structure that has the coro_t as its first
+ *  member. The awaits work through switch labels, so a flow may not use a
+ *  switch statement of its own around one.
+*******************************************************************************/
+#ifndef CORO_H__
+#define CORO_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Coroutines running at once
+#define CORO_MAX 4
+// Scheduler cost given for a step (radio_sched), the steps are short
+#define CORO_STEP_COST_US 50
+
+// Step results
+typedef enum {
+    CORO_WAITING,                       // Resumed by the awaited event
+    CORO_YIELDED,                       // Resumed by the radio scheduler
+    CORO_DONE
+} coro_status_t;
+
+typedef struct coro_s coro_t;
+// Flow function; p_ble_evt is the event that resumed it (NULL at the start
+// and after a yield), valid until the flow returns
+typedef coro_status_t (*coro_fn_t)(coro_t* p_coro, ble_evt_t const* p_ble_evt);
+
+// Coroutine state
+struct coro_s {
+    coro_fn_t fn;
+    uint16_t resume;                    // Resume point (source line), 0 at the start
+    uint16_t evt_id;                    // Awaited SoftDevice event, 0 when not waiting
+};
+
+// Makes the resume point stores visible before the event can be matched:
+// the event may resume the flow from interrupt context before it returns
+#define CORO_BARRIER() __asm volatile("" ::: "memory")
+
+#define CORO_BEGIN(p_coro)                                                  \
+    switch ((p_coro)->resume) {                                             \
+        case 0:
+
+#define CORO_END(p_coro)                                                    \
+    }                                                                       \
+    return CORO_DONE
+
+// Returns to the radio scheduler; the flow continues in a later gap
+#define CORO_YIELD(p_coro)                                                  \
+    do {                                                                    \
+        (p_coro)->resume = __LINE__;                                        \
+        return CORO_YIELDED;                                                \
+        case __LINE__:;                                                     \
+    } while (0)
+
+// Waits for a SoftDevice event. A disconnection also resumes the flow, so
+// check the event id after the await
+#define CORO_AWAIT_EVT(p_coro, id)                                          \
+    do {                                                                    \
+        (p_coro)->resume = __LINE__;                                        \
+        CORO_BARRIER();                                                     \
+        (p_coro)->evt_id = (id);                                            \
+        return CORO_WAITING;                                                \
+        case __LINE__:;                                                     \
+    } while (0)
+
+// Ends the flow
+#define CORO_EXIT(p_coro) return CORO_DONE
+
+
+/***************************************
+ * Functions
+***************************************/
+// Starts a flow; its first step runs from the radio scheduler. Returns false
+// if the coroutine is still running or CORO_MAX are
+bool coro_start(coro_t* p_coro, coro_fn_t fn);
+// Returns true while the coroutine has not finished
+bool coro_running(coro_t const* p_coro);
+// Feeds a SoftDevice event to the coroutines waiting for it (the module's
+// BLE observer calls this; exposed for the benchmark)
+void coro_ble_evt(ble_evt_t const* p_ble_evt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CORO_H__
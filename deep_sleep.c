@@ -0,0 +1,298 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: deep_sleep.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Inactivity policy.
+ *
+ *  An idle timer runs whenever the device is not connected. When it
+ *  expires, a job in the next radio gap saves the active radio profile and
+ *  the counters to a block in .noinit (checked with a magic number and a
+ *  CRC, like the trace ring), keeps only the RAM sections holding .noinit
+ *  retained, arms the button's SENSE detection and calls
+ *  sd_power_system_off(). The button wakes the chip through a reset with
+ *  RESETREAS.OFF set; main() then uses the retained profile straight away
+ *  instead of waiting for FDS to scan its pages, and advertises at a fast
+ *  interval for a while. The wake-to-advertising time is boot_time's
+ *  main() to first packet time of that boot.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stddef.h>
+#include <string.h>
+#include "deep_sleep.h"
+#include "nrf.h"
+#include "nrf_gpio.h"
+#include "nrf_soc.h"
+#include "nrf_sdh_ble.h"
+#include "boards.h"
+#include "crc16.h"
+#include "timer_wheel.h"
+#include "radio_sched.h"
+#include "boot_time.h"
+#include "trace_ring.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE priority value
+#define DEEP_SLEEP_BLE_OBSERVER_PRIO 2
+// Retained block magic ("SLEP") and layout version
+#define DEEP_SLEEP_MAGIC 0x50454C53
+#define DEEP_SLEEP_VERSION 1
+// Cost of the System OFF job (state, retention and GPIO set-up)
+#define DEEP_SLEEP_JOB_COST_US 200
+// nRF52840 RAM: RAM0-7 have two 4 kB sections each, RAM8 six of 32 kB
+#define RAM_START 0x20000000UL
+#define RAM_SMALL_SECTION 0x1000UL
+#define RAM_SMALL_SECTIONS 2
+#define RAM_SMALL_END 0x10000UL
+#define RAM_LARGE_SECTION 0x8000UL
+#define RAM_LARGE_INDEX 8
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t cfg_valid;
+    uint8_t reserved;
+    deep_sleep_info_t info;
+    radio_cfg_t cfg;                    // Active profile when the device went off
+    uint16_t crc;                       // Over everything above
+} retained_t;
+
+// .noinit bounds (linker script)
+extern uint8_t __start_noinit[];
+extern uint8_t __stop_noinit[];
+
+static retained_t m_retained __attribute__((section(".noinit")));
+static bool m_woken;
+static bool m_wake_recorded;
+static bool m_connected;
+static bool m_off_requested;
+TIMER_WHEEL_DEF(m_idle_timer);
+
+
+/****************************************************************
+ * Function: retained_crc()
+ * Description: Returns the CRC of the retained block.
+****************************************************************/
+static uint16_t retained_crc(void) {
+    return crc16_compute((uint8_t const*)&m_retained, offsetof(retained_t, crc), NULL);
+}
+
+
+/****************************************************************
+ * Function: wake_record()
+ * Description: Adds this boot's wake-to-advertising time to the
+ *  counters once boot_time has it.
+****************************************************************/
+static void wake_record(void) {
+    uint32_t wake_to_adv_us = boot_time_get()[BOOT_PHASE_FIRST_ADV];
+    if (!m_woken || m_wake_recorded || wake_to_adv_us == 0) {
+        return;
+    }
+    m_wake_recorded = true;
+    m_retained.info.wake_to_adv_us = wake_to_adv_us;
+    m_retained.crc = retained_crc();
+}
+
+
+/****************************************************************
+ * Function: ram_retain()
+ * Description: Keeps the RAM sections that hold .noinit powered
+ *  and retained in System OFF.
+****************************************************************/
+static void ram_retain(void) {
+    uintptr_t addr = (uintptr_t)__start_noinit;
+    while (addr < (uintptr_t)__stop_noinit) {
+        uint32_t offset = (uint32_t)(addr - RAM_START);
+        uint32_t index, section, size;
+        if (offset < RAM_SMALL_END) {
+            index = offset / (RAM_SMALL_SECTION * RAM_SMALL_SECTIONS);
+            section = (offset / RAM_SMALL_SECTION) % RAM_SMALL_SECTIONS;
+            size = RAM_SMALL_SECTION;
+        }
+        else {
+            index = RAM_LARGE_INDEX;
+            section = (offset - RAM_SMALL_END) / RAM_LARGE_SECTION;
+            size = RAM_LARGE_SECTION;
+        }
+        sd_power_ram_power_set(index,
+            (POWER_RAM_POWER_S0POWER_On << (POWER_RAM_POWER_S0POWER_Pos + section)) |
+            (POWER_RAM_POWER_S0RETENTION_On << (POWER_RAM_POWER_S0RETENTION_Pos + section)));
+        addr = (addr & ~(uintptr_t)(size - 1)) + size;
+    }
+}
+
+
+/****************************************************************
+ * Function: system_off_job()
+ * Description: Saves the state and enters System OFF, with the
+ *  button as the wake source. Does not return.
+****************************************************************/
+static void system_off_job(void* p_context) {
+    if (m_connected) {
+        return;
+    }
+    wake_record();
+    m_retained.info.off_count++;
+    m_retained.cfg = *radio_cfg_active();
+    m_retained.cfg_valid = true;
+    m_retained.crc = retained_crc();
+    trace_ring_add(TRACE_SYSTEM_OFF, m_retained.info.off_count);
+    ram_retain();
+
+    bsp_board_leds_off();
+    nrf_gpio_cfg_sense_input(bsp_board_button_idx_to_pin(BSP_BOARD_BUTTON_0), BUTTON_PULL,
+                             BUTTONS_ACTIVE_STATE ? NRF_GPIO_PIN_SENSE_HIGH : NRF_GPIO_PIN_SENSE_LOW);
+    sd_power_system_off();
+}
+
+
+/****************************************************************
+ * Function: idle_timeout_handler()
+ * Description: Goes to System OFF in the next radio gap.
+****************************************************************/
+static void idle_timeout_handler(void* p_context) {
+    radio_sched_post(system_off_job, NULL, DEEP_SLEEP_JOB_COST_US);
+}
+
+
+/****************************************************************
+ * Function: idle_timer_start()
+ * Description: Starts counting idle time, if enabled.
+****************************************************************/
+static void idle_timer_start(void) {
+    if (m_retained.info.idle_ms != 0) {
+        uint32_t ticks = TIMER_WHEEL_TICKS(m_retained.info.idle_ms);
+        timer_wheel_start(&m_idle_timer, (ticks < TIMER_WHEEL_MAX_TICKS) ? ticks : TIMER_WHEEL_MAX_TICKS,
+                          0, idle_timeout_handler, NULL);
+    }
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Stops the idle timer while connected.
+ *  BLE_GAP_EVT_CONNECTED    - Connected to peer
+ *  BLE_GAP_EVT_DISCONNECTED - Idle again
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    switch (p_ble_evt->header.evt_id) {
+        case BLE_GAP_EVT_CONNECTED:
+            m_connected = true;
+            timer_wheel_stop(&m_idle_timer);
+            wake_record();
+            break;
+        case BLE_GAP_EVT_DISCONNECTED:
+            m_connected = false;
+            if (m_off_requested) {
+                radio_sched_post(system_off_job, NULL, DEEP_SLEEP_JOB_COST_US);
+            }
+            else {
+                idle_timer_start();
+            }
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: deep_sleep_init()
+ * Description: Keeps the retained block if it is valid, sets it
+ *  up otherwise. A button wake is a reset with RESETREAS.OFF.
+****************************************************************/
+void deep_sleep_init(void) {
+    trace_ring_info_t trace;
+    trace_ring_info_get(&trace);
+    bool valid = m_retained.magic == DEEP_SLEEP_MAGIC && m_retained.version == DEEP_SLEEP_VERSION &&
+                 m_retained.crc == retained_crc();
+    if (!valid) {
+        memset(&m_retained, 0, sizeof(m_retained));
+        m_retained.magic = DEEP_SLEEP_MAGIC;
+        m_retained.version = DEEP_SLEEP_VERSION;
+        m_retained.info.idle_ms = DEEP_SLEEP_IDLE_MS;
+    }
+    m_woken = valid && (trace.reset_reason & POWER_RESETREAS_OFF_Msk) && m_retained.cfg_valid;
+    if (m_woken) {
+        m_retained.info.wake_count++;
+    }
+    // The profile only carries over to the boot that wakes from it
+    m_retained.cfg_valid = false;
+    m_retained.crc = retained_crc();
+}
+
+
+/****************************************************************
+ * Function: deep_sleep_woken()
+ * Description: Returns true if the button woke the device from
+ *  System OFF.
+****************************************************************/
+bool deep_sleep_woken(void) {
+    return m_woken;
+}
+
+
+/****************************************************************
+ * Function: deep_sleep_cfg_get()
+ * Description: Copies the radio profile kept across System OFF.
+****************************************************************/
+bool deep_sleep_cfg_get(radio_cfg_t* p_cfg) {
+    if (!m_woken) {
+        return false;
+    }
+    *p_cfg = m_retained.cfg;
+    return true;
+}
+
+
+/****************************************************************
+ * Function: deep_sleep_start()
+ * Description: Starts the idle timer (the device is advertising).
+****************************************************************/
+void deep_sleep_start(void) {
+    idle_timer_start();
+}
+
+
+/****************************************************************
+ * Function: deep_sleep_idle_set()
+ * Description: Sets the idle time and restarts the count.
+****************************************************************/
+void deep_sleep_idle_set(uint32_t idle_ms) {
+    m_retained.info.idle_ms = idle_ms;
+    m_retained.crc = retained_crc();
+    timer_wheel_stop(&m_idle_timer);
+    if (!m_connected) {
+        idle_timer_start();
+    }
+}
+
+
+/****************************************************************
+ * Function: deep_sleep_enter()
+ * Description: Goes to System OFF in the next radio gap, or
+ *  after the connection ends.
+****************************************************************/
+void deep_sleep_enter(void) {
+    m_off_requested = true;
+    timer_wheel_stop(&m_idle_timer);
+    if (!m_connected) {
+        radio_sched_post(system_off_job, NULL, DEEP_SLEEP_JOB_COST_US);
+    }
+}
+
+
+/****************************************************************
+ * Function: deep_sleep_info_get()
+ * Description: Returns the counters.
+****************************************************************/
+void deep_sleep_info_get(deep_sleep_info_t* p_info) {
+    wake_record();
+    *p_info = m_retained.info;
+}
+
+NRF_SDH_BLE_OBSERVER(m_deep_sleep_observer, DEEP_SLEEP_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
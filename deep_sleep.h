@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: deep_sleep.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Inactivity policy. After a set time without a connection the
+ * device keeps its state in retained RAM and enters System OFF; the button
+ * wakes it (through a reset) and it resumes advertising with the retained
+ * radio profile, without waiting for flash.
+*******************************************************************************/
+#ifndef DEEP_SLEEP_H__
+#define DEEP_SLEEP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "radio_cfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Default time without a connection before System OFF (0 never sleeps)
+#define DEEP_SLEEP_IDLE_MS (5 * 60 * 1000)
+// Advertising after a button wake: interval (0.625 ms units) and how long
+// before it falls back to the profile's interval (10 ms units)
+#define DEEP_SLEEP_WAKE_ADV_INTERVAL 32
+#define DEEP_SLEEP_WAKE_ADV_DURATION 3000
+
+// Counters, kept across System OFF and warm resets
+typedef struct {
+    uint32_t idle_ms;                   // Current idle time before System OFF
+    uint32_t off_count;                 // System OFF entries
+    uint32_t wake_count;                // Button wakes
+    uint32_t wake_to_adv_us;            // Last wake: main() to the first advertising packet
+} deep_sleep_info_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Checks the retained state (call after trace_ring_init(), which reads the reset reason)
+void deep_sleep_init(void);
+// Returns true if this boot is a wake from System OFF
+bool deep_sleep_woken(void);
+// Copies the radio profile in use when the device went off; false if there is none
+bool deep_sleep_cfg_get(radio_cfg_t* p_cfg);
+// Starts counting idle time (call once advertising has started)
+void deep_sleep_start(void);
+// Sets the idle time before System OFF, 0 disables it
+void deep_sleep_idle_set(uint32_t idle_ms);
+// Enters System OFF now, or as soon as the connection ends
+void deep_sleep_enter(void);
+// Returns the counters
+void deep_sleep_info_get(deep_sleep_info_t* p_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEEP_SLEEP_H__
@@ -0,0 +1,212 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: energy_mon.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Energy event counters.
+ *
+ *  CPU awake time comes from the DWT cycle counter, which only runs while
+ *  the CPU clock does, so everything executed between sleeps is counted
+ *  (SoftDevice interrupts included) at no cost per wake-up. It wraps every
+ *  67 s at 64 MHz and is folded into a microsecond count well before.
+ *  Radio time comes from the radio notifications radio_sched already
+ *  receives: active to inactive, minus the notification lead time.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include "energy_mon.h"
+#include "nrf.h"
+#include "nrf_sdh_ble.h"
+#include "nrf_sdh_soc.h"
+#include "nrf_soc.h"
+#include "app_util_platform.h"
+#include "app_timer.h"
+#include "app_ticks.h"
+#include "radio_sched.h"
+#include "timer_wheel.h"
+#include "tx_sched.h"
+#include "battery.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE and SoC priority values
+#define ENERGY_BLE_OBSERVER_PRIO 2
+#define ENERGY_SOC_OBSERVER_PRIO 1
+// CPU cycles per microsecond
+#define CYCLES_PER_US (SystemCoreClock / 1000000)
+// Cycle counter folding interval (well inside its 67 s wrap)
+#define FOLD_INTERVAL TIMER_WHEEL_TICKS(30000)
+
+TIMER_WHEEL_DEF(m_fold_timer);
+
+static energy_mon_snapshot_t m_counters;
+// Cycle counter folding
+static uint32_t m_last_cyccnt;
+static uint32_t m_cycles_rem;
+// Connection time
+static bool m_connected;
+static uint32_t m_connected_since;      // Wheel ticks
+static uint32_t m_connected_ticks;
+// Radio event in progress
+static uint32_t m_radio_start;
+static bool m_radio_connected;
+// Button handling cycles
+static uint32_t m_button_cycles_rem;
+
+
+/****************************************************************
+ * Function: ticks_to_ms()
+ * Description: Converts wheel ticks to milliseconds.
+****************************************************************/
+static uint32_t ticks_to_ms(uint32_t ticks) {
+    return (uint32_t)(((uint64_t)ticks * 1000) / TIMER_WHEEL_FREQ);
+}
+
+
+/****************************************************************
+ * Function: awake_fold()
+ * Description: Moves the cycles counted since the last fold
+ *  into the awake time.
+****************************************************************/
+static void awake_fold(void) {
+    CRITICAL_REGION_ENTER();
+    uint32_t now = DWT->CYCCNT;
+    uint32_t cycles = (now - m_last_cyccnt) + m_cycles_rem;
+    m_last_cyccnt = now;
+    m_counters.awake_us += cycles / CYCLES_PER_US;
+    m_cycles_rem = cycles % CYCLES_PER_US;
+    CRITICAL_REGION_EXIT();
+}
+
+
+/****************************************************************
+ * Function: fold_timeout_handler()
+ * Description: Folds the cycle counter before it can wrap.
+****************************************************************/
+static void fold_timeout_handler(void* p_context) {
+    awake_fold();
+}
+
+
+/****************************************************************
+ * Function: radio_listener()
+ * Description: Counts radio events and their radio time, split
+ *  by connection state at the start of the event.
+****************************************************************/
+static void radio_listener(bool radio_active) {
+    uint32_t now = app_timer_cnt_get();
+    if (radio_active) {
+        m_radio_start = now;
+        m_radio_connected = m_connected;
+        if (m_radio_connected) {
+            m_counters.conn_events++;
+        }
+        else {
+            m_counters.adv_events++;
+        }
+        return;
+    }
+    uint32_t span_us = APP_TICKS_TO_US(app_timer_cnt_diff_compute(now, m_radio_start));
+    uint32_t radio_us = (span_us > RADIO_SCHED_LEAD_US) ? span_us - RADIO_SCHED_LEAD_US : 0;
+    if (m_radio_connected) {
+        m_counters.conn_radio_us += radio_us;
+    }
+    else {
+        m_counters.adv_radio_us += radio_us;
+    }
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Tracks time spent connected.
+ *  BLE_GAP_EVT_CONNECTED    - Start of connected time
+ *  BLE_GAP_EVT_DISCONNECTED - End of connected time
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    switch (p_ble_evt->header.evt_id) {
+        case BLE_GAP_EVT_CONNECTED:
+            m_connected = true;
+            m_connected_since = timer_wheel_now();
+            break;
+        case BLE_GAP_EVT_DISCONNECTED:
+            if (m_connected) {
+                m_connected_ticks += timer_wheel_now() - m_connected_since;
+                m_connected = false;
+            }
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: soc_evt_handler()
+ * Description: Counts completed flash operations.
+****************************************************************/
+static void soc_evt_handler(uint32_t evt_id, void* p_context) {
+    if (evt_id == NRF_EVT_FLASH_OPERATION_SUCCESS) {
+        m_counters.flash_ops++;
+    }
+}
+
+
+/****************************************************************
+ * Function: energy_mon_init()
+ * Description: Starts the cycle counter and the radio listener.
+****************************************************************/
+void energy_mon_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    m_last_cyccnt = 0;
+
+    radio_sched_listener_add(radio_listener);
+    timer_wheel_start(&m_fold_timer, FOLD_INTERVAL, FOLD_INTERVAL, fold_timeout_handler, NULL);
+}
+
+
+/****************************************************************
+ * Function: energy_mon_mark()
+ * Description: Returns the cycle counter.
+****************************************************************/
+uint32_t energy_mon_mark(void) {
+    return DWT->CYCCNT;
+}
+
+
+/****************************************************************
+ * Function: energy_mon_button_done()
+ * Description: Counts a button event and its handling time.
+****************************************************************/
+void energy_mon_button_done(uint32_t mark) {
+    uint32_t cycles = (DWT->CYCCNT - mark) + m_button_cycles_rem;
+    m_counters.button_events++;
+    m_counters.button_cpu_us += cycles / CYCLES_PER_US;
+    m_button_cycles_rem = cycles % CYCLES_PER_US;
+}
+
+
+/****************************************************************
+ * Function: energy_mon_snapshot()
+ * Description: Copies all counters, bringing the time based
+ *  ones up to date first.
+****************************************************************/
+void energy_mon_snapshot(energy_mon_snapshot_t* p_snapshot) {
+    awake_fold();
+    CRITICAL_REGION_ENTER();
+    uint32_t now = timer_wheel_now();
+    uint32_t connected_ticks = m_connected_ticks + (m_connected ? now - m_connected_since : 0);
+    *p_snapshot = m_counters;
+    p_snapshot->uptime_ms = ticks_to_ms(now);
+    p_snapshot->connected_ms = ticks_to_ms(connected_ticks);
+    p_snapshot->conn_events_saved = tx_sched_batch_stats_get()->events_saved;
+    p_snapshot->supply_mv = battery_mv();
+    CRITICAL_REGION_EXIT();
+}
+
+NRF_SDH_BLE_OBSERVER(m_energy_ble_observer, ENERGY_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+NRF_SDH_SOC_OBSERVER(m_energy_soc_observer, ENERGY_SOC_OBSERVER_PRIO, soc_evt_handler, NULL);
@@ -0,0 +1,60 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: energy_mon.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Energy event counters. Counts radio events and radio time
+ * (advertising and connected), CPU awake time, flash operations and button
+ * events, plus the supply voltage, so tools/energy/energy_model.py can turn a recorded series of
+ * snapshots into charge estimates.
+*******************************************************************************/
+#ifndef ENERGY_MON_H__
+#define ENERGY_MON_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Snapshot bytes returned per RPC page
+#define ENERGY_MON_PAGE_SIZE 16
+
+// Counter snapshot; every counter is free running and wraps at 2^32, so
+// consumers work on differences between snapshots
+typedef struct __attribute__((packed)) {
+    uint32_t uptime_ms;
+    uint32_t connected_ms;
+    uint32_t awake_us;                  // CPU clock running (DWT cycle counter)
+    uint32_t flash_ops;                 // Flash writes and erases completed
+    uint32_t adv_events;                // Radio events while not connected
+    uint32_t conn_events;               // Radio events while connected
+    uint32_t adv_radio_us;              // Radio time of those events
+    uint32_t conn_radio_us;
+    uint32_t button_events;
+    uint32_t button_cpu_us;             // CPU time spent handling them
+    uint32_t conn_events_saved;         // Avoided by notification batching (tx_sched)
+    uint32_t supply_mv;                 // Filtered supply voltage (battery.h), not a counter
+} energy_mon_snapshot_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Starts the counters (call after radio_sched_init and timer_wheel_init)
+void energy_mon_init(void);
+// Returns a mark for energy_mon_button_done()
+uint32_t energy_mon_mark(void);
+// Counts a button event whose handling started at mark
+void energy_mon_button_done(uint32_t mark);
+// Takes a snapshot of all counters
+void energy_mon_snapshot(energy_mon_snapshot_t* p_snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENERGY_MON_H__
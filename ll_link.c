@@ -0,0 +1,398 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: ll_link.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Low latency proprietary link over the SoftDevice Radio
+ * Timeslot API. Sending a packet requests the earliest available timeslot;
+ * inside the slot the radio is driven directly as an ESB transmitter (PTX)
+ * and waits for the dongle's acknowledgement, retransmitting while the slot
+ * lasts. The BLE connection keeps running in between timeslots.
+ *
+ * NOTE: the HFXO is kept running while the link is enabled so a timeslot
+ *  can start without waiting for the crystal. This trades idle current
+ *  for latency.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <string.h>
+#include "ll_link.h"
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_sdh_soc.h"
+#include "app_timer.h"
+#include "app_ticks.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// SoC event observer priority
+#define LL_SOC_OBSERVER_PRIO 1
+// Timeslot length and the time reserved at its end to shut the radio down
+#define SLOT_LENGTH_US 1500
+#define SLOT_MARGIN_US 200
+// Give up on a timeslot request after this long (BLE event in the way)
+#define SLOT_TIMEOUT_US 10000
+// Time to wait for the acknowledgement after a transmission
+#define ACK_TIMEOUT_US 250
+// Transmissions per packet before it is dropped
+#define MAX_ATTEMPTS 4
+
+// Packet layout: length, S1 (PID and no-ack bit), payload
+#define PACKET_HEADER_LEN 2
+// S1 no-ack bit: as in ESB, set when the packet wants an ACK
+#define PACKET_S1_ACK 0x01
+
+typedef struct {
+    uint8_t len;
+    uint8_t data[LL_LINK_MAX_PAYLOAD];
+    uint32_t queued;
+} ll_packet_t;
+
+typedef enum {
+    STATE_IDLE,
+    STATE_TX,
+    STATE_RX_ACK,
+    STATE_ACK_TIMEOUT
+} ll_state_t;
+
+// Packet queue, filled by the application and drained in timeslots
+static ll_packet_t m_queue[LL_LINK_QUEUE_SIZE];
+static volatile uint8_t m_head;
+static volatile uint8_t m_tail;
+static volatile bool m_slot_pending;
+// Timeslot state
+static ll_state_t m_state;
+static uint8_t m_attempts;
+static uint8_t m_pid;
+static uint8_t m_tx_packet[PACKET_HEADER_LEN + LL_LINK_MAX_PAYLOAD];
+static uint8_t m_rx_packet[PACKET_HEADER_LEN + LL_LINK_MAX_PAYLOAD];
+static nrf_radio_request_t m_request;
+static nrf_radio_signal_callback_return_param_t m_signal_return;
+// Statistics
+static ll_link_stats_t m_stats;
+
+
+/****************************************************************
+ * Function: queue_empty()
+ * Description: Returns true if no packet is waiting.
+****************************************************************/
+static bool queue_empty(void) {
+    return m_head == m_tail;
+}
+
+
+/****************************************************************
+ * Function: request_build()
+ * Description: Fills in a request for the earliest possible
+ *  timeslot.
+****************************************************************/
+static void request_build(void) {
+    memset(&m_request, 0, sizeof(m_request));
+    m_request.request_type = NRF_RADIO_REQ_TYPE_EARLIEST;
+    m_request.params.earliest.hfclk = NRF_RADIO_HFCLK_CFG_NO_GUARANTEE;
+    m_request.params.earliest.priority = NRF_RADIO_PRIORITY_NORMAL;
+    m_request.params.earliest.length_us = SLOT_LENGTH_US;
+    m_request.params.earliest.timeout_us = SLOT_TIMEOUT_US;
+}
+
+
+/****************************************************************
+ * Function: slot_request()
+ * Description: Requests the earliest possible timeslot.
+****************************************************************/
+static void slot_request(void) {
+    request_build();
+    sd_radio_request(&m_request);
+}
+
+
+/****************************************************************
+ * Function: radio_configure()
+ * Description: Sets the radio up as an ESB transmitter with
+ *  dynamic payload length.
+****************************************************************/
+static void radio_configure(void) {
+    NRF_RADIO->POWER = 1;
+    NRF_RADIO->TXPOWER = RADIO_TXPOWER_TXPOWER_0dBm << RADIO_TXPOWER_TXPOWER_Pos;
+    NRF_RADIO->MODE = RADIO_MODE_MODE_Nrf_2Mbit << RADIO_MODE_MODE_Pos;
+    NRF_RADIO->FREQUENCY = LL_LINK_RF_CHANNEL;
+    NRF_RADIO->PCNF0 = (6 << RADIO_PCNF0_LFLEN_Pos) | (3 << RADIO_PCNF0_S1LEN_Pos);
+    NRF_RADIO->PCNF1 = (LL_LINK_MAX_PAYLOAD << RADIO_PCNF1_MAXLEN_Pos) |
+                       (4 << RADIO_PCNF1_BALEN_Pos) |
+                       (RADIO_PCNF1_ENDIAN_Big << RADIO_PCNF1_ENDIAN_Pos) |
+                       (RADIO_PCNF1_WHITEEN_Disabled << RADIO_PCNF1_WHITEEN_Pos);
+    NRF_RADIO->BASE0 = LL_LINK_BASE_ADDR;
+    NRF_RADIO->PREFIX0 = LL_LINK_PREFIX;
+    NRF_RADIO->TXADDRESS = 0;
+    NRF_RADIO->RXADDRESSES = 1;
+    NRF_RADIO->CRCCNF = RADIO_CRCCNF_LEN_Two << RADIO_CRCCNF_LEN_Pos;
+    NRF_RADIO->CRCINIT = 0xFFFF;
+    NRF_RADIO->CRCPOLY = 0x11021;
+    NRF_RADIO->EVENTS_DISABLED = 0;
+    NRF_RADIO->INTENSET = RADIO_INTENSET_DISABLED_Msk;
+    NVIC_EnableIRQ(RADIO_IRQn);
+}
+
+
+/****************************************************************
+ * Function: packet_transmit()
+ * Description: Transmits the packet at the head of the queue.
+ *  The radio switches to receive on its own to catch the ACK.
+****************************************************************/
+static void packet_transmit(void) {
+    ll_packet_t const* p_packet = &m_queue[m_head];
+    m_tx_packet[0] = p_packet->len;
+    m_tx_packet[1] = (m_pid << 1) | PACKET_S1_ACK;
+    memcpy(&m_tx_packet[PACKET_HEADER_LEN], p_packet->data, p_packet->len);
+
+    m_state = STATE_TX;
+    m_attempts++;
+    NRF_RADIO->PACKETPTR = (uint32_t)m_tx_packet;
+    NRF_RADIO->SHORTS = RADIO_SHORTS_READY_START_Msk |
+                        RADIO_SHORTS_END_DISABLE_Msk |
+                        RADIO_SHORTS_DISABLED_RXEN_Msk;
+    NRF_RADIO->TASKS_TXEN = 1;
+}
+
+
+/****************************************************************
+ * Function: packet_done()
+ * Description: Removes the head packet from the queue, either
+ *  because it was acknowledged or because it ran out of attempts.
+****************************************************************/
+static void packet_done(bool acked) {
+    if (acked) {
+        uint32_t latency = APP_TICKS_TO_US(app_timer_cnt_diff_compute(app_timer_cnt_get(),
+                                                                      m_queue[m_head].queued));
+        m_stats.sent++;
+        m_stats.latency_last_us = latency;
+        if (latency > m_stats.latency_max_us) {
+            m_stats.latency_max_us = latency;
+        }
+    }
+    else {
+        m_stats.failed++;
+    }
+    m_pid = (m_pid + 1) & 0x03;
+    m_attempts = 0;
+    m_head = (m_head + 1) % LL_LINK_QUEUE_SIZE;
+}
+
+
+/****************************************************************
+ * Function: slot_end()
+ * Description: Stops the radio and hands the slot back. Another
+ *  slot is requested right away if packets are still waiting.
+****************************************************************/
+static void slot_end(void) {
+    NRF_RADIO->SHORTS = 0;
+    NRF_RADIO->INTENCLR = 0xFFFFFFFF;
+    NRF_RADIO->TASKS_DISABLE = 1;
+    NRF_TIMER0->INTENCLR = 0xFFFFFFFF;
+    m_state = STATE_IDLE;
+
+    m_slot_pending = false;
+    if (queue_empty()) {
+        m_signal_return.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_END;
+    }
+    else {
+        m_slot_pending = true;
+        request_build();
+        m_signal_return.params.request.p_next = &m_request;
+        m_signal_return.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_REQUEST_AND_END;
+    }
+}
+
+
+/****************************************************************
+ * Function: next_packet()
+ * Description: Sends the next packet if there is one and enough
+ *  of the slot is left, otherwise ends the slot.
+****************************************************************/
+static void next_packet(void) {
+    NRF_TIMER0->TASKS_CAPTURE[2] = 1;
+    bool time_left = NRF_TIMER0->CC[2] + 2 * ACK_TIMEOUT_US < SLOT_LENGTH_US - SLOT_MARGIN_US;
+    if (!queue_empty() && time_left) {
+        packet_transmit();
+    }
+    else {
+        slot_end();
+    }
+}
+
+
+/****************************************************************
+ * Function: radio_signal()
+ * Description: Handles the radio DISABLED event, which ends the
+ *  transmit, receive and abort phases.
+****************************************************************/
+static void radio_signal(void) {
+    if (!NRF_RADIO->EVENTS_DISABLED) {
+        return;
+    }
+    NRF_RADIO->EVENTS_DISABLED = 0;
+
+    switch (m_state) {
+        case STATE_TX:
+            // Radio is ramping up for RX already, listen for the ACK
+            NRF_RADIO->SHORTS = RADIO_SHORTS_READY_START_Msk | RADIO_SHORTS_END_DISABLE_Msk;
+            NRF_RADIO->PACKETPTR = (uint32_t)m_rx_packet;
+            NRF_TIMER0->TASKS_CAPTURE[1] = 1;
+            NRF_TIMER0->CC[1] += ACK_TIMEOUT_US;
+            NRF_TIMER0->EVENTS_COMPARE[1] = 0;
+            NRF_TIMER0->INTENSET = TIMER_INTENSET_COMPARE1_Msk;
+            m_state = STATE_RX_ACK;
+            break;
+        case STATE_RX_ACK:
+            if (NRF_RADIO->CRCSTATUS == RADIO_CRCSTATUS_CRCSTATUS_CRCOk) {
+                NRF_TIMER0->INTENCLR = TIMER_INTENCLR_COMPARE1_Msk;
+                packet_done(true);
+                next_packet();
+            }
+            else {
+                // Corrupted ACK, listen again until the timeout (still
+                // armed, it ends the attempt like a missing ACK)
+                NRF_RADIO->TASKS_RXEN = 1;
+            }
+            break;
+        case STATE_ACK_TIMEOUT:
+            if (m_attempts >= MAX_ATTEMPTS) {
+                packet_done(false);
+            }
+            else {
+                m_stats.retransmits++;
+            }
+            next_packet();
+            break;
+        default:
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: timer_signal()
+ * Description: Handles the ACK timeout (CC1) and the end of the
+ *  timeslot (CC0).
+****************************************************************/
+static void timer_signal(void) {
+    if (NRF_TIMER0->EVENTS_COMPARE[0]) {
+        NRF_TIMER0->EVENTS_COMPARE[0] = 0;
+        slot_end();
+        return;
+    }
+    if (NRF_TIMER0->EVENTS_COMPARE[1]) {
+        NRF_TIMER0->EVENTS_COMPARE[1] = 0;
+        NRF_TIMER0->INTENCLR = TIMER_INTENCLR_COMPARE1_Msk;
+        if (m_state == STATE_RX_ACK) {
+            m_state = STATE_ACK_TIMEOUT;
+            NRF_RADIO->SHORTS = 0;
+            NRF_RADIO->TASKS_DISABLE = 1;
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: timeslot_callback()
+ * Description: Timeslot signal handler. Runs at the highest
+ *  interrupt priority, so it only drives the radio state machine.
+****************************************************************/
+static nrf_radio_signal_callback_return_param_t* timeslot_callback(uint8_t signal_type) {
+    m_signal_return.params.request.p_next = NULL;
+    m_signal_return.callback_action = NRF_RADIO_SIGNAL_CALLBACK_ACTION_NONE;
+
+    switch (signal_type) {
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_START:
+            m_stats.slots++;
+            // TIMER0 starts at zero with the slot, CC0 marks its end
+            NRF_TIMER0->CC[0] = SLOT_LENGTH_US - SLOT_MARGIN_US;
+            NRF_TIMER0->EVENTS_COMPARE[0] = 0;
+            NRF_TIMER0->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+            NVIC_EnableIRQ(TIMER0_IRQn);
+            radio_configure();
+            next_packet();
+            break;
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_RADIO:
+            radio_signal();
+            break;
+        case NRF_RADIO_CALLBACK_SIGNAL_TYPE_TIMER0:
+            timer_signal();
+            break;
+        default:
+            break;
+    }
+    return &m_signal_return;
+}
+
+
+/****************************************************************
+ * Function: soc_evt_handler()
+ * Description: Retries timeslot requests that the SoftDevice
+ *  could not grant.
+****************************************************************/
+static void soc_evt_handler(uint32_t evt_id, void* p_context) {
+    switch (evt_id) {
+        case NRF_EVT_RADIO_BLOCKED:
+        case NRF_EVT_RADIO_CANCELED:
+            m_stats.blocked++;
+            if (m_slot_pending) {
+                slot_request();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: ll_link_send()
+ * Description: Queues a packet and requests a timeslot if none
+ *  is pending. The timeslot callback can preempt this function
+ *  but never the other way around.
+****************************************************************/
+bool ll_link_send(uint8_t const* p_data, uint8_t len) {
+    uint8_t next = (m_tail + 1) % LL_LINK_QUEUE_SIZE;
+    if (len > LL_LINK_MAX_PAYLOAD || next == m_head) {
+        m_stats.dropped++;
+        return false;
+    }
+    ll_packet_t* p_packet = &m_queue[m_tail];
+    p_packet->len = len;
+    memcpy(p_packet->data, p_data, len);
+    p_packet->queued = app_timer_cnt_get();
+    m_tail = next;
+
+    if (!m_slot_pending) {
+        m_slot_pending = true;
+        slot_request();
+    }
+    return true;
+}
+
+
+/****************************************************************
+ * Function: ll_link_stats_get()
+ * Description: Returns the link statistics.
+****************************************************************/
+ll_link_stats_t const* ll_link_stats_get(void) {
+    return &m_stats;
+}
+
+
+/****************************************************************
+ * Function: ll_link_init()
+ * Description: Keeps the HFXO running and opens the timeslot
+ *  session.
+****************************************************************/
+void ll_link_init(void) {
+    sd_clock_hfclk_request();
+    sd_radio_session_open(timeslot_callback);
+}
+
+NRF_SDH_SOC_OBSERVER(m_ll_soc_observer, LL_SOC_OBSERVER_PRIO, soc_evt_handler, NULL);
@@ -0,0 +1,64 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: ll_link.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Low latency proprietary link. Short packets are sent to a
+ * paired dongle in Enhanced ShockBurst format (2 Mbit, dynamic payload,
+ * acknowledged) inside SoftDevice radio timeslots, alongside the BLE link.
+ * Packets are sent from the button handler, so the press to dongle latency
+ * also includes app_button's detection delay (BUTTON_DETECTION_DELAY_MS in
+ * main.c), which the link statistics do not cover.
+*******************************************************************************/
+#ifndef LL_LINK_H__
+#define LL_LINK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// RF channel (2400 MHz + n) and address shared with the dongle (PRX)
+#define LL_LINK_RF_CHANNEL 78
+#define LL_LINK_BASE_ADDR 0xE7E7E7E7
+#define LL_LINK_PREFIX 0xE7
+// Largest payload in bytes
+#define LL_LINK_MAX_PAYLOAD 8
+// Packets waiting for a timeslot (power of two)
+#define LL_LINK_QUEUE_SIZE 8
+// Message types
+#define LL_LINK_MSG_BUTTON 0x01
+
+// Link statistics
+typedef struct {
+    uint32_t sent;                  // Packets acknowledged by the dongle
+    uint32_t failed;                // Packets dropped after all attempts
+    uint32_t dropped;               // Packets refused (queue full)
+    uint32_t retransmits;
+    uint32_t slots;                 // Timeslots granted
+    uint32_t blocked;               // Timeslot requests blocked/cancelled
+    uint32_t latency_last_us;       // ll_link_send() to ack, not from the button edge
+    uint32_t latency_max_us;
+} ll_link_stats_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Opens the timeslot session (call after the SoftDevice is enabled)
+void ll_link_init(void);
+// Queues a packet for the dongle; false if it cannot be queued
+bool ll_link_send(uint8_t const* p_data, uint8_t len);
+// Returns the link statistics
+ll_link_stats_t const* ll_link_stats_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LL_LINK_H__
@@ -2,7 +2,7 @@
  * Project: nRF52840 Tech Demo (Server)
  * File: main.c
  * Author: Michael Barnes
- * Last Modified: 12/10/20
+ * Last Modified: 10/17/26
  * Description: Basic communication test for the nRF52840. Can be connected to
  * a separate dongle (via nRF connect) to control the on-board LED.
 *******************************************************************************/
@@ -20,6 +20,28 @@
 #include "boards.h"
 #include "app_timer.h"
 #include "app_button.h"
+#include "nrf_pwr_mgmt.h"
+#include "nrf_drv_clock.h"
+
+#include "ble_diag.h"
+#include "radio_sched.h"
+#include "ll_link.h"
+#include "timer_wheel.h"
+#include "app_pools.h"
+#include "tx_sched.h"
+#include "bulk_xfer.h"
+#include "rpc.h"
+#include "radio_cfg.h"
+#include "energy_mon.h"
+#include "trace_ring.h"
+#include "pc_sample.h"
+#include "boot_time.h"
+#include "deep_sleep.h"
+#include "battery.h"
+#include "temp_mon.h"
+#include "button_lat.h"
+#include "app_ticks.h"
+#include "coro.h"
 
 
 /***************************************
@@ -29,7 +51,7 @@
 #define APP_BLE_OBSERVER_PRIO 3
 // Config tag
 #define APP_BLE_CONN_CFG_TAG 1
-// GAP details
+// GAP details (defaults, see radio_cfg.h for runtime changes)
 #define DEVICE_NAME "nRF52840_TechDemo"
 #define MIN_CONN_INTERVAL MSEC_TO_UNITS(100, UNIT_1_25_MS)
 #define MAX_CONN_INTERVAL MSEC_TO_UNITS(200, UNIT_1_25_MS)
@@ -38,40 +60,70 @@
 // Advertising constants
 #define APP_ADV_INTERVAL 64
 #define APP_ADV_DURATION BLE_GAP_ADV_TIMEOUT_GENERAL_UNLIMITED
+// Advertising interval on a low battery: scaled up, capped at 10.24 s
+#define LOW_BATTERY_ADV_SCALE 4
+#define LOW_BATTERY_ADV_INTERVAL_MAX MSEC_TO_UNITS(10240, UNIT_0_625_MS)
+// Company ID of the manufacturer data carrying the die temperature (Nordic)
+#define ADV_COMPANY_ID 0x0059
 //Connection parameters
-#define FIRST_CONN_PARAMS_UPDATE_DELAY APP_TIMER_TICKS(20000)
-#define NEXT_CONN_PARAMS_UPDATE_DELAY APP_TIMER_TICKS(5000)
+#define FIRST_CONN_PARAMS_UPDATE_DELAY_MS 20000
+#define NEXT_CONN_PARAMS_UPDATE_DELAY_MS 5000
 #define MAX_CONN_PARAMS_UPDATE_COUNT 3
 // UUID
 #define UUID_BASE {0x23, 0xD1, 0xBC, 0xEA, 0x5F, 0x78, 0x23, 0x15, \
                    0xDE, 0xEF, 0x12, 0x12, 0x00, 0x00, 0x00, 0x00}
 #define UUID_SERVICE 0x1234
 #define UUID_BUTTON_CHAR 0x1234
+// app_button debounce (detection delay)
+#define BUTTON_DETECTION_DELAY_MS 50
+// Also send button events to the paired dongle over the low latency link
+#define LL_LINK_ENABLED 0
+// Button presses start the bulk transfer benchmark (L2CAP vs GATT)
+#define BULK_BENCH_ENABLED 0
+// RPC method numbers (index into m_rpc_methods)
+#define RPC_METHOD_PING 0
+#define RPC_METHOD_LED 1
+#define RPC_METHOD_BULK_BENCH 2
+#define RPC_METHOD_ENERGY 3
+#define RPC_METHOD_TRACE 4
+#define RPC_METHOD_BOOT_TIME 5
+#define RPC_METHOD_SLEEP 6
+#define RPC_METHOD_BUTTON_LAT 7
+#define RPC_METHOD_DISC_REASONS 8
+#define RPC_METHOD_CHANNEL_ENERGY 9
+#define RPC_METHOD_POOLS 10
 
 NRF_BLE_GATT_DEF(m_gatt);
 NRF_BLE_QWR_DEF(m_qwr);
 
+// Payload pools (see app_pools.h)
+BLOCK_POOL_DEF(g_notif_pool, APP_POOL_NOTIF_SIZE, APP_POOL_NOTIF_COUNT);
+BLOCK_POOL_DEF(g_event_pool, APP_POOL_EVENT_SIZE, APP_POOL_EVENT_COUNT);
+BLOCK_POOL_DEF(g_sdu_pool, APP_POOL_SDU_SIZE, APP_POOL_SDU_COUNT);
+
 //Current connection handle
 static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;
 // Advertising handle
 static uint8_t m_adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET;
-// Advertising data buffer
-static uint8_t m_enc_advdata[BLE_GAP_ADV_SET_DATA_SIZE_MAX];
-// Scan data buffer
-static uint8_t m_enc_scan_response_data[BLE_GAP_ADV_SET_DATA_SIZE_MAX];
-// Advertising data
-static ble_gap_adv_data_t m_adv_data = {
-    .adv_data = {
-        .p_data = m_enc_advdata,
-        .len = BLE_GAP_ADV_SET_DATA_SIZE_MAX
-    },
-    .scan_rsp_data = {
-        .p_data = m_enc_scan_response_data,
-        .len = BLE_GAP_ADV_SET_DATA_SIZE_MAX
-    }
-};
+// Fast advertising after a button wake from System OFF
+static bool m_fast_adv;
+// Advertising and scan data buffers; two sets, as data updated while
+// advertising must go to buffers the stack is not using
+static uint8_t m_enc_advdata[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+static uint8_t m_enc_scan_response_data[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+static uint8_t m_adv_buffer;
+// Advertising data (points at the set in use)
+static ble_gap_adv_data_t m_adv_data;
 
 ble_gatts_char_handles_t button_char_handles;
+// Vendor specific UUID type of UUID_BASE
+static uint8_t m_uuid_type;
+// Connection set-up flow
+static coro_t m_conn_flow;
+#if APP_USER_VALUES
+// Button attribute value, in application memory
+static uint8_t* m_button_value;
+#endif
 
 /****************************************************************
  * Function: gap_params_init()
@@ -89,10 +141,11 @@ static void gap_params_init() {
         strlen(DEVICE_NAME)
     );
     memset(&gap_conn_params, 0, sizeof(gap_conn_params));
-    gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
-    gap_conn_params.max_conn_interval = MIN_CONN_INTERVAL;
-    gap_conn_params.slave_latency = SLAVE_LATENCY;
-    gap_conn_params.conn_sup_timeout = CONN_SUP_TIMEOUT;
+    radio_cfg_t const* p_cfg = radio_cfg_active();
+    gap_conn_params.min_conn_interval = p_cfg->min_conn_interval;
+    gap_conn_params.max_conn_interval = p_cfg->max_conn_interval;
+    gap_conn_params.slave_latency = p_cfg->slave_latency;
+    gap_conn_params.conn_sup_timeout = p_cfg->conn_sup_timeout;
     sd_ble_gap_ppcp_set(&gap_conn_params);
 }
 
@@ -114,6 +167,333 @@ static void services_init() {
 }
 
 
+/****************************************************************
+ * Function: rpc_ping()
+ * Description: RPC method, echoes its arguments.
+****************************************************************/
+static uint8_t rpc_ping(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                        uint8_t* p_resp, uint8_t* p_resp_len) {
+    *p_resp_len = (args_len < RPC_RESP_MAX) ? args_len : RPC_RESP_MAX;
+    memcpy(p_resp, p_args, *p_resp_len);
+    return RPC_STATUS_OK;
+}
+
+
+/****************************************************************
+ * Function: rpc_led()
+ * Description: RPC method, switches a board LED.
+ *  Args: LED index, state (0 off, 1 on)
+****************************************************************/
+static uint8_t rpc_led(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                       uint8_t* p_resp, uint8_t* p_resp_len) {
+    if (args_len != 2 || p_args[0] >= LEDS_NUMBER) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    if (p_args[1]) {
+        bsp_board_led_on(p_args[0]);
+    }
+    else {
+        bsp_board_led_off(p_args[0]);
+    }
+    return RPC_STATUS_OK;
+}
+
+
+/****************************************************************
+ * Function: rpc_bulk_bench()
+ * Description: RPC method, starts the bulk transfer benchmark.
+****************************************************************/
+static uint8_t rpc_bulk_bench(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                              uint8_t* p_resp, uint8_t* p_resp_len) {
+    return bulk_xfer_bench_start(conn_handle) ? RPC_STATUS_OK : RPC_STATUS_BUSY;
+}
+
+
+/****************************************************************
+ * Function: rpc_energy()
+ * Description: RPC method, returns one page of the energy
+ *  counter snapshot.
+ *  Args: page index
+****************************************************************/
+static uint8_t rpc_energy(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                          uint8_t* p_resp, uint8_t* p_resp_len) {
+    energy_mon_snapshot_t snapshot;
+    uint32_t offset = (args_len == 1) ? (uint32_t)p_args[0] * ENERGY_MON_PAGE_SIZE : sizeof(snapshot);
+    if (offset >= sizeof(snapshot)) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    energy_mon_snapshot(&snapshot);
+    uint32_t remaining = sizeof(snapshot) - offset;
+    *p_resp_len = (remaining < ENERGY_MON_PAGE_SIZE) ? remaining : ENERGY_MON_PAGE_SIZE;
+    memcpy(p_resp, (uint8_t const*)&snapshot + offset, *p_resp_len);
+    return RPC_STATUS_OK;
+}
+
+
+/****************************************************************
+ * Function: rpc_trace()
+ * Description: RPC method, reads the post-mortem trace.
+ *  No args: ring state (head, boot count, reset reason, capacity)
+ *  Args: record index (16 bit) from the oldest record; returns
+ *  up to two records
+****************************************************************/
+static uint8_t rpc_trace(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                         uint8_t* p_resp, uint8_t* p_resp_len) {
+    if (args_len == 0) {
+        trace_ring_info_t info;
+        trace_ring_info_get(&info);
+        memcpy(&p_resp[0], &info.head, 4);
+        memcpy(&p_resp[4], &info.boot_count, 4);
+        memcpy(&p_resp[8], &info.reset_reason, 4);
+        memcpy(&p_resp[12], &info.capacity, 2);
+        *p_resp_len = 14;
+        return RPC_STATUS_OK;
+    }
+    if (args_len != 2) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    trace_record_t records[2];
+    uint32_t count = trace_ring_read(p_args[0] | (p_args[1] << 8), records, 2);
+    *p_resp_len = count * sizeof(trace_record_t);
+    memcpy(p_resp, records, *p_resp_len);
+    return RPC_STATUS_OK;
+}
+
+
+/****************************************************************
+ * Function: rpc_boot_time()
+ * Description: RPC method, returns the boot phase times in
+ *  microseconds (boot_phase_t order), four per page.
+ *  Args: page index
+****************************************************************/
+static uint8_t rpc_boot_time(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                             uint8_t* p_resp, uint8_t* p_resp_len) {
+    uint32_t first = (args_len == 1) ? (uint32_t)p_args[0] * 4 : BOOT_PHASE_COUNT;
+    if (first >= BOOT_PHASE_COUNT) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    uint32_t count = (BOOT_PHASE_COUNT - first < 4) ? BOOT_PHASE_COUNT - first : 4;
+    memcpy(p_resp, &boot_time_get()[first], count * sizeof(uint32_t));
+    *p_resp_len = count * sizeof(uint32_t);
+    return RPC_STATUS_OK;
+}
+
+/****************************************************************
+ * Function: rpc_sleep()
+ * Description: RPC method, returns the System OFF counters:
+ *  idle time (ms), System OFF entries, wakes, last wake to
+ *  advertising time (us).
+ *  Args: optional idle time in ms (32 bit) to set, 0 disables
+****************************************************************/
+static uint8_t rpc_sleep(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                         uint8_t* p_resp, uint8_t* p_resp_len) {
+    if (args_len == 4) {
+        uint32_t idle_ms;
+        memcpy(&idle_ms, p_args, 4);
+        deep_sleep_idle_set(idle_ms);
+    }
+    else if (args_len != 0) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    deep_sleep_info_t info;
+    deep_sleep_info_get(&info);
+    memcpy(&p_resp[0], &info.idle_ms, 4);
+    memcpy(&p_resp[4], &info.off_count, 4);
+    memcpy(&p_resp[8], &info.wake_count, 4);
+    memcpy(&p_resp[12], &info.wake_to_adv_us, 4);
+    *p_resp_len = 16;
+    return RPC_STATUS_OK;
+}
+
+
+/****************************************************************
+ * Function: rpc_button_lat()
+ * Description: RPC method, returns one page of a button latency
+ *  histogram (button_lat_hist_t).
+ *  Args: histogram (button_lat_hist_id_t), page index
+****************************************************************/
+static uint8_t rpc_button_lat(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                              uint8_t* p_resp, uint8_t* p_resp_len) {
+    if (args_len != 2 || p_args[0] >= BUTTON_LAT_HIST_COUNT) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    button_lat_hist_t const* p_hist = button_lat_hist_get((button_lat_hist_id_t)p_args[0]);
+    uint32_t offset = (uint32_t)p_args[1] * BUTTON_LAT_PAGE_SIZE;
+    if (offset >= sizeof(*p_hist)) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    uint32_t remaining = sizeof(*p_hist) - offset;
+    *p_resp_len = (remaining < BUTTON_LAT_PAGE_SIZE) ? remaining : BUTTON_LAT_PAGE_SIZE;
+    memcpy(p_resp, (uint8_t const*)p_hist + offset, *p_resp_len);
+    return RPC_STATUS_OK;
+}
+
+
+/****************************************************************
+ * Function: rpc_disc_reasons()
+ * Description: RPC method, returns the disconnect reason
+ *  counters: reason, count (16 bit), up to five per call.
+ *  Args: index of the first counter
+****************************************************************/
+static uint8_t rpc_disc_reasons(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                                uint8_t* p_resp, uint8_t* p_resp_len) {
+    if (args_len != 1 || p_args[0] >= BLE_DIAG_DISC_REASONS) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    uint8_t len = 0;
+    ble_diag_disc_t const* p_disc;
+    for (uint8_t i = p_args[0]; len + 3 <= RPC_RESP_MAX && (p_disc = ble_diag_disc_get(i)) != NULL; i++) {
+        p_resp[len] = p_disc->reason;
+        memcpy(&p_resp[len + 1], &p_disc->count, 2);
+        len += 3;
+    }
+    *p_resp_len = len;
+    return RPC_STATUS_OK;
+}
+
+
+/****************************************************************
+ * Function: rpc_channel_energy()
+ * Description: RPC method, returns the surveyed energy of up to
+ *  sixteen channels in dBm (BLE_GAP_POWER_LEVEL_INVALID if not
+ *  surveyed yet).
+ *  Args: first channel
+****************************************************************/
+static uint8_t rpc_channel_energy(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                                  uint8_t* p_resp, uint8_t* p_resp_len) {
+    if (args_len != 1 || p_args[0] >= BLE_GAP_CHANNEL_COUNT) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    uint32_t count = BLE_GAP_CHANNEL_COUNT - p_args[0];
+    if (count > 16) {
+        count = 16;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        p_resp[i] = (uint8_t)ble_diag_channel_energy_get(p_args[0] + i);
+    }
+    *p_resp_len = count;
+    return RPC_STATUS_OK;
+}
+
+
+/****************************************************************
+ * Function: rpc_pools()
+ * Description: RPC method, returns the counters of a block pool:
+ *  block count, in use, high-water mark (16 bit each), refused
+ *  allocations, refused frees (32 bit each).
+ *  Args: pool (0 notifications, 1 events, 2 SDUs)
+****************************************************************/
+static uint8_t rpc_pools(uint16_t conn_handle, uint8_t id, uint8_t const* p_args, uint8_t args_len,
+                         uint8_t* p_resp, uint8_t* p_resp_len) {
+    static block_pool_t const* const pools[] = {&g_notif_pool, &g_event_pool, &g_sdu_pool};
+    if (args_len != 1 || p_args[0] >= ARRAY_SIZE(pools)) {
+        return RPC_STATUS_INVALID_ARGS;
+    }
+    block_pool_t const* p_pool = pools[p_args[0]];
+    uint16_t in_use = (uint16_t)p_pool->in_use;
+    uint16_t high_water = (uint16_t)p_pool->high_water;
+    uint32_t exhausted = p_pool->exhausted;
+    uint32_t bad_frees = p_pool->bad_frees;
+    memcpy(&p_resp[0], &p_pool->block_count, 2);
+    memcpy(&p_resp[2], &in_use, 2);
+    memcpy(&p_resp[4], &high_water, 2);
+    memcpy(&p_resp[6], &exhausted, 4);
+    memcpy(&p_resp[10], &bad_frees, 4);
+    *p_resp_len = 14;
+    return RPC_STATUS_OK;
+}
+
+// RPC dispatch table
+static const rpc_handler_t m_rpc_methods[] = {
+    [RPC_METHOD_PING]           = rpc_ping,
+    [RPC_METHOD_LED]            = rpc_led,
+    [RPC_METHOD_BULK_BENCH]     = rpc_bulk_bench,
+    [RPC_METHOD_ENERGY]         = rpc_energy,
+    [RPC_METHOD_TRACE]          = rpc_trace,
+    [RPC_METHOD_BOOT_TIME]      = rpc_boot_time,
+    [RPC_METHOD_SLEEP]          = rpc_sleep,
+    [RPC_METHOD_BUTTON_LAT]     = rpc_button_lat,
+    [RPC_METHOD_DISC_REASONS]   = rpc_disc_reasons,
+    [RPC_METHOD_CHANNEL_ENERGY] = rpc_channel_energy,
+    [RPC_METHOD_POOLS]          = rpc_pools
+};
+
+
+/****************************************************************
+ * Function: advertising_configure()
+ * Description: Passes the advertising data and parameters to
+ *  the stack (only while not advertising).
+****************************************************************/
+static void advertising_configure() {
+    ble_gap_adv_params_t adv_params;
+    memset(&adv_params, 0, sizeof(adv_params));
+    uint32_t interval = radio_cfg_active()->adv_interval;
+    if (battery_state() != BATTERY_OK) {
+        interval *= LOW_BATTERY_ADV_SCALE;
+        if (interval > LOW_BATTERY_ADV_INTERVAL_MAX) {
+            interval = LOW_BATTERY_ADV_INTERVAL_MAX;
+        }
+    }
+
+    // Initialize advertising parameters
+    adv_params.primary_phy      = BLE_GAP_PHY_1MBPS;
+    adv_params.duration         = m_fast_adv ? DEEP_SLEEP_WAKE_ADV_DURATION : APP_ADV_DURATION;
+    adv_params.properties.type  = BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED;
+    adv_params.p_peer_addr      = NULL;
+    adv_params.filter_policy    = BLE_GAP_ADV_FP_ANY;
+    adv_params.interval         = m_fast_adv ? DEEP_SLEEP_WAKE_ADV_INTERVAL : interval;
+    sd_ble_gap_adv_set_configure(&m_adv_handle, &m_adv_data, &adv_params);
+}
+
+
+/****************************************************************
+ * Function: advertising_data_encode()
+ * Description: Encodes the advertising and scan data into the
+ *  buffer set not in use. The die temperature goes into the
+ *  advertising packet as manufacturer data (with the name,
+ *  appearance and flags it fills all 31 bytes).
+****************************************************************/
+static void advertising_data_encode() {
+    int8_t celsius = temp_mon_celsius();
+    ble_advdata_manuf_data_t manuf_data = {
+        .company_identifier = ADV_COMPANY_ID,
+        .data = {
+            .size = sizeof(celsius),
+            .p_data = (uint8_t*)&celsius
+        }
+    };
+    ble_advdata_t advdata, srdata;
+    ble_uuid_t adv_uuids[] = {{UUID_SERVICE, m_uuid_type}};
+    memset(&advdata, 0, sizeof(advdata));
+    advdata.name_type = BLE_ADVDATA_FULL_NAME;
+    advdata.include_appearance = true;
+    advdata.flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    advdata.p_manuf_specific_data = &manuf_data;
+    memset(&srdata, 0, sizeof(srdata));
+    srdata.uuids_complete.uuid_cnt  = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
+    srdata.uuids_complete.p_uuids   = adv_uuids;
+
+    m_adv_buffer ^= 1;
+    m_adv_data.adv_data.p_data = m_enc_advdata[m_adv_buffer];
+    m_adv_data.adv_data.len = BLE_GAP_ADV_SET_DATA_SIZE_MAX;
+    m_adv_data.scan_rsp_data.p_data = m_enc_scan_response_data[m_adv_buffer];
+    m_adv_data.scan_rsp_data.len = BLE_GAP_ADV_SET_DATA_SIZE_MAX;
+    ble_advdata_encode(&advdata, m_adv_data.adv_data.p_data, &m_adv_data.adv_data.len);
+    ble_advdata_encode(&srdata, m_adv_data.scan_rsp_data.p_data, &m_adv_data.scan_rsp_data.len);
+}
+
+
+/****************************************************************
+ * Function: temp_handler()
+ * Description: Advertises the new temperature. Data alone (no
+ *  parameters) can be replaced while advertising.
+****************************************************************/
+static void temp_handler(int8_t celsius) {
+    advertising_data_encode();
+    sd_ble_gap_adv_set_configure(&m_adv_handle, &m_adv_data, NULL);
+}
+
+
 /****************************************************************
  * Function: services_init()
  * Description: Encodes the required advertising data and 
@@ -125,9 +505,8 @@ static void advertising_init() {
     ble_uuid_t ble_uuid;
     ble_add_char_params_t add_char_params;
     ble_uuid128_t base_uuid = {UUID_BASE};
-    uint8_t uuid_type;
-    sd_ble_uuid_vs_add(&base_uuid, &uuid_type);
-    ble_uuid.type = uuid_type;
+    sd_ble_uuid_vs_add(&base_uuid, &m_uuid_type);
+    ble_uuid.type = m_uuid_type;
     ble_uuid.uuid = UUID_SERVICE;
     uint16_t service_handle;
     sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &service_handle);
@@ -135,38 +514,35 @@ static void advertising_init() {
     // Add button characteristic
     memset(&add_char_params, 0, sizeof(add_char_params));
     add_char_params.uuid                = UUID_BUTTON_CHAR;
-    add_char_params.uuid_type           = uuid_type;
+    add_char_params.uuid_type           = m_uuid_type;
     add_char_params.init_len            = sizeof(uint8_t);
     add_char_params.max_len             = sizeof(uint8_t);
     add_char_params.char_props.read     = 1;
     add_char_params.char_props.notify   = 1;
     add_char_params.read_access         = SEC_OPEN;
     add_char_params.cccd_write_access   = SEC_OPEN;
+#if APP_USER_VALUES
+    // Taken for the lifetime of the attribute
+    m_button_value = block_pool_alloc(&g_notif_pool);
+    m_button_value[0] = 0;
+    add_char_params.is_value_user       = true;
+    add_char_params.p_init_value        = m_button_value;
+#endif
     characteristic_add(service_handle, &add_char_params, &button_char_handles);
-    
-    // Build and set advertising data
-    ble_advdata_t advdata, srdata;
-    ble_uuid_t adv_uuids[] = {{UUID_SERVICE, uuid_type}};
-    memset(&advdata, 0, sizeof(advdata));
-    advdata.name_type = BLE_ADVDATA_FULL_NAME;
-    advdata.include_appearance = true;
-    advdata.flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
-    memset(&srdata, 0, sizeof(srdata));
-    srdata.uuids_complete.uuid_cnt  = sizeof(adv_uuids) / sizeof(adv_uuids[0]);
-    srdata.uuids_complete.p_uuids   = adv_uuids;
-    ble_advdata_encode(&advdata, m_adv_data.adv_data.p_data, &m_adv_data.adv_data.len);
-    ble_advdata_encode(&srdata, m_adv_data.scan_rsp_data.p_data, &m_adv_data.scan_rsp_data.len);
-    ble_gap_adv_params_t adv_params;
-    memset(&adv_params, 0, sizeof(adv_params));
 
-    // Initialize advertising parameters
-    adv_params.primary_phy      = BLE_GAP_PHY_1MBPS;
-    adv_params.duration         = APP_ADV_DURATION;
-    adv_params.properties.type  = BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED;
-    adv_params.p_peer_addr      = NULL;
-    adv_params.filter_policy    = BLE_GAP_ADV_FP_ANY;
-    adv_params.interval         = APP_ADV_INTERVAL;
-    sd_ble_gap_adv_set_configure(&m_adv_handle, &m_adv_data, &adv_params);
+    // Add link diagnostics service
+    ble_diag_init(m_uuid_type);
+    // Add bulk transfer service
+    bulk_xfer_init(m_uuid_type, NULL);
+    // Add RPC service
+    rpc_init(m_uuid_type, m_rpc_methods, ARRAY_SIZE(m_rpc_methods));
+    // Add radio configuration service
+    radio_cfg_service_init(m_uuid_type);
+    // Add temperature service (takes the first sample)
+    temp_mon_init(m_uuid_type, temp_handler);
+    
+    // Build advertising data
+    advertising_data_encode();
 }
 
 
@@ -182,9 +558,10 @@ static void conn_params_init() {
     ble_conn_params_init_t params;
     memset(&params, 0, sizeof(params));
     params.p_conn_params = NULL;
-    params.first_conn_params_update_delay   = FIRST_CONN_PARAMS_UPDATE_DELAY;
-    params.next_conn_params_update_delay    = NEXT_CONN_PARAMS_UPDATE_DELAY;
-    params.max_conn_params_update_count     = MAX_CONN_PARAMS_UPDATE_COUNT;
+    radio_cfg_t const* p_cfg = radio_cfg_active();
+    params.first_conn_params_update_delay   = APP_TIMER_TICKS(p_cfg->first_update_delay_ms);
+    params.next_conn_params_update_delay    = APP_TIMER_TICKS(p_cfg->next_update_delay_ms);
+    params.max_conn_params_update_count     = p_cfg->max_update_count;
     params.start_on_notify_cccd_handle      = BLE_GATT_HANDLE_INVALID;
     params.disconnect_on_fail               = true;
     ble_conn_params_init(&params);
@@ -201,20 +578,44 @@ static void advertising_start() {
 }
 
 
+/****************************************************************
+ * Function: battery_state_handler()
+ * Description: Advertises less often on a low battery and goes
+ *  to System OFF on a critical one (the button still wakes it).
+****************************************************************/
+static void battery_state_handler(battery_state_t state) {
+    if (state == BATTERY_CRITICAL) {
+        deep_sleep_enter();
+        return;
+    }
+    // Restart advertising with the new interval
+    if (m_conn_handle == BLE_CONN_HANDLE_INVALID) {
+        sd_ble_gap_adv_stop(m_adv_handle);
+        advertising_configure();
+        advertising_start();
+    }
+}
+
+
 /****************************************************************
  * Function: send_button()
  * Description: Sends the button state to the connected board or
  *  BLE peripheral (server)
 ****************************************************************/
 void send_button(uint8_t button_state) {
-    ble_gatts_hvx_params_t params;
-    uint16_t len = sizeof(button_state);
-    memset(&params, 0, sizeof(params));
-    params.type = BLE_GATT_HVX_NOTIFICATION;
-    params.handle = button_char_handles.value_handle;
-    params.p_data = &button_state;
-    params.p_len = &len;
-    sd_ble_gatts_hvx(m_conn_handle, &params);
+#if APP_USER_VALUES
+    // Reads see the latest state straight away
+    m_button_value[0] = button_state;
+#endif
+    // Every press and release is notified, so each queued notification
+    // carries its own copy rather than the (changing) attribute value
+    uint8_t* p_payload = block_pool_alloc(&g_notif_pool);
+    if (p_payload == NULL) {
+        return;
+    }
+    p_payload[0] = button_state;
+    tx_sched_notify(m_conn_handle, button_char_handles.value_handle, TX_SCHED_URGENT,
+                    p_payload, sizeof(button_state));
 }
 
 
@@ -223,6 +624,10 @@ void send_button(uint8_t button_state) {
  * Description: Processes the button state of the client board
 ****************************************************************/
 static void button_handler(uint8_t pin, uint8_t action) {
+    button_lat_enter();
+    uint32_t trace_mark = trace_ring_enter(TRACE_HANDLER_BUTTON);
+    uint32_t mark = energy_mon_mark();
+    trace_ring_add(TRACE_BUTTON, ((uint32_t)pin << 8) | action);
     if (pin == BSP_BOARD_BUTTON_0) {
         if (action == APP_BUTTON_PUSH) {
             bsp_board_led_on(BSP_BOARD_LED_1);
@@ -231,30 +636,81 @@ static void button_handler(uint8_t pin, uint8_t action) {
             bsp_board_led_off(BSP_BOARD_LED_1);
         }
         send_button(action);
+        button_lat_sent();
+#if BULK_BENCH_ENABLED
+        if (action == APP_BUTTON_PUSH) {
+            bulk_xfer_bench_start(m_conn_handle);
+        }
+#endif
+#if LL_LINK_ENABLED
+        uint8_t msg[] = {LL_LINK_MSG_BUTTON, action};
+        ll_link_send(msg, sizeof(msg));
+#endif
+        energy_mon_button_done(mark);
     }
+    trace_ring_exit(TRACE_HANDLER_BUTTON, trace_mark);
 } 
 
 
+/****************************************************************
+ * Function: conn_flow()
+ * Description: Connection set-up: waits for the peer to enable
+ *  button notifications, then sends the current button state so
+ *  the peer starts from it rather than from the next press.
+****************************************************************/
+static coro_status_t conn_flow(coro_t* p_coro, ble_evt_t const* p_ble_evt) {
+    ble_gatts_evt_write_t const* p_write;
+    CORO_BEGIN(p_coro);
+    do {
+        CORO_AWAIT_EVT(p_coro, BLE_GATTS_EVT_WRITE);
+        if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED) {
+            CORO_EXIT(p_coro);
+        }
+        p_write = &p_ble_evt->evt.gatts_evt.params.write;
+    } while (p_write->handle != button_char_handles.cccd_handle || p_write->len != 2 ||
+             !(p_write->data[0] & BLE_GATT_HVX_NOTIFICATION));
+    send_button(app_button_is_pushed(0) ? APP_BUTTON_PUSH : APP_BUTTON_RELEASE);
+    CORO_END(p_coro);
+}
+
+
 /****************************************************************
  * Function: ble_evt_handler()
  * Description: Function to process BLE events.
- *  BLE_GAP_EVT_CONNECTED    - Connected to peer
- *  BLE_GAP_EVT_DISCONNECTED - Disconnected from peer
+ *  BLE_GAP_EVT_CONNECTED          - Connected to peer
+ *  BLE_GAP_EVT_DISCONNECTED       - Disconnected from peer
+ *  BLE_GAP_EVT_ADV_SET_TERMINATED - Fast advertising timed out
 ****************************************************************/
 static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    uint32_t trace_mark = trace_ring_enter(TRACE_HANDLER_BLE_EVT);
     switch (p_ble_evt->header.evt_id) {
         case BLE_GAP_EVT_CONNECTED:
             bsp_board_led_off(BSP_BOARD_LED_2);
             bsp_board_led_on(BSP_BOARD_LED_3);
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
             nrf_ble_qwr_conn_handle_assign(&m_qwr, m_conn_handle);
+            // Back to the profile's interval after this connection
+            m_fast_adv = false;
+            coro_start(&m_conn_flow, conn_flow);
             break;
         case BLE_GAP_EVT_DISCONNECTED:
             bsp_board_led_off(BSP_BOARD_LED_3);
             m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            // A profile written during the connection takes effect now
+            if (radio_cfg_apply()) {
+                gap_params_init();
+                conn_params_init();
+            }
+            advertising_configure();
+            advertising_start();
+            break;
+        case BLE_GAP_EVT_ADV_SET_TERMINATED:
+            m_fast_adv = false;
+            advertising_configure();
             advertising_start();
             break;
     }
+    trace_ring_exit(TRACE_HANDLER_BLE_EVT, trace_mark);
 }
 
 
@@ -262,31 +718,114 @@ static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
  * MAIN
 ****************************************************************/
 int main() {
+    // Boot timing, then the LFXO so it ramps up while the rest of the
+    // core is set up (the SoftDevice takes over the running clock)
+    boot_time_init();
+    nrf_drv_clock_init();
+    nrf_drv_clock_lfclk_request(NULL);
+    // Post-mortem trace, it records the reset reason
+    trace_ring_init();
+    // State kept across System OFF
+    deep_sleep_init();
+    m_fast_adv = deep_sleep_woken();
     // Initializations
     bsp_board_init(BSP_INIT_LEDS);
+    block_pool_init(&g_notif_pool);
+    block_pool_init(&g_event_pool);
+    block_pool_init(&g_sdu_pool);
     app_timer_init();
-    nrf_sdh_enable_request();
-
+    nrf_pwr_mgmt_init();
     static app_button_cfg_t buttons[] = {
         {BSP_BOARD_BUTTON_0, false, BUTTON_PULL, button_handler}
     };
-    app_button_init(buttons, ARRAY_SIZE(buttons), APP_TIMER_TICKS(50));
+    app_button_init(buttons, ARRAY_SIZE(buttons), APP_TIMER_TICKS(BUTTON_DETECTION_DELAY_MS));
     app_button_enable();
+    boot_time_mark(BOOT_PHASE_CORE);
+    // Waits for the LFCLK
+    nrf_sdh_enable_request();
+    boot_time_mark(BOOT_PHASE_SD_ENABLED);
 
     // Fetch start address of application RAM
     uint32_t ram_start = 0;
     nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
+    // Notification queue deep enough for the TX scheduler's classes
+    ble_cfg_t ble_cfg;
+    memset(&ble_cfg, 0, sizeof(ble_cfg));
+    ble_cfg.conn_cfg.conn_cfg_tag = APP_BLE_CONN_CFG_TAG;
+    ble_cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = TX_SCHED_SD_QUEUE_SIZE;
+    sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &ble_cfg, ram_start);
+    // L2CAP channel for bulk transfers
+    bulk_xfer_cfg_set(APP_BLE_CONN_CFG_TAG, ram_start);
     // Enable BLE stack
     nrf_sdh_ble_enable(&ram_start);
     // Register handler for BLE events
     NRF_SDH_BLE_OBSERVER(m_ble_observer, APP_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+    boot_time_mark(BOOT_PHASE_BLE_ENABLED);
+
+    // Radio profile stored in flash, or the defaults above. FDS scans
+    // its pages while the modules and the GATT table are set up.
+    static const radio_cfg_t radio_defaults = {
+        .adv_interval           = APP_ADV_INTERVAL,
+        .min_conn_interval      = MIN_CONN_INTERVAL,
+        .max_conn_interval      = MAX_CONN_INTERVAL,
+        .slave_latency          = SLAVE_LATENCY,
+        .conn_sup_timeout       = CONN_SUP_TIMEOUT,
+        .first_update_delay_ms  = FIRST_CONN_PARAMS_UPDATE_DELAY_MS,
+        .next_update_delay_ms   = NEXT_CONN_PARAMS_UPDATE_DELAY_MS,
+        .max_update_count       = MAX_CONN_PARAMS_UPDATE_COUNT
+    };
+    radio_cfg_init(&radio_defaults);
+    // Track radio activity so deferred work runs between radio events
+    radio_sched_init();
+    // Prioritized notifications
+    tx_sched_init();
+    // Module timers (RTC2)
+    timer_wheel_init();
+    // Energy counters (radio, CPU, flash)
+    energy_mon_init();
+#if PC_SAMPLE_ENABLED
+    // Sampling profiler (TIMER1), streamed over RTT
+    pc_sample_init();
+#endif
+#if LL_LINK_ENABLED
+    // Low latency link runs in timeslots between BLE events
+    ll_link_init();
+#endif
 
-    // Set up for advertising
+    // Set up for advertising (device name and GATT table)
     gap_params_init();
     nrf_ble_gatt_init(&m_gatt, NULL);
     services_init();
     advertising_init();
+    // Battery Service and supply measurements (RTC2, SAADC, PPI)
+    battery_init(battery_state_handler);
+    // Button latency probes (GPIOTE edge to TIMER2 through PPI); the
+    // detection delay is whole app_timer ticks
+    button_lat_init(APP_TICKS_TO_US(APP_TIMER_TICKS(BUTTON_DETECTION_DELAY_MS)));
+    boot_time_mark(BOOT_PHASE_SERVICES);
+
+    // Apply the stored profile, if any. After a wake from System OFF
+    // the retained copy is used and FDS finishes in the background.
+    radio_cfg_t retained_cfg;
+    if (deep_sleep_cfg_get(&retained_cfg) ? radio_cfg_restore(&retained_cfg) : radio_cfg_load()) {
+        gap_params_init();
+    }
+    boot_time_mark(BOOT_PHASE_CFG_LOADED);
+    advertising_configure();
     conn_params_init();
     // Begin advertising
     advertising_start();
+    boot_time_mark(BOOT_PHASE_ADV_STARTED);
+    // System OFF after a while without a connection
+    deep_sleep_start();
+
+    // Run deferred jobs in radio gaps, sleep otherwise
+    for (;;) {
+        radio_sched_execute();
+        trace_ring_rtt_process();
+#if PC_SAMPLE_ENABLED
+        pc_sample_process();
+#endif
+        nrf_pwr_mgmt_run();
+    }
 }
\ No newline at end of file
@@ -0,0 +1,223 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: pc_sample.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Statistical profiler.
+ *
+ *  TIMER1 runs at 1 MHz and interrupts at APP_IRQ_PRIORITY_HIGH, above
+ *  every application interrupt and the SoftDevice's API calls (SVC,
+ *  priority 4), so application, SDK and SoftDevice API code are all
+ *  sampled. The handler takes the PC and xPSR from the exception frame of
+ *  the interrupted code, on the stack EXC_RETURN points at, and adds them
+ *  to a ring; that is a few dozen cycles per sample. Time in the
+ *  SoftDevice's own interrupts (priorities 0 and 1) cannot be seen and is
+ *  charged to the code they interrupted. Each period is dithered by up to
+ *  an eighth so the samples do not lock to periodic work such as radio
+ *  events. The main loop streams the ring to its own RTT channel in
+ *  batches; samples that find the ring full are counted and reported to
+ *  the host as a marker, so the profile stays unbiased.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include "pc_sample.h"
+
+#if PC_SAMPLE_ENABLED
+#include <stdbool.h>
+#include "nrf.h"
+#include "app_util_platform.h"
+#include "SEGGER_RTT.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+#define SAMPLE_TIMER NRF_TIMER1
+#define SAMPLE_IRQn TIMER1_IRQn
+#define SAMPLE_IRQ_PRIORITY APP_IRQ_PRIORITY_HIGH
+// Timer prescaler (1 MHz)
+#define SAMPLE_TIMER_PRESCALER 4
+#define SAMPLE_TIMER_HZ 1000000
+// Samples gathered before a write to RTT
+#define SAMPLE_BATCH 32
+// RTT buffer (samples; a write takes at most one less, see
+// pc_sample_process())
+#define SAMPLE_RTT_RECORDS 128
+// Exception frame: word offsets of the stacked PC and xPSR
+#define FRAME_PC 6
+#define FRAME_XPSR 7
+#define XPSR_EXCEPTION_Msk 0x1FF
+
+static pc_sample_t m_ring[PC_SAMPLE_RING_SIZE];
+static volatile uint32_t m_head;            // Written by the timer interrupt only
+static volatile uint32_t m_tail;            // Written by the main loop only
+static volatile uint32_t m_lost;
+static uint32_t m_lost_sent;
+static volatile uint32_t m_period_us;
+static uint32_t m_rate_hz;
+static bool m_rate_marker;
+static uint32_t m_rand = 1;
+static pc_sample_t m_rtt_buffer[SAMPLE_RTT_RECORDS];
+
+// Called from the timer handler with the interrupted code's exception frame;
+// only the assembly refers to it, which link time optimization cannot see
+__attribute__((used)) void pc_sample_isr(uint32_t const* p_frame);
+
+
+/****************************************************************
+ * Function: period_next()
+ * Description: Returns the next sampling period, dithered by up
+ *  to an eighth of the nominal one either way.
+****************************************************************/
+static uint32_t period_next(void) {
+    uint32_t period = m_period_us;
+    m_rand ^= m_rand << 13;
+    m_rand ^= m_rand >> 17;
+    m_rand ^= m_rand << 5;
+    return period - period / 8 + m_rand % (period / 4 + 1);
+}
+
+
+/****************************************************************
+ * Function: TIMER1_IRQHandler()
+ * Description: Finds the exception frame of the interrupted code
+ *  (main or process stack, from EXC_RETURN) before the compiler
+ *  touches the stack, and hands it on.
+****************************************************************/
+__attribute__((naked)) void TIMER1_IRQHandler(void) {
+    __asm volatile(
+        "tst lr, #4        \n"
+        "ite eq            \n"
+        "mrseq r0, msp     \n"
+        "mrsne r0, psp     \n"
+        "b pc_sample_isr   \n");
+}
+
+
+/****************************************************************
+ * Function: pc_sample_isr()
+ * Description: Records the interrupted PC and context and sets
+ *  up the next period.
+****************************************************************/
+void pc_sample_isr(uint32_t const* p_frame) {
+    SAMPLE_TIMER->EVENTS_COMPARE[0] = 0;
+    // Read back so the event is cleared before the handler returns
+    (void)SAMPLE_TIMER->EVENTS_COMPARE[0];
+    SAMPLE_TIMER->CC[0] = period_next();
+
+    uint32_t head = m_head;
+    if (head - m_tail >= PC_SAMPLE_RING_SIZE) {
+        m_lost++;
+        return;
+    }
+    pc_sample_t* p_sample = &m_ring[head & (PC_SAMPLE_RING_SIZE - 1)];
+    p_sample->pc = p_frame[FRAME_PC];
+    p_sample->info = p_frame[FRAME_XPSR] & XPSR_EXCEPTION_Msk;
+    m_head = head + 1;
+}
+
+
+/****************************************************************
+ * Function: pc_sample_rate_set()
+ * Description: Restarts the timer at the new rate, or stops it.
+ *  The rate goes to the host ahead of the next samples.
+****************************************************************/
+void pc_sample_rate_set(uint32_t rate_hz) {
+    SAMPLE_TIMER->TASKS_STOP = 1;
+    NVIC_DisableIRQ(SAMPLE_IRQn);
+    if (rate_hz != 0) {
+        rate_hz = (rate_hz < PC_SAMPLE_RATE_MIN_HZ) ? PC_SAMPLE_RATE_MIN_HZ : rate_hz;
+        rate_hz = (rate_hz > PC_SAMPLE_RATE_MAX_HZ) ? PC_SAMPLE_RATE_MAX_HZ : rate_hz;
+    }
+    m_rate_hz = rate_hz;
+    m_rate_marker = true;
+    if (rate_hz == 0) {
+        return;
+    }
+    m_period_us = SAMPLE_TIMER_HZ / rate_hz;
+    SAMPLE_TIMER->TASKS_CLEAR = 1;
+    SAMPLE_TIMER->CC[0] = period_next();
+    SAMPLE_TIMER->EVENTS_COMPARE[0] = 0;
+    NVIC_ClearPendingIRQ(SAMPLE_IRQn);
+    NVIC_EnableIRQ(SAMPLE_IRQn);
+    SAMPLE_TIMER->TASKS_START = 1;
+}
+
+
+/****************************************************************
+ * Function: pc_sample_init()
+ * Description: Sets up the RTT channel and the timer (cleared on
+ *  each compare) and starts sampling.
+****************************************************************/
+void pc_sample_init(void) {
+    SEGGER_RTT_ConfigUpBuffer(PC_SAMPLE_RTT_CHANNEL, "pc_sample", m_rtt_buffer,
+                              sizeof(m_rtt_buffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    SAMPLE_TIMER->MODE = TIMER_MODE_MODE_Timer;
+    SAMPLE_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+    SAMPLE_TIMER->PRESCALER = SAMPLE_TIMER_PRESCALER;
+    SAMPLE_TIMER->SHORTS = TIMER_SHORTS_COMPARE0_CLEAR_Msk;
+    SAMPLE_TIMER->INTENSET = TIMER_INTENSET_COMPARE0_Msk;
+    NVIC_SetPriority(SAMPLE_IRQn, SAMPLE_IRQ_PRIORITY);
+    pc_sample_rate_set(PC_SAMPLE_RATE_HZ);
+}
+
+
+/****************************************************************
+ * Function: marker_write()
+ * Description: Writes a marker; returns false if RTT is full.
+****************************************************************/
+static bool marker_write(uint32_t type, uint32_t value) {
+    pc_sample_t marker = {
+        .pc = 0,
+        .info = (type << 24) | (value & 0xFFFFFF)
+    };
+    return SEGGER_RTT_Write(PC_SAMPLE_RTT_CHANNEL, &marker, sizeof(marker)) != 0;
+}
+
+
+/****************************************************************
+ * Function: pc_sample_process()
+ * Description: Sends pending markers, then the buffered samples
+ *  in runs up to the end of the ring once a batch is ready. In
+ *  skip mode RTT drops a write that does not fit whole, and it
+ *  never has more than its size less one byte free, so every run
+ *  is capped at the space free.
+****************************************************************/
+void pc_sample_process(void) {
+    if (m_rate_marker) {
+        if (!marker_write(PC_SAMPLE_MARK_RATE, m_rate_hz)) {
+            return;
+        }
+        m_rate_marker = false;
+    }
+    uint32_t lost = m_lost;
+    if (lost != m_lost_sent) {
+        if (!marker_write(PC_SAMPLE_MARK_LOST, lost - m_lost_sent)) {
+            return;
+        }
+        m_lost_sent = lost;
+    }
+    uint32_t head = m_head;
+    if (head - m_tail < SAMPLE_BATCH) {
+        return;
+    }
+    while (m_tail != head) {
+        uint32_t index = m_tail & (PC_SAMPLE_RING_SIZE - 1);
+        uint32_t count = head - m_tail;
+        uint32_t space = SEGGER_RTT_GetAvailWriteSpace(PC_SAMPLE_RTT_CHANNEL) / sizeof(pc_sample_t);
+        if (count > PC_SAMPLE_RING_SIZE - index) {
+            count = PC_SAMPLE_RING_SIZE - index;
+        }
+        if (count > space) {
+            count = space;
+        }
+        if (count == 0 ||
+            SEGGER_RTT_Write(PC_SAMPLE_RTT_CHANNEL, &m_ring[index], count * sizeof(pc_sample_t)) == 0) {
+            return;
+        }
+        m_tail += count;
+    }
+}
+#endif
@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: pc_sample.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Statistical profiler. A spare TIMER interrupts at a set rate
+ * and records the program counter it interrupted, SoftDevice and SDK code
+ * included; the samples are streamed over RTT to the host symbolizer
+ * (tools/profile/pc_profile.py).
+*******************************************************************************/
+#ifndef PC_SAMPLE_H__
+#define PC_SAMPLE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Profiling builds only: the timer keeps the HFCLK running and every sample
+// wakes the CPU
+#define PC_SAMPLE_ENABLED 0
+// Default sampling rate and the allowed range
+#define PC_SAMPLE_RATE_HZ 1000
+#define PC_SAMPLE_RATE_MIN_HZ 10
+#define PC_SAMPLE_RATE_MAX_HZ 20000
+// Samples buffered for the stream (power of two)
+#define PC_SAMPLE_RING_SIZE 256
+// RTT up channel of the stream
+#define PC_SAMPLE_RTT_CHANNEL 2
+
+// Stream record: the interrupted PC and its exception number (0 in thread
+// mode). A record with pc 0 is a marker, its type in the top byte of info
+typedef struct {
+    uint32_t pc;
+    uint32_t info;
+} pc_sample_t;
+
+// Markers
+#define PC_SAMPLE_MARK_RATE 1               // info: rate in Hz (stream start, rate change)
+#define PC_SAMPLE_MARK_LOST 2               // info: samples dropped, ring full
+
+
+/***************************************
+ * Functions
+***************************************/
+// Sets up the stream and starts sampling at PC_SAMPLE_RATE_HZ
+void pc_sample_init(void);
+// Changes the sampling rate (clamped to the range), 0 stops sampling
+void pc_sample_rate_set(uint32_t rate_hz);
+// Streams buffered samples while RTT has room; call from the main loop
+void pc_sample_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PC_SAMPLE_H__
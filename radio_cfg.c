@@ -0,0 +1,425 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: radio_cfg.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Runtime radio configuration.
+ *
+ *  Writes to the configuration characteristic are authorized so invalid
+ *  profiles are refused with an ATT error instead of being stored. An
+ *  accepted profile is written to flash straight away (or, if a write is
+ *  still in flight, as soon as it completes) and becomes active
+ *  when main.c calls radio_cfg_apply() before advertising again, so a live
+ *  connection is never renegotiated half way. Reads always return the
+ *  active profile, with RADIO_CFG_FLAG_PENDING set while a new one waits.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <string.h>
+#include "radio_cfg.h"
+#include "nrf_sdh_ble.h"
+#include "ble_srv_common.h"
+#include "fds.h"
+#include "nrf_pwr_mgmt.h"
+#include "trace_ring.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE priority value
+#define RADIO_CFG_BLE_OBSERVER_PRIO 2
+// FDS location of the stored profile
+#define RADIO_CFG_FILE_ID 0x1000
+#define RADIO_CFG_RECORD_KEY 0x0001
+// ATT error for an out of range profile
+#define RADIO_CFG_ATTERR_INVALID BLE_GATT_STATUS_ATTERR_APP_BEGIN
+// Parameter limits (Core spec, Vol 6, Part B, 4.5.1 and 4.4.2.2)
+#define ADV_INTERVAL_MIN 0x0020
+#define ADV_INTERVAL_MAX 0x4000
+#define CONN_INTERVAL_MIN 6
+#define CONN_INTERVAL_MAX 3200
+#define SLAVE_LATENCY_MAX 499
+#define SUP_TIMEOUT_MIN 10
+#define SUP_TIMEOUT_MAX 3200
+#define UPDATE_DELAY_MIN_MS 100
+#define UPDATE_COUNT_MAX 10
+
+static radio_cfg_t m_active;
+static radio_cfg_t m_pending;
+static bool m_has_pending;
+static ble_gatts_char_handles_t m_cfg_handles;
+// FDS state; the record buffer must stay valid until the write completes
+static uint32_t m_record_buf[(sizeof(radio_cfg_t) + 3) / 4];
+static fds_record_desc_t m_record_desc;
+static bool m_record_exists;
+static volatile bool m_fds_ready;
+static bool m_restored;
+// One write, update or garbage collection of the profile at a time: FDS
+// does not copy the record buffer, and m_record_exists only changes when
+// a write completes
+static bool m_store_busy;
+// The profile changed, or could not be queued, while busy
+static bool m_store_again;
+// The operation in flight is a garbage collection of ours
+static bool m_gc_retry;
+
+
+/****************************************************************
+ * Function: cfg_valid()
+ * Description: Checks a profile against the Bluetooth limits.
+ *  The supervision timeout must outlast the longest possible
+ *  gap between connection events twice over.
+****************************************************************/
+static bool cfg_valid(radio_cfg_t const* p_cfg) {
+    if (p_cfg->version != RADIO_CFG_VERSION) {
+        return false;
+    }
+    if (p_cfg->adv_interval < ADV_INTERVAL_MIN || p_cfg->adv_interval > ADV_INTERVAL_MAX) {
+        return false;
+    }
+    if (p_cfg->min_conn_interval < CONN_INTERVAL_MIN ||
+        p_cfg->max_conn_interval > CONN_INTERVAL_MAX ||
+        p_cfg->min_conn_interval > p_cfg->max_conn_interval) {
+        return false;
+    }
+    if (p_cfg->slave_latency > SLAVE_LATENCY_MAX ||
+        p_cfg->conn_sup_timeout < SUP_TIMEOUT_MIN ||
+        p_cfg->conn_sup_timeout > SUP_TIMEOUT_MAX) {
+        return false;
+    }
+    // timeout * 10 ms > (1 + latency) * max interval * 1.25 ms * 2
+    if ((uint32_t)p_cfg->conn_sup_timeout * 4 <= (1UL + p_cfg->slave_latency) * p_cfg->max_conn_interval) {
+        return false;
+    }
+    return p_cfg->first_update_delay_ms >= UPDATE_DELAY_MIN_MS &&
+           p_cfg->next_update_delay_ms >= UPDATE_DELAY_MIN_MS &&
+           p_cfg->max_update_count >= 1 &&
+           p_cfg->max_update_count <= UPDATE_COUNT_MAX;
+}
+
+
+/****************************************************************
+ * Function: value_refresh()
+ * Description: Shows the active profile (and whether another
+ *  is pending) in the characteristic.
+****************************************************************/
+static void value_refresh(void) {
+    radio_cfg_t shown = m_active;
+    shown.flags = m_has_pending ? RADIO_CFG_FLAG_PENDING : 0;
+    ble_gatts_value_t value = {
+        .len = sizeof(shown),
+        .offset = 0,
+        .p_value = (uint8_t*)&shown
+    };
+    sd_ble_gatts_value_set(BLE_CONN_HANDLE_INVALID, m_cfg_handles.value_handle, &value);
+}
+
+
+/****************************************************************
+ * Function: cfg_store()
+ * Description: Writes the latest profile to flash, collecting
+ *  garbage first if FDS has run out of space (once: may_gc is
+ *  false straight after a collection). While another operation
+ *  is in flight (or FDS is not ready) the store is left for the
+ *  FDS event that ends it.
+****************************************************************/
+static void cfg_store(bool may_gc) {
+    if (m_store_busy || !m_fds_ready) {
+        m_store_again = true;
+        return;
+    }
+    m_store_again = false;
+    memset(m_record_buf, 0, sizeof(m_record_buf));
+    memcpy(m_record_buf, m_has_pending ? &m_pending : &m_active, sizeof(radio_cfg_t));
+    fds_record_t record = {
+        .file_id = RADIO_CFG_FILE_ID,
+        .key = RADIO_CFG_RECORD_KEY,
+        .data.p_data = m_record_buf,
+        .data.length_words = sizeof(m_record_buf) / 4
+    };
+    trace_ring_add(TRACE_FLASH, m_record_exists ? TRACE_FLASH_UPDATE : TRACE_FLASH_WRITE);
+    ret_code_t err_code = m_record_exists ? fds_record_update(&m_record_desc, &record)
+                                          : fds_record_write(&m_record_desc, &record);
+    if (err_code == FDS_ERR_NO_SPACE_IN_FLASH && may_gc) {
+        // Written again once the garbage is collected
+        trace_ring_add(TRACE_FLASH, TRACE_FLASH_GC);
+        err_code = fds_gc();
+        m_gc_retry = (err_code == NRF_SUCCESS);
+        m_store_again = true;
+    }
+    if (err_code == NRF_SUCCESS) {
+        m_store_busy = true;
+    }
+    else if (err_code == FDS_ERR_NO_SPACE_IN_QUEUES) {
+        // Tried again on the event of an operation ahead in the queue
+        m_store_again = true;
+    }
+    else {
+        trace_ring_add(TRACE_ERROR_INFO, err_code);
+        m_store_again = false;
+    }
+}
+
+
+/****************************************************************
+ * Function: store_done()
+ * Description: Ends the operation in flight and stores the
+ *  profile again if it changed meanwhile.
+****************************************************************/
+static void store_done(ret_code_t result, bool after_gc) {
+    m_store_busy = false;
+    if (result != NRF_SUCCESS) {
+        trace_ring_add(TRACE_ERROR_INFO, result);
+    }
+    if (m_store_again) {
+        cfg_store(!after_gc);
+    }
+}
+
+
+/****************************************************************
+ * Function: cfg_load()
+ * Description: Reads the stored profile. Returns false if there
+ *  is none or it is invalid.
+****************************************************************/
+static bool cfg_load(radio_cfg_t* p_cfg) {
+    fds_find_token_t token;
+    fds_flash_record_t flash_record;
+    memset(&token, 0, sizeof(token));
+    if (fds_record_find(RADIO_CFG_FILE_ID, RADIO_CFG_RECORD_KEY, &m_record_desc, &token) != NRF_SUCCESS) {
+        return false;
+    }
+    m_record_exists = true;
+    if (fds_record_open(&m_record_desc, &flash_record) != NRF_SUCCESS) {
+        return false;
+    }
+    bool valid = false;
+    if (flash_record.p_header->length_words * 4 >= sizeof(radio_cfg_t)) {
+        memcpy(p_cfg, flash_record.p_data, sizeof(*p_cfg));
+        valid = cfg_valid(p_cfg);
+    }
+    fds_record_close(&m_record_desc);
+    return valid;
+}
+
+
+/****************************************************************
+ * Function: fds_evt_handler()
+ * Description: Tracks FDS initialization and the profile record.
+****************************************************************/
+static void fds_evt_handler(fds_evt_t const* p_evt) {
+    switch (p_evt->id) {
+        case FDS_EVT_INIT:
+            m_fds_ready = true;
+            // A restored profile skipped the load; find its record for later updates
+            if (m_restored) {
+                radio_cfg_t stored;
+                cfg_load(&stored);
+            }
+            break;
+        case FDS_EVT_WRITE:
+            trace_ring_add(TRACE_FLASH, TRACE_FLASH_DONE | TRACE_FLASH_WRITE);
+            if (p_evt->write.file_id == RADIO_CFG_FILE_ID) {
+                if (p_evt->result == NRF_SUCCESS) {
+                    m_record_exists = true;
+                }
+                store_done(p_evt->result, false);
+                return;
+            }
+            break;
+        case FDS_EVT_UPDATE:
+            trace_ring_add(TRACE_FLASH, TRACE_FLASH_DONE | TRACE_FLASH_UPDATE);
+            if (p_evt->write.file_id == RADIO_CFG_FILE_ID) {
+                store_done(p_evt->result, false);
+                return;
+            }
+            break;
+        case FDS_EVT_GC:
+            trace_ring_add(TRACE_FLASH, TRACE_FLASH_DONE | TRACE_FLASH_GC);
+            if (m_gc_retry) {
+                m_gc_retry = false;
+                store_done(p_evt->result, true);
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+    // Another module's operation left room in the queue
+    if (m_store_again && !m_store_busy) {
+        cfg_store(true);
+    }
+}
+
+
+/****************************************************************
+ * Function: on_write_authorize()
+ * Description: Accepts a valid profile as pending and stores
+ *  it, or refuses the write.
+****************************************************************/
+static void on_write_authorize(uint16_t conn_handle, ble_gatts_evt_write_t const* p_write) {
+    ble_gatts_rw_authorize_reply_params_t reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.type = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+
+    radio_cfg_t cfg;
+    if (p_write->offset != 0 || p_write->len != sizeof(cfg)) {
+        reply.params.write.gatt_status = BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH;
+    }
+    else {
+        memcpy(&cfg, p_write->data, sizeof(cfg));
+        cfg.flags = 0;
+        if (cfg_valid(&cfg)) {
+            reply.params.write.gatt_status = BLE_GATT_STATUS_SUCCESS;
+            m_pending = cfg;
+            m_has_pending = true;
+            cfg_store(true);
+        }
+        else {
+            reply.params.write.gatt_status = RADIO_CFG_ATTERR_INVALID;
+        }
+    }
+    // The attribute keeps showing the active profile
+    reply.params.write.update = 0;
+    sd_ble_gatts_rw_authorize_reply(conn_handle, &reply);
+    value_refresh();
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Handles writes to the configuration.
+ *  BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST - Profile written
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    ble_gatts_evt_rw_authorize_request_t const* p_auth = &p_ble_evt->evt.gatts_evt.params.authorize_request;
+    switch (p_ble_evt->header.evt_id) {
+        case BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST:
+            if (p_auth->type == BLE_GATTS_AUTHORIZE_TYPE_WRITE &&
+                p_auth->request.write.handle == m_cfg_handles.value_handle) {
+                on_write_authorize(p_ble_evt->evt.gatts_evt.conn_handle, &p_auth->request.write);
+            }
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: radio_cfg_init()
+ * Description: Starts FDS, which scans its pages in the
+ *  background, and uses the defaults until the profile is loaded.
+****************************************************************/
+void radio_cfg_init(radio_cfg_t const* p_defaults) {
+    m_active = *p_defaults;
+    m_active.version = RADIO_CFG_VERSION;
+    m_active.flags = 0;
+    fds_register(fds_evt_handler);
+    fds_init();
+}
+
+
+/****************************************************************
+ * Function: radio_cfg_load()
+ * Description: Waits for FDS and loads the stored profile, if
+ *  there is one.
+****************************************************************/
+bool radio_cfg_load(void) {
+    while (!m_fds_ready) {
+        nrf_pwr_mgmt_run();
+    }
+    radio_cfg_t stored;
+    if (!cfg_load(&stored)) {
+        return false;
+    }
+    m_active = stored;
+    m_active.flags = 0;
+    if (m_cfg_handles.value_handle != BLE_GATT_HANDLE_INVALID) {
+        value_refresh();
+    }
+    return true;
+}
+
+
+/****************************************************************
+ * Function: radio_cfg_restore()
+ * Description: Makes a retained profile active without waiting
+ *  for FDS. The stored record is the same profile, so only its
+ *  descriptor is looked up once FDS is ready.
+****************************************************************/
+bool radio_cfg_restore(radio_cfg_t const* p_cfg) {
+    if (!cfg_valid(p_cfg)) {
+        return radio_cfg_load();
+    }
+    m_active = *p_cfg;
+    m_active.flags = 0;
+    m_restored = true;
+    if (m_fds_ready) {
+        radio_cfg_t stored;
+        cfg_load(&stored);
+    }
+    if (m_cfg_handles.value_handle != BLE_GATT_HANDLE_INVALID) {
+        value_refresh();
+    }
+    return true;
+}
+
+
+/****************************************************************
+ * Function: radio_cfg_service_init()
+ * Description: Adds the configuration service and its
+ *  read/write (authorized) characteristic.
+****************************************************************/
+void radio_cfg_service_init(uint8_t uuid_type) {
+    // Add service
+    ble_uuid_t ble_uuid;
+    ble_add_char_params_t add_char_params;
+    uint16_t service_handle;
+    ble_uuid.type = uuid_type;
+    ble_uuid.uuid = UUID_RADIO_CFG_SERVICE;
+    sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &service_handle);
+
+    // Add profile characteristic
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid                = UUID_RADIO_CFG_CHAR;
+    add_char_params.uuid_type           = uuid_type;
+    add_char_params.init_len            = sizeof(radio_cfg_t);
+    add_char_params.max_len             = sizeof(radio_cfg_t);
+    add_char_params.p_init_value        = (uint8_t*)&m_active;
+    add_char_params.char_props.read     = 1;
+    add_char_params.char_props.write    = 1;
+    add_char_params.is_defered_write    = true;
+    add_char_params.read_access         = SEC_OPEN;
+    add_char_params.write_access        = SEC_OPEN;
+    characteristic_add(service_handle, &add_char_params, &m_cfg_handles);
+}
+
+
+/****************************************************************
+ * Function: radio_cfg_active()
+ * Description: Returns the profile in use.
+****************************************************************/
+radio_cfg_t const* radio_cfg_active(void) {
+    return &m_active;
+}
+
+
+/****************************************************************
+ * Function: radio_cfg_apply()
+ * Description: Makes the pending profile active. Returns true
+ *  if it differs from the one in use.
+****************************************************************/
+bool radio_cfg_apply(void) {
+    if (!m_has_pending) {
+        return false;
+    }
+    bool changed = (memcmp(&m_active, &m_pending, sizeof(m_active)) != 0);
+    m_active = m_pending;
+    m_has_pending = false;
+    value_refresh();
+    return changed;
+}
+
+NRF_SDH_BLE_OBSERVER(m_radio_cfg_observer, RADIO_CFG_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
@@ -0,0 +1,69 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: radio_cfg.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Runtime radio configuration. Advertising and connection
+ * parameters can be rewritten over a characteristic, are validated, kept in
+ * flash (FDS) and take effect on the next advertising/connection cycle.
+*******************************************************************************/
+#ifndef RADIO_CFG_H__
+#define RADIO_CFG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Configuration service and characteristic UUIDs (on the application base UUID)
+#define UUID_RADIO_CFG_SERVICE 0x1600
+#define UUID_RADIO_CFG_CHAR 0x1601
+// Profile format version, bump when radio_cfg_t changes
+#define RADIO_CFG_VERSION 1
+// Set in flags when a written profile waits for the next cycle
+#define RADIO_CFG_FLAG_PENDING 0x01
+
+// Radio profile, as read and written over the air
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    uint8_t  flags;
+    uint16_t adv_interval;              // 0.625 ms units
+    uint16_t min_conn_interval;         // 1.25 ms units
+    uint16_t max_conn_interval;         // 1.25 ms units
+    uint16_t slave_latency;             // Connection events
+    uint16_t conn_sup_timeout;          // 10 ms units
+    uint16_t first_update_delay_ms;     // Connection parameter negotiation
+    uint16_t next_update_delay_ms;
+    uint8_t  max_update_count;
+    uint8_t  reserved;
+} radio_cfg_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Starts reading the stored profile; p_defaults is active until
+// radio_cfg_load() (call after the SoftDevice is enabled)
+void radio_cfg_init(radio_cfg_t const* p_defaults);
+// Waits for the read to finish; true if a stored profile replaced the defaults
+bool radio_cfg_load(void);
+// Uses a profile kept in retained RAM instead of waiting for the read;
+// true if it is valid and replaced the defaults
+bool radio_cfg_restore(radio_cfg_t const* p_cfg);
+// Adds the configuration service
+void radio_cfg_service_init(uint8_t uuid_type);
+// Returns the profile in use
+radio_cfg_t const* radio_cfg_active(void);
+// Makes a written profile the active one; true if anything changed
+bool radio_cfg_apply(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RADIO_CFG_H__
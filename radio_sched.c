@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: radio_sched.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Radio notification aware job scheduler. The SoftDevice
+ * signals shortly before every radio event and again when it ends; jobs
+ * (compression, flash writes, DSP) are only started when the predicted gap
+ * to the next radio event is long enough to hold them. Jobs that have
+ * waited too long are run regardless so nothing is starved.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include "radio_sched.h"
+#include "ble_radio_notification.h"
+#include "app_util_platform.h"
+#include "app_timer.h"
+#include "app_ticks.h"
+#include "trace_ring.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Radio notification interrupt priority
+#define RADIO_NOTIFICATION_IRQ_PRIO APP_IRQ_PRIORITY_LOW
+// Notification lead time before the radio becomes active (RADIO_SCHED_LEAD_US)
+#define RADIO_NOTIFICATION_DISTANCE NRF_RADIO_NOTIFICATION_DISTANCE_800US
+// Jobs older than this run even if they overlap radio activity
+#define MAX_DEFER_TICKS APP_TIMER_TICKS(50)
+// Safety margin kept free before the next radio event
+#define GAP_MARGIN_US 200
+// Radio event spacing above this is not a connection/advertising period
+#define MAX_PERIOD_TICKS APP_TIMER_TICKS(4000)
+
+typedef struct {
+    radio_sched_job_t job;
+    void* p_context;
+    uint16_t cost_us;
+    bool deferred;
+    uint32_t posted;
+} queue_entry_t;
+
+// Job queue
+static queue_entry_t m_queue[RADIO_SCHED_QUEUE_SIZE];
+static uint8_t m_head;
+static uint8_t m_count;
+// Radio activity
+static volatile bool m_radio_active;
+static volatile uint32_t m_last_active;
+static volatile uint32_t m_period_ticks;
+static radio_sched_listener_t m_listeners[RADIO_SCHED_MAX_LISTENERS];
+static uint8_t m_listener_count;
+// Metrics
+static radio_sched_stats_t m_stats;
+
+
+/****************************************************************
+ * Function: radio_notification_handler()
+ * Description: Tracks radio activity and the spacing between
+ *  radio events, then forwards the transition to listeners.
+****************************************************************/
+static void radio_notification_handler(bool radio_active) {
+    uint32_t trace_mark = trace_ring_enter(TRACE_HANDLER_RADIO);
+#if TRACE_RING_TIMING
+    trace_ring_add(TRACE_RADIO, radio_active);
+#endif
+    m_radio_active = radio_active;
+    if (radio_active) {
+        uint32_t now = app_timer_cnt_get();
+        if (m_stats.radio_events > 0) {
+            uint32_t period = app_timer_cnt_diff_compute(now, m_last_active);
+            if (period < MAX_PERIOD_TICKS) {
+                m_period_ticks = (m_period_ticks == 0) ? period : (m_period_ticks * 3 + period) / 4;
+            }
+        }
+        m_last_active = now;
+        m_stats.radio_events++;
+    }
+    for (uint32_t i = 0; i < m_listener_count; i++) {
+        m_listeners[i](radio_active);
+    }
+    trace_ring_exit(TRACE_HANDLER_RADIO, trace_mark);
+}
+
+
+/****************************************************************
+ * Function: job_fits()
+ * Description: Returns true if a job of the given cost can run
+ *  to completion before the next predicted radio event.
+****************************************************************/
+static bool job_fits(uint16_t cost_us, uint32_t now) {
+    if (m_radio_active) {
+        return false;
+    }
+    uint32_t period = m_period_ticks;
+    if (period == 0) {
+        // No radio pattern yet, nothing to collide with
+        return true;
+    }
+    uint32_t elapsed = app_timer_cnt_diff_compute(now, m_last_active);
+    if (elapsed >= period) {
+        // Predicted event missed (slave latency, end of advertising)
+        return true;
+    }
+    return APP_TICKS_TO_US(period - elapsed) >= (uint32_t)cost_us + GAP_MARGIN_US;
+}
+
+
+/****************************************************************
+ * Function: radio_sched_post()
+ * Description: Queues a job. May be called from any interrupt
+ *  priority.
+****************************************************************/
+bool radio_sched_post(radio_sched_job_t job, void* p_context, uint16_t cost_us) {
+    bool queued = false;
+    CRITICAL_REGION_ENTER();
+    if (m_count < RADIO_SCHED_QUEUE_SIZE) {
+        queue_entry_t* p_entry = &m_queue[(m_head + m_count) % RADIO_SCHED_QUEUE_SIZE];
+        p_entry->job = job;
+        p_entry->p_context = p_context;
+        p_entry->cost_us = cost_us;
+        p_entry->deferred = false;
+        p_entry->posted = app_timer_cnt_get();
+        m_count++;
+        queued = true;
+    }
+    else {
+        m_stats.jobs_dropped++;
+    }
+    CRITICAL_REGION_EXIT();
+    return queued;
+}
+
+
+/****************************************************************
+ * Function: radio_sched_execute()
+ * Description: Runs queued jobs in order for as long as they fit
+ *  in the current radio gap. Called from the main loop; the
+ *  radio notification interrupt wakes the loop again when the
+ *  radio goes idle.
+****************************************************************/
+void radio_sched_execute(void) {
+    while (m_count > 0) {
+        queue_entry_t entry = m_queue[m_head];
+        uint32_t now = app_timer_cnt_get();
+        uint32_t age = app_timer_cnt_diff_compute(now, entry.posted);
+        bool forced = age >= MAX_DEFER_TICKS;
+
+        if (!forced && !job_fits(entry.cost_us, now)) {
+            if (!m_queue[m_head].deferred) {
+                m_queue[m_head].deferred = true;
+                m_stats.jobs_deferred++;
+            }
+            return;
+        }
+
+        CRITICAL_REGION_ENTER();
+        m_head = (m_head + 1) % RADIO_SCHED_QUEUE_SIZE;
+        m_count--;
+        CRITICAL_REGION_EXIT();
+
+        uint32_t latency_us = APP_TICKS_TO_US(age);
+        m_stats.latency_sum_us += latency_us;
+        if (latency_us > m_stats.latency_max_us) {
+            m_stats.latency_max_us = latency_us;
+        }
+        if (forced) {
+            m_stats.jobs_forced++;
+        }
+        else if (entry.deferred) {
+            m_stats.overlaps_avoided++;
+        }
+        m_stats.jobs_run++;
+        trace_ring_add(TRACE_JOB, (uint32_t)(uintptr_t)entry.job);
+        uint32_t trace_mark = trace_ring_enter(TRACE_HANDLER_JOB);
+        entry.job(entry.p_context);
+        trace_ring_exit(TRACE_HANDLER_JOB, trace_mark);
+    }
+}
+
+
+/****************************************************************
+ * Function: radio_sched_listener_add()
+ * Description: Registers a listener for radio transitions.
+****************************************************************/
+bool radio_sched_listener_add(radio_sched_listener_t listener) {
+    if (m_listener_count >= RADIO_SCHED_MAX_LISTENERS) {
+        return false;
+    }
+    m_listeners[m_listener_count++] = listener;
+    return true;
+}
+
+
+/****************************************************************
+ * Function: radio_sched_radio_active()
+ * Description: Returns the current radio state.
+****************************************************************/
+bool radio_sched_radio_active(void) {
+    return m_radio_active;
+}
+
+
+/****************************************************************
+ * Function: radio_sched_stats_get()
+ * Description: Returns the scheduler metrics.
+****************************************************************/
+radio_sched_stats_t const* radio_sched_stats_get(void) {
+    m_stats.radio_period_us = APP_TICKS_TO_US(m_period_ticks);
+    return &m_stats;
+}
+
+
+/****************************************************************
+ * Function: radio_sched_init()
+ * Description: Enables radio notifications on both edges of
+ *  every radio event.
+****************************************************************/
+void radio_sched_init(void) {
+    ble_radio_notification_init(RADIO_NOTIFICATION_IRQ_PRIO,
+                                RADIO_NOTIFICATION_DISTANCE,
+                                radio_notification_handler);
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: radio_sched.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Radio notification aware job scheduler. CPU heavy work is
+ * queued here and run from the main loop in the gaps between radio events.
+*******************************************************************************/
+#ifndef RADIO_SCHED_H__
+#define RADIO_SCHED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Maximum number of queued jobs
+#define RADIO_SCHED_QUEUE_SIZE 8
+// Maximum number of radio activity listeners
+#define RADIO_SCHED_MAX_LISTENERS 4
+// Time between the active notification and the radio event
+#define RADIO_SCHED_LEAD_US 800
+
+// Deferred job
+typedef void (*radio_sched_job_t)(void* p_context);
+// Radio activity listener, called from the radio notification interrupt
+typedef void (*radio_sched_listener_t)(bool radio_active);
+
+// Scheduler metrics
+typedef struct {
+    uint32_t jobs_run;
+    uint32_t jobs_dropped;          // Queue full
+    uint32_t jobs_deferred;         // Held back at least once by radio activity
+    uint32_t jobs_forced;           // Ran past their deadline regardless of radio
+    uint32_t overlaps_avoided;      // Times a ready job was held back
+    uint32_t latency_max_us;        // Post-to-run latency
+    uint32_t latency_sum_us;
+    uint32_t radio_events;
+    uint32_t radio_period_us;       // Averaged time between radio events
+} radio_sched_stats_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Enables radio notifications (call after the SoftDevice is enabled)
+void radio_sched_init(void);
+// Queues a job expected to take cost_us; false if the queue is full
+bool radio_sched_post(radio_sched_job_t job, void* p_context, uint16_t cost_us);
+// Runs queued jobs that fit before the next radio event (main loop)
+void radio_sched_execute(void);
+// Registers a listener for radio active/inactive transitions
+bool radio_sched_listener_add(radio_sched_listener_t listener);
+// Returns true while the radio is active (or about to be)
+bool radio_sched_radio_active(void);
+// Returns the scheduler metrics
+radio_sched_stats_t const* radio_sched_stats_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RADIO_SCHED_H__
@@ -0,0 +1,305 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: rpc.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Request/response RPC over a GATT characteristic.
+ *
+ *  Each write is parsed for frames and every request is dispatched through
+ *  a constant table indexed by method number. Responses are packed into a
+ *  pooled notification buffer; it is sent when it is full and once the
+ *  whole write has been handled, so a batch of requests is usually answered
+ *  by one or two notifications.
+ *
+ *  Responses share the telemetry class of the scheduler. A buffer it has no
+ *  room for is held, and sent as notifications complete, rather than lost.
+ *  Once RPC_RESP_HELD buffers are held, further requests are not run and
+ *  are answered with RPC_STATUS_BUSY, so the central knows to retry.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <string.h>
+#include "rpc.h"
+#include "nrf_sdh_ble.h"
+#include "ble_srv_common.h"
+#include "app_util_platform.h"
+#include "tx_sched.h"
+#include "trace_ring.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE priority value (after tx_sched so its queue has room again)
+#define RPC_BLE_OBSERVER_PRIO 3
+// Class responses are sent with
+#define RPC_TX_CLASS TX_SCHED_TELEMETRY
+// Response buffers held while the scheduler's queue is full
+#define RPC_RESP_HELD 4
+
+typedef struct {
+    uint8_t* p_block;
+    uint16_t conn_handle;
+    uint8_t len;
+} rpc_held_t;
+
+static ble_gatts_char_handles_t m_rpc_handles;
+static rpc_handler_t const* m_methods;
+static uint8_t m_method_count;
+// Responses being packed
+static uint8_t* m_resp_block;
+static uint8_t m_resp_len;
+static uint16_t m_resp_conn;
+// Packed responses waiting for the scheduler, oldest first
+static rpc_held_t m_held[RPC_RESP_HELD];
+static uint8_t m_held_head;
+static uint8_t m_held_count;
+static rpc_stats_t m_stats;
+
+
+/****************************************************************
+ * Function: resp_send()
+ * Description: Hands held responses to the scheduler while it
+ *  has room for them.
+****************************************************************/
+static void resp_send(void) {
+    while (m_held_count > 0) {
+        rpc_held_t const* p_held = &m_held[m_held_head];
+        if (!tx_sched_room(p_held->conn_handle, RPC_TX_CLASS)) {
+            return;
+        }
+        if (tx_sched_notify(p_held->conn_handle, m_rpc_handles.value_handle, RPC_TX_CLASS,
+                            p_held->p_block, p_held->len) != NRF_SUCCESS) {
+            m_stats.dropped++;
+        }
+        m_held_head = (m_held_head + 1) % RPC_RESP_HELD;
+        m_held_count--;
+    }
+}
+
+
+/****************************************************************
+ * Function: resp_flush()
+ * Description: Queues the packed responses as a notification,
+ *  holding them if the scheduler has no room yet.
+****************************************************************/
+static void resp_flush(void) {
+    if (m_resp_block == NULL) {
+        return;
+    }
+    if (m_held_count < RPC_RESP_HELD) {
+        rpc_held_t* p_held = &m_held[(m_held_head + m_held_count) % RPC_RESP_HELD];
+        p_held->p_block = m_resp_block;
+        p_held->conn_handle = m_resp_conn;
+        p_held->len = m_resp_len;
+        m_held_count++;
+    }
+    else {
+        block_pool_free(&g_notif_pool, m_resp_block);
+        m_stats.dropped++;
+    }
+    m_resp_block = NULL;
+    m_resp_len = 0;
+    resp_send();
+}
+
+
+/****************************************************************
+ * Function: resp_drop()
+ * Description: Frees the responses of a connection that went
+ *  away, packed or held.
+****************************************************************/
+static void resp_drop(uint16_t conn_handle) {
+    if (m_resp_block != NULL && m_resp_conn == conn_handle) {
+        block_pool_free(&g_notif_pool, m_resp_block);
+        m_resp_block = NULL;
+        m_resp_len = 0;
+    }
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < m_held_count; i++) {
+        rpc_held_t held = m_held[(m_held_head + i) % RPC_RESP_HELD];
+        if (held.conn_handle == conn_handle) {
+            block_pool_free(&g_notif_pool, held.p_block);
+        }
+        else {
+            m_held[(m_held_head + kept++) % RPC_RESP_HELD] = held;
+        }
+    }
+    m_held_count = kept;
+}
+
+
+/****************************************************************
+ * Function: resp_add()
+ * Description: Packs a response frame, flushing first if it
+ *  would not fit.
+****************************************************************/
+static void resp_add(uint16_t conn_handle, uint8_t id, uint8_t status, uint8_t const* p_data, uint8_t len) {
+    if (len > RPC_RESP_MAX) {
+        len = RPC_RESP_MAX;
+    }
+    if (m_resp_block != NULL &&
+        (m_resp_conn != conn_handle || m_resp_len + RPC_FRAME_HEADER + len > APP_POOL_NOTIF_SIZE)) {
+        resp_flush();
+    }
+    if (m_resp_block == NULL) {
+        m_resp_block = block_pool_alloc(&g_notif_pool);
+        if (m_resp_block == NULL) {
+            m_stats.dropped++;
+            return;
+        }
+        m_resp_conn = conn_handle;
+    }
+    uint8_t* p_frame = &m_resp_block[m_resp_len];
+    p_frame[0] = len + 2;
+    p_frame[1] = id;
+    p_frame[2] = status;
+    memcpy(&p_frame[RPC_FRAME_HEADER], p_data, len);
+    m_resp_len += RPC_FRAME_HEADER + len;
+    m_stats.responses++;
+}
+
+
+/****************************************************************
+ * Function: on_write()
+ * Description: Dispatches every request frame of a write.
+****************************************************************/
+static void on_write(uint16_t conn_handle, uint8_t const* p_data, uint16_t len) {
+    uint16_t offset = 0;
+    uint8_t batch = 0;
+    while (offset < len) {
+        uint8_t frame_len = p_data[offset];
+        if (frame_len < 2 || offset + 1 + frame_len > len) {
+            // Malformed, the rest of the write cannot be framed
+            m_stats.errors++;
+            break;
+        }
+        uint8_t id = p_data[offset + 1];
+        uint8_t method = p_data[offset + 2];
+        uint8_t const* p_args = &p_data[offset + RPC_FRAME_HEADER];
+        uint8_t args_len = frame_len - 2;
+        offset += 1 + frame_len;
+        batch++;
+        m_stats.requests++;
+        trace_ring_add(TRACE_RPC, ((uint32_t)id << 8) | method);
+
+        uint8_t resp[RPC_RESP_MAX];
+        uint8_t resp_len = 0;
+        uint8_t status;
+        if (m_held_count >= RPC_RESP_HELD) {
+            // A new buffer could not be held, do not run the request
+            status = RPC_STATUS_BUSY;
+            m_stats.busy++;
+        }
+        else if (method < m_method_count && m_methods[method] != NULL) {
+            status = m_methods[method](conn_handle, id, p_args, args_len, resp, &resp_len);
+        }
+        else {
+            status = RPC_STATUS_UNKNOWN_METHOD;
+            m_stats.errors++;
+        }
+        if (status == RPC_STATUS_PENDING) {
+            m_stats.pending++;
+        }
+        else {
+            // Handlers run with interrupts enabled; only the shared
+            // response buffer is protected (rpc_respond() uses it too)
+            CRITICAL_REGION_ENTER();
+            resp_add(conn_handle, id, status, resp, resp_len);
+            CRITICAL_REGION_EXIT();
+        }
+    }
+    CRITICAL_REGION_ENTER();
+    resp_flush();
+    CRITICAL_REGION_EXIT();
+    if (batch > m_stats.batch_max) {
+        m_stats.batch_max = batch;
+    }
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Picks up writes to the RPC characteristic.
+ *  BLE_GAP_EVT_DISCONNECTED      - Drop unsent responses
+ *  BLE_GATTS_EVT_WRITE           - Requests from the central
+ *  BLE_GATTS_EVT_HVN_TX_COMPLETE - Send held responses
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    ble_gatts_evt_write_t const* p_write = &p_ble_evt->evt.gatts_evt.params.write;
+    switch (p_ble_evt->header.evt_id) {
+        case BLE_GAP_EVT_DISCONNECTED:
+            CRITICAL_REGION_ENTER();
+            resp_drop(p_ble_evt->evt.gap_evt.conn_handle);
+            CRITICAL_REGION_EXIT();
+            break;
+        case BLE_GATTS_EVT_WRITE:
+            if (p_write->handle == m_rpc_handles.value_handle) {
+                on_write(p_ble_evt->evt.gatts_evt.conn_handle, p_write->data, p_write->len);
+            }
+            break;
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+            CRITICAL_REGION_ENTER();
+            resp_send();
+            CRITICAL_REGION_EXIT();
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: rpc_init()
+ * Description: Adds the RPC service and its request/response
+ *  characteristic.
+****************************************************************/
+void rpc_init(uint8_t uuid_type, rpc_handler_t const* p_methods, uint8_t method_count) {
+    m_methods = p_methods;
+    m_method_count = method_count;
+
+    // Add service
+    ble_uuid_t ble_uuid;
+    ble_add_char_params_t add_char_params;
+    uint16_t service_handle;
+    ble_uuid.type = uuid_type;
+    ble_uuid.uuid = UUID_RPC_SERVICE;
+    sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &service_handle);
+
+    // Add request/response characteristic
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid                    = UUID_RPC_CHAR;
+    add_char_params.uuid_type               = uuid_type;
+    add_char_params.init_len                = 0;
+    add_char_params.max_len                 = APP_POOL_NOTIF_SIZE;
+    add_char_params.is_var_len              = true;
+    add_char_params.char_props.write        = 1;
+    add_char_params.char_props.write_wo_resp = 1;
+    add_char_params.char_props.notify       = 1;
+    add_char_params.write_access            = SEC_OPEN;
+    add_char_params.cccd_write_access       = SEC_OPEN;
+    characteristic_add(service_handle, &add_char_params, &m_rpc_handles);
+}
+
+
+/****************************************************************
+ * Function: rpc_respond()
+ * Description: Sends a late response on its own.
+****************************************************************/
+void rpc_respond(uint16_t conn_handle, uint8_t id, uint8_t status, uint8_t const* p_data, uint8_t len) {
+    CRITICAL_REGION_ENTER();
+    resp_add(conn_handle, id, status, p_data, len);
+    resp_flush();
+    CRITICAL_REGION_EXIT();
+}
+
+
+/****************************************************************
+ * Function: rpc_stats_get()
+ * Description: Returns the RPC statistics.
+****************************************************************/
+rpc_stats_t const* rpc_stats_get(void) {
+    return &m_stats;
+}
+
+NRF_SDH_BLE_OBSERVER(m_rpc_observer, RPC_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
@@ -0,0 +1,76 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: rpc.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Request/response RPC over a single GATT characteristic.
+ * Centrals write framed requests (several per write, without response) and
+ * get framed responses back as notifications, matched by request ID, so
+ * many commands can be in flight at once.
+ *
+ *  Request frame:  len | id | method | args...   (len counts id onwards)
+ *  Response frame: len | id | status | data...
+*******************************************************************************/
+#ifndef RPC_H__
+#define RPC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_pools.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// RPC service and characteristic UUIDs (on the application base UUID)
+#define UUID_RPC_SERVICE 0x1500
+#define UUID_RPC_CHAR 0x1501
+// Frame header sizes
+#define RPC_FRAME_HEADER 3
+// Largest response data (one frame filling a notification)
+#define RPC_RESP_MAX (APP_POOL_NOTIF_SIZE - RPC_FRAME_HEADER)
+
+// Response status codes
+#define RPC_STATUS_OK 0x00
+#define RPC_STATUS_UNKNOWN_METHOD 0x01
+#define RPC_STATUS_INVALID_ARGS 0x02
+#define RPC_STATUS_BUSY 0x03
+// Returned by a handler that responds later with rpc_respond()
+#define RPC_STATUS_PENDING 0xFF
+
+// Method handler. Fills up to RPC_RESP_MAX bytes of p_resp, sets
+// *p_resp_len and returns a status (or RPC_STATUS_PENDING).
+typedef uint8_t (*rpc_handler_t)(uint16_t conn_handle, uint8_t id,
+                                 uint8_t const* p_args, uint8_t args_len,
+                                 uint8_t* p_resp, uint8_t* p_resp_len);
+
+// RPC statistics
+typedef struct {
+    uint32_t requests;
+    uint32_t responses;
+    uint32_t errors;                // Unknown method, bad frame
+    uint32_t dropped;               // Responses lost (no buffer, link gone)
+    uint32_t busy;                  // Requests refused, responses backed up
+    uint32_t pending;               // Requests answered later
+    uint8_t batch_max;              // Most requests seen in one write
+} rpc_stats_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Adds the RPC service; p_methods is indexed by method number
+void rpc_init(uint8_t uuid_type, rpc_handler_t const* p_methods, uint8_t method_count);
+// Sends the response of a request whose handler returned RPC_STATUS_PENDING
+void rpc_respond(uint16_t conn_handle, uint8_t id, uint8_t status, uint8_t const* p_data, uint8_t len);
+// Returns the RPC statistics
+rpc_stats_t const* rpc_stats_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RPC_H__
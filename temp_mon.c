@@ -0,0 +1,279 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: temp_mon.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Die temperature telemetry.
+ *
+ *  A timer wheel timer posts one sample every TEMP_MON_INTERVAL_MS to the
+ *  next radio gap, where sd_temp_get() runs the TEMP peripheral (about
+ *  36 us at ~1 mA) without meeting a radio event. The rolling statistics
+ *  are recomputed from a small ring on each sample. While connected, the
+ *  link's last RSSI from ble_diag is added to the band of the sample's
+ *  temperature, so drift in link quality can be matched to temperature.
+ *  The summary is stored for reads on every sample, but only notified
+ *  (and the advertising data only updated) when the whole degree value
+ *  moves past a hysteresis, so steady temperatures cost no airtime.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <string.h>
+#include "temp_mon.h"
+#include "nrf_soc.h"
+#include "nrf_sdh_ble.h"
+#include "ble_srv_common.h"
+#include "timer_wheel.h"
+#include "radio_sched.h"
+#include "app_pools.h"
+#include "tx_sched.h"
+#include "ble_diag.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE priority value
+#define TEMP_BLE_OBSERVER_PRIO 2
+#define TEMP_INTERVAL TIMER_WHEEL_TICKS(TEMP_MON_INTERVAL_MS)
+// Cost of one sample (sd_temp_get() blocks while the sensor converts)
+#define TEMP_SAMPLE_COST_US 60
+// sd_temp_get() units per degree
+#define TEMP_UNITS_PER_DEGREE 4
+// Change (0.25 degree units) from the advertised value before it follows
+#define TEMP_REPORT_HYSTERESIS 6
+
+typedef struct {
+    int32_t rssi_sum;
+    uint32_t samples;
+} band_t;
+
+TIMER_WHEEL_DEF(m_temp_timer);
+
+static temp_mon_handler_t m_handler;
+// Last TEMP_MON_WINDOW samples
+static int16_t m_window[TEMP_MON_WINDOW];
+static uint32_t m_window_count;
+static uint32_t m_window_next;
+static int16_t m_current;
+static int8_t m_reported;
+static band_t m_bands[TEMP_MON_BANDS];
+static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;
+// Summary characteristic
+static ble_gatts_char_handles_t m_summary_handles;
+#if APP_USER_VALUES
+// Summary attribute value, in application memory
+static temp_mon_summary_t* m_summary_value;
+#endif
+
+
+/****************************************************************
+ * Function: celsius()
+ * Description: Rounds a temperature to whole degrees.
+****************************************************************/
+static int8_t celsius(int32_t temp) {
+    int32_t half = TEMP_UNITS_PER_DEGREE / 2;
+    return (int8_t)((temp >= 0) ? (temp + half) / TEMP_UNITS_PER_DEGREE
+                                : -((-temp + half) / TEMP_UNITS_PER_DEGREE));
+}
+
+
+/****************************************************************
+ * Function: band_add()
+ * Description: Adds the link's last RSSI to the band of the
+ *  current temperature.
+****************************************************************/
+static void band_add(void) {
+    ble_diag_link_t const* p_link = ble_diag_link_get(m_conn_handle);
+    if (p_link == NULL || p_link->rssi_samples == 0) {
+        return;
+    }
+    int32_t band = (celsius(m_current) - TEMP_MON_BAND_FLOOR) / TEMP_MON_BAND_WIDTH;
+    if (band < 0) {
+        band = 0;
+    }
+    else if (band >= TEMP_MON_BANDS) {
+        band = TEMP_MON_BANDS - 1;
+    }
+    m_bands[band].rssi_sum += p_link->rssi_last;
+    m_bands[band].samples++;
+}
+
+
+/****************************************************************
+ * Function: temp_mon_summary_get()
+ * Description: Builds the summary from the window and bands.
+****************************************************************/
+void temp_mon_summary_get(temp_mon_summary_t* p_summary) {
+    memset(p_summary, 0, sizeof(*p_summary));
+    p_summary->version = TEMP_MON_SUMMARY_VERSION;
+    p_summary->current = m_current;
+    if (m_window_count > 0) {
+        int32_t sum = 0;
+        p_summary->min = INT16_MAX;
+        p_summary->max = INT16_MIN;
+        for (uint32_t i = 0; i < m_window_count; i++) {
+            sum += m_window[i];
+            if (m_window[i] < p_summary->min) {
+                p_summary->min = m_window[i];
+            }
+            if (m_window[i] > p_summary->max) {
+                p_summary->max = m_window[i];
+            }
+        }
+        p_summary->mean = (int16_t)(sum / (int32_t)m_window_count);
+    }
+    for (uint32_t i = 0; i < TEMP_MON_BANDS; i++) {
+        if (m_bands[i].samples > 0) {
+            p_summary->band_rssi[i] = (int8_t)(m_bands[i].rssi_sum / (int32_t)m_bands[i].samples);
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: summary_publish()
+ * Description: Stores the summary for reads and, if asked to,
+ *  queues it as telemetry.
+****************************************************************/
+static void summary_publish(bool notify) {
+    notify = notify && m_conn_handle != BLE_CONN_HANDLE_INVALID;
+#if APP_USER_VALUES
+    // Built in the attribute itself, the notification sends it as is
+    temp_mon_summary_get(m_summary_value);
+    if (notify) {
+        tx_sched_notify(m_conn_handle, m_summary_handles.value_handle, TX_SCHED_TELEMETRY,
+                        NULL, sizeof(*m_summary_value));
+    }
+#else
+    temp_mon_summary_t* p_summary = block_pool_alloc(&g_notif_pool);
+    if (p_summary == NULL) {
+        return;
+    }
+    temp_mon_summary_get(p_summary);
+
+    // Stored for reads, then queued (the block is handed over)
+    ble_gatts_value_t value = {
+        .len = sizeof(*p_summary),
+        .offset = 0,
+        .p_value = (uint8_t*)p_summary
+    };
+    sd_ble_gatts_value_set(BLE_CONN_HANDLE_INVALID, m_summary_handles.value_handle, &value);
+    if (notify) {
+        tx_sched_notify(m_conn_handle, m_summary_handles.value_handle, TX_SCHED_TELEMETRY,
+                        (uint8_t*)p_summary, sizeof(*p_summary));
+    }
+    else {
+        block_pool_free(&g_notif_pool, p_summary);
+    }
+#endif
+}
+
+
+/****************************************************************
+ * Function: sample_job()
+ * Description: Takes a sample, updates the statistics and
+ *  reports a change of the whole degree value.
+****************************************************************/
+static void sample_job(void* p_context) {
+    int32_t temp;
+    if (sd_temp_get(&temp) != NRF_SUCCESS) {
+        return;
+    }
+    m_current = (int16_t)temp;
+    m_window[m_window_next] = m_current;
+    m_window_next = (m_window_next + 1) % TEMP_MON_WINDOW;
+    if (m_window_count < TEMP_MON_WINDOW) {
+        m_window_count++;
+    }
+    band_add();
+
+    int32_t delta = temp - m_reported * TEMP_UNITS_PER_DEGREE;
+    bool changed = delta >= TEMP_REPORT_HYSTERESIS || delta <= -TEMP_REPORT_HYSTERESIS;
+    if (changed) {
+        m_reported = celsius(temp);
+    }
+    summary_publish(changed);
+    if (changed && m_handler != NULL) {
+        m_handler(m_reported);
+    }
+}
+
+
+/****************************************************************
+ * Function: sample_timeout_handler()
+ * Description: Schedules a sample in the next radio gap.
+****************************************************************/
+static void sample_timeout_handler(void* p_context) {
+    radio_sched_post(sample_job, NULL, TEMP_SAMPLE_COST_US);
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Tracks the connection the summary is notified on.
+ *  BLE_GAP_EVT_CONNECTED    - Connected to peer
+ *  BLE_GAP_EVT_DISCONNECTED - Disconnected from peer
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    switch (p_ble_evt->header.evt_id) {
+        case BLE_GAP_EVT_CONNECTED:
+            m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            break;
+        case BLE_GAP_EVT_DISCONNECTED:
+            m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: temp_mon_init()
+ * Description: Adds the temperature service and summary
+ *  characteristic, takes the first sample so the advertised
+ *  value is valid from the start, and starts sampling.
+****************************************************************/
+void temp_mon_init(uint8_t uuid_type, temp_mon_handler_t handler) {
+    // Add service
+    ble_uuid_t ble_uuid;
+    ble_add_char_params_t add_char_params;
+    uint16_t service_handle;
+    ble_uuid.type = uuid_type;
+    ble_uuid.uuid = UUID_TEMP_SERVICE;
+    sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY, &ble_uuid, &service_handle);
+
+    // Add summary characteristic
+    memset(&add_char_params, 0, sizeof(add_char_params));
+    add_char_params.uuid                = UUID_TEMP_SUMMARY_CHAR;
+    add_char_params.uuid_type           = uuid_type;
+    add_char_params.init_len            = sizeof(temp_mon_summary_t);
+    add_char_params.max_len             = sizeof(temp_mon_summary_t);
+    add_char_params.char_props.read     = 1;
+    add_char_params.char_props.notify   = 1;
+    add_char_params.read_access         = SEC_OPEN;
+    add_char_params.cccd_write_access   = SEC_OPEN;
+#if APP_USER_VALUES
+    // Taken for the lifetime of the attribute
+    m_summary_value = block_pool_alloc(&g_notif_pool);
+    memset(m_summary_value, 0, sizeof(*m_summary_value));
+    add_char_params.is_value_user       = true;
+    add_char_params.p_init_value        = (uint8_t*)m_summary_value;
+#endif
+    characteristic_add(service_handle, &add_char_params, &m_summary_handles);
+
+    sample_job(NULL);
+    m_handler = handler;
+    timer_wheel_start(&m_temp_timer, TEMP_INTERVAL, TEMP_INTERVAL, sample_timeout_handler, NULL);
+}
+
+
+/****************************************************************
+ * Function: temp_mon_celsius()
+ * Description: Returns the advertised temperature.
+****************************************************************/
+int8_t temp_mon_celsius(void) {
+    return m_reported;
+}
+
+NRF_SDH_BLE_OBSERVER(m_temp_observer, TEMP_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: temp_mon.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Die temperature telemetry. Samples the SoftDevice's
+ * temperature sensor in radio gaps, keeps rolling statistics, records the
+ * link RSSI seen in each temperature band and publishes a summary through
+ * a read/notify characteristic; the whole degree value is advertised.
+*******************************************************************************/
+#ifndef TEMP_MON_H__
+#define TEMP_MON_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Temperature service and characteristic UUIDs (on the application base UUID)
+#define UUID_TEMP_SERVICE 0x1700
+#define UUID_TEMP_SUMMARY_CHAR 0x1701
+// Sampling interval; the rolling statistics cover the last TEMP_MON_WINDOW samples
+#define TEMP_MON_INTERVAL_MS 10000
+#define TEMP_MON_WINDOW 32
+// Link RSSI per temperature band: TEMP_MON_BANDS bands of TEMP_MON_BAND_WIDTH
+// degrees, starting at TEMP_MON_BAND_FLOOR (everything below lands in band 0)
+#define TEMP_MON_BANDS 8
+#define TEMP_MON_BAND_WIDTH 10
+#define TEMP_MON_BAND_FLOOR (-10)
+// Summary format version, bump when temp_mon_summary_t changes
+#define TEMP_MON_SUMMARY_VERSION 1
+
+// Summary sent over the air; temperatures in 0.25 degree units (sd_temp_get())
+typedef struct __attribute__((packed)) {
+    uint8_t  version;
+    int16_t  current;
+    int16_t  min;                       // Over the window
+    int16_t  max;
+    int16_t  mean;
+    int8_t   band_rssi[TEMP_MON_BANDS]; // Mean link RSSI sampled in each band, 0 if none
+} temp_mon_summary_t;
+
+// Called from the main loop when the advertised whole degree value changes
+typedef void (*temp_mon_handler_t)(int8_t celsius);
+
+
+/***************************************
+ * Functions
+***************************************/
+// Adds the temperature service, takes the first sample and starts sampling
+void temp_mon_init(uint8_t uuid_type, temp_mon_handler_t handler);
+// Returns the advertised temperature in whole degrees
+int8_t temp_mon_celsius(void);
+// Builds the current summary
+void temp_mon_summary_get(temp_mon_summary_t* p_summary);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TEMP_MON_H__
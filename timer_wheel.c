@@ -0,0 +1,454 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: timer_wheel.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Tickless hierarchical timer wheel on RTC2 (RTC0 belongs to
+ * the SoftDevice and RTC1 to app_timer).
+ *
+ *  Level k has 64 slots of 64^k ticks each and holds timers due between
+ *  64^k and 64^(k+1) ticks after the wheel time. Starting or stopping a
+ *  timer only links or unlinks it from one slot list. A bitmap per level
+ *  gives the next slot that needs attention in a few instructions. Timers
+ *  in higher levels are moved down (cascaded) once their slot has started,
+ *  but lazily: each slot remembers its earliest expiry and the RTC compare
+ *  is programmed for the earliest real expiry only, so cascading never
+ *  costs a wake-up of its own.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stddef.h>
+#include "timer_wheel.h"
+#include "nrf.h"
+#include "app_util_platform.h"
+#include "trace_ring.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// RTC2 runs at 32768 / (PRESCALER + 1) Hz
+#define RTC_PRESCALER ((32768 / TIMER_WHEEL_FREQ) - 1)
+#define RTC_COUNTER_BITS 24
+#define RTC_COUNTER_MASK ((1UL << RTC_COUNTER_BITS) - 1)
+// Compare values must be at least this far ahead of the counter
+#define RTC_MIN_DISTANCE 2
+// Compare values further ahead than this are split into several wake-ups
+#define RTC_MAX_DISTANCE (1UL << (RTC_COUNTER_BITS - 1))
+#define RTC_IRQ_PRIORITY APP_IRQ_PRIORITY_LOW
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+#define LEVEL_SHIFT(level) ((level) * TIMER_WHEEL_SLOT_BITS)
+#define WHEEL_SPAN (1UL << LEVEL_SHIFT(TIMER_WHEEL_LEVELS))
+
+// Slot lists and occupancy bitmaps
+static timer_wheel_timer_t* m_slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+static uint64_t m_occupied[TIMER_WHEEL_LEVELS];
+// Earliest expiry per slot (may be stale-early after a stop)
+static uint32_t m_slot_min[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+// Wheel time: every event up to this tick has been handled
+static uint32_t m_now;
+// RTC overflows, extending the counter to 32 bits
+static volatile uint32_t m_overflows;
+// Statistics
+static timer_wheel_stats_t m_stats;
+
+
+/****************************************************************
+ * Function: hw_now()
+ * Description: Returns the RTC2 counter extended to 32 bits.
+ *  Safe from thread context: if the interrupt counts an
+ *  overflow while the counter is read, it is read again.
+****************************************************************/
+static uint32_t hw_now(void) {
+    uint32_t overflows;
+    uint32_t counter;
+    bool pending;
+    do {
+        overflows = m_overflows;
+        counter = NRF_RTC2->COUNTER;
+        pending = NRF_RTC2->EVENTS_OVRFLW;
+    } while (overflows != m_overflows);
+    // Overflow not handled yet by the interrupt
+    if (pending && counter < (RTC_COUNTER_MASK / 2)) {
+        overflows++;
+    }
+    return (overflows << RTC_COUNTER_BITS) + counter;
+}
+
+
+/****************************************************************
+ * Function: slot_link()
+ * Description: Puts a timer in the slot matching its expiry,
+ *  relative to the wheel time.
+****************************************************************/
+static void slot_link(timer_wheel_timer_t* p_timer) {
+    int32_t delta = (int32_t)(p_timer->expires - m_now);
+    uint32_t level;
+    uint32_t slot;
+    if (delta <= 0) {
+        // Overdue, expire with the current slot
+        level = 0;
+        slot = m_now & SLOT_MASK;
+    }
+    else if ((uint32_t)delta >= WHEEL_SPAN) {
+        // Beyond the wheel, park in the furthest top level slot
+        level = TIMER_WHEEL_LEVELS - 1;
+        slot = ((m_now >> LEVEL_SHIFT(level)) + SLOT_MASK) & SLOT_MASK;
+    }
+    else {
+        level = (31 - __builtin_clz((uint32_t)delta)) / TIMER_WHEEL_SLOT_BITS;
+        slot = (p_timer->expires >> LEVEL_SHIFT(level)) & SLOT_MASK;
+    }
+
+    timer_wheel_timer_t** pp_head = &m_slots[level][slot];
+    if (*pp_head == NULL || (int32_t)(p_timer->expires - m_slot_min[level][slot]) < 0) {
+        m_slot_min[level][slot] = p_timer->expires;
+    }
+    p_timer->level = level;
+    p_timer->slot = slot;
+    p_timer->p_prev = NULL;
+    p_timer->p_next = *pp_head;
+    if (*pp_head != NULL) {
+        (*pp_head)->p_prev = p_timer;
+    }
+    *pp_head = p_timer;
+    m_occupied[level] |= (1ULL << slot);
+}
+
+
+/****************************************************************
+ * Function: slot_unlink()
+ * Description: Removes a timer from its slot.
+****************************************************************/
+static void slot_unlink(timer_wheel_timer_t* p_timer) {
+    timer_wheel_timer_t** pp_head = &m_slots[p_timer->level][p_timer->slot];
+    if (p_timer->p_prev != NULL) {
+        p_timer->p_prev->p_next = p_timer->p_next;
+    }
+    else {
+        *pp_head = p_timer->p_next;
+    }
+    if (p_timer->p_next != NULL) {
+        p_timer->p_next->p_prev = p_timer->p_prev;
+    }
+    if (*pp_head == NULL) {
+        m_occupied[p_timer->level] &= ~(1ULL << p_timer->slot);
+    }
+    p_timer->level = TIMER_WHEEL_LEVELS;
+}
+
+
+/****************************************************************
+ * Function: next_occupied()
+ * Description: Returns the distance from slot start to the next
+ *  occupied slot of a bitmap (start included), or
+ *  TIMER_WHEEL_SLOTS if the bitmap is empty.
+****************************************************************/
+static uint32_t next_occupied(uint64_t bitmap, uint32_t start) {
+    if (bitmap == 0) {
+        return TIMER_WHEEL_SLOTS;
+    }
+    uint64_t rotated = (start == 0) ? bitmap : (bitmap >> start) | (bitmap << (TIMER_WHEEL_SLOTS - start));
+    return __builtin_ctzll(rotated);
+}
+
+
+/****************************************************************
+ * Function: next_event()
+ * Description: Finds the next tick at which the wheel has work:
+ *  a level 0 slot to expire or a higher level slot to cascade.
+ *  Returns false if no timer is running.
+****************************************************************/
+static bool next_event(uint32_t* p_tick) {
+    bool found = false;
+    uint32_t best = 0;
+
+    uint32_t distance = next_occupied(m_occupied[0], m_now & SLOT_MASK);
+    if (distance < TIMER_WHEEL_SLOTS) {
+        best = m_now + distance;
+        found = true;
+    }
+    for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        // The current slot of a level has been cascaded already
+        uint32_t index = m_now >> LEVEL_SHIFT(level);
+        distance = next_occupied(m_occupied[level], (index + 1) & SLOT_MASK);
+        if (distance < TIMER_WHEEL_SLOTS) {
+            uint32_t tick = (index + distance + 1) << LEVEL_SHIFT(level);
+            if (!found || (int32_t)(tick - best) < 0) {
+                best = tick;
+                found = true;
+            }
+        }
+    }
+    *p_tick = best;
+    return found;
+}
+
+
+/****************************************************************
+ * Function: next_deadline()
+ * Description: Finds the earliest expiry of any running timer
+ *  (or a little earlier after stops). Returns false if no timer
+ *  is running.
+****************************************************************/
+static bool next_deadline(uint32_t* p_tick) {
+    bool found = false;
+    uint32_t best = 0;
+
+    uint32_t distance = next_occupied(m_occupied[0], m_now & SLOT_MASK);
+    if (distance < TIMER_WHEEL_SLOTS) {
+        best = m_now + distance;
+        found = true;
+    }
+    for (uint32_t level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        // Later slots of a level cannot hold anything earlier
+        uint32_t index = m_now >> LEVEL_SHIFT(level);
+        distance = next_occupied(m_occupied[level], (index + 1) & SLOT_MASK);
+        if (distance < TIMER_WHEEL_SLOTS) {
+            uint32_t tick = m_slot_min[level][(index + distance + 1) & SLOT_MASK];
+            if (!found || (int32_t)(tick - best) < 0) {
+                best = tick;
+                found = true;
+            }
+        }
+    }
+    *p_tick = best;
+    return found;
+}
+
+
+/****************************************************************
+ * Function: cascade()
+ * Description: Moves the timers of every higher level slot that
+ *  starts at the wheel time down to lower levels.
+****************************************************************/
+static void cascade(void) {
+    for (uint32_t level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+        if ((m_now & ((1UL << LEVEL_SHIFT(level)) - 1)) != 0) {
+            continue;
+        }
+        uint32_t slot = (m_now >> LEVEL_SHIFT(level)) & SLOT_MASK;
+        timer_wheel_timer_t* p_timer = m_slots[level][slot];
+        m_slots[level][slot] = NULL;
+        m_occupied[level] &= ~(1ULL << slot);
+        while (p_timer != NULL) {
+            timer_wheel_timer_t* p_next = p_timer->p_next;
+            slot_link(p_timer);
+            m_stats.cascades++;
+            p_timer = p_next;
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: due_pop()
+ * Description: Advances the wheel time up to target and returns
+ *  the first timer due by then, or NULL.
+****************************************************************/
+static timer_wheel_timer_t* due_pop(uint32_t target) {
+    for (;;) {
+        timer_wheel_timer_t* p_timer = m_slots[0][m_now & SLOT_MASK];
+        if (p_timer != NULL) {
+            slot_unlink(p_timer);
+            return p_timer;
+        }
+        uint32_t tick;
+        if (!next_event(&tick) || (int32_t)(tick - target) > 0) {
+            return NULL;
+        }
+        m_now = tick;
+        cascade();
+    }
+}
+
+
+/****************************************************************
+ * Function: compare_update()
+ * Description: Programs the RTC compare for the next event, or
+ *  pends the interrupt if it is already due.
+****************************************************************/
+static void compare_update(void) {
+    uint32_t tick;
+    if (!next_deadline(&tick)) {
+        NRF_RTC2->INTENCLR = RTC_INTENCLR_COMPARE0_Msk;
+        return;
+    }
+    uint32_t now = hw_now();
+    if ((int32_t)(tick - now) > (int32_t)RTC_MAX_DISTANCE) {
+        tick = now + RTC_MAX_DISTANCE;
+    }
+    NRF_RTC2->CC[0] = tick & RTC_COUNTER_MASK;
+    NRF_RTC2->EVENTS_COMPARE[0] = 0;
+    NRF_RTC2->INTENSET = RTC_INTENSET_COMPARE0_Msk;
+    // Counter may have caught up while the compare was written
+    if ((int32_t)(tick - hw_now()) < RTC_MIN_DISTANCE) {
+        NVIC_SetPendingIRQ(RTC2_IRQn);
+    }
+}
+
+
+/****************************************************************
+ * Function: timer_wheel_process()
+ * Description: Expires every timer due now or within the
+ *  coalescing window, one at a time so handlers may start and
+ *  stop timers freely.
+****************************************************************/
+void timer_wheel_process(void) {
+    uint32_t now = hw_now();
+    uint32_t target = now + TIMER_WHEEL_COALESCE_TICKS;
+
+    for (;;) {
+        timer_wheel_handler_t handler = NULL;
+        void* p_context = NULL;
+        uint32_t expires = 0;
+
+        CRITICAL_REGION_ENTER();
+        timer_wheel_timer_t* p_timer = due_pop(target);
+        if (p_timer != NULL) {
+            handler = p_timer->handler;
+            p_context = p_timer->p_context;
+            expires = p_timer->expires;
+            if (p_timer->period != 0) {
+                p_timer->expires += p_timer->period;
+                slot_link(p_timer);
+            }
+            else {
+                m_stats.active--;
+            }
+        }
+        else {
+            compare_update();
+        }
+        CRITICAL_REGION_EXIT();
+
+        if (handler == NULL) {
+            return;
+        }
+        m_stats.expirations++;
+        if ((int32_t)(expires - now) > 0) {
+            m_stats.coalesced++;
+        }
+        handler(p_context);
+    }
+}
+
+
+/****************************************************************
+ * Function: timer_wheel_start()
+ * Description: Starts a timer ticks from now. A running timer is
+ *  restarted.
+****************************************************************/
+void timer_wheel_start(timer_wheel_timer_t* p_timer, uint32_t ticks, uint32_t period,
+                       timer_wheel_handler_t handler, void* p_context) {
+    if (ticks > TIMER_WHEEL_MAX_TICKS) {
+        ticks = TIMER_WHEEL_MAX_TICKS;
+    }
+    if (period > TIMER_WHEEL_MAX_TICKS) {
+        period = TIMER_WHEEL_MAX_TICKS;
+    }
+    CRITICAL_REGION_ENTER();
+    if (p_timer->level < TIMER_WHEEL_LEVELS) {
+        slot_unlink(p_timer);
+        m_stats.active--;
+    }
+    uint32_t now = hw_now();
+    if (m_stats.active == 0 && (int32_t)(now - m_now) > 0) {
+        // Idle wheel, catch up with the RTC
+        m_now = now;
+    }
+    p_timer->expires = now + ticks;
+    p_timer->period = period;
+    p_timer->handler = handler;
+    p_timer->p_context = p_context;
+    slot_link(p_timer);
+    m_stats.active++;
+    if (m_stats.active > m_stats.active_max) {
+        m_stats.active_max = m_stats.active;
+    }
+    compare_update();
+    CRITICAL_REGION_EXIT();
+}
+
+
+/****************************************************************
+ * Function: timer_wheel_stop()
+ * Description: Stops a timer.
+****************************************************************/
+void timer_wheel_stop(timer_wheel_timer_t* p_timer) {
+    CRITICAL_REGION_ENTER();
+    if (p_timer->level < TIMER_WHEEL_LEVELS) {
+        slot_unlink(p_timer);
+        m_stats.active--;
+        compare_update();
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+/****************************************************************
+ * Function: timer_wheel_is_running()
+ * Description: Returns true if the timer is linked in the wheel.
+****************************************************************/
+bool timer_wheel_is_running(timer_wheel_timer_t const* p_timer) {
+    return p_timer->level < TIMER_WHEEL_LEVELS;
+}
+
+
+/****************************************************************
+ * Function: timer_wheel_now()
+ * Description: Returns the current time in wheel ticks.
+****************************************************************/
+uint32_t timer_wheel_now(void) {
+    return hw_now();
+}
+
+
+/****************************************************************
+ * Function: timer_wheel_stats_get()
+ * Description: Returns the wheel statistics.
+****************************************************************/
+timer_wheel_stats_t const* timer_wheel_stats_get(void) {
+    return &m_stats;
+}
+
+
+/****************************************************************
+ * Function: RTC2_IRQHandler()
+ * Description: Counts overflows and serves compare matches.
+****************************************************************/
+void RTC2_IRQHandler(void) {
+    uint32_t trace_mark = trace_ring_enter(TRACE_HANDLER_TIMER);
+    if (NRF_RTC2->EVENTS_OVRFLW) {
+        NRF_RTC2->EVENTS_OVRFLW = 0;
+        m_overflows++;
+    }
+    if (NRF_RTC2->EVENTS_COMPARE[0]) {
+        NRF_RTC2->EVENTS_COMPARE[0] = 0;
+    }
+    m_stats.wakeups++;
+    timer_wheel_process();
+    trace_ring_exit(TRACE_HANDLER_TIMER, trace_mark);
+}
+
+
+/****************************************************************
+ * Function: timer_wheel_init()
+ * Description: Starts RTC2. The low frequency clock is already
+ *  running once the SoftDevice is enabled.
+****************************************************************/
+void timer_wheel_init(void) {
+    NRF_RTC2->TASKS_STOP = 1;
+    NRF_RTC2->TASKS_CLEAR = 1;
+    NRF_RTC2->PRESCALER = RTC_PRESCALER;
+    NRF_RTC2->EVENTS_OVRFLW = 0;
+    NRF_RTC2->EVENTS_COMPARE[0] = 0;
+    NRF_RTC2->INTENSET = RTC_INTENSET_OVRFLW_Msk;
+    NVIC_SetPriority(RTC2_IRQn, RTC_IRQ_PRIORITY);
+    NVIC_ClearPendingIRQ(RTC2_IRQn);
+    NVIC_EnableIRQ(RTC2_IRQn);
+    NRF_RTC2->TASKS_START = 1;
+}
@@ -0,0 +1,86 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: timer_wheel.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Tickless hierarchical timer wheel on RTC2. Starting and
+ * stopping a timer is O(1) regardless of how many timers are running, and
+ * timers due close together are served by a single wake-up.
+*******************************************************************************/
+#ifndef TIMER_WHEEL_H__
+#define TIMER_WHEEL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Wheel tick frequency (RTC2 prescaler 31)
+#define TIMER_WHEEL_FREQ 1024
+// Levels and slots per level (slots must be 64, one bitmap word per level)
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_SLOT_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_SLOT_BITS)
+// Longest timeout in ticks (about 2.3 hours)
+#define TIMER_WHEEL_MAX_TICKS ((1UL << 23) - 1)
+// Timers due within this many ticks of a wake-up are expired with it
+#define TIMER_WHEEL_COALESCE_TICKS 2
+// Converts milliseconds to wheel ticks (rounded up)
+#define TIMER_WHEEL_TICKS(ms) ((uint32_t)((((uint64_t)(ms)) * TIMER_WHEEL_FREQ + 999) / 1000))
+
+typedef void (*timer_wheel_handler_t)(void* p_context);
+
+typedef struct timer_wheel_timer_s {
+    struct timer_wheel_timer_s* p_next;
+    struct timer_wheel_timer_s* p_prev;
+    uint32_t expires;                   // Absolute tick
+    uint32_t period;                    // 0 for single shot
+    timer_wheel_handler_t handler;
+    void* p_context;
+    uint8_t level;                      // TIMER_WHEEL_LEVELS when not running
+    uint8_t slot;
+} timer_wheel_timer_t;
+
+// Wheel statistics
+typedef struct {
+    uint32_t wakeups;                   // Compare interrupts
+    uint32_t expirations;
+    uint32_t coalesced;                 // Expirations served by an earlier wake-up
+    uint32_t cascades;                  // Timers moved down a level
+    uint16_t active;
+    uint16_t active_max;
+} timer_wheel_stats_t;
+
+// Declares a timer
+#define TIMER_WHEEL_DEF(_name) static timer_wheel_timer_t _name = {.level = TIMER_WHEEL_LEVELS}
+
+
+/***************************************
+ * Functions
+***************************************/
+// Starts RTC2 and the wheel
+void timer_wheel_init(void);
+// Starts (or restarts) a timer; period 0 makes it single shot
+void timer_wheel_start(timer_wheel_timer_t* p_timer, uint32_t ticks, uint32_t period,
+                       timer_wheel_handler_t handler, void* p_context);
+// Stops a timer (no effect if it is not running)
+void timer_wheel_stop(timer_wheel_timer_t* p_timer);
+// Returns true if the timer is running
+bool timer_wheel_is_running(timer_wheel_timer_t const* p_timer);
+// Returns the current wheel time in ticks
+uint32_t timer_wheel_now(void);
+// Expires due timers (called from the RTC2 interrupt)
+void timer_wheel_process(void);
+// Returns the wheel statistics
+timer_wheel_stats_t const* timer_wheel_stats_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TIMER_WHEEL_H__
@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+"""*****************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: build_profiles.py
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Build profile comparison. Builds the firmware with each
+ * optimization profile (-O3, -Os, each with and without link time
+ * optimization by default), reads .text/.data/.bss and the code size per
+ * module from each link map, times the host benchmarks and the network
+ * simulator with the same flags, and prints a report with every profile
+ * against the first.
+ *
+ *  Target builds go to pca10059/s140/armgcc/_build/profiles/<profile> and
+ *  need arm-none-eabi-gcc; without it only the host side is measured.
+ *  Host timings show how the compiler trades size for speed on the same
+ *  source, not Cortex-M4 cycles. For those, build a profile with
+ *  TRACE_RING_TIMING set, capture the trace stream (RTT channel 1) on the
+ *  target and pass it with --trace: the handler cycle counts the DWT
+ *  recorded are added to the report.
+ *
+ *  Module sizes are taken from the input sections in the map, so with link
+ *  time optimization the application is a single "(lto)" entry.
+*****************************************************************************"""
+
+import argparse
+import collections
+import os
+import re
+import resource
+import shutil
+import subprocess
+import sys
+
+# Profiles: name, OPT for the armgcc Makefile
+PROFILES = (("O3", "-O3 -g3"),
+            ("Os", "-Os -g3"),
+            ("O3-lto", "-O3 -g3 -flto"),
+            ("Os-lto", "-Os -g3 -flto"))
+RAM_BASE = 0x20000000
+# RAM sections without contents; heap and stack are set by the linker
+# script, not the compiler, and are left out
+BSS_SECTIONS = (".bss", ".noinit")
+SKIP_SECTIONS = (".heap", ".stack_dummy")
+# Simulator run timed on the host
+SIM_ARGS = ("-n", "100", "-t", "120", "-j", "1", "-s", "1")
+# timer_wheel_bench rows: timers | impl start restart expire wakeups
+WHEEL_ROW = re.compile(r"^\s*(\d+) \| wheel\s+([\d.]+)\s+([\d.]+)\s+([\d.]+)\s+\d+$")
+WHEEL_COUNTS = ("100", "1000")
+# coro_bench rows: impl ns/event sent state
+CORO_ROW = re.compile(r"^(\S.*?)\s{2,}([\d.]+)\s+\d+\s+\d+$")
+
+ROOT = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", ".."))
+ARMGCC_DIR = os.path.join(ROOT, "pca10059", "s140", "armgcc")
+BENCH_DIR = os.path.join(ROOT, "tools", "bench")
+SIM_DIR = os.path.join(ROOT, "tools", "sim")
+
+
+def run(cmd, quiet=True):
+    """Runs a command; exits with its output if it fails."""
+    result = subprocess.run(cmd, capture_output=quiet, text=True)
+    if result.returncode != 0:
+        if quiet:
+            sys.stderr.write(result.stdout + result.stderr)
+        sys.exit("build_profiles: failed: %s" % " ".join(cmd))
+    return result.stdout
+
+
+def host_opt(opt):
+    """Host flags of a profile (no debug information)."""
+    return " ".join(flag for flag in opt.split() if not flag.startswith("-g"))
+
+
+def parse_map(path):
+    """Returns ({text, data, bss}, code bytes per module) from a GNU ld map."""
+    with open(path) as f:
+        lines = f.read().splitlines()
+    try:
+        lines = lines[lines.index("Linker script and memory map") + 1:]
+    except ValueError:
+        sys.exit("build_profiles: %s: not a linker map" % path)
+
+    # Long section names put the address and size on the next line
+    joined = []
+    for line in lines:
+        if joined and len(joined[-1].split()) == 1 and joined[-1].lstrip().startswith(".") \
+                and line.startswith(" ") and line.split() and line.split()[0].startswith("0x"):
+            joined[-1] += " " + line.strip()
+        else:
+            joined.append(line)
+
+    sizes = {"text": 0, "data": 0, "bss": 0}
+    modules = collections.Counter()
+    in_flash = False
+    for line in joined:
+        parts = line.split()
+        if line.startswith(".") and len(parts) >= 3 and parts[1].startswith("0x"):
+            name, address, size = parts[0], int(parts[1], 16), int(parts[2], 16)
+            in_flash = 0 < address < RAM_BASE
+            if address == 0 or name in SKIP_SECTIONS:
+                continue
+            if in_flash:
+                sizes["text"] += size
+            elif name in BSS_SECTIONS or "bss" in name:
+                sizes["bss"] += size
+            else:
+                sizes["data"] += size
+        elif in_flash and line.startswith(" .") and len(parts) >= 4 and parts[1].startswith("0x"):
+            modules[module_name(parts[3])] += int(parts[2], 16)
+    return sizes, modules
+
+
+def module_name(obj):
+    """Names the module an input section came from."""
+    if "ltrans" in obj:
+        return "(lto)"
+    archive = re.match(r"(.*\.a)\(.*\)$", obj)
+    if archive:
+        return os.path.basename(archive.group(1))
+    name = os.path.basename(obj)
+    for suffix in (".c.o", ".S.o", ".s.o", ".o"):
+        if name.endswith(suffix):
+            return name[:-len(suffix)]
+    return name
+
+
+def build_target(name, opt, jobs):
+    """Builds a profile; returns the path of its map."""
+    out_dir = os.path.join("_build", "profiles", name)
+    run(["make", "-B", "-C", ARMGCC_DIR, "-j%d" % jobs, "nrf52840_xxaa",
+         "OPT=%s" % opt, "OUTPUT_DIRECTORY=%s" % out_dir])
+    return os.path.join(ARMGCC_DIR, out_dir, "nrf52840_xxaa.map")
+
+
+def bench_host(name, opt, repeat):
+    """Builds and times the host benchmarks; returns {metric: value}."""
+    out_dir = os.path.join("_build", "profiles", name)
+    flags = host_opt(opt)
+    run(["make", "-B", "-C", BENCH_DIR, "OUT=%s" % out_dir, "OPT=%s" % flags])
+    run(["make", "-B", "-C", SIM_DIR, "OUT=%s" % out_dir, "FW_OPT=%s" % flags])
+
+    metrics = {}
+    for _ in range(repeat):
+        values = {}
+        for line in run([os.path.join(BENCH_DIR, out_dir, "timer_wheel_bench")]).splitlines():
+            match = WHEEL_ROW.match(line)
+            if match and match.group(1) in WHEEL_COUNTS:
+                for phase, value in zip(("start", "restart", "expire"), match.groups()[1:]):
+                    values["wheel %s x%s (ns)" % (phase, match.group(1))] = float(value)
+        for line in run([os.path.join(BENCH_DIR, out_dir, "coro_bench")]).splitlines():
+            match = CORO_ROW.match(line)
+            if match:
+                values["%s (ns/event)" % match.group(1)] = float(match.group(2))
+        # CPU time of the simulator, nearly all of it in the firmware
+        before = resource.getrusage(resource.RUSAGE_CHILDREN).ru_utime
+        run([os.path.join(SIM_DIR, out_dir, "sim")] + list(SIM_ARGS) +
+            [os.path.join(SIM_DIR, out_dir, "sim_fw.so")])
+        values["sim 100 devices x 120 s (cpu s)"] = resource.getrusage(resource.RUSAGE_CHILDREN).ru_utime - before
+        # Best of the runs: the least disturbed by the rest of the host
+        for key, value in values.items():
+            metrics[key] = min(value, metrics.get(key, value))
+    return metrics
+
+
+def handler_cycles(path, cpu_mhz):
+    """Returns {handler: (count, mean cycles, max cycles)} from a trace stream."""
+    sys.path.insert(0, os.path.join(ROOT, "tools", "trace"))
+    import trace_export
+    exporter = trace_export.Exporter(16384.0, cpu_mhz, [])
+    for stamp, arg in trace_export.read_records(path, "auto"):
+        exporter.add(stamp, arg)
+    exporter.trace()
+    return {name: (count, total / count * cpu_mhz, longest * cpu_mhz)
+            for name, (count, total, longest) in exporter.stats.items()}
+
+
+def delta(value, base):
+    """Formats a change against the first profile."""
+    if base == 0 or value == base:
+        return ""
+    return " (%+.1f%%)" % (100.0 * (value - base) / base)
+
+
+def report(names, sizes, modules, host, cycles, top):
+    """Prints the comparison as markdown."""
+    print("# Build profile comparison\n")
+    print("Changes are against %s.\n" % names[0])
+    print("| profile | %s |" % " | ".join(names))
+    print("|---|" + "---|" * len(names))
+
+    if sizes:
+        built = [n for n in names if n in sizes]
+        rows = [("text", lambda s: s["text"]), ("data", lambda s: s["data"]),
+                ("bss", lambda s: s["bss"]), ("flash (text + data)", lambda s: s["text"] + s["data"]),
+                ("RAM (data + bss)", lambda s: s["data"] + s["bss"])]
+        for label, value in rows:
+            base = value(sizes[built[0]])
+            print("| %s | %s |" % (label, " | ".join(
+                "%d%s" % (value(sizes[n]), delta(value(sizes[n]), base)) if n in sizes else "-"
+                for n in names)))
+    if host:
+        for key in host[names[0]]:
+            base = host[names[0]][key]
+            print("| %s | %s |" % (key, " | ".join(
+                "%.2f%s" % (host[n][key], delta(host[n][key], base)) for n in names)))
+    if cycles:
+        handlers = collections.Counter()
+        for stats in cycles.values():
+            for handler, (count, mean, _) in stats.items():
+                handlers[handler] += count * mean
+        for handler, _ in handlers.most_common(top):
+            cells = []
+            base = cycles.get(names[0], {}).get(handler)
+            for n in names:
+                stat = cycles.get(n, {}).get(handler)
+                cells.append("%.0f / %.0f%s" % (stat[1], stat[2], delta(stat[1], base[1]) if base else "")
+                             if stat else "-")
+            print("| %s cycles (mean / max) | %s |" % (handler, " | ".join(cells)))
+
+    split = [n for n in names if n in modules and "(lto)" not in modules[n]]
+    if len(split) > 1:
+        print("\n## Code size by module\n")
+        print("Largest differences between %s.\n" % ", ".join(split))
+        print("| module | %s |" % " | ".join(split))
+        print("|---|" + "---|" * len(split))
+        spread = {m: max(modules[n][m] for n in split) - min(modules[n][m] for n in split)
+                  for n in split for m in modules[n]}
+        for module, _ in sorted((s for s in spread.items() if s[1]), key=lambda s: -s[1])[:top]:
+            base = modules[split[0]][module]
+            print("| %s | %s |" % (module, " | ".join(
+                "%d%s" % (modules[n][module], delta(modules[n][module], base)) for n in split)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare optimization profiles on size and speed.")
+    parser.add_argument("--profile", action="append", default=[], metavar="NAME=OPT",
+                        help="profile to compare instead of the defaults (repeatable)")
+    parser.add_argument("--trace", action="append", default=[], metavar="NAME=FILE",
+                        help="target trace stream of a profile built with TRACE_RING_TIMING")
+    parser.add_argument("--no-target", action="store_true", help="skip the firmware builds")
+    parser.add_argument("--no-host", action="store_true", help="skip the host benchmarks")
+    parser.add_argument("--repeat", type=int, default=3, help="host runs per profile (best is kept)")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count() or 1, help="parallel make jobs")
+    parser.add_argument("--cpu-mhz", type=float, default=64.0, help="DWT cycle counter rate")
+    parser.add_argument("--top", type=int, default=12, help="handlers and modules listed")
+    args = parser.parse_args()
+
+    profiles = [p.split("=", 1) for p in args.profile] if args.profile else list(PROFILES)
+    names = [name for name, _ in profiles]
+    traces = dict(t.split("=", 1) for t in args.trace)
+    for name in traces:
+        if name not in names:
+            sys.exit("build_profiles: --trace %s: no such profile" % name)
+
+    target = not args.no_target
+    if target and shutil.which("arm-none-eabi-gcc") is None:
+        print("build_profiles: arm-none-eabi-gcc not found, target builds skipped", file=sys.stderr)
+        target = False
+
+    sizes, modules, host, cycles = {}, {}, {}, {}
+    for name, opt in profiles:
+        print("build_profiles: %s (%s)" % (name, opt), file=sys.stderr)
+        if target:
+            sizes[name], modules[name] = parse_map(build_target(name, opt, args.jobs))
+        if not args.no_host:
+            host[name] = bench_host(name, opt, args.repeat)
+        if name in traces:
+            cycles[name] = handler_cycles(traces[name], args.cpu_mhz)
+    report(names, sizes, modules, host, cycles, args.top)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,278 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: coro_bench.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Host benchmark of coro.c against a hand-written state machine.
+ * Both implement the same streaming flow: wait for the peer to subscribe,
+ * then queue a notification per completed one, yielding to the scheduler
+ * every few notifications, until disconnected. The firmware source is
+ * compiled unchanged; the scheduler is a stub that runs the posted job
+ * straight after the event.
+ *
+ *  The cost per event is measured for the state machine, for the flow
+ *  function called directly (the resume itself) and for the flow driven by
+ *  coro.c with one and with CORO_MAX coroutines running, the latter adding
+ *  the table scan every event pays.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "coro.h"
+#include "radio_sched.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Completed notifications delivered per run
+#define EVENTS 10000000
+// Notifications queued between yields
+#define YIELD_EVERY 8
+
+// Coroutine flow
+typedef struct {
+    coro_t coro;
+    uint32_t sent;
+} stream_flow_t;
+
+// Hand-written state machine
+typedef enum {
+    SM_SUBSCRIBE,
+    SM_STREAM,
+    SM_YIELDED,
+    SM_DONE
+} sm_state_t;
+
+typedef struct {
+    uint8_t state;
+    uint32_t sent;
+} stream_sm_t;
+
+static stream_flow_t m_flow;
+static stream_sm_t m_sm;
+// Coroutines that only wait, to fill the table
+static coro_t m_idle[CORO_MAX - 1];
+// Scheduler stub: the job posted by the last event
+static radio_sched_job_t m_job;
+static void* m_job_context;
+
+static ble_evt_t const m_evt_write = {.header = {.evt_id = BLE_GATTS_EVT_WRITE}};
+static ble_evt_t const m_evt_complete = {.header = {.evt_id = BLE_GATTS_EVT_HVN_TX_COMPLETE}};
+static ble_evt_t const m_evt_disconnected = {.header = {.evt_id = BLE_GAP_EVT_DISCONNECTED}};
+
+
+/****************************************************************
+ * Function: now_ns()
+ * Description: Returns a monotonic timestamp in nanoseconds.
+****************************************************************/
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/****************************************************************
+ * Function: radio_sched_post()
+ * Description: Scheduler stub, holds one job.
+****************************************************************/
+bool radio_sched_post(radio_sched_job_t job, void* p_context, uint16_t cost_us) {
+    if (m_job != NULL) {
+        return false;
+    }
+    m_job = job;
+    m_job_context = p_context;
+    return true;
+}
+
+
+/****************************************************************
+ * Function: job_run()
+ * Description: Runs the posted job, if any.
+****************************************************************/
+static void job_run(void) {
+    radio_sched_job_t job = m_job;
+    if (job != NULL) {
+        m_job = NULL;
+        job(m_job_context);
+    }
+}
+
+
+/****************************************************************
+ * Function: stream_flow()
+ * Description: The streaming flow as a coroutine.
+****************************************************************/
+static __attribute__((noinline)) coro_status_t stream_flow(coro_t* p_coro, ble_evt_t const* p_ble_evt) {
+    stream_flow_t* p_flow = (stream_flow_t*)p_coro;
+    CORO_BEGIN(p_coro);
+    CORO_AWAIT_EVT(p_coro, BLE_GATTS_EVT_WRITE);
+    if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED) {
+        CORO_EXIT(p_coro);
+    }
+    while (true) {
+        p_flow->sent++;
+        CORO_AWAIT_EVT(p_coro, BLE_GATTS_EVT_HVN_TX_COMPLETE);
+        if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED) {
+            CORO_EXIT(p_coro);
+        }
+        if (p_flow->sent % YIELD_EVERY == 0) {
+            CORO_YIELD(p_coro);
+        }
+    }
+    CORO_END(p_coro);
+}
+
+
+/****************************************************************
+ * Function: idle_flow()
+ * Description: Waits for an event that never comes.
+****************************************************************/
+static coro_status_t idle_flow(coro_t* p_coro, ble_evt_t const* p_ble_evt) {
+    CORO_BEGIN(p_coro);
+    CORO_AWAIT_EVT(p_coro, BLE_GAP_EVT_CONNECTED);
+    CORO_END(p_coro);
+}
+
+
+/****************************************************************
+ * Function: sm_job()
+ * Description: Scheduler job of the state machine.
+****************************************************************/
+static void sm_job(void* p_context) {
+    if (m_sm.state == SM_YIELDED) {
+        m_sm.sent++;
+        m_sm.state = SM_STREAM;
+    }
+}
+
+
+/****************************************************************
+ * Function: sm_ble_evt()
+ * Description: The streaming flow as a state machine.
+****************************************************************/
+static __attribute__((noinline)) void sm_ble_evt(ble_evt_t const* p_ble_evt) {
+    uint16_t evt_id = p_ble_evt->header.evt_id;
+    if (evt_id == BLE_GAP_EVT_DISCONNECTED) {
+        m_sm.state = SM_DONE;
+        return;
+    }
+    switch (m_sm.state) {
+        case SM_SUBSCRIBE:
+            if (evt_id == BLE_GATTS_EVT_WRITE) {
+                m_sm.sent++;
+                m_sm.state = SM_STREAM;
+            }
+            break;
+        case SM_STREAM:
+            if (evt_id == BLE_GATTS_EVT_HVN_TX_COMPLETE) {
+                if (m_sm.sent % YIELD_EVERY == 0) {
+                    m_sm.state = SM_YIELDED;
+                    radio_sched_post(sm_job, NULL, CORO_STEP_COST_US);
+                }
+                else {
+                    m_sm.sent++;
+                }
+            }
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: bench_sm()
+ * Description: Runs the state machine; returns ns per event.
+****************************************************************/
+static double bench_sm(uint32_t* p_sent) {
+    m_sm.state = SM_SUBSCRIBE;
+    m_sm.sent = 0;
+    sm_ble_evt(&m_evt_write);
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        sm_ble_evt(&m_evt_complete);
+        job_run();
+    }
+    uint64_t t1 = now_ns();
+    sm_ble_evt(&m_evt_disconnected);
+    *p_sent = m_sm.sent;
+    return (double)(t1 - t0) / EVENTS;
+}
+
+
+/****************************************************************
+ * Function: bench_direct()
+ * Description: Resumes the flow function itself, yields at once;
+ *  returns ns per event.
+****************************************************************/
+static double bench_direct(uint32_t* p_sent) {
+    coro_t* p_coro = &m_flow.coro;
+    m_flow.sent = 0;
+    p_coro->resume = 0;
+    coro_fn_t fn = stream_flow;
+    fn(p_coro, NULL);
+    fn(p_coro, &m_evt_write);
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        if (fn(p_coro, &m_evt_complete) == CORO_YIELDED) {
+            fn(p_coro, NULL);
+        }
+    }
+    uint64_t t1 = now_ns();
+    fn(p_coro, &m_evt_disconnected);
+    *p_sent = m_flow.sent;
+    return (double)(t1 - t0) / EVENTS;
+}
+
+
+/****************************************************************
+ * Function: bench_coro()
+ * Description: Drives the flow through coro.c with idle extra
+ *  coroutines running; returns ns per event.
+****************************************************************/
+static double bench_coro(uint32_t idle, uint32_t* p_sent) {
+    for (uint32_t i = 0; i < idle; i++) {
+        coro_start(&m_idle[i], idle_flow);
+        job_run();
+    }
+    m_flow.sent = 0;
+    coro_start(&m_flow.coro, stream_flow);
+    job_run();
+    coro_ble_evt(&m_evt_write);
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < EVENTS; i++) {
+        coro_ble_evt(&m_evt_complete);
+        job_run();
+    }
+    uint64_t t1 = now_ns();
+    // Ends every coroutine
+    coro_ble_evt(&m_evt_disconnected);
+    *p_sent = m_flow.sent;
+    return (double)(t1 - t0) / EVENTS;
+}
+
+
+/****************************************************************
+ * MAIN
+****************************************************************/
+int main(void) {
+    uint32_t sent;
+    printf("%u events, a yield every %u\n", EVENTS, YIELD_EVERY);
+    printf("%-28s %8s %10s %8s\n", "impl", "ns/event", "sent", "state B");
+    double ns = bench_sm(&sent);
+    printf("%-28s %8.2f %10u %8zu\n", "state machine", ns, sent, sizeof(stream_sm_t));
+    ns = bench_direct(&sent);
+    printf("%-28s %8.2f %10u %8zu\n", "coroutine, direct", ns, sent, sizeof(stream_flow_t));
+    ns = bench_coro(0, &sent);
+    printf("%-28s %8.2f %10u %8zu\n", "coroutine, coro.c", ns, sent, sizeof(stream_flow_t));
+    ns = bench_coro(CORO_MAX - 1, &sent);
+    char label[32];
+    snprintf(label, sizeof(label), "coroutine, coro.c, %u running", CORO_MAX);
+    printf("%-28s %8.2f %10u %8zu\n", label, ns, sent, sizeof(stream_flow_t));
+    printf("coro_t: %zu bytes (%zu on the target)\n", sizeof(coro_t), sizeof(uint32_t) + 2 * sizeof(uint16_t));
+    return 0;
+}
@@ -0,0 +1,20 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: app_util_platform.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Host stand-in for the SDK platform utilities. The benchmarks
+ * are single threaded, so critical regions compile to nothing.
+*******************************************************************************/
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+
+#define APP_IRQ_PRIORITY_HIGH 2
+#define APP_IRQ_PRIORITY_MID 3
+#define APP_IRQ_PRIORITY_LOW 6
+#define APP_IRQ_PRIORITY_LOWEST 7
+
+#define CRITICAL_REGION_ENTER() do {
+#define CRITICAL_REGION_EXIT() } while (0)
+
+#endif // APP_UTIL_PLATFORM_H__
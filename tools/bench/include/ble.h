@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: ble.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Host stand-in for the SoftDevice BLE headers: the event header
+ * and ids and the GATT server types and calls the benchmarked modules use,
+ * laid out as in the SoftDevice. The benchmarks define the calls.
+*******************************************************************************/
+#ifndef BLE_H__
+#define BLE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLE_CONN_HANDLE_INVALID 0xFFFF
+#define BLE_GATT_HVX_NOTIFICATION 0x01
+#define BLE_GATT_HVX_INDICATION 0x02
+#define BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION 0x13
+#define BLE_UUID_TYPE_BLE 0x01
+
+#define BLE_GAP_EVT_CONNECTED 0x10
+#define BLE_GAP_EVT_DISCONNECTED 0x11
+#define BLE_GATTS_EVT_WRITE 0x50
+#define BLE_GATTS_EVT_HVN_TX_COMPLETE 0x57
+
+typedef struct {
+    uint16_t evt_id;
+    uint16_t evt_len;
+} ble_evt_hdr_t;
+
+typedef struct {
+    ble_evt_hdr_t header;
+    union {
+        struct {
+            uint16_t conn_handle;
+        } gap_evt;
+        uint8_t raw[32];
+    } evt;
+} ble_evt_t;
+
+typedef struct {
+    uint16_t uuid;
+    uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+    uint8_t uuid128[16];
+} ble_uuid128_t;
+
+typedef struct {
+    uint16_t value_handle;
+    uint16_t user_desc_handle;
+    uint16_t cccd_handle;
+    uint16_t sccd_handle;
+} ble_gatts_char_handles_t;
+
+typedef struct {
+    uint16_t handle;
+    uint8_t type;
+    uint16_t offset;
+    uint16_t* p_len;
+    uint8_t const* p_data;
+} ble_gatts_hvx_params_t;
+
+typedef struct {
+    uint16_t len;
+    uint16_t offset;
+    uint8_t* p_value;
+} ble_gatts_value_t;
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const* p_vs_uuid, uint8_t* p_uuid_type);
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const* p_hvx_params);
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t* p_value);
+uint32_t sd_ble_gatts_value_get(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t* p_value);
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BLE_H__
@@ -0,0 +1,45 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: nrf.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Host stand-in for the nRF52840 device header. Only the
+ * registers used by the benchmarked modules are modelled; the benchmark
+ * drives them directly (e.g. advancing the RTC counter).
+*******************************************************************************/
+#ifndef NRF_H__
+#define NRF_H__
+
+#include <stdint.h>
+
+typedef enum {
+    RTC2_IRQn = 36
+} IRQn_Type;
+
+typedef struct {
+    volatile uint32_t TASKS_START;
+    volatile uint32_t TASKS_STOP;
+    volatile uint32_t TASKS_CLEAR;
+    volatile uint32_t EVENTS_OVRFLW;
+    volatile uint32_t EVENTS_COMPARE[4];
+    volatile uint32_t INTENSET;
+    volatile uint32_t INTENCLR;
+    volatile uint32_t INTEN;
+    volatile uint32_t COUNTER;
+    volatile uint32_t PRESCALER;
+    volatile uint32_t CC[4];
+} NRF_RTC_Type;
+
+#define RTC_INTENSET_OVRFLW_Msk (1UL << 1)
+#define RTC_INTENSET_COMPARE0_Msk (1UL << 16)
+#define RTC_INTENCLR_COMPARE0_Msk (1UL << 16)
+
+extern NRF_RTC_Type host_rtc2;
+#define NRF_RTC2 (&host_rtc2)
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+
+#endif // NRF_H__
@@ -0,0 +1,20 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: nrf_sdh_ble.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Host stand-in for the SoftDevice handler's BLE observers. The
+ * benchmarks call the modules' event entry points themselves, so an observer
+ * only keeps its handler referenced.
+*******************************************************************************/
+#ifndef NRF_SDH_BLE_H__
+#define NRF_SDH_BLE_H__
+
+#include "ble.h"
+
+typedef void (*nrf_sdh_ble_evt_handler_t)(ble_evt_t const* p_ble_evt, void* p_context);
+
+#define NRF_SDH_BLE_OBSERVER(_name, _prio, _handler, _context)                      \
+    static nrf_sdh_ble_evt_handler_t const _name __attribute__((used)) = (_handler)
+
+#endif // NRF_SDH_BLE_H__
@@ -0,0 +1,183 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: sd_ble_bench.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Host benchmark of sd_ble.hpp against the C it replaces. The
+ * calls in sd_ble_ops.c and sd_ble_ops.cpp are timed against SoftDevice
+ * stubs that record their arguments, and each C/C++ pair is checked to make
+ * the same call. make disasm compares the instructions the two compile to,
+ * for the target with CROSS=arm-none-eabi-.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include "sd_ble_ops.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Calls timed per operation
+#define CALLS 20000000
+#define CONN_HANDLE 0x0010
+#define VALUE_HANDLE 0x0012
+#define CCCD_HANDLE 0x0013
+
+// Arguments of the last SoftDevice call
+typedef struct {
+    uint32_t call;
+    uint16_t conn_handle;
+    uint16_t handle;
+    uint8_t type;
+    uint16_t offset;
+    uint16_t len;
+    void const* p_data;
+    uint8_t uuid[16];
+} sd_call_t;
+
+typedef struct {
+    char const* name;
+    uint32_t (*c_op)(void);
+    uint32_t (*cpp_op)(void);
+} op_t;
+
+static sd_call_t m_last;
+static uint8_t m_data[20];
+
+
+// SoftDevice stubs, each records its arguments
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const* p_vs_uuid, uint8_t* p_uuid_type) {
+    m_last.call = 1;
+    memcpy(m_last.uuid, p_vs_uuid->uuid128, sizeof(m_last.uuid));
+    *p_uuid_type = 2;
+    return 0;
+}
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const* p_hvx_params) {
+    m_last.call = 2;
+    m_last.conn_handle = conn_handle;
+    m_last.handle = p_hvx_params->handle;
+    m_last.type = p_hvx_params->type;
+    m_last.offset = p_hvx_params->offset;
+    m_last.len = *p_hvx_params->p_len;
+    m_last.p_data = p_hvx_params->p_data;
+    return 0;
+}
+
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t* p_value) {
+    m_last.call = 3;
+    m_last.conn_handle = conn_handle;
+    m_last.handle = handle;
+    m_last.offset = p_value->offset;
+    m_last.len = p_value->len;
+    m_last.p_data = p_value->p_value;
+    return 0;
+}
+
+uint32_t sd_ble_gatts_value_get(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t* p_value) {
+    m_last.call = 4;
+    m_last.conn_handle = conn_handle;
+    m_last.handle = handle;
+    m_last.offset = p_value->offset;
+    m_last.len = p_value->len;
+    m_last.p_data = p_value->p_value;
+    p_value->len = 1;
+    return 0;
+}
+
+uint32_t sd_ble_gap_disconnect(uint16_t conn_handle, uint8_t hci_status_code) {
+    m_last.call = 5;
+    m_last.conn_handle = conn_handle;
+    m_last.type = hci_status_code;
+    return 0;
+}
+
+
+// Operations with the benchmark's arguments
+static uint32_t c_notify_op(void) { return c_notify(m_data, 4); }
+static uint32_t cpp_notify_op(void) { return cpp_notify(m_data, 4); }
+static uint32_t c_write_op(void) { return c_write(m_data, 8); }
+static uint32_t cpp_write_op(void) { return cpp_write(m_data, 8); }
+static uint32_t c_read_op(void) { uint16_t len = sizeof(m_data); return c_read(m_data, &len) + len; }
+static uint32_t cpp_read_op(void) { uint16_t len = sizeof(m_data); return cpp_read(m_data, &len) + len; }
+static uint32_t c_vs_add_op(void) { uint8_t type; return c_vs_add(&type) + type; }
+static uint32_t cpp_vs_add_op(void) { uint8_t type; return cpp_vs_add(&type) + type; }
+
+
+/****************************************************************
+ * Function: now_ns()
+ * Description: Returns a monotonic timestamp in nanoseconds.
+****************************************************************/
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/****************************************************************
+ * Function: time_op()
+ * Description: Returns the ns per call of an operation.
+****************************************************************/
+static double time_op(uint32_t (*op)(void)) {
+    volatile uint32_t sink = 0;
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < CALLS; i++) {
+        sink += op();
+    }
+    return (double)(now_ns() - t0) / CALLS;
+}
+
+
+/****************************************************************
+ * Function: same_call()
+ * Description: Returns true if both versions make the same
+ *  SoftDevice call.
+****************************************************************/
+static bool same_call(op_t const* p_op) {
+    sd_call_t c_call, cpp_call;
+    memset(&m_last, 0, sizeof(m_last));
+    uint32_t c_result = p_op->c_op();
+    c_call = m_last;
+    memset(&m_last, 0, sizeof(m_last));
+    uint32_t cpp_result = p_op->cpp_op();
+    cpp_call = m_last;
+    return c_result == cpp_result && memcmp(&c_call, &cpp_call, sizeof(c_call)) == 0;
+}
+
+
+/****************************************************************
+ * MAIN
+****************************************************************/
+int main(void) {
+    static const op_t ops[] = {
+        {"notify", c_notify_op, cpp_notify_op},
+        {"write", c_write_op, cpp_write_op},
+        {"read", c_read_op, cpp_read_op},
+        {"uuid_vs_add", c_vs_add_op, cpp_vs_add_op},
+        {"disconnect", c_disconnect, cpp_disconnect}
+    };
+    ble_gatts_char_handles_t handles = {
+        .value_handle = VALUE_HANDLE,
+        .cccd_handle = CCCD_HANDLE
+    };
+    c_connect(CONN_HANDLE, &handles);
+    cpp_connect(CONN_HANDLE, &handles);
+
+    bool same = true;
+    printf("%-12s %8s %8s %6s\n", "call", "C ns", "C++ ns", "same");
+    for (uint32_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+        bool op_same = same_call(&ops[i]);
+        double c_ns = time_op(ops[i].c_op);
+        double cpp_ns = time_op(ops[i].cpp_op);
+        printf("%-12s %8.2f %8.2f %6s\n", ops[i].name, c_ns, cpp_ns, op_same ? "yes" : "NO");
+        same = same && op_same;
+    }
+    return same ? 0 : 1;
+}
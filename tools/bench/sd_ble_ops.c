@@ -0,0 +1,99 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: sd_ble_ops.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: The C side of the sd_ble_bench comparison: the SoftDevice
+ * calls as main.c, tx_sched.c and temp_mon.c make them.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <string.h>
+#include "sd_ble_ops.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// main.c's vendor specific base
+#define UUID_BASE {0x23, 0xD1, 0xBC, 0xEA, 0x5F, 0x78, 0x23, 0x15, \
+                   0xDE, 0xEF, 0x12, 0x12, 0x00, 0x00, 0x00, 0x00}
+
+static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;
+static ble_gatts_char_handles_t m_char_handles;
+
+
+/****************************************************************
+ * Function: c_connect()
+ * Description: Keeps the handles of a connection.
+****************************************************************/
+void c_connect(uint16_t conn_handle, ble_gatts_char_handles_t const* p_handles) {
+    m_conn_handle = conn_handle;
+    m_char_handles = *p_handles;
+}
+
+
+/****************************************************************
+ * Function: c_notify()
+ * Description: Notifies as tx_sched.c does.
+****************************************************************/
+uint32_t c_notify(uint8_t const* p_data, uint16_t len) {
+    ble_gatts_hvx_params_t params;
+    memset(&params, 0, sizeof(params));
+    params.type = BLE_GATT_HVX_NOTIFICATION;
+    params.handle = m_char_handles.value_handle;
+    params.p_data = p_data;
+    params.p_len = &len;
+    return sd_ble_gatts_hvx(m_conn_handle, &params);
+}
+
+
+/****************************************************************
+ * Function: c_write()
+ * Description: Sets the value as temp_mon.c does.
+****************************************************************/
+uint32_t c_write(uint8_t const* p_data, uint16_t len) {
+    ble_gatts_value_t value = {
+        .len = len,
+        .offset = 0,
+        .p_value = (uint8_t*)p_data
+    };
+    return sd_ble_gatts_value_set(BLE_CONN_HANDLE_INVALID, m_char_handles.value_handle, &value);
+}
+
+
+/****************************************************************
+ * Function: c_read()
+ * Description: Reads the value back.
+****************************************************************/
+uint32_t c_read(uint8_t* p_data, uint16_t* p_len) {
+    ble_gatts_value_t value = {
+        .len = *p_len,
+        .offset = 0,
+        .p_value = p_data
+    };
+    uint32_t err_code = sd_ble_gatts_value_get(BLE_CONN_HANDLE_INVALID, m_char_handles.value_handle, &value);
+    *p_len = value.len;
+    return err_code;
+}
+
+
+/****************************************************************
+ * Function: c_vs_add()
+ * Description: Adds the vendor base as main.c does.
+****************************************************************/
+uint32_t c_vs_add(uint8_t* p_type) {
+    ble_uuid128_t base_uuid = {UUID_BASE};
+    return sd_ble_uuid_vs_add(&base_uuid, p_type);
+}
+
+
+/****************************************************************
+ * Function: c_disconnect()
+ * Description: Ends the connection.
+****************************************************************/
+uint32_t c_disconnect(void) {
+    return sd_ble_gap_disconnect(m_conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+}
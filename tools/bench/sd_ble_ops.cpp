@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: sd_ble_ops.cpp
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: The C++ side of the sd_ble_bench comparison: the same calls
+ * as sd_ble_ops.c through sd_ble.hpp, with typed handles.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include "sd_ble_ops.h"
+#include "sd_ble.hpp"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// main.c's vendor specific base
+constexpr ble_uuid128_t uuid_base = sd_ble::uuid128("00000000-1212-EFDE-1523-785FEABCD123");
+static_assert(uuid_base.uuid128[0] == 0x23 && uuid_base.uuid128[11] == 0x12 &&
+              uuid_base.uuid128[15] == 0x00, "byte order of uuid128()");
+static_assert(sizeof(sd_ble::conn_handle) == sizeof(uint16_t), "handles are a uint16_t");
+
+static sd_ble::conn_handle m_conn = sd_ble::conn_invalid;
+static sd_ble::characteristic m_char = {sd_ble::value_handle(0), sd_ble::cccd_handle(0)};
+
+
+/****************************************************************
+ * Function: cpp_connect()
+ * Description: Keeps the handles of a connection.
+****************************************************************/
+void cpp_connect(uint16_t conn_handle, ble_gatts_char_handles_t const* p_handles) {
+    m_conn = sd_ble::conn_handle(conn_handle);
+    m_char = sd_ble::characteristic::from(*p_handles);
+}
+
+
+/****************************************************************
+ * Function: cpp_notify()
+ * Description: Notifies through sd_ble::notify().
+****************************************************************/
+uint32_t cpp_notify(uint8_t const* p_data, uint16_t len) {
+    return sd_ble::notify(m_conn, m_char.value, p_data, len);
+}
+
+
+/****************************************************************
+ * Function: cpp_write()
+ * Description: Sets the value through sd_ble::write().
+****************************************************************/
+uint32_t cpp_write(uint8_t const* p_data, uint16_t len) {
+    return sd_ble::write(m_char.value, p_data, len);
+}
+
+
+/****************************************************************
+ * Function: cpp_read()
+ * Description: Reads the value back through sd_ble::read().
+****************************************************************/
+uint32_t cpp_read(uint8_t* p_data, uint16_t* p_len) {
+    return sd_ble::read(m_char.value, p_data, *p_len);
+}
+
+
+/****************************************************************
+ * Function: cpp_vs_add()
+ * Description: Adds the vendor base from its compile time UUID.
+****************************************************************/
+uint32_t cpp_vs_add(uint8_t* p_type) {
+    return sd_ble::uuid_vs_add(uuid_base, *p_type);
+}
+
+
+/****************************************************************
+ * Function: cpp_disconnect()
+ * Description: Ends the connection.
+****************************************************************/
+uint32_t cpp_disconnect(void) {
+    return sd_ble::disconnect(m_conn);
+}
@@ -0,0 +1,39 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: sd_ble_ops.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: SoftDevice calls of the sd_ble_bench comparison, written once
+ * in C as main.c and the modules make them (c_*) and once through
+ * sd_ble.hpp (cpp_*). Both keep the connection and characteristic handles
+ * in their own globals, as the application does.
+*******************************************************************************/
+#ifndef SD_BLE_OPS_H__
+#define SD_BLE_OPS_H__
+
+#include <stdint.h>
+#include "ble.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void c_connect(uint16_t conn_handle, ble_gatts_char_handles_t const* p_handles);
+uint32_t c_notify(uint8_t const* p_data, uint16_t len);
+uint32_t c_write(uint8_t const* p_data, uint16_t len);
+uint32_t c_read(uint8_t* p_data, uint16_t* p_len);
+uint32_t c_vs_add(uint8_t* p_type);
+uint32_t c_disconnect(void);
+
+void cpp_connect(uint16_t conn_handle, ble_gatts_char_handles_t const* p_handles);
+uint32_t cpp_notify(uint8_t const* p_data, uint16_t len);
+uint32_t cpp_write(uint8_t const* p_data, uint16_t len);
+uint32_t cpp_read(uint8_t* p_data, uint16_t* p_len);
+uint32_t cpp_vs_add(uint8_t* p_type);
+uint32_t cpp_disconnect(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SD_BLE_OPS_H__
@@ -0,0 +1,283 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: timer_wheel_bench.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Host benchmark of timer_wheel.c against the sorted list that
+ * app_timer2 keeps its timers in (nrf_sortlist: singly linked, linear
+ * insert and remove, O(1) pop of the earliest timer). The firmware source
+ * is compiled unchanged against a host model of RTC2.
+ *
+ *  For each timer count the benchmark measures the cost of starting all
+ *  timers, of restarting random running timers (the supervision timer
+ *  pattern) and of expiring all of them, and counts the wake-ups each
+ *  approach needs.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include "timer_wheel.h"
+#include "nrf.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Timeouts are drawn uniformly from 1 ms to this
+#define MAX_TIMEOUT_MS 60000
+// Restarts measured per timer count
+#define RESTARTS 10000
+
+// RTC2 model
+NRF_RTC_Type host_rtc2;
+static bool m_irq_pending;
+
+// Sorted list item, as nrf_sortlist_item_t plus app_timer's end value
+typedef struct sortlist_item_s {
+    struct sortlist_item_s* p_next;
+    uint32_t end_val;
+} sortlist_item_t;
+
+typedef bool (*sortlist_compare_t)(sortlist_item_t*, sortlist_item_t*);
+
+static sortlist_item_t* m_sortlist_head;
+static timer_wheel_timer_t* m_wheel_timers;
+static sortlist_item_t* m_sortlist_items;
+static uint32_t* m_timeouts;
+static uint32_t m_fired;
+
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {}
+void NVIC_EnableIRQ(IRQn_Type irq) {}
+void NVIC_ClearPendingIRQ(IRQn_Type irq) { m_irq_pending = false; }
+void NVIC_SetPendingIRQ(IRQn_Type irq) { m_irq_pending = true; }
+
+
+/****************************************************************
+ * Function: now_ns()
+ * Description: Returns a monotonic timestamp in nanoseconds.
+****************************************************************/
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+/****************************************************************
+ * Function: sortlist_compare()
+ * Description: app_timer2's ordering function (earlier first).
+****************************************************************/
+static bool sortlist_compare(sortlist_item_t* p_item0, sortlist_item_t* p_item1) {
+    return (int32_t)(p_item0->end_val - p_item1->end_val) <= 0;
+}
+
+
+/****************************************************************
+ * Function: sortlist_add()
+ * Description: Linear insert, as nrf_sortlist_add().
+****************************************************************/
+static void sortlist_add(sortlist_item_t* p_item, sortlist_compare_t compare) {
+    sortlist_item_t** pp_curr = &m_sortlist_head;
+    while (*pp_curr != NULL) {
+        if (!compare(*pp_curr, p_item)) {
+            break;
+        }
+        pp_curr = &(*pp_curr)->p_next;
+    }
+    p_item->p_next = *pp_curr;
+    *pp_curr = p_item;
+}
+
+
+/****************************************************************
+ * Function: sortlist_remove()
+ * Description: Linear search and unlink, as nrf_sortlist_remove().
+****************************************************************/
+static void sortlist_remove(sortlist_item_t* p_item) {
+    sortlist_item_t** pp_curr = &m_sortlist_head;
+    while (*pp_curr != NULL) {
+        if (*pp_curr == p_item) {
+            *pp_curr = p_item->p_next;
+            return;
+        }
+        pp_curr = &(*pp_curr)->p_next;
+    }
+}
+
+
+/****************************************************************
+ * Function: wheel_handler()
+ * Description: Counts expirations.
+****************************************************************/
+static void wheel_handler(void* p_context) {
+    m_fired++;
+}
+
+
+/****************************************************************
+ * Function: rtc_latch()
+ * Description: Applies interrupt enable writes to the RTC model.
+****************************************************************/
+static void rtc_latch(void) {
+    host_rtc2.INTEN |= host_rtc2.INTENSET;
+    host_rtc2.INTEN &= ~host_rtc2.INTENCLR;
+    host_rtc2.INTENSET = 0;
+    host_rtc2.INTENCLR = 0;
+}
+
+
+/****************************************************************
+ * Function: rtc_advance()
+ * Description: Moves the RTC model forward and raises the
+ *  compare event if it was passed.
+****************************************************************/
+static void rtc_advance(uint32_t ticks) {
+    rtc_latch();
+    uint32_t before = host_rtc2.COUNTER;
+    uint32_t after = (before + ticks) & 0xFFFFFF;
+    uint32_t to_cc = (host_rtc2.CC[0] - before) & 0xFFFFFF;
+    if (after < before) {
+        host_rtc2.EVENTS_OVRFLW = 1;
+        m_irq_pending = true;
+    }
+    if ((host_rtc2.INTEN & RTC_INTENSET_COMPARE0_Msk) && to_cc <= ticks) {
+        host_rtc2.EVENTS_COMPARE[0] = 1;
+        m_irq_pending = true;
+    }
+    host_rtc2.COUNTER = after;
+}
+
+
+/****************************************************************
+ * Function: rtc_irq_run()
+ * Description: Runs the RTC2 interrupt while it is pending.
+****************************************************************/
+static uint32_t rtc_irq_run(void) {
+    extern void RTC2_IRQHandler(void);
+    uint32_t runs = 0;
+    while (m_irq_pending) {
+        m_irq_pending = false;
+        RTC2_IRQHandler();
+        rtc_latch();
+        runs++;
+    }
+    return runs;
+}
+
+
+/****************************************************************
+ * Function: bench_wheel()
+ * Description: Runs the start/restart/expire phases on the
+ *  timer wheel. Expiry is simulated tickless: time jumps to the
+ *  programmed compare value.
+****************************************************************/
+static void bench_wheel(uint32_t count, double* p_start_ns, double* p_restart_ns,
+                        double* p_expire_ns, uint32_t* p_wakeups) {
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        timer_wheel_start(&m_wheel_timers[i], TIMER_WHEEL_TICKS(m_timeouts[i]), 0, wheel_handler, NULL);
+    }
+    uint64_t t1 = now_ns();
+    for (uint32_t i = 0; i < RESTARTS; i++) {
+        uint32_t index = m_timeouts[i % count] % count;
+        timer_wheel_start(&m_wheel_timers[index], TIMER_WHEEL_TICKS(m_timeouts[index]), 0, wheel_handler, NULL);
+    }
+    uint64_t t2 = now_ns();
+
+    uint32_t wakeups = 0;
+    uint64_t expire_ns = 0;
+    m_fired = 0;
+    while (m_fired < count) {
+        uint32_t distance = (host_rtc2.CC[0] - host_rtc2.COUNTER) & 0xFFFFFF;
+        rtc_advance(distance == 0 ? 1 : distance);
+        uint64_t t = now_ns();
+        wakeups += rtc_irq_run();
+        expire_ns += now_ns() - t;
+    }
+    *p_start_ns = (double)(t1 - t0) / count;
+    *p_restart_ns = (double)(t2 - t1) / RESTARTS;
+    *p_expire_ns = (double)expire_ns / count;
+    *p_wakeups = wakeups;
+}
+
+
+/****************************************************************
+ * Function: bench_sortlist()
+ * Description: Runs the same phases on the sorted list at
+ *  app_timer's 16384 Hz resolution.
+****************************************************************/
+static void bench_sortlist(uint32_t count, double* p_start_ns, double* p_restart_ns,
+                           double* p_expire_ns, uint32_t* p_wakeups) {
+    uint32_t now = 0;
+    m_sortlist_head = NULL;
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        m_sortlist_items[i].end_val = now + m_timeouts[i] * 16384 / 1000;
+        sortlist_add(&m_sortlist_items[i], sortlist_compare);
+    }
+    uint64_t t1 = now_ns();
+    for (uint32_t i = 0; i < RESTARTS; i++) {
+        uint32_t index = m_timeouts[i % count] % count;
+        sortlist_remove(&m_sortlist_items[index]);
+        m_sortlist_items[index].end_val = now + m_timeouts[index] * 16384 / 1000;
+        sortlist_add(&m_sortlist_items[index], sortlist_compare);
+    }
+    uint64_t t2 = now_ns();
+
+    uint32_t wakeups = 0;
+    uint64_t expire_ns = 0;
+    while (m_sortlist_head != NULL) {
+        // Each distinct end value is a compare match
+        now = m_sortlist_head->end_val;
+        uint64_t t = now_ns();
+        while (m_sortlist_head != NULL && (int32_t)(m_sortlist_head->end_val - now) <= 0) {
+            m_sortlist_head = m_sortlist_head->p_next;
+        }
+        expire_ns += now_ns() - t;
+        wakeups++;
+    }
+    *p_start_ns = (double)(t1 - t0) / count;
+    *p_restart_ns = (double)(t2 - t1) / RESTARTS;
+    *p_expire_ns = (double)expire_ns / count;
+    *p_wakeups = wakeups;
+}
+
+
+/****************************************************************
+ * MAIN
+****************************************************************/
+int main(void) {
+    static const uint32_t counts[] = {10, 50, 100, 200, 500, 1000};
+    uint32_t max_count = counts[sizeof(counts) / sizeof(counts[0]) - 1];
+    m_wheel_timers = calloc(max_count, sizeof(*m_wheel_timers));
+    m_sortlist_items = calloc(max_count, sizeof(*m_sortlist_items));
+    m_timeouts = calloc(max_count, sizeof(*m_timeouts));
+    srand(52840);
+
+    timer_wheel_init();
+    printf("%6s | %-9s %10s %10s %10s %8s\n", "timers", "impl", "start ns", "restart ns", "expire ns", "wakeups");
+    for (uint32_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        uint32_t count = counts[c];
+        for (uint32_t i = 0; i < max_count; i++) {
+            m_wheel_timers[i].level = TIMER_WHEEL_LEVELS;
+            m_timeouts[i] = 1 + rand() % MAX_TIMEOUT_MS;
+        }
+        double start_ns, restart_ns, expire_ns;
+        uint32_t wakeups;
+
+        bench_wheel(count, &start_ns, &restart_ns, &expire_ns, &wakeups);
+        printf("%6u | %-9s %10.1f %10.1f %10.1f %8u\n", count, "wheel", start_ns, restart_ns, expire_ns, wakeups);
+        bench_sortlist(count, &start_ns, &restart_ns, &expire_ns, &wakeups);
+        printf("%6u | %-9s %10.1f %10.1f %10.1f %8u\n", count, "sortlist", start_ns, restart_ns, expire_ns, wakeups);
+    }
+    timer_wheel_stats_t const* p_stats = timer_wheel_stats_get();
+    printf("wheel: %u expirations, %u coalesced, %u cascades, %u peak active\n",
+           p_stats->expirations, p_stats->coalesced, p_stats->cascades, p_stats->active_max);
+    return 0;
+}
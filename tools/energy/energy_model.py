@@ -0,0 +1,219 @@
+#!/usr/bin/env python3
+"""*****************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: energy_model.py
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Charge model for the energy_mon counters. Reads a recorded
+ * series of counter snapshots (RPC method 3, pages 0-2) and estimates the
+ * charge per advertising event, per connection hour and per button event,
+ * the average current over the trace and the battery life it implies.
+ * With a supply reading in the trace (battery.h) the currents are scaled
+ * to the measured voltage and the remaining life is estimated from the
+ * coin cell's discharge curve.
+ * Advertising interval, connection interval and slave latency can be
+ * changed to see their effect before trying them on the device.
+ *
+ *  Input is a CSV file with one row per snapshot. Either the snapshot
+ *  fields are given as columns (names as in energy_mon.h) or a single
+ *  "snapshot" column holds the 48 snapshot bytes as hex, in the order the
+ *  three RPC pages return them. Counters wrap at 2^32; the model works on
+ *  the differences between consecutive rows. supply_mv is a reading, the
+ *  last non-zero one is used.
+ *
+ *  The currents are nRF52840 datasheet figures with the DC/DC regulator
+ *  on at 3 V and can be replaced from a JSON file (--currents).
+*****************************************************************************"""
+
+import argparse
+import csv
+import json
+import struct
+import sys
+
+# Snapshot layout (energy_mon_snapshot_t)
+FIELDS = ("uptime_ms", "connected_ms", "awake_us", "flash_ops", "adv_events",
+          "conn_events", "adv_radio_us", "conn_radio_us", "button_events",
+          "button_cpu_us", "conn_events_saved", "supply_mv")
+SNAPSHOT_FORMAT = "<12I"
+# Fields that are readings rather than counters
+READINGS = ("supply_mv",)
+
+# Default currents and charges
+CURRENTS = {
+    "tx_ma": 4.8,                   # Radio TX, 0 dBm
+    "rx_ma": 4.6,                   # Radio RX, 1 Mbit
+    "cpu_ma": 3.3,                  # CPU running from flash at 64 MHz
+    "sleep_ua": 3.0,                # System ON, RTC running, RAM retained
+    "event_overhead_uc": 0.5,       # HFXO start-up and radio ramp per event
+    "flash_op_uc": 20.0,            # One SoftDevice flash write or erase
+    "adv_tx_fraction": 0.75,        # Share of advertising radio time in TX
+    "conn_tx_fraction": 0.5,        # Share of connection radio time in TX
+    "notif_airtime_us": 200.0,      # Extra TX time of one button notification
+}
+# Mean random advertising delay added to every interval (0-10 ms)
+ADV_DELAY_MS = 5.0
+# Voltage the currents are given at; with the DC/DC regulator the supply
+# current scales with its inverse
+CURRENTS_MV = 3000.0
+# CR2032 discharge curve (mV, percent left), as in battery.c
+COIN_CELL_CURVE = ((3000, 100), (2900, 80), (2800, 60), (2700, 40), (2600, 20),
+                   (2500, 10), (2300, 5), (2000, 0))
+
+
+def load_rows(path):
+    """Reads the snapshot rows from a CSV file."""
+    rows = []
+    with open(path, newline="") as f:
+        for record in csv.DictReader(f):
+            if record.get("snapshot"):
+                raw = bytes.fromhex(record["snapshot"].replace(" ", ""))
+                rows.append(dict(zip(FIELDS, struct.unpack(SNAPSHOT_FORMAT, raw))))
+            else:
+                rows.append({name: int(record.get(name) or "0", 0) for name in FIELDS})
+    if len(rows) < 2:
+        sys.exit("energy_model: need at least two snapshots")
+    return rows
+
+
+def accumulate(rows):
+    """Sums the wrap-safe differences between consecutive rows."""
+    totals = dict.fromkeys(FIELDS, 0)
+    for prev, curr in zip(rows, rows[1:]):
+        for name in FIELDS:
+            if name not in READINGS:
+                totals[name] += (curr[name] - prev[name]) & 0xFFFFFFFF
+    for row in rows:
+        for name in READINGS:
+            totals[name] = row[name] or totals[name]
+    return totals
+
+
+def percent_left(mv):
+    """Interpolates the charge left (percent) on the coin cell curve."""
+    if mv >= COIN_CELL_CURVE[0][0]:
+        return 100.0
+    for (hi_mv, hi_pct), (lo_mv, lo_pct) in zip(COIN_CELL_CURVE, COIN_CELL_CURVE[1:]):
+        if mv >= lo_mv:
+            return lo_pct + (mv - lo_mv) * (hi_pct - lo_pct) / (hi_mv - lo_mv)
+    return 0.0
+
+
+def radio_ma(currents, tx_fraction):
+    """Returns the mean radio current for a TX/RX mix."""
+    return tx_fraction * currents["tx_ma"] + (1 - tx_fraction) * currents["rx_ma"]
+
+
+def per_event(t, currents):
+    """Returns the charge (uC) of one advertising and one connection event.
+    CPU time not spent on buttons is spread over all radio events, as the
+    SoftDevice's event handling dominates it."""
+    events = t["adv_events"] + t["conn_events"]
+    cpu_us = max(t["awake_us"] - t["button_cpu_us"], 0)
+    cpu_uc = cpu_us * currents["cpu_ma"] / 1000 / events if events else 0.0
+    adv_uc = conn_uc = None
+    if t["adv_events"]:
+        adv_us = t["adv_radio_us"] / t["adv_events"]
+        adv_uc = (adv_us * radio_ma(currents, currents["adv_tx_fraction"]) / 1000
+                  + currents["event_overhead_uc"] + cpu_uc)
+    if t["conn_events"]:
+        conn_us = t["conn_radio_us"] / t["conn_events"]
+        conn_uc = (conn_us * radio_ma(currents, currents["conn_tx_fraction"]) / 1000
+                   + currents["event_overhead_uc"] + cpu_uc)
+    return adv_uc, conn_uc
+
+
+def per_button(t, currents):
+    """Returns the charge (uC) of one button event: its CPU time plus the
+    airtime of the notification it sends."""
+    if not t["button_events"]:
+        return None
+    cpu_us = t["button_cpu_us"] / t["button_events"]
+    return (cpu_us * currents["cpu_ma"] + currents["notif_airtime_us"] * currents["tx_ma"]) / 1000
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Estimates charge from energy_mon snapshots.")
+    parser.add_argument("trace", help="CSV file of snapshots")
+    parser.add_argument("--currents", help="JSON file overriding the default currents")
+    parser.add_argument("--battery-mah", type=float, default=220.0, help="Battery capacity (CR2032: 220)")
+    parser.add_argument("--adv-interval-ms", type=float, help="What-if advertising interval")
+    parser.add_argument("--conn-interval-ms", type=float, help="What-if connection interval")
+    parser.add_argument("--slave-latency", type=int, help="What-if slave latency")
+    args = parser.parse_args()
+
+    currents = dict(CURRENTS)
+    if args.currents:
+        with open(args.currents) as f:
+            currents.update(json.load(f))
+
+    t = accumulate(load_rows(args.trace))
+    if not t["uptime_ms"]:
+        sys.exit("energy_model: trace covers no time")
+    if t["supply_mv"]:
+        scale = CURRENTS_MV / t["supply_mv"]
+        for name in currents:
+            if not name.endswith("_fraction") and name != "notif_airtime_us":
+                currents[name] *= scale
+    connected_ms = min(t["connected_ms"], t["uptime_ms"])
+    adv_ms = t["uptime_ms"] - connected_ms
+    adv_uc, conn_uc = per_event(t, currents)
+    button_uc = per_button(t, currents)
+    sleep_uc_per_ms = currents["sleep_ua"] / 1000
+
+    # Measured event rates, optionally replaced by the what-if parameters
+    adv_per_ms = t["adv_events"] / adv_ms if adv_ms else 0.0
+    conn_per_ms = t["conn_events"] / connected_ms if connected_ms else 0.0
+    if args.adv_interval_ms:
+        adv_per_ms = 1 / (args.adv_interval_ms + ADV_DELAY_MS)
+    if args.conn_interval_ms or args.slave_latency is not None:
+        interval_ms = args.conn_interval_ms or (1 / conn_per_ms if conn_per_ms else 0.0)
+        latency = args.slave_latency or 0
+        conn_per_ms = 1 / (interval_ms * (latency + 1)) if interval_ms else 0.0
+
+    print("trace: %.1f s (%.1f s connected), %u adv events, %u conn events, %u button events, %u flash ops"
+          % (t["uptime_ms"] / 1000, connected_ms / 1000, t["adv_events"], t["conn_events"],
+             t["button_events"], t["flash_ops"]))
+    print("cpu awake: %.3f%%" % (100.0 * t["awake_us"] / (t["uptime_ms"] * 1000)))
+    if t["supply_mv"]:
+        print("supply: %u mV, currents scaled by %.2f, %.0f%% charge left"
+              % (t["supply_mv"], CURRENTS_MV / t["supply_mv"], percent_left(t["supply_mv"])))
+
+    total_uc = t["uptime_ms"] * sleep_uc_per_ms + t["flash_ops"] * currents["flash_op_uc"]
+    adv_hour_uc = conn_hour_uc = None
+    if adv_uc is not None:
+        adv_hour_uc = 3600000 * (adv_per_ms * adv_uc + sleep_uc_per_ms)
+        total_uc += t["adv_events"] * adv_uc
+        print("advertising event: %.2f uC (%.0f us radio), %.1f mC per hour advertising"
+              % (adv_uc, t["adv_radio_us"] / t["adv_events"], adv_hour_uc / 1000))
+    if conn_uc is not None:
+        conn_hour_uc = 3600000 * (conn_per_ms * conn_uc + sleep_uc_per_ms)
+        total_uc += t["conn_events"] * conn_uc
+        print("connection event: %.2f uC (%.0f us radio), %.1f mC per connection hour"
+              % (conn_uc, t["conn_radio_us"] / t["conn_events"], conn_hour_uc / 1000))
+        if t["conn_events_saved"]:
+            saved_uc = t["conn_events_saved"] * conn_uc
+            print("notification batching: %u conn events saved, %.1f uC (%.1f%% of connected charge)"
+                  % (t["conn_events_saved"], saved_uc,
+                     100.0 * saved_uc / (saved_uc + t["conn_events"] * conn_uc)))
+    if button_uc is not None:
+        total_uc += t["button_events"] * button_uc
+        print("button event: %.2f uC (%.0f us cpu)"
+              % (button_uc, t["button_cpu_us"] / t["button_events"]))
+
+    # Average current over the trace as recorded
+    average_ua = total_uc / (t["uptime_ms"] / 1000)
+    print("average current: %.1f uA, battery life %.0f days"
+          % (average_ua, args.battery_mah * 1000 / average_ua / 24))
+    if t["supply_mv"]:
+        print("remaining life: %.0f days at the trace's average current"
+              % (args.battery_mah * percent_left(t["supply_mv"]) / 100 * 1000 / average_ua / 24))
+    # Average current when always in one state at the (what-if) rates
+    for name, hour_uc in (("advertising", adv_hour_uc), ("connected", conn_hour_uc)):
+        if hour_uc:
+            print("always %s: %.1f uA, battery life %.0f days"
+                  % (name, hour_uc / 3600, args.battery_mah * 1000 / (hour_uc / 3600) / 24))
+
+
+if __name__ == "__main__":
+    main()
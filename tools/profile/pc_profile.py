@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""*****************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: pc_profile.py
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Symbolizer for the pc_sample profiler. Reads the sample
+ * stream (RTT channel 2, e.g. saved with JLinkRTTLogger) and prints a flat
+ * profile by function, a profile by module (source file) and a profile by
+ * the context the samples interrupted (main loop or interrupt).
+ *
+ *  Functions, sizes and source files come from the firmware ELF file
+ *  (nrf52840_xxaa.out) through nm -l, so the profile covers the SDK and
+ *  libraries as well as the application; library code without debug
+ *  information is grouped as "(no source)".
+ *  Addresses below the application's flash start belong to the SoftDevice
+ *  (or the MBR) and are reported as one function, which also holds the
+ *  time the CPU sleeps in sd_app_evt_wait().
+*****************************************************************************"""
+
+import argparse
+import bisect
+import collections
+import os
+import struct
+import subprocess
+import sys
+
+SAMPLE_FORMAT = "<II"
+MARK_RATE = 1
+MARK_LOST = 2
+# Application flash start (pca10059/s140/armgcc linker script)
+APP_START = 0x27000
+# nRF52840 interrupts (exception number - 16)
+IRQ_NAMES = ("POWER_CLOCK", "RADIO", "UARTE0_UART0", "SPIM0_SPIS0_TWIM0_TWIS0",
+             "SPIM1_SPIS1_TWIM1_TWIS1", "NFCT", "GPIOTE", "SAADC", "TIMER0", "TIMER1",
+             "TIMER2", "RTC0", "TEMP", "RNG", "ECB", "CCM_AAR", "WDT", "RTC1", "QDEC",
+             "COMP_LPCOMP", "SWI0_EGU0", "SWI1_EGU1", "SWI2_EGU2", "SWI3_EGU3", "SWI4_EGU4",
+             "SWI5_EGU5", "TIMER3", "TIMER4", "PWM0", "PDM", "?", "?", "MWU", "PWM1", "PWM2",
+             "SPIM2_SPIS2", "RTC2", "I2S", "FPU", "USBD", "UARTE1", "QSPI", "CRYPTOCELL",
+             "?", "?", "PWM3", "?", "SPIM3")
+EXCEPTION_NAMES = {0: "thread", 2: "NMI", 3: "HardFault", 11: "SVCall", 14: "PendSV", 15: "SysTick"}
+
+
+def read_stream(path):
+    """Returns the samples, the sampling rates seen and the lost count."""
+    with open(path, "rb") as f:
+        data = f.read()
+    size = struct.calcsize(SAMPLE_FORMAT)
+    samples, rates, lost = [], [], 0
+    for pc, info in struct.iter_unpack(SAMPLE_FORMAT, data[:len(data) - len(data) % size]):
+        if pc != 0:
+            samples.append((pc, info))
+        elif info >> 24 == MARK_RATE:
+            rates.append(info & 0xFFFFFF)
+        elif info >> 24 == MARK_LOST:
+            lost += info & 0xFFFFFF
+    return samples, rates, lost
+
+
+def load_functions(elf, nm):
+    """Returns sorted (address, size, name, module) tuples."""
+    try:
+        out = subprocess.run([nm, "-n", "-S", "-l", "--defined-only", elf], check=True,
+                             capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as err:
+        sys.exit("pc_profile: %s: %s" % (nm, err))
+    functions = []
+    for line in out.splitlines():
+        symbol, _, location = line.partition("\t")
+        parts = symbol.split()
+        if len(parts) != 4 or parts[2] not in "tTwW":
+            continue
+        source = location.rpartition(":")[0]
+        module = os.path.splitext(os.path.basename(source))[0] if source else "(no source)"
+        functions.append((int(parts[0], 16) & ~1, int(parts[1], 16), parts[3], module))
+    functions.sort()
+    return functions
+
+
+class Symbolizer:
+    """Maps sampled PCs to functions and modules."""
+
+    def __init__(self, functions, app_start):
+        self.functions = functions
+        self.starts = [f[0] for f in functions]
+        self.app_start = app_start
+
+    def lookup(self, pc):
+        """Returns (function, module) for a PC."""
+        pc &= ~1
+        if pc < self.app_start:
+            return "(SoftDevice)", "SoftDevice"
+        i = bisect.bisect_right(self.starts, pc) - 1
+        if i >= 0:
+            start, size, name, module = self.functions[i]
+            # Symbols without a size (assembly) run up to the next one
+            if size == 0 or pc < start + size:
+                return name, module
+        return "0x%08x" % pc, "?"
+
+
+def context_name(exception):
+    """Names the interrupted context."""
+    if exception in EXCEPTION_NAMES:
+        return EXCEPTION_NAMES[exception]
+    irq = exception - 16
+    if 0 <= irq < len(IRQ_NAMES):
+        return "%s_IRQ" % IRQ_NAMES[irq]
+    return "exception %d" % exception
+
+
+def table(title, counts, total, top, extra=None):
+    """Prints one profile, largest first."""
+    print("\n%s" % title)
+    print("%8s %6s  %s" % ("samples", "%", "name"))
+    for key, count in counts.most_common(top or None):
+        name = "%-40s %s" % (key, extra[key]) if extra else key
+        print("%8d %6.2f  %s" % (count, 100.0 * count / total, name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Profile from a pc_sample stream.")
+    parser.add_argument("stream", help="sample stream (RTT channel 2)")
+    parser.add_argument("--elf", default="pca10059/s140/armgcc/_build/nrf52840_xxaa.out",
+                        help="firmware ELF file")
+    parser.add_argument("--nm", default="arm-none-eabi-nm", help="nm to read the ELF file with")
+    parser.add_argument("--app-start", type=lambda s: int(s, 0), default=APP_START,
+                        help="application flash start; lower addresses are the SoftDevice")
+    parser.add_argument("--top", type=int, default=30, help="functions listed (0: all)")
+    args = parser.parse_args()
+
+    samples, rates, lost = read_stream(args.stream)
+    if not samples:
+        sys.exit("pc_profile: no samples")
+    symbolizer = Symbolizer(load_functions(args.elf, args.nm), args.app_start)
+
+    functions, modules, contexts = collections.Counter(), collections.Counter(), collections.Counter()
+    function_module = {}
+    for pc, info in samples:
+        name, module = symbolizer.lookup(pc)
+        functions[name] += 1
+        modules[module] += 1
+        contexts[context_name(info & 0x1FF)] += 1
+        function_module[name] = module
+
+    total = len(samples)
+    rate = rates[-1] if rates else 0
+    print("%d samples" % total, end="")
+    if rate:
+        print(" at %d Hz (%.1f s)" % (rate, total / rate), end="")
+    print(", %d lost (%.2f%%)" % (lost, 100.0 * lost / (total + lost)))
+    if len(set(rates)) > 1:
+        print("rate changed during the capture: %s Hz" % ", ".join(str(r) for r in rates))
+    table("Flat profile", functions, total, args.top, function_module)
+    table("By module", modules, total, 0)
+    table("By context", contexts, total, 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+"""*****************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: ram_budget.py
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: SoftDevice RAM budget. Models the RAM the S140 needs for the
+ * BLE configuration in sdk_config.h (link counts, ATT MTU, data length, event
+ * length, attribute table, vendor UUIDs) and the sd_ble_cfg_set() calls in
+ * main.c and bulk_xfer.c (notification queue, L2CAP channels), reports the
+ * application RAM start that results and the headroom against the linker
+ * script, and fails when nrf_sdh_ble_enable() would return NO_MEM or when
+ * the SES project's RAM placement differs from the linker script.
+ *
+ *  Nordic does not publish the SoftDevice's allocation formula, so the
+ *  model works in differences: every setting adds an estimated cost per
+ *  unit relative to an anchor configuration whose RAM start is known. The
+ *  built-in anchor is the SDK template's stock configuration and start.
+ *  Once nrf_sdh_ble_enable() has reported the real start for a
+ *  configuration (it logs it at warning level when RAM is short, or
+ *  sd_ble_enable() returns it in ram_start), --anchor records it in
+ *  anchor.json and later estimates are made relative to that.
+ *
+ *  With --elf the application's own RAM (.data, .bss, .noinit, heap and
+ *  stack) is added up from the image to report what is left.
+*****************************************************************************"""
+
+import argparse
+import json
+import os
+import re
+import struct
+import sys
+
+RAM_BASE = 0x20000000
+RAM_END = 0x20040000
+# SoftDevice RAM start granularity
+RAM_ALIGN = 8
+
+# Stock SDK template configuration and its RAM start
+STOCK_ANCHOR = {
+    "ram_start": 0x20002270,
+    "config": {
+        "NRF_SDH_BLE_PERIPHERAL_LINK_COUNT": 1,
+        "NRF_SDH_BLE_CENTRAL_LINK_COUNT": 0,
+        "NRF_SDH_BLE_GAP_DATA_LENGTH": 27,
+        "NRF_SDH_BLE_GAP_EVENT_LENGTH": 6,
+        "NRF_SDH_BLE_GATT_MAX_MTU_SIZE": 23,
+        "NRF_SDH_BLE_GATTS_ATTR_TAB_SIZE": 1408,
+        "NRF_SDH_BLE_VS_UUID_COUNT": 1,
+        "NRF_SDH_BLE_SERVICE_CHANGED": 1,
+        "HVN_TX_QUEUE_SIZE": 1,
+        "L2CAP_CH_COUNT": 0,
+        "L2CAP_MPS": 0,
+        "L2CAP_RX_QUEUE_SIZE": 0,
+        "L2CAP_TX_QUEUE_SIZE": 0,
+    },
+}
+
+# Estimated costs in bytes
+LINK_BASE = 1024                    # Link layer and host state per link
+LL_PACKET_OVERHEAD = 8              # Per link layer packet buffer
+LL_PACKETS_MIN = 3                  # Packet buffers per direction, at least
+ATT_BUFFERS = 2                     # ATT MTU sized buffers per link
+HVN_ENTRY_OVERHEAD = 8              # Per notification queue entry
+VS_UUID_SIZE = 16
+SERVICE_CHANGED_SIZE = 16
+L2CAP_CH_BASE = 96                  # Channel state
+L2CAP_QUEUE_ENTRY = 12              # Per SDU queue entry
+L2CAP_PDU_OVERHEAD = 4              # Per MPS sized reassembly buffer
+
+# Where the settings come from, relative to the repository root
+SDK_CONFIG = "pca10059/s140/config/sdk_config.h"
+LINKER_SCRIPT = "pca10059/s140/armgcc/ble_app_template_gcc_nrf52.ld"
+SES_PROJECT = "pca10059/s140/ses/ble_app_template_pca10056_s140.emProject"
+ANCHOR_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "anchor.json")
+
+
+def read_defines(path):
+    """Returns the numeric #defines of a file."""
+    defines = {}
+    with open(path) as f:
+        for line in f:
+            m = re.match(r"\s*#define\s+(\w+)\s+\(?(0x[0-9A-Fa-f]+|\d+)\)?\s*(//.*)?$", line)
+            if m and m.group(1) not in defines:
+                defines[m.group(1)] = int(m.group(2), 0)
+    return defines
+
+
+def read_config(root):
+    """Collects the settings that size the SoftDevice RAM."""
+    sdk = read_defines(os.path.join(root, SDK_CONFIG))
+    config = {name: sdk[name] for name in STOCK_ANCHOR["config"] if name in sdk}
+    tx_sched = read_defines(os.path.join(root, "tx_sched.h"))
+    config["HVN_TX_QUEUE_SIZE"] = tx_sched["TX_SCHED_SD_QUEUE_SIZE"]
+    bulk = read_defines(os.path.join(root, "bulk_xfer.h"))
+    with open(os.path.join(root, "bulk_xfer.c")) as f:
+        m = re.search(r"l2cap_conn_cfg\.ch_count\s*=\s*(\d+)", f.read())
+    config["L2CAP_CH_COUNT"] = int(m.group(1)) if m else 0
+    config["L2CAP_MPS"] = bulk["BULK_XFER_MPS"]
+    config["L2CAP_RX_QUEUE_SIZE"] = bulk["BULK_XFER_RX_QUEUE_SIZE"]
+    config["L2CAP_TX_QUEUE_SIZE"] = bulk["BULK_XFER_TX_QUEUE_SIZE"]
+    missing = set(STOCK_ANCHOR["config"]) - set(config)
+    if missing:
+        sys.exit("ram_budget: missing settings: " + ", ".join(sorted(missing)))
+    return config
+
+
+def align(value, to=4):
+    return (value + to - 1) // to * to
+
+
+def ll_packets(c):
+    """Packet buffers per direction: as many full packet exchanges as fit
+    in the event length at 1 Mbit, at least LL_PACKETS_MIN."""
+    exchange_us = 2 * (c["NRF_SDH_BLE_GAP_DATA_LENGTH"] + 14) * 8 + 2 * 150
+    fit = c["NRF_SDH_BLE_GAP_EVENT_LENGTH"] * 1250 // exchange_us
+    return max(LL_PACKETS_MIN, fit)
+
+
+def model(c):
+    """Returns the estimated SoftDevice RAM use in bytes (up to a constant)."""
+    links = c["NRF_SDH_BLE_PERIPHERAL_LINK_COUNT"] + c["NRF_SDH_BLE_CENTRAL_LINK_COUNT"]
+    mtu = c["NRF_SDH_BLE_GATT_MAX_MTU_SIZE"]
+    ll = 2 * ll_packets(c) * align(c["NRF_SDH_BLE_GAP_DATA_LENGTH"] + LL_PACKET_OVERHEAD)
+    att = ATT_BUFFERS * align(mtu)
+    hvn = c["HVN_TX_QUEUE_SIZE"] * align(mtu + HVN_ENTRY_OVERHEAD)
+    l2cap = 0
+    if c["L2CAP_CH_COUNT"]:
+        l2cap = c["L2CAP_CH_COUNT"] * (
+            L2CAP_CH_BASE
+            + (c["L2CAP_RX_QUEUE_SIZE"] + c["L2CAP_TX_QUEUE_SIZE"]) * L2CAP_QUEUE_ENTRY
+            + 2 * align(c["L2CAP_MPS"] + L2CAP_PDU_OVERHEAD))
+    per_link = LINK_BASE + ll + att + hvn + l2cap
+    return (links * per_link
+            + align(c["NRF_SDH_BLE_GATTS_ATTR_TAB_SIZE"])
+            + c["NRF_SDH_BLE_VS_UUID_COUNT"] * VS_UUID_SIZE
+            + c["NRF_SDH_BLE_SERVICE_CHANGED"] * SERVICE_CHANGED_SIZE)
+
+
+def load_anchor():
+    if os.path.exists(ANCHOR_FILE):
+        with open(ANCHOR_FILE) as f:
+            anchor = json.load(f)
+        anchor["ram_start"] = int(anchor["ram_start"], 0)
+        return anchor, os.path.basename(ANCHOR_FILE)
+    return STOCK_ANCHOR, "SDK template"
+
+
+def read_linker(path):
+    """Returns the RAM origin and length of the linker script."""
+    with open(path) as f:
+        m = re.search(r"RAM\s*\([^)]*\)\s*:\s*ORIGIN\s*=\s*(0x[0-9A-Fa-f]+)\s*,\s*LENGTH\s*=\s*(0x[0-9A-Fa-f]+)",
+                      f.read())
+    if not m:
+        sys.exit("ram_budget: no RAM region in " + path)
+    return int(m.group(1), 16), int(m.group(2), 16)
+
+
+def read_ses(path):
+    """Returns the RAM start and size of the SES project, or None without one."""
+    if not os.path.exists(path):
+        return None
+    with open(path) as f:
+        m = re.search(r"RAM_START=(0x[0-9A-Fa-f]+);RAM_SIZE=(0x[0-9A-Fa-f]+)", f.read())
+    if not m:
+        sys.exit("ram_budget: no RAM_START/RAM_SIZE in " + path)
+    return int(m.group(1), 16), int(m.group(2), 16)
+
+
+def elf_ram_used(path):
+    """Adds up the allocated sections of a 32-bit ELF image that lie in RAM."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] != b"\x7fELF" or data[4] != 1:
+        sys.exit("ram_budget: not a 32-bit ELF file: " + path)
+    shoff, = struct.unpack_from("<I", data, 0x20)
+    shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+    used = 0
+    for i in range(shnum):
+        _, _, flags, addr, _, size = struct.unpack_from("<IIIIII", data, shoff + i * shentsize)
+        if flags & 0x2 and RAM_BASE <= addr < RAM_END:
+            used += size
+    return used
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Checks the SoftDevice RAM budget.")
+    parser.add_argument("--root", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", ".."),
+                        help="Repository root")
+    parser.add_argument("--linker", help="Linker script (default: the pca10059 one)")
+    parser.add_argument("--elf", help="Built image, to report application RAM")
+    parser.add_argument("--check", action="store_true", help="Exit with an error if RAM is short")
+    parser.add_argument("--anchor", metavar="RAM_START",
+                        help="Record the RAM start reported by sd_ble_enable() for the current configuration")
+    args = parser.parse_args()
+
+    config = read_config(args.root)
+    if args.anchor:
+        with open(ANCHOR_FILE, "w") as f:
+            json.dump({"ram_start": args.anchor, "config": config}, f, indent=4)
+            f.write("\n")
+        print("ram_budget: anchored at %s" % args.anchor)
+
+    anchor, anchor_name = load_anchor()
+    delta = model(config) - model(anchor["config"])
+    required = align(anchor["ram_start"] + delta, RAM_ALIGN)
+    origin, length = read_linker(args.linker or os.path.join(args.root, LINKER_SCRIPT))
+
+    for name in sorted(config):
+        if config[name] != anchor["config"].get(name):
+            print("  %-36s %6u (anchor %u)" % (name, config[name], anchor["config"].get(name, 0)))
+    print("softdevice RAM: %+d bytes against the %s anchor, app RAM must start at 0x%08x"
+          % (delta, anchor_name, required))
+    print("linker RAM:     0x%08x, headroom %d bytes" % (origin, origin - required))
+    if args.elf:
+        used = elf_ram_used(args.elf)
+        print("application:    %u of %u bytes, %u left" % (used, length, length - used))
+
+    errors = []
+    if origin < required:
+        errors.append("RAM origin 0x%08x is below 0x%08x, nrf_sdh_ble_enable() would fail with NO_MEM"
+                      % (origin, required))
+    if origin + length != RAM_END:
+        errors.append("RAM origin + length is 0x%08x, not the end of RAM (0x%08x)" % (origin + length, RAM_END))
+    ses = read_ses(os.path.join(args.root, SES_PROJECT))
+    if ses is not None and ses != (origin, length):
+        errors.append("SES project RAM is 0x%08x + 0x%x, the linker script has 0x%08x + 0x%x"
+                      % (ses[0], ses[1], origin, length))
+    for error in errors:
+        print("ram_budget: error: " + error, file=sys.stderr)
+    if errors and args.check:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,727 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: sim.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Multi-device network simulator. Loads one copy of the
+ * firmware (sim_fw.so) per device, runs the devices in parallel on a thread
+ * pool and connects them to simulated gateways over a shared advertising
+ * medium, then reports discovery time, connection success and button event
+ * latency for each device count.
+ *
+ *  Time advances in fixed windows. In the parallel phase every thread runs
+ *  its devices up to the end of the window; devices only touch their own
+ *  state and their own outbox of advertising PDUs. In the serial phase the
+ *  PDUs are merged in start time order, checked for collisions on each
+ *  channel (any overlap loses both, there is no capture effect) and offered
+ *  to the gateways. A PDU can only be overlapped by one that starts less
+ *  than a PDU length later, so a PDU is settled once the window end is
+ *  more than a PDU and CONNECT_IND exchange beyond its start.
+ *
+ *  Gateways scan the three primary channels in turn, do not scan during
+ *  the connection events of their links or while sending a CONNECT_IND, and
+ *  connect to every device they hear while they have a link free. A
+ *  connected device is subscribed to the button characteristic after
+ *  service discovery and released after the hold time, after which it
+ *  advertises again. Device reactions to the gateway are applied at the
+ *  device's next event, up to one window late.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include "sim.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+#define STACK_SIZE (64 * 1024)
+#define POWER_ON_SPREAD_US 1000000          // Devices power on over the first second
+#define BOOT_US 1000000                     // No button presses before this after power-on
+#define PRESS_MIN_GAP_US 500000
+#define PRESS_HOLD_US 150000
+#define PRESSES_MAX 64                      // Unmatched presses kept per device
+#define SCAN_WINDOW_US 100000               // Gateway scan time per channel
+#define T_IFS_US 150
+#define CONNECT_IND_US 352                  // 34 byte payload at 1 Mbit
+#define ADV_PDU_MAX_US 376                  // 31 bytes of advertising data
+#define SETTLE_US (ADV_PDU_MAX_US + T_IFS_US + CONNECT_IND_US)
+#define CONN_SLOT_US 1000                   // Gateway time per link per connection interval
+#define DISCOVERY_INTERVALS 10              // Service discovery before subscribing
+#define BUTTON_UUID 0x1234
+#define RTT_TRACE_CHANNEL 1                 // trace_ring's record stream (timing builds)
+#define BUTTON_PUSH 1
+
+typedef struct {
+    uint64_t t_us;
+    uint32_t dev;
+    uint16_t duration_us;
+    uint8_t channel;
+} pdu_t;
+
+typedef struct {
+    pdu_t* p;
+    size_t count;
+    size_t cap;
+} pdu_list_t;
+
+typedef struct {
+    uint32_t* p;
+    size_t count;
+    size_t cap;
+} stat_list_t;
+
+typedef struct {
+    uint32_t index;
+    void* p_lib;
+    int fd;                                 // Memory file the copy was loaded from
+    sim_fw_t const* p_fw;
+    ucontext_t ctx;                         // Firmware main loop
+    ucontext_t* p_return;                   // Worker it yields to
+    void* p_stack;
+    bool started;
+    uint32_t rand;
+    uint64_t power_on_us;
+    uint64_t next_press_us;
+    pdu_list_t outbox;
+    // Host view of the link
+    uint64_t first_pdu_us;
+    uint64_t discovered_us;
+    bool served;
+    uint64_t connected_us;                  // CONNECT_IND time, SIM_NEVER when advertising
+    uint64_t released_us;                   // Gateway disconnect time
+    uint16_t button_handle;
+    // Presses not yet seen at a gateway
+    uint64_t presses[PRESSES_MAX];
+    uint32_t press_count;
+    uint32_t pressed;
+    uint32_t missed;
+    stat_list_t latency;
+} device_t;
+
+typedef struct {
+    uint64_t scan_offset_us;
+    uint64_t busy_until_us;
+    uint32_t link_count;
+    struct {
+        uint64_t anchor_us;
+        uint64_t end_us;
+    }* p_links;
+} gateway_t;
+
+typedef struct {
+    pthread_t thread;
+    uint32_t index;
+    ucontext_t ctx;
+} worker_t;
+
+static struct {
+    uint32_t gateways;
+    uint32_t max_links;
+    uint64_t duration_us;
+    uint64_t hold_us;
+    double presses_per_min;
+    uint32_t threads;
+    uint32_t seed;
+    uint64_t window_us;
+    uint32_t interval_ms;
+} m_cfg = {
+    .gateways = 1,
+    .max_links = 20,
+    .duration_us = 60000000,
+    .hold_us = 10000000,
+    .presses_per_min = 6,
+    .window_us = 2000,
+    .interval_ms = 30,
+    .seed = 1
+};
+
+static void* m_image;
+static size_t m_image_size;
+static device_t* m_devs;
+static uint32_t m_dev_count;
+static gateway_t* m_gws;
+static worker_t* m_workers;
+static pthread_barrier_t m_barrier;
+static uint64_t m_window_end;
+// Trace stream capture (-r), device 0 of the first run
+static FILE* m_rtt_file;
+static bool m_done;
+static __thread device_t* m_current;
+
+// Serial phase state
+static pdu_list_t m_pending;
+static uint64_t m_chan_end[3];
+static uint32_t m_rand;
+static struct {
+    uint64_t pdus;
+    uint64_t collided;
+    uint32_t attempts;
+    uint32_t connections;
+    stat_list_t discovery;
+    stat_list_t connect;
+} m_stats;
+
+
+/****************************************************************
+ * Function: xorshift()
+ * Description: Advances a xorshift generator.
+****************************************************************/
+static uint32_t xorshift(uint32_t* p_state) {
+    *p_state ^= *p_state << 13;
+    *p_state ^= *p_state >> 17;
+    *p_state ^= *p_state << 5;
+    return *p_state;
+}
+
+
+/****************************************************************
+ * Function: stat_add()
+ * Description: Appends a sample.
+****************************************************************/
+static void stat_add(stat_list_t* p_list, uint32_t value) {
+    if (p_list->count == p_list->cap) {
+        p_list->cap = p_list->cap ? p_list->cap * 2 : 64;
+        p_list->p = realloc(p_list->p, p_list->cap * sizeof(uint32_t));
+    }
+    p_list->p[p_list->count++] = value;
+}
+
+
+/****************************************************************
+ * Function: pdu_add()
+ * Description: Appends a PDU.
+****************************************************************/
+static void pdu_add(pdu_list_t* p_list, pdu_t const* p_pdu) {
+    if (p_list->count == p_list->cap) {
+        p_list->cap = p_list->cap ? p_list->cap * 2 : 64;
+        p_list->p = realloc(p_list->p, p_list->cap * sizeof(pdu_t));
+    }
+    p_list->p[p_list->count++] = *p_pdu;
+}
+
+
+/***************************************
+ * Host services (run on the device's worker thread)
+***************************************/
+static void host_yield(void* p_dev) {
+    device_t* p = p_dev;
+    swapcontext(&p->ctx, p->p_return);
+}
+
+static void host_adv_pdu(void* p_dev, uint64_t t_us, uint8_t channel, uint16_t duration_us) {
+    device_t* p = p_dev;
+    pdu_add(&p->outbox, &(pdu_t){.t_us = t_us, .dev = p->index, .duration_us = duration_us, .channel = channel});
+}
+
+static void host_notify(void* p_dev, uint64_t t_us, uint16_t handle, uint8_t const* p_data, uint16_t len) {
+    device_t* p = p_dev;
+    if (handle != p->button_handle || len < 1 || p_data[0] != BUTTON_PUSH || p->press_count == 0) {
+        return;
+    }
+    // The latest press is reported; any before it were lost
+    p->missed += p->press_count - 1;
+    stat_add(&p->latency, (uint32_t)(t_us - p->presses[p->press_count - 1]));
+    p->press_count = 0;
+}
+
+static void host_rtt(void* p_dev, unsigned channel, void const* p_data, unsigned len) {
+    device_t* p = p_dev;
+    if (m_rtt_file != NULL && p->index == 0 && channel == RTT_TRACE_CHANNEL) {
+        fwrite(p_data, 1, len, m_rtt_file);
+    }
+}
+
+static void host_fault(void* p_dev, char const* p_reason) {
+    device_t* p = p_dev;
+    fprintf(stderr, "sim: device %u: %s\n", p->index, p_reason);
+    exit(1);
+}
+
+static sim_host_t const m_host = {
+    .yield = host_yield,
+    .adv_pdu = host_adv_pdu,
+    .notify = host_notify,
+    .rtt = host_rtt,
+    .fault = host_fault
+};
+
+
+/****************************************************************
+ * Function: device_entry()
+ * Description: Runs the firmware main() on the device stack.
+****************************************************************/
+static void device_entry(void) {
+    device_t* p = m_current;
+    p->p_fw->main();
+    host_fault(p, "main() returned");
+}
+
+
+/****************************************************************
+ * Function: device_load()
+ * Description: Loads a private copy of the firmware. dlopen()
+ *  shares a library that is already loaded, so each copy comes
+ *  from its own memory file, kept open so that no two copies
+ *  have the same path.
+****************************************************************/
+static void device_load(device_t* p) {
+    char path[64];
+    int fd = memfd_create("sim_fw", 0);
+    if (fd < 0 || write(fd, m_image, m_image_size) != (ssize_t)m_image_size) {
+        perror("sim: memfd");
+        exit(1);
+    }
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    p->p_lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    p->fd = fd;
+    if (p->p_lib == NULL) {
+        fprintf(stderr, "sim: %s\n", dlerror());
+        exit(1);
+    }
+    p->p_fw = dlsym(p->p_lib, "sim_fw");
+    if (p->p_fw == NULL) {
+        fprintf(stderr, "sim: no sim_fw in the firmware image\n");
+        exit(1);
+    }
+}
+
+
+/****************************************************************
+ * Function: device_run()
+ * Description: Runs a device up to the end of the window.
+****************************************************************/
+static void device_run(device_t* p, worker_t* p_worker) {
+    m_current = p;
+    p->p_return = &p_worker->ctx;
+    while (p->next_press_us < m_window_end) {
+        p->p_fw->button(p->next_press_us, PRESS_HOLD_US);
+        if (p->press_count == PRESSES_MAX) {
+            memmove(p->presses, p->presses + 1, (PRESSES_MAX - 1) * sizeof(uint64_t));
+            p->press_count--;
+            p->missed++;
+        }
+        p->presses[p->press_count++] = p->next_press_us;
+        p->pressed++;
+        double u = (xorshift(&p->rand) + 1.0) / 4294967296.0;
+        uint64_t gap = (uint64_t)(-log(u) * 60e6 / m_cfg.presses_per_min);
+        p->next_press_us += (gap < PRESS_MIN_GAP_US) ? PRESS_MIN_GAP_US : gap;
+    }
+    while (p->p_fw->next_event() < m_window_end) {
+        p->p_fw->run_event();
+        if (!p->started) {
+            getcontext(&p->ctx);
+            p->ctx.uc_stack.ss_sp = p->p_stack;
+            p->ctx.uc_stack.ss_size = STACK_SIZE;
+            p->ctx.uc_link = NULL;
+            makecontext(&p->ctx, device_entry, 0);
+            p->started = true;
+        }
+        // Main loop runs until it sleeps again
+        swapcontext(&p_worker->ctx, &p->ctx);
+    }
+}
+
+
+/****************************************************************
+ * Function: gateway_hears()
+ * Description: Checks whether a gateway receives a PDU: it must
+ *  be scanning that channel and not be busy with a link.
+****************************************************************/
+static bool gateway_hears(gateway_t const* p_gw, pdu_t const* p_pdu) {
+    uint64_t start = p_pdu->t_us;
+    uint64_t end = start + p_pdu->duration_us;
+    uint64_t interval_us = (uint64_t)m_cfg.interval_ms * 1000;
+    if (SIM_ADV_CHANNEL + (start + p_gw->scan_offset_us) / SCAN_WINDOW_US % 3 != p_pdu->channel ||
+        start < p_gw->busy_until_us) {
+        return false;
+    }
+    for (uint32_t i = 0; i < m_cfg.max_links; i++) {
+        if (p_gw->p_links[i].end_us <= start || p_gw->p_links[i].anchor_us >= end) {
+            continue;
+        }
+        uint64_t phase = (start - p_gw->p_links[i].anchor_us) % interval_us;
+        if (phase < CONN_SLOT_US || phase + p_pdu->duration_us > interval_us) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/****************************************************************
+ * Function: channel_busy()
+ * Description: Checks for another transmission on a channel
+ *  between two times, among the pending PDUs from an index on.
+****************************************************************/
+static bool channel_busy(uint8_t channel, uint64_t start, uint64_t end, size_t from, size_t skip) {
+    if (m_chan_end[channel - SIM_ADV_CHANNEL] > start) {
+        return true;
+    }
+    for (size_t j = from; j < m_pending.count && m_pending.p[j].t_us < end; j++) {
+        pdu_t const* p_other = &m_pending.p[j];
+        if (j != skip && p_other->channel == channel && p_other->t_us + p_other->duration_us > start &&
+            m_devs[p_other->dev].connected_us > p_other->t_us) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/****************************************************************
+ * Function: gateway_connect()
+ * Description: Sends a CONNECT_IND after a PDU. Returns false if
+ *  it collided on air.
+****************************************************************/
+static bool gateway_connect(gateway_t* p_gw, device_t* p_dev, pdu_t const* p_pdu, size_t index) {
+    uint64_t start = p_pdu->t_us + p_pdu->duration_us + T_IFS_US;
+    uint64_t end = start + CONNECT_IND_US;
+    p_gw->busy_until_us = end;
+    m_stats.attempts++;
+    if (channel_busy(p_pdu->channel, start, end, index + 1, index)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < m_cfg.max_links; i++) {
+        if (p_gw->p_links[i].end_us <= start) {
+            p_gw->p_links[i].anchor_us = end + 1250;
+            p_gw->p_links[i].end_us = end + m_cfg.hold_us;
+            break;
+        }
+    }
+    uint64_t interval_us = (uint64_t)m_cfg.interval_ms * 1000;
+    uint16_t cccd = p_dev->p_fw->cccd_find(BUTTON_UUID, &p_dev->button_handle);
+    p_dev->p_fw->connect(end, (uint16_t)(interval_us / 1250));
+    if (cccd != 0) {
+        p_dev->p_fw->write(end + DISCOVERY_INTERVALS * interval_us, cccd, (uint8_t const[]){1, 0}, 2);
+    }
+    p_dev->p_fw->disconnect(end + m_cfg.hold_us);
+    p_dev->connected_us = end;
+    p_dev->released_us = end + m_cfg.hold_us;
+    if (!p_dev->served) {
+        p_dev->served = true;
+        stat_add(&m_stats.connect, (uint32_t)(end - p_dev->first_pdu_us));
+    }
+    m_stats.connections++;
+    return true;
+}
+
+
+/****************************************************************
+ * Function: pdu_cmp()
+ * Description: Orders PDUs by start time, then device.
+****************************************************************/
+static int pdu_cmp(void const* p_a, void const* p_b) {
+    pdu_t const* a = p_a;
+    pdu_t const* b = p_b;
+    if (a->t_us != b->t_us) {
+        return (a->t_us < b->t_us) ? -1 : 1;
+    }
+    return (a->dev > b->dev) - (a->dev < b->dev);
+}
+
+
+/****************************************************************
+ * Function: medium_run()
+ * Description: Serial phase: settles the PDUs that can no longer
+ *  be overlapped by one still to come.
+****************************************************************/
+static void medium_run(void) {
+    for (uint32_t i = 0; i < m_dev_count; i++) {
+        device_t* p_dev = &m_devs[i];
+        for (size_t j = 0; j < p_dev->outbox.count; j++) {
+            pdu_add(&m_pending, &p_dev->outbox.p[j]);
+        }
+        p_dev->outbox.count = 0;
+        if (p_dev->connected_us != SIM_NEVER && p_dev->released_us <= m_window_end) {
+            p_dev->connected_us = SIM_NEVER;
+        }
+    }
+    qsort(m_pending.p, m_pending.count, sizeof(pdu_t), pdu_cmp);
+
+    uint64_t horizon = (m_window_end > SETTLE_US) ? m_window_end - SETTLE_US : 0;
+    size_t settled = 0;
+    for (; settled < m_pending.count && m_pending.p[settled].t_us < horizon; settled++) {
+        pdu_t const* p_pdu = &m_pending.p[settled];
+        device_t* p_dev = &m_devs[p_pdu->dev];
+        // The device stopped advertising at the CONNECT_IND
+        if (p_dev->connected_us <= p_pdu->t_us) {
+            continue;
+        }
+        uint64_t end = p_pdu->t_us + p_pdu->duration_us;
+        m_stats.pdus++;
+        if (p_dev->first_pdu_us == SIM_NEVER) {
+            p_dev->first_pdu_us = p_pdu->t_us;
+        }
+        bool collided = channel_busy(p_pdu->channel, p_pdu->t_us, end, settled + 1, settled);
+        uint64_t* p_chan_end = &m_chan_end[p_pdu->channel - SIM_ADV_CHANNEL];
+        *p_chan_end = (end > *p_chan_end) ? end : *p_chan_end;
+        if (collided) {
+            m_stats.collided++;
+            continue;
+        }
+        uint32_t first = xorshift(&m_rand) % m_cfg.gateways;
+        for (uint32_t k = 0; k < m_cfg.gateways; k++) {
+            gateway_t* p_gw = &m_gws[(first + k) % m_cfg.gateways];
+            if (!gateway_hears(p_gw, p_pdu)) {
+                continue;
+            }
+            if (p_dev->discovered_us == SIM_NEVER) {
+                p_dev->discovered_us = end;
+                stat_add(&m_stats.discovery, (uint32_t)(end - p_dev->first_pdu_us));
+            }
+            bool link_free = false;
+            for (uint32_t i = 0; i < m_cfg.max_links; i++) {
+                link_free |= p_gw->p_links[i].end_us <= end;
+            }
+            if (link_free) {
+                gateway_connect(p_gw, p_dev, p_pdu, settled);
+                break;
+            }
+        }
+    }
+    memmove(m_pending.p, m_pending.p + settled, (m_pending.count - settled) * sizeof(pdu_t));
+    m_pending.count -= settled;
+}
+
+
+/****************************************************************
+ * Function: worker_main()
+ * Description: Runs this thread's devices window by window;
+ *  thread 0 also runs the serial phase.
+****************************************************************/
+static void* worker_main(void* p_arg) {
+    worker_t* p_worker = p_arg;
+    while (true) {
+        pthread_barrier_wait(&m_barrier);
+        if (m_done) {
+            return NULL;
+        }
+        for (uint32_t i = p_worker->index; i < m_dev_count; i += m_cfg.threads) {
+            device_run(&m_devs[i], p_worker);
+        }
+        pthread_barrier_wait(&m_barrier);
+        if (p_worker->index == 0) {
+            medium_run();
+            m_window_end += m_cfg.window_us;
+            m_done = m_window_end > m_cfg.duration_us;
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: percentile()
+ * Description: Returns a percentile of a sample list in ms.
+****************************************************************/
+static int u32_cmp(void const* p_a, void const* p_b) {
+    uint32_t a = *(uint32_t const*)p_a;
+    uint32_t b = *(uint32_t const*)p_b;
+    return (a > b) - (a < b);
+}
+
+static double percentile(stat_list_t* p_list, double pct) {
+    if (p_list->count == 0) {
+        return NAN;
+    }
+    qsort(p_list->p, p_list->count, sizeof(uint32_t), u32_cmp);
+    size_t i = (size_t)(pct / 100.0 * (p_list->count - 1) + 0.5);
+    return p_list->p[i] / 1000.0;
+}
+
+
+/****************************************************************
+ * Function: simulate()
+ * Description: Runs one simulation with a device count and
+ *  prints its row of the report.
+****************************************************************/
+static void simulate(uint32_t count) {
+    struct timespec wall_start, wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    memset(&m_stats, 0, sizeof(m_stats));
+    memset(m_chan_end, 0, sizeof(m_chan_end));
+    m_pending.count = 0;
+    m_rand = m_cfg.seed * 2654435761U + count;
+    m_rand = m_rand ? m_rand : 1;
+
+    m_dev_count = count;
+    m_devs = calloc(count, sizeof(device_t));
+    for (uint32_t i = 0; i < count; i++) {
+        device_t* p = &m_devs[i];
+        p->index = i;
+        p->rand = xorshift(&m_rand) | 1;
+        p->power_on_us = xorshift(&p->rand) % POWER_ON_SPREAD_US;
+        p->next_press_us = p->power_on_us + BOOT_US + xorshift(&p->rand) % PRESS_MIN_GAP_US;
+        p->first_pdu_us = p->discovered_us = p->connected_us = SIM_NEVER;
+        p->p_stack = mmap(NULL, STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        device_load(p);
+        p->p_fw->init(&m_host, p, p->power_on_us, xorshift(&p->rand));
+    }
+    m_gws = calloc(m_cfg.gateways, sizeof(gateway_t));
+    for (uint32_t g = 0; g < m_cfg.gateways; g++) {
+        m_gws[g].scan_offset_us = xorshift(&m_rand) % (3 * SCAN_WINDOW_US);
+        m_gws[g].p_links = calloc(m_cfg.max_links, sizeof(*m_gws[g].p_links));
+    }
+
+    m_window_end = m_cfg.window_us;
+    m_done = false;
+    pthread_barrier_init(&m_barrier, NULL, m_cfg.threads);
+    m_workers = calloc(m_cfg.threads, sizeof(worker_t));
+    for (uint32_t t = 1; t < m_cfg.threads; t++) {
+        m_workers[t].index = t;
+        pthread_create(&m_workers[t].thread, NULL, worker_main, &m_workers[t]);
+    }
+    worker_main(&m_workers[0]);
+    for (uint32_t t = 1; t < m_cfg.threads; t++) {
+        pthread_join(m_workers[t].thread, NULL);
+    }
+    pthread_barrier_destroy(&m_barrier);
+
+    // Collect the device results
+    uint32_t discovered = 0, served = 0, pressed = 0, delivered = 0;
+    stat_list_t latency = {0};
+    for (uint32_t i = 0; i < count; i++) {
+        device_t* p = &m_devs[i];
+        discovered += p->discovered_us != SIM_NEVER;
+        served += p->served;
+        pressed += p->pressed;
+        delivered += p->latency.count;
+        for (size_t j = 0; j < p->latency.count; j++) {
+            stat_add(&latency, p->latency.p[j]);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+
+    printf("%5u %5u %8.0f %8.0f %6u %6.1f %6.1f %8.0f %8.0f %7u %6.1f %7.0f %7.0f %6.2f %7.1f\n",
+           count, discovered, percentile(&m_stats.discovery, 50), percentile(&m_stats.discovery, 95),
+           m_stats.attempts, m_stats.attempts ? 100.0 * m_stats.connections / m_stats.attempts : 0.0,
+           100.0 * served / count, percentile(&m_stats.connect, 50), percentile(&m_stats.connect, 95),
+           pressed, pressed ? 100.0 * delivered / pressed : 0.0,
+           percentile(&latency, 50), percentile(&latency, 95),
+           m_stats.pdus ? 100.0 * m_stats.collided / m_stats.pdus : 0.0, wall);
+    fflush(stdout);
+
+    for (uint32_t i = 0; i < count; i++) {
+        dlclose(m_devs[i].p_lib);
+        close(m_devs[i].fd);
+        munmap(m_devs[i].p_stack, STACK_SIZE);
+        free(m_devs[i].outbox.p);
+        free(m_devs[i].latency.p);
+    }
+    for (uint32_t g = 0; g < m_cfg.gateways; g++) {
+        free(m_gws[g].p_links);
+    }
+    free(latency.p);
+    free(m_stats.discovery.p);
+    free(m_stats.connect.p);
+    free(m_gws);
+    free(m_workers);
+    free(m_devs);
+}
+
+
+/****************************************************************
+ * Function: image_read()
+ * Description: Reads the firmware image into memory.
+****************************************************************/
+static void image_read(char const* p_path) {
+    FILE* f = fopen(p_path, "rb");
+    if (f == NULL) {
+        perror(p_path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    m_image_size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    m_image = malloc(m_image_size);
+    if (fread(m_image, 1, m_image_size, f) != m_image_size) {
+        perror(p_path);
+        exit(1);
+    }
+    fclose(f);
+}
+
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: sim [options] sim_fw.so\n"
+            "  -n N,N,...  device counts (default 10,50,100,200,500)\n"
+            "  -t S        simulated time per run in seconds (60)\n"
+            "  -g N        gateways (1)\n"
+            "  -l N        links per gateway (20)\n"
+            "  -H S        time a gateway keeps a device connected, seconds (10)\n"
+            "  -p N        button presses per device per minute (6)\n"
+            "  -c MS       gateway connection interval (30)\n"
+            "  -j N        threads (all CPUs)\n"
+            "  -w US       window length (2000)\n"
+            "  -s N        random seed (1)\n"
+            "  -r FILE     write device 0's trace stream of the first run to FILE\n");
+    exit(2);
+}
+
+
+int main(int argc, char* argv[]) {
+    char const* p_counts = "10,50,100,200,500";
+    m_cfg.threads = (uint32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:g:l:H:p:c:j:w:s:r:")) != -1) {
+        switch (opt) {
+            case 'n': p_counts = optarg; break;
+            case 't': m_cfg.duration_us = (uint64_t)(atof(optarg) * 1e6); break;
+            case 'g': m_cfg.gateways = atoi(optarg); break;
+            case 'l': m_cfg.max_links = atoi(optarg); break;
+            case 'H': m_cfg.hold_us = (uint64_t)(atof(optarg) * 1e6); break;
+            case 'p': m_cfg.presses_per_min = atof(optarg); break;
+            case 'c': m_cfg.interval_ms = atoi(optarg); break;
+            case 'j': m_cfg.threads = atoi(optarg); break;
+            case 'w': m_cfg.window_us = atoi(optarg); break;
+            case 's': m_cfg.seed = atoi(optarg); break;
+            case 'r':
+                m_rtt_file = fopen(optarg, "wb");
+                if (m_rtt_file == NULL) {
+                    perror(optarg);
+                    exit(1);
+                }
+                break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1 || m_cfg.gateways == 0 || m_cfg.max_links == 0 || m_cfg.threads == 0 ||
+        m_cfg.window_us == 0 || m_cfg.interval_ms < 8 || m_cfg.presses_per_min <= 0) {
+        usage();
+    }
+    image_read(argv[optind]);
+
+    printf("%.0f s per run, %u gateway(s) x %u links, %.0f s hold, %.1f presses/min, %u threads\n",
+           m_cfg.duration_us / 1e6, m_cfg.gateways, m_cfg.max_links, m_cfg.hold_us / 1e6,
+           m_cfg.presses_per_min, m_cfg.threads);
+    printf("                discovery ms              connect %%       connect ms     presses   latency ms    adv   wall\n");
+    printf("    N  disc      p50      p95  tries     ok served      p50      p95   count  deliv     p50     p95  coll%%      s\n");
+    char counts[256];
+    snprintf(counts, sizeof(counts), "%s", p_counts);
+    for (char* p_tok = strtok(counts, ","); p_tok != NULL; p_tok = strtok(NULL, ",")) {
+        uint32_t count = atoi(p_tok);
+        if (count > 0) {
+            simulate(count);
+            if (m_rtt_file != NULL) {
+                fclose(m_rtt_file);
+                m_rtt_file = NULL;
+            }
+        }
+    }
+    return 0;
+}
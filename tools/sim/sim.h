@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: sim.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Interface between the network simulator (sim.c) and one
+ * simulated device: the firmware linked against the SoftDevice stand-in
+ * (softdevice.c), loaded as its own copy of sim_fw.so.
+ *
+ *  Device time is in microseconds from the start of the simulation. The
+ *  host only enqueues into a device from the serial phase or from the
+ *  thread that runs it; device code calls back into the host while it
+ *  runs.
+*******************************************************************************/
+#ifndef SIM_H__
+#define SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// No pending event
+#define SIM_NEVER UINT64_MAX
+// First advertising channel (37, 38 and 39 follow each other)
+#define SIM_ADV_CHANNEL 37
+
+// Host services for a device
+typedef struct {
+    // The firmware main loop sleeps (nrf_pwr_mgmt_run); returns after the
+    // next event has been handled
+    void (*yield)(void* p_dev);
+    // An advertising PDU goes on air
+    void (*adv_pdu)(void* p_dev, uint64_t t_us, uint8_t channel, uint16_t duration_us);
+    // A notification reached the central in a connection event
+    void (*notify)(void* p_dev, uint64_t t_us, uint16_t handle, uint8_t const* p_data, uint16_t len);
+    // The firmware wrote to an RTT up buffer
+    void (*rtt)(void* p_dev, unsigned channel, void const* p_data, unsigned len);
+    // The firmware called NVIC_SystemReset() or the SoftDevice asserted
+    void (*fault)(void* p_dev, char const* p_reason);
+} sim_host_t;
+
+// Device entry points (sim_fw in each loaded copy)
+typedef struct {
+    // Binds the device to the host; it powers on at power_on_us
+    void (*init)(sim_host_t const* p_host, void* p_dev, uint64_t power_on_us, uint32_t seed);
+    // Firmware main(), run on its own stack by the host
+    int (*main)(void);
+    // Time of the next device event, SIM_NEVER if there is none
+    uint64_t (*next_event)(void);
+    // Handles the next device event (interrupt context: main is asleep)
+    void (*run_event)(void);
+    // A CONNECT_IND for the device ended on air at t_us
+    void (*connect)(uint64_t t_us, uint16_t interval);
+    // The central ends the connection at t_us
+    void (*disconnect)(uint64_t t_us);
+    // The central writes an attribute in the first connection event after t_us
+    void (*write)(uint64_t t_us, uint16_t handle, uint8_t const* p_data, uint16_t len);
+    // Service discovery: CCCD handle of the characteristic with this 16-bit
+    // UUID, BLE_GATT_HANDLE_INVALID (0) if there is none
+    uint16_t (*cccd_find)(uint16_t uuid, uint16_t* p_value_handle);
+    // The button is pressed at t_us and released hold_us later
+    void (*button)(uint64_t t_us, uint32_t hold_us);
+} sim_fw_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_H__
@@ -0,0 +1,883 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: sim_sdk.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Host stand-in for the parts of the nRF5 SDK, the S140 API and
+ * the nRF52840 MDK that the firmware uses. The simulator build generates a
+ * header for every SDK header the firmware includes that just includes this
+ * one; sdk_config.h is the project's own. Types and constants follow the
+ * SDK 17 / S140 7.x headers where the firmware depends on them, the rest is
+ * trimmed. softdevice.c implements the functions.
+*******************************************************************************/
+#ifndef SIM_SDK_H__
+#define SIM_SDK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "sdk_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * SDK common (sdk_errors.h, app_util.h)
+***************************************/
+#define NRF_SUCCESS 0
+#define NRF_ERROR_NO_MEM 4
+#define NRF_ERROR_NOT_FOUND 5
+#define NRF_ERROR_NOT_SUPPORTED 6
+#define NRF_ERROR_INVALID_PARAM 7
+#define NRF_ERROR_INVALID_STATE 8
+#define NRF_ERROR_INVALID_LENGTH 9
+#define NRF_ERROR_DATA_SIZE 12
+#define NRF_ERROR_BUSY 17
+#define NRF_ERROR_RESOURCES 19
+#define BLE_ERROR_INVALID_CONN_HANDLE 0x3002
+typedef uint32_t ret_code_t;
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
+#define UNIT_0_625_MS 625
+#define UNIT_1_25_MS 1250
+#define UNIT_10_MS 10000
+#define MSEC_TO_UNITS(TIME, RESOLUTION) (((TIME) * 1000) / (RESOLUTION))
+#define ROUNDED_DIV(A, B) (((A) + ((B) / 2)) / (B))
+#define STATIC_ASSERT(EXPR) _Static_assert((EXPR), #EXPR)
+
+
+/***************************************
+ * MDK (nrf.h): registers the firmware touches directly
+***************************************/
+typedef enum {
+    RADIO_IRQn = 1,
+    SAADC_IRQn = 7,
+    TIMER0_IRQn = 8,
+    GPIOTE_IRQn = 6,
+    RTC1_IRQn = 17,
+    SWI1_EGU1_IRQn = 21,                // Radio notification
+    SWI2_EGU2_IRQn = 22,                // SoftDevice events
+    TIMER3_IRQn = 26,
+    RTC2_IRQn = 36
+} IRQn_Type;
+
+typedef struct {
+    volatile uint32_t TASKS_START, TASKS_STOP, TASKS_CLEAR, TASKS_TRIGOVRFLW;
+    volatile uint32_t EVENTS_TICK, EVENTS_OVRFLW, EVENTS_COMPARE[4];
+    volatile uint32_t INTEN, INTENSET, INTENCLR, EVTEN, EVTENSET, EVTENCLR;
+    volatile uint32_t COUNTER, PRESCALER, CC[4];
+} NRF_RTC_Type;
+
+typedef struct {
+    volatile uint32_t TASKS_START, TASKS_STOP, TASKS_COUNT, TASKS_CLEAR, TASKS_SHUTDOWN;
+    volatile uint32_t TASKS_CAPTURE[6], EVENTS_COMPARE[6];
+    volatile uint32_t SHORTS, INTENSET, INTENCLR, MODE, BITMODE, PRESCALER, CC[6];
+} NRF_TIMER_Type;
+
+typedef struct {
+    volatile uint32_t RESETREAS, SYSTEMOFF, GPREGRET, GPREGRET2, MAINREGSTATUS;
+} NRF_POWER_Type;
+
+typedef struct {
+    volatile uint32_t TASKS_START, TASKS_SAMPLE, TASKS_STOP, TASKS_CALIBRATEOFFSET;
+    volatile uint32_t EVENTS_STARTED, EVENTS_END, EVENTS_DONE, EVENTS_RESULTDONE;
+    volatile uint32_t EVENTS_CALIBRATEDONE, EVENTS_STOPPED;
+    volatile uint32_t INTEN, INTENSET, INTENCLR, ENABLE;
+    struct {
+        volatile uint32_t PSELP, PSELN, CONFIG, LIMIT;
+    } CH[8];
+    volatile uint32_t RESOLUTION, OVERSAMPLE, SAMPLERATE;
+    struct {
+        volatile uintptr_t PTR;             // 32 bits on the device
+        volatile uint32_t MAXCNT, AMOUNT;
+    } RESULT;
+} NRF_SAADC_Type;
+
+typedef struct {
+    volatile uint32_t EVENTS_PORT;
+} NRF_GPIOTE_Type;
+
+typedef struct {
+    volatile uint32_t CTRL, CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define RTC_INTENSET_OVRFLW_Msk (1UL << 1)
+#define RTC_INTENSET_COMPARE0_Msk (1UL << 16)
+#define RTC_INTENCLR_COMPARE0_Msk (1UL << 16)
+#define RTC_EVTENSET_COMPARE1_Msk (1UL << 17)
+#define RTC_COUNTER_COUNTER_Msk 0xFFFFFFUL
+#define TIMER_MODE_MODE_Timer 0
+#define TIMER_BITMODE_BITMODE_32Bit 3
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define POWER_RESETREAS_OFF_Msk (1UL << 16)
+#define POWER_RAM_POWER_S0POWER_Pos 0
+#define POWER_RAM_POWER_S0POWER_On 1UL
+#define POWER_RAM_POWER_S0RETENTION_Pos 16
+#define POWER_RAM_POWER_S0RETENTION_On 1UL
+#define POWER_MAINREGSTATUS_MAINREGSTATUS_Pos 0
+#define POWER_MAINREGSTATUS_MAINREGSTATUS_Msk 1UL
+#define POWER_MAINREGSTATUS_MAINREGSTATUS_High 1UL
+#define SAADC_INTENSET_END_Msk (1UL << 1)
+#define SAADC_INTENSET_CALIBRATEDONE_Msk (1UL << 4)
+#define SAADC_ENABLE_ENABLE_Enabled 1
+#define SAADC_RESOLUTION_VAL_12bit 2
+#define SAADC_OVERSAMPLE_OVERSAMPLE_Over16x 4
+#define SAADC_CH_PSELP_PSELP_VDD 9
+#define SAADC_CH_PSELP_PSELP_VDDHDIV5 0x0D
+#define SAADC_CH_PSELN_PSELN_NC 0
+#define SAADC_CH_CONFIG_GAIN_Pos 8
+#define SAADC_CH_CONFIG_GAIN_Gain1_6 0
+#define SAADC_CH_CONFIG_REFSEL_Pos 12
+#define SAADC_CH_CONFIG_REFSEL_Internal 0
+#define SAADC_CH_CONFIG_TACQ_Pos 16
+#define SAADC_CH_CONFIG_TACQ_10us 2
+#define SAADC_CH_CONFIG_MODE_Pos 20
+#define SAADC_CH_CONFIG_MODE_SE 0
+#define SAADC_CH_CONFIG_BURST_Pos 24
+#define SAADC_CH_CONFIG_BURST_Enabled 1
+
+// One instance per loaded device (softdevice.c)
+extern NRF_RTC_Type sim_rtc1;
+extern NRF_RTC_Type sim_rtc2;
+extern NRF_TIMER_Type sim_timer2;
+extern NRF_TIMER_Type sim_timer3;
+extern NRF_GPIOTE_Type sim_gpiote;
+extern NRF_POWER_Type sim_power;
+extern NRF_SAADC_Type sim_saadc;
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+extern uint32_t SystemCoreClock;
+#define NRF_RTC1 (&sim_rtc1)
+#define NRF_RTC2 (&sim_rtc2)
+#define NRF_TIMER2 (&sim_timer2)
+#define NRF_TIMER3 (&sim_timer3)
+#define NRF_GPIOTE (&sim_gpiote)
+#define NRF_POWER (&sim_power)
+#define NRF_SAADC (&sim_saadc)
+#define DWT (&sim_dwt)
+#define CoreDebug (&sim_core_debug)
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type irq);
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+void NVIC_SystemReset(void);
+// Exception number of the event being handled, 0 in the main loop
+uint32_t __get_IPSR(void);
+
+// Device code never preempts itself (handlers only run while main
+// sleeps), so the exclusive monitor always succeeds
+static inline uint32_t __LDREXW(volatile uint32_t* p_addr) {
+    return *p_addr;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t* p_addr) {
+    *p_addr = value;
+    return 0;
+}
+
+static inline void __CLREX(void) {}
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+
+
+/***************************************
+ * app_util_platform.h
+***************************************/
+#define APP_IRQ_PRIORITY_HIGH 2
+#define APP_IRQ_PRIORITY_MID 3
+#define APP_IRQ_PRIORITY_LOW 6
+#define APP_IRQ_PRIORITY_LOWEST 7
+
+#define CRITICAL_REGION_ENTER() {
+#define CRITICAL_REGION_EXIT() }
+
+
+/***************************************
+ * app_error.h
+***************************************/
+#define NRF_FAULT_ID_SDK_ERROR 0x00004001
+
+typedef struct {
+    uint32_t line_num;
+    uint8_t const* p_file_name;
+    uint32_t err_code;
+} error_info_t;
+
+void app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info);
+
+
+/***************************************
+ * app_timer.h (RTC1 at APP_TIMER_CONFIG_RTC_FREQUENCY)
+***************************************/
+#define APP_TIMER_CLOCK_FREQ 32768
+#define APP_TIMER_TICKS(MS) \
+    ((uint32_t)ROUNDED_DIV((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ, 1000 * (APP_TIMER_CONFIG_RTC_FREQUENCY + 1)))
+
+ret_code_t app_timer_init(void);
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from);
+
+
+/***************************************
+ * boards.h, app_button.h
+***************************************/
+#define LEDS_NUMBER 4
+#define BUTTONS_NUMBER 1
+#define BSP_BOARD_LED_0 0
+#define BSP_BOARD_LED_1 1
+#define BSP_BOARD_LED_2 2
+#define BSP_BOARD_LED_3 3
+#define BSP_BOARD_BUTTON_0 0
+#define BSP_INIT_LEDS (1 << 0)
+#define BUTTON_PULL 3
+#define BUTTONS_ACTIVE_STATE 0
+#define APP_BUTTON_PUSH 1
+#define APP_BUTTON_RELEASE 0
+
+typedef void (*app_button_handler_t)(uint8_t pin_no, uint8_t button_action);
+
+typedef struct {
+    uint8_t pin_no;
+    uint8_t active_state;
+    uint8_t pull_cfg;
+    app_button_handler_t button_handler;
+} app_button_cfg_t;
+
+void bsp_board_init(uint32_t init_flags);
+void bsp_board_led_on(uint32_t led_idx);
+void bsp_board_led_off(uint32_t led_idx);
+void bsp_board_leds_off(void);
+uint32_t bsp_board_button_idx_to_pin(uint32_t button_idx);
+ret_code_t app_button_init(app_button_cfg_t const* p_buttons, uint8_t button_count, uint32_t detection_delay);
+ret_code_t app_button_enable(void);
+bool app_button_is_pushed(uint8_t button_id);
+
+
+/***************************************
+ * nrf_gpio.h
+***************************************/
+#define NRF_GPIO_PIN_SENSE_HIGH 2
+#define NRF_GPIO_PIN_SENSE_LOW 3
+
+void nrf_gpio_cfg_sense_input(uint32_t pin_number, uint32_t pull_config, uint32_t sense_config);
+
+
+/***************************************
+ * nrf_pwr_mgmt.h, nrf_drv_clock.h
+***************************************/
+typedef void (*nrf_drv_clock_handler_t)(int event);
+typedef struct {
+    nrf_drv_clock_handler_t handler;
+    void* p_next;
+} nrf_drv_clock_handler_item_t;
+
+ret_code_t nrf_pwr_mgmt_init(void);
+void nrf_pwr_mgmt_run(void);
+ret_code_t nrf_drv_clock_init(void);
+void nrf_drv_clock_lfclk_request(nrf_drv_clock_handler_item_t* p_handler_item);
+
+
+/***************************************
+ * crc16.h, SEGGER_RTT.h
+***************************************/
+uint16_t crc16_compute(uint8_t const* p_data, uint32_t size, uint16_t const* p_crc);
+unsigned SEGGER_RTT_Write(unsigned BufferIndex, const void* pBuffer, unsigned NumBytes);
+unsigned SEGGER_RTT_Read(unsigned BufferIndex, void* pBuffer, unsigned BufferSize);
+unsigned SEGGER_RTT_GetAvailWriteSpace(unsigned BufferIndex);
+#define SEGGER_RTT_MODE_NO_BLOCK_SKIP 0
+int SEGGER_RTT_ConfigUpBuffer(unsigned BufferIndex, const char* sName, void* pBuffer,
+                              unsigned BufferSize, unsigned Flags);
+
+
+/***************************************
+ * nrf_soc.h, nrf_sdh_soc.h
+***************************************/
+enum {
+    NRF_EVT_HFCLKSTARTED,
+    NRF_EVT_POWER_FAILURE_WARNING,
+    NRF_EVT_FLASH_OPERATION_SUCCESS,
+    NRF_EVT_FLASH_OPERATION_ERROR,
+    NRF_EVT_RADIO_BLOCKED,
+    NRF_EVT_RADIO_CANCELED,
+    NRF_EVT_RADIO_SIGNAL_CALLBACK_INVALID_RETURN,
+    NRF_EVT_RADIO_SESSION_IDLE,
+    NRF_EVT_RADIO_SESSION_CLOSED
+};
+
+uint32_t sd_power_system_off(void);
+uint32_t sd_power_ram_power_set(uint8_t index, uint32_t ram_powerset);
+uint32_t sd_ppi_channel_assign(uint8_t channel_num, const volatile void* evt_endpoint,
+                               const volatile void* task_endpoint);
+uint32_t sd_ppi_channel_enable_set(uint32_t channel_enable_set_msk);
+uint32_t sd_temp_get(int32_t* p_temp);
+
+typedef void (*nrf_sdh_soc_evt_handler_t)(uint32_t evt_id, void* p_context);
+
+typedef struct {
+    uint8_t prio;
+    nrf_sdh_soc_evt_handler_t handler;
+    void* p_context;
+} nrf_sdh_soc_evt_observer_t;
+
+// Observers are collected in a section, as in the SDK (pointers to them,
+// so the section is a plain array); softdevice.c calls them in priority order
+#define NRF_SDH_SOC_OBSERVER(_name, _prio, _handler, _context)                      \
+    static nrf_sdh_soc_evt_observer_t const _name = {                               \
+        .prio = (_prio), .handler = (_handler), .p_context = (_context)             \
+    };                                                                              \
+    static nrf_sdh_soc_evt_observer_t const* const _name##_ptr                      \
+        __attribute__((section("sim_sdh_soc_observers"), used)) = &_name
+
+
+/***************************************
+ * ble_radio_notification.h
+***************************************/
+#define NRF_RADIO_NOTIFICATION_DISTANCE_800US 1
+
+typedef void (*ble_radio_notification_evt_handler_t)(bool radio_active);
+
+uint32_t ble_radio_notification_init(uint32_t irq_priority, uint8_t distance,
+                                     ble_radio_notification_evt_handler_t evt_handler);
+
+
+/***************************************
+ * ble.h, ble_gap.h, ble_gatts.h, ble_l2cap.h
+***************************************/
+#define BLE_CONN_HANDLE_INVALID 0xFFFF
+#define BLE_GATT_HANDLE_INVALID 0x0000
+#define BLE_UUID_TYPE_BLE 0x01
+#define BLE_UUID_TYPE_VENDOR_BEGIN 0x02
+
+#define BLE_GAP_EVT_CONNECTED 0x10
+#define BLE_GAP_EVT_DISCONNECTED 0x11
+#define BLE_GAP_EVT_CONN_PARAM_UPDATE 0x12
+#define BLE_GAP_EVT_RSSI_CHANGED 0x1C
+#define BLE_GAP_EVT_ADV_SET_TERMINATED 0x26
+#define BLE_GAP_EVT_QOS_CHANNEL_SURVEY_REPORT 0x2A
+#define BLE_GATTS_EVT_WRITE 0x50
+#define BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST 0x51
+#define BLE_GATTS_EVT_HVN_TX_COMPLETE 0x57
+#define BLE_L2CAP_EVT_CH_SETUP_REQUEST 0x70
+#define BLE_L2CAP_EVT_CH_SETUP_REFUSED 0x71
+#define BLE_L2CAP_EVT_CH_SETUP 0x72
+#define BLE_L2CAP_EVT_CH_RELEASED 0x73
+#define BLE_L2CAP_EVT_CH_SDU_BUF_RELEASED 0x74
+#define BLE_L2CAP_EVT_CH_CREDIT 0x75
+#define BLE_L2CAP_EVT_CH_RX 0x76
+#define BLE_L2CAP_EVT_CH_TX 0x77
+
+#define BLE_CONN_CFG_GATTS 0x23
+#define BLE_CONN_CFG_L2CAP 0x24
+
+#define BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION 0x13
+#define BLE_HCI_CONNECTION_TIMEOUT 0x08
+
+#define BLE_GAP_CHANNEL_COUNT 40
+#define BLE_GAP_POWER_LEVEL_INVALID 127
+#define BLE_GAP_RSSI_THRESHOLD_INVALID 0xFF
+#define BLE_GAP_PHY_1MBPS 0x01
+#define BLE_GAP_ADV_SET_DATA_SIZE_MAX 31
+#define BLE_GAP_ADV_SET_HANDLE_NOT_SET 0xFF
+#define BLE_GAP_ADV_TIMEOUT_GENERAL_UNLIMITED 0
+#define BLE_GAP_ADV_TYPE_CONNECTABLE_SCANNABLE_UNDIRECTED 0x01
+#define BLE_GAP_ADV_FP_ANY 0x00
+#define BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE 0x06
+
+#define BLE_GATT_HVX_NOTIFICATION 0x01
+#define BLE_GATTS_SRVC_TYPE_PRIMARY 0x01
+#define BLE_GATTS_VLOC_STACK 0x01
+#define BLE_GATTS_VLOC_USER 0x02
+#define BLE_GATTS_AUTHORIZE_TYPE_READ 0x01
+#define BLE_GATTS_AUTHORIZE_TYPE_WRITE 0x02
+#define BLE_GATT_STATUS_SUCCESS 0x0000
+#define BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH 0x010D
+#define BLE_GATT_STATUS_ATTERR_APP_BEGIN 0x0180
+
+#define BLE_L2CAP_CID_INVALID 0x0000
+#define BLE_L2CAP_CREDITS_DEFAULT 1
+#define BLE_L2CAP_CH_STATUS_CODE_SUCCESS 0x0000
+#define BLE_L2CAP_CH_STATUS_CODE_LE_PSM_NOT_SUPPORTED 0x0002
+
+typedef struct {
+    uint16_t uuid;
+    uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+    uint8_t uuid128[16];
+} ble_uuid128_t;
+
+typedef struct {
+    uint8_t* p_data;
+    uint16_t len;
+} ble_data_t;
+
+typedef struct {
+    uint16_t min_conn_interval;
+    uint16_t max_conn_interval;
+    uint16_t slave_latency;
+    uint16_t conn_sup_timeout;
+} ble_gap_conn_params_t;
+
+typedef struct {
+    uint8_t sm : 4;
+    uint8_t lv : 4;
+} ble_gap_conn_sec_mode_t;
+
+#define BLE_GAP_CONN_SEC_MODE_SET_OPEN(ptr) do { (ptr)->sm = 1; (ptr)->lv = 1; } while (0)
+
+typedef struct {
+    ble_data_t adv_data;
+    ble_data_t scan_rsp_data;
+} ble_gap_adv_data_t;
+
+typedef struct {
+    struct {
+        uint8_t type;
+        uint8_t anonymous : 1;
+        uint8_t include_tx_power : 1;
+    } properties;
+    void const* p_peer_addr;
+    uint32_t interval;
+    uint16_t duration;
+    uint8_t max_adv_evts;
+    uint8_t channel_mask[5];
+    uint8_t filter_policy;
+    uint8_t primary_phy;
+    uint8_t secondary_phy;
+} ble_gap_adv_params_t;
+
+typedef struct {
+    uint8_t role;
+    ble_gap_conn_params_t conn_params;
+} ble_gap_evt_connected_t;
+
+typedef struct {
+    uint8_t reason;
+} ble_gap_evt_disconnected_t;
+
+typedef struct {
+    ble_gap_conn_params_t conn_params;
+} ble_gap_evt_conn_param_update_t;
+
+typedef struct {
+    int8_t rssi;
+    uint8_t ch_index;
+} ble_gap_evt_rssi_changed_t;
+
+typedef struct {
+    int8_t channel_energy[BLE_GAP_CHANNEL_COUNT];
+} ble_gap_evt_qos_channel_survey_report_t;
+
+typedef struct {
+    uint16_t conn_handle;
+    union {
+        ble_gap_evt_connected_t connected;
+        ble_gap_evt_disconnected_t disconnected;
+        ble_gap_evt_conn_param_update_t conn_param_update;
+        ble_gap_evt_rssi_changed_t rssi_changed;
+        ble_gap_evt_qos_channel_survey_report_t qos_channel_survey_report;
+    } params;
+} ble_gap_evt_t;
+
+typedef struct {
+    uint16_t handle;
+    ble_uuid_t uuid;
+    uint8_t op;
+    uint8_t auth_required;
+    uint16_t offset;
+    uint16_t len;
+    uint8_t data[1];                    // Variable length
+} ble_gatts_evt_write_t;
+
+typedef struct {
+    uint8_t type;
+    union {
+        ble_gatts_evt_write_t write;
+    } request;
+} ble_gatts_evt_rw_authorize_request_t;
+
+typedef struct {
+    uint8_t count;
+} ble_gatts_evt_hvn_tx_complete_t;
+
+typedef struct {
+    uint16_t conn_handle;
+    union {
+        ble_gatts_evt_write_t write;
+        ble_gatts_evt_rw_authorize_request_t authorize_request;
+        ble_gatts_evt_hvn_tx_complete_t hvn_tx_complete;
+    } params;
+} ble_gatts_evt_t;
+
+typedef struct {
+    uint16_t tx_mtu;
+    uint16_t peer_mps;
+    uint16_t tx_mps;
+    uint16_t credits;
+} ble_l2cap_ch_tx_params_t;
+
+typedef struct {
+    uint16_t rx_mtu;
+    uint16_t rx_mps;
+    ble_data_t sdu_buf;
+} ble_l2cap_ch_rx_params_t;
+
+typedef struct {
+    ble_l2cap_ch_rx_params_t rx_params;
+    uint16_t le_psm;
+    uint16_t status;
+} ble_l2cap_ch_setup_params_t;
+
+typedef struct {
+    uint16_t conn_handle;
+    uint16_t local_cid;
+    union {
+        struct {
+            ble_l2cap_ch_tx_params_t tx_params;
+            uint16_t le_psm;
+        } ch_setup_request;
+        struct {
+            ble_l2cap_ch_tx_params_t tx_params;
+        } ch_setup;
+        struct {
+            ble_data_t sdu_buf;
+        } ch_sdu_buf_released;
+        struct {
+            uint16_t credits;
+        } credit;
+        struct {
+            uint16_t sdu_len;
+            ble_data_t sdu_buf;
+        } rx;
+        struct {
+            ble_data_t sdu_buf;
+        } tx;
+    } params;
+} ble_l2cap_evt_t;
+
+typedef struct {
+    uint16_t evt_id;
+    uint16_t evt_len;
+} ble_evt_hdr_t;
+
+typedef struct {
+    ble_evt_hdr_t header;
+    union {
+        ble_gap_evt_t gap_evt;
+        ble_gatts_evt_t gatts_evt;
+        ble_l2cap_evt_t l2cap_evt;
+    } evt;
+} ble_evt_t;
+
+typedef struct {
+    uint8_t hvn_tx_queue_size;
+} ble_gatts_conn_cfg_t;
+
+typedef struct {
+    uint16_t rx_mps;
+    uint16_t tx_mps;
+    uint8_t rx_queue_size;
+    uint8_t tx_queue_size;
+    uint8_t ch_count;
+} ble_l2cap_conn_cfg_t;
+
+typedef struct {
+    struct {
+        uint8_t conn_cfg_tag;
+        union {
+            ble_gatts_conn_cfg_t gatts_conn_cfg;
+            ble_l2cap_conn_cfg_t l2cap_conn_cfg;
+        } params;
+    } conn_cfg;
+} ble_cfg_t;
+
+typedef struct {
+    uint16_t value_handle;
+    uint16_t user_desc_handle;
+    uint16_t cccd_handle;
+    uint16_t sccd_handle;
+} ble_gatts_char_handles_t;
+
+typedef struct {
+    uint16_t handle;
+    uint8_t type;
+    uint16_t offset;
+    uint16_t* p_len;
+    uint8_t const* p_data;
+} ble_gatts_hvx_params_t;
+
+typedef struct {
+    uint16_t len;
+    uint16_t offset;
+    uint8_t* p_value;
+} ble_gatts_value_t;
+
+typedef struct {
+    uint8_t type;
+    union {
+        struct {
+            uint16_t gatt_status;
+            uint8_t update;
+            uint16_t offset;
+            uint16_t len;
+            uint8_t const* p_data;
+        } write;
+    } params;
+} ble_gatts_rw_authorize_reply_params_t;
+
+uint32_t sd_ble_cfg_set(uint32_t cfg_id, ble_cfg_t const* p_cfg, uint32_t app_ram_base);
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const* p_vs_uuid, uint8_t* p_uuid_type);
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const* p_write_perm,
+                                    uint8_t const* p_dev_name, uint16_t len);
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const* p_conn_params);
+uint32_t sd_ble_gap_adv_set_configure(uint8_t* p_adv_handle, ble_gap_adv_data_t const* p_adv_data,
+                                      ble_gap_adv_params_t const* p_adv_params);
+uint32_t sd_ble_gap_adv_start(uint8_t adv_handle, uint8_t conn_cfg_tag);
+uint32_t sd_ble_gap_adv_stop(uint8_t adv_handle);
+uint32_t sd_ble_gap_rssi_start(uint16_t conn_handle, uint8_t threshold_dbm, uint8_t skip_count);
+uint32_t sd_ble_gap_rssi_get(uint16_t conn_handle, int8_t* p_rssi, uint8_t* p_ch_index);
+uint32_t sd_ble_gap_qos_channel_survey_start(uint32_t interval_us);
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const* p_uuid, uint16_t* p_handle);
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const* p_hvx_params);
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t* p_value);
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t conn_handle,
+                                         ble_gatts_rw_authorize_reply_params_t const* p_rw_authorize_reply_params);
+uint32_t sd_ble_l2cap_ch_setup(uint16_t conn_handle, uint16_t* p_local_cid,
+                               ble_l2cap_ch_setup_params_t const* p_params);
+uint32_t sd_ble_l2cap_ch_rx(uint16_t conn_handle, uint16_t local_cid, ble_data_t const* p_sdu_buf);
+uint32_t sd_ble_l2cap_ch_tx(uint16_t conn_handle, uint16_t local_cid, ble_data_t const* p_sdu_buf);
+uint32_t sd_ble_l2cap_ch_flow_control(uint16_t conn_handle, uint16_t local_cid, uint16_t credits,
+                                      uint16_t* p_credits);
+
+
+/***************************************
+ * nrf_sdh.h, nrf_sdh_ble.h
+***************************************/
+typedef void (*nrf_sdh_ble_evt_handler_t)(ble_evt_t const* p_ble_evt, void* p_context);
+
+typedef struct {
+    uint8_t prio;
+    nrf_sdh_ble_evt_handler_t handler;
+    void* p_context;
+} nrf_sdh_ble_evt_observer_t;
+
+#define NRF_SDH_BLE_OBSERVER(_name, _prio, _handler, _context)                      \
+    static nrf_sdh_ble_evt_observer_t const _name = {                               \
+        .prio = (_prio), .handler = (_handler), .p_context = (_context)             \
+    };                                                                              \
+    static nrf_sdh_ble_evt_observer_t const* const _name##_ptr                      \
+        __attribute__((section("sim_sdh_ble_observers"), used)) = &_name
+
+ret_code_t nrf_sdh_enable_request(void);
+ret_code_t nrf_sdh_ble_default_cfg_set(uint8_t conn_cfg_tag, uint32_t* p_ram_start);
+ret_code_t nrf_sdh_ble_enable(uint32_t* p_app_ram_start);
+
+
+/***************************************
+ * ble_srv_common.h, ble_advdata.h
+***************************************/
+typedef enum {
+    SEC_NO_ACCESS,
+    SEC_OPEN
+} security_req_t;
+
+typedef struct {
+    uint8_t broadcast : 1;
+    uint8_t read : 1;
+    uint8_t write_wo_resp : 1;
+    uint8_t write : 1;
+    uint8_t notify : 1;
+    uint8_t indicate : 1;
+    uint8_t auth_signed_wr : 1;
+} ble_gatt_char_props_t;
+
+typedef struct {
+    uint8_t reliable_wr : 1;
+    uint8_t wr_aux : 1;
+} ble_gatt_char_ext_props_t;
+
+typedef struct {
+    uint16_t uuid;
+    uint8_t uuid_type;
+    uint16_t max_len;
+    uint16_t init_len;
+    uint8_t* p_init_value;
+    bool is_var_len;
+    ble_gatt_char_props_t char_props;
+    ble_gatt_char_ext_props_t char_ext_props;
+    bool is_defered_read;
+    bool is_defered_write;
+    security_req_t read_access;
+    security_req_t write_access;
+    security_req_t cccd_write_access;
+    bool is_value_user;
+    void const* p_user_descr;
+    void const* p_presentation_format;
+} ble_add_char_params_t;
+
+uint32_t characteristic_add(uint16_t service_handle, ble_add_char_params_t* p_char_props,
+                            ble_gatts_char_handles_t* p_char_handle);
+
+typedef enum {
+    BLE_ADVDATA_NO_NAME,
+    BLE_ADVDATA_SHORT_NAME,
+    BLE_ADVDATA_FULL_NAME
+} ble_advdata_name_type_t;
+
+typedef struct {
+    uint16_t uuid_cnt;
+    ble_uuid_t* p_uuids;
+} ble_advdata_uuid_list_t;
+
+typedef struct {
+    uint16_t size;
+    uint8_t* p_data;
+} uint8_array_t;
+
+typedef struct {
+    uint16_t company_identifier;
+    uint8_array_t data;
+} ble_advdata_manuf_data_t;
+
+typedef struct {
+    ble_advdata_name_type_t name_type;
+    uint8_t short_name_len;
+    bool include_appearance;
+    uint8_t flags;
+    ble_advdata_uuid_list_t uuids_more_available;
+    ble_advdata_uuid_list_t uuids_complete;
+    ble_advdata_uuid_list_t uuids_solicited;
+    ble_advdata_manuf_data_t* p_manuf_specific_data;
+} ble_advdata_t;
+
+ret_code_t ble_advdata_encode(ble_advdata_t const* p_advdata, uint8_t* p_encoded_data, uint16_t* p_len);
+
+
+/***************************************
+ * ble_conn_params.h, nrf_ble_gatt.h, nrf_ble_qwr.h
+***************************************/
+typedef struct {
+    ble_gap_conn_params_t* p_conn_params;
+    uint32_t first_conn_params_update_delay;
+    uint32_t next_conn_params_update_delay;
+    uint8_t max_conn_params_update_count;
+    uint16_t start_on_notify_cccd_handle;
+    bool disconnect_on_fail;
+    void* evt_handler;
+    void* error_handler;
+} ble_conn_params_init_t;
+
+typedef struct {
+    uint16_t att_mtu_desired_periph;
+} nrf_ble_gatt_t;
+
+typedef struct {
+    uint16_t conn_handle;
+} nrf_ble_qwr_t;
+
+typedef void (*nrf_ble_qwr_error_handler_t)(uint32_t nrf_error);
+
+typedef struct {
+    nrf_ble_qwr_error_handler_t error_handler;
+} nrf_ble_qwr_init_t;
+
+#define NRF_BLE_GATT_DEF(_name) static nrf_ble_gatt_t _name
+#define NRF_BLE_QWR_DEF(_name) static nrf_ble_qwr_t _name
+
+ret_code_t ble_conn_params_init(ble_conn_params_init_t const* p_init);
+ret_code_t nrf_ble_gatt_init(nrf_ble_gatt_t* p_gatt, void* evt_handler);
+ret_code_t nrf_ble_qwr_init(nrf_ble_qwr_t* p_qwr, nrf_ble_qwr_init_t const* p_qwr_init);
+ret_code_t nrf_ble_qwr_conn_handle_assign(nrf_ble_qwr_t* p_qwr, uint16_t conn_handle);
+
+
+/***************************************
+ * fds.h
+***************************************/
+#define FDS_ERR_NOT_FOUND 0x8607
+#define FDS_ERR_NO_SPACE_IN_FLASH 0x860A
+#define FDS_ERR_NO_SPACE_IN_QUEUES 0x860B
+
+typedef enum {
+    FDS_EVT_INIT,
+    FDS_EVT_WRITE,
+    FDS_EVT_UPDATE,
+    FDS_EVT_DEL_RECORD,
+    FDS_EVT_DEL_FILE,
+    FDS_EVT_GC
+} fds_evt_id_t;
+
+typedef struct {
+    fds_evt_id_t id;
+    ret_code_t result;
+    union {
+        struct {
+            uint32_t record_id;
+            uint16_t file_id;
+            uint16_t record_key;
+            bool is_record_updated;
+        } write;
+    };
+} fds_evt_t;
+
+typedef void (*fds_cb_t)(fds_evt_t const* p_evt);
+
+typedef struct {
+    uint32_t record_id;
+    uint32_t const* p_record;
+    uint16_t gc_run_count;
+    bool record_is_open;
+} fds_record_desc_t;
+
+typedef struct {
+    uint32_t const* p_addr;
+    uint16_t page;
+} fds_find_token_t;
+
+typedef struct {
+    uint16_t record_key;
+    uint16_t length_words;
+    uint16_t file_id;
+    uint16_t crc16;
+    uint32_t record_id;
+} fds_header_t;
+
+typedef struct {
+    fds_header_t const* p_header;
+    void const* p_data;
+} fds_flash_record_t;
+
+typedef struct {
+    uint16_t file_id;
+    uint16_t key;
+    struct {
+        void const* p_data;
+        uint32_t length_words;
+    } data;
+} fds_record_t;
+
+ret_code_t fds_register(fds_cb_t cb);
+ret_code_t fds_init(void);
+ret_code_t fds_gc(void);
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key, fds_record_desc_t* p_desc,
+                           fds_find_token_t* p_token);
+ret_code_t fds_record_open(fds_record_desc_t* p_desc, fds_flash_record_t* p_flash_record);
+ret_code_t fds_record_close(fds_record_desc_t* p_desc);
+ret_code_t fds_record_write(fds_record_desc_t* p_desc, fds_record_t const* p_record);
+ret_code_t fds_record_update(fds_record_desc_t* p_desc, fds_record_t const* p_record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SIM_SDK_H__
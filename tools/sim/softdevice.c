@@ -0,0 +1,1613 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: softdevice.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: SoftDevice and SDK stand-in for the network simulator. One
+ * copy is linked into every loaded firmware instance, so each simulated
+ * device has its own attribute table, link layer timing and registers.
+ *
+ *  Device time only moves between events. Each event (radio notification,
+ *  advertising and connection event phases, RTC2 compare, SoftDevice and
+ *  FDS events, button edges, SAADC conversions) runs its handlers as an
+ *  interrupt would, and
+ *  the host then resumes main() until it sleeps again in nrf_pwr_mgmt_run().
+ *  Registers the firmware reads directly (RTC1/RTC2 COUNTER, the boot
+ *  timer's capture registers) are brought up to date before any firmware
+ *  code runs; register writes are picked up before the next event.
+ *
+ *  The link layer is modelled as a peripheral sees it: advertising events
+ *  on the three primary channels with the random advertising delay, and
+ *  connection events at the connection interval that are skipped under
+ *  slave latency unless a notification is queued. Notifications leave the
+ *  SoftDevice queue in the next attended connection event, as many as fit
+ *  in the event length.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stdio.h>
+#include <string.h>
+#include "sim_sdk.h"
+#include "sim.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Start-up
+#define LFCLK_START_US 250000               // LFXO start-up, typical
+#define FDS_INIT_US 12000                   // FDS page scan
+#define FLASH_WRITE_US 2500                 // One FDS write or garbage collection
+// Radio notification lead (NRF_RADIO_NOTIFICATION_DISTANCE_800US)
+#define RADIO_NOTIFICATION_US 800
+// Advertising: random advDelay, and each PDU is followed by a listen
+// period for SCAN_REQ/CONNECT_IND before the next channel
+#define ADV_DELAY_MAX_US 10000
+#define ADV_FIRST_DELAY_US 3000
+#define ADV_PDU_OVERHEAD 16                 // Preamble, access address, header, AdvA, CRC
+#define ADV_LISTEN_US 400
+// Connections (1 Mbit): first event after CONNECT_IND, packet exchanges
+#define CONN_FIRST_EVENT_US 1250
+#define T_IFS_US 150
+#define EMPTY_PDU_US 80
+#define DATA_PDU_OVERHEAD 17                // Preamble, access address, header, MIC-less CRC, L2CAP, ATT
+#define CONN_EVENT_US (NRF_SDH_BLE_GAP_EVENT_LENGTH * 1250)
+#define CONN_UPDATE_INSTANT_EVENTS 6
+// Nominal CPU time per handled event, for the DWT cycle counter
+#define EVENT_CPU_US 20
+#define CPU_MHZ 64
+// SAADC: supply voltage, noise, and one 16x oversampled burst
+// (16 x (10 us acquisition + 2 us conversion))
+#define SUPPLY_MV 3000
+#define SUPPLY_NOISE_MV 10
+#define SAADC_BURST_US 192
+// Link RSSI and its noise
+#define SIM_RSSI_DBM (-60)
+#define SIM_RSSI_NOISE_DB 6
+#define PPI_CHANNELS 20
+// Interrupts (IRQn) with a priority
+#define IRQ_COUNT 48
+// Die temperature (0.25 degree units): 25 degrees with a slow triangular
+// swing of +-5 degrees, like an enclosure warming up and cooling down
+#define TEMP_BASE 100
+#define TEMP_SWING 20
+#define TEMP_PERIOD_US (20 * 60 * 1000000ULL)
+// Sizes
+#define EVT_QUEUE_SIZE 32
+#define EVT_DATA_MAX 32
+#define ATTR_MAX 128
+#define ATTR_ARENA_SIZE 2048
+#define HVN_QUEUE_MAX 16
+#define PEER_WRITES_MAX 4
+#define FDS_HANDLERS_MAX 2
+#define RTC_COUNTER_MASK 0xFFFFFF
+#define APP_TIMER_FREQ (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+#define CONN_HANDLE 0
+
+typedef enum {
+    EVT_POWER_ON,
+    EVT_WAKE,                               // main sleeping until a time
+    EVT_BLE,
+    EVT_SOC,
+    EVT_FDS,
+    EVT_BUTTON,
+    EVT_BUTTON_EDGE,                        // The pin changes (GPIOTE PORT event)
+    EVT_CONNECT,                            // CONNECT_IND from the host
+    EVT_CONN_PARAMS                         // ble_conn_params update timer
+} evt_type_t;
+
+typedef struct {
+    uint64_t t_us;
+    uint32_t seq;                           // Keeps equal times in order
+    uint8_t type;
+    union {
+        struct {
+            ble_evt_t evt;
+            uint8_t data[EVT_DATA_MAX];     // Write data past ble_gatts_evt_write_t
+        } ble;
+        uint32_t soc_evt;
+        fds_evt_t fds;
+        uint8_t button_action;
+        uint16_t interval;
+    };
+} sd_evt_t;
+
+typedef enum {
+    ATTR_SERVICE,
+    ATTR_DECL,
+    ATTR_VALUE,
+    ATTR_CCCD
+} attr_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t uuid_type;
+    uint16_t uuid;
+    bool notify;
+    bool deferred_write;
+    uint16_t cccd_handle;                   // Value attributes
+    uint16_t len;
+    uint16_t max_len;
+    uint8_t* p_value;
+    uint8_t cccd[2];                        // CCCD attributes
+} attr_t;
+
+typedef struct {
+    uint16_t handle;
+    uint16_t len;
+    uint8_t data[NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3];
+} hvn_t;
+
+typedef struct {
+    uint64_t t_us;
+    uint16_t handle;
+    uint16_t len;
+    uint8_t data[EVT_DATA_MAX];
+} peer_write_t;
+
+typedef enum {
+    RADIO_IDLE,
+    RADIO_ADV,
+    RADIO_CONN
+} radio_mode_t;
+
+typedef enum {
+    PHASE_NOTIFY,                           // Notification lead before the event
+    PHASE_ON,                               // Radio event starts
+    PHASE_OFF                               // Radio event ends
+} radio_phase_t;
+
+// A TIMER in timer mode; task writes take effect at the next refresh
+typedef struct {
+    NRF_TIMER_Type* p_regs;
+    bool running;
+    uint64_t start_us;
+    uint32_t value;
+} timer_model_t;
+
+// Registers
+NRF_RTC_Type sim_rtc1;
+NRF_RTC_Type sim_rtc2;
+NRF_TIMER_Type sim_timer2;
+NRF_TIMER_Type sim_timer3;
+NRF_GPIOTE_Type sim_gpiote;
+NRF_POWER_Type sim_power;
+NRF_SAADC_Type sim_saadc;
+DWT_Type sim_dwt;
+CoreDebug_Type sim_core_debug;
+uint32_t SystemCoreClock = CPU_MHZ * 1000000;
+// .noinit bounds; nothing is lost in System OFF here, the device never wakes
+uint8_t __start_noinit[1];
+uint8_t __stop_noinit[1];
+
+// Host binding
+static sim_host_t const* m_host;
+static void* m_dev;
+static uint32_t m_rand;
+static uint64_t m_now;
+static uint64_t m_seg_us;                   // Time the running code started at
+static bool m_in_event;
+static IRQn_Type m_irq;                     // Interrupt the running event stands for
+static uint8_t m_irq_priority[IRQ_COUNT];
+static bool m_system_off;
+
+// Events
+static sd_evt_t m_evts[EVT_QUEUE_SIZE];
+static uint32_t m_evt_count;
+static uint32_t m_evt_seq;
+
+// RTC2 (timer wheel) and the boot timer
+static bool m_rtc2_running;
+static uint64_t m_rtc2_start_us;
+static uint32_t m_rtc2_freq;
+static uint64_t m_rtc2_ticks;               // Absolute ticks at the last refresh
+static uint64_t m_rtc2_target;              // Absolute tick of the next compare
+static bool m_rtc2_pending;
+static timer_model_t m_timers[] = {{&sim_timer2}, {&sim_timer3}};
+
+// SAADC and the PPI channels the firmware assigned
+static bool m_saadc_armed;                  // Result buffer set up (START)
+static uint64_t m_saadc_end_us = SIM_NEVER; // Burst in progress until then
+static bool m_saadc_pending;
+static const volatile void* m_ppi_eep[PPI_CHANNELS];
+static const volatile void* m_ppi_tep[PPI_CHANNELS];
+static uint32_t m_ppi_enabled;
+
+// RTT up buffer sizes the firmware configured (0: the SDK's default)
+static unsigned m_rtt_up_size[SEGGER_RTT_CONFIG_MAX_NUM_UP_BUFFERS];
+
+// SDK state
+static uint64_t m_lfclk_ready_us;
+static app_button_handler_t m_button_handler;
+static uint8_t m_button_pin;
+static uint32_t m_button_delay_us;
+static bool m_button_pushed;
+static ble_radio_notification_evt_handler_t m_radio_handler;
+static fds_cb_t m_fds_handlers[FDS_HANDLERS_MAX];
+static uint32_t m_fds_handler_count;
+static uint8_t m_fds_record[64];
+static fds_header_t m_fds_header;
+static bool m_fds_record_valid;
+
+// GATT server
+static attr_t m_attrs[ATTR_MAX];            // Index is the handle
+static uint16_t m_attr_count = 1;
+static uint8_t m_attr_arena[ATTR_ARENA_SIZE];
+static uint32_t m_attr_arena_used;
+static uint8_t m_vs_uuid_count;
+static uint8_t m_hvn_queue_size = 1;
+static hvn_t m_hvn[HVN_QUEUE_MAX];
+static uint32_t m_hvn_head;
+static uint32_t m_hvn_count;
+
+// GAP
+static uint16_t m_name_len;
+static ble_gap_conn_params_t m_ppcp;
+static uint32_t m_adv_interval_us;
+static uint16_t m_adv_pdu_us;
+static ble_conn_params_init_t m_conn_params_init;
+
+// Link layer
+static radio_mode_t m_radio_mode;
+static radio_phase_t m_radio_phase;
+static uint64_t m_radio_next_us;
+static uint64_t m_radio_event_us;           // Start of the current or next event
+static bool m_radio_notified;
+static struct {
+    uint16_t interval;                      // 1.25 ms units
+    uint16_t slave_latency;
+    uint16_t sup_timeout;
+    uint32_t skipped;
+    uint32_t sent;                          // Notifications sent in this event
+    uint32_t id;                            // Counts connections, for stale timers
+    bool update_pending;
+    uint64_t update_after_us;
+    ble_gap_conn_params_t update;
+    peer_write_t writes[PEER_WRITES_MAX];
+    uint32_t write_count;
+    bool disconnect_pending;
+    uint64_t disconnect_after_us;
+} m_conn;
+
+
+/****************************************************************
+ * Function: rand_u32()
+ * Description: Per device xorshift generator.
+****************************************************************/
+static uint32_t rand_u32(void) {
+    m_rand ^= m_rand << 13;
+    m_rand ^= m_rand >> 17;
+    m_rand ^= m_rand << 5;
+    return m_rand;
+}
+
+
+/****************************************************************
+ * Function: evt_push()
+ * Description: Queues an event for a time (not before now).
+****************************************************************/
+static sd_evt_t* evt_push(uint64_t t_us, evt_type_t type) {
+    if (m_evt_count >= EVT_QUEUE_SIZE) {
+        m_host->fault(m_dev, "SoftDevice event queue overflow");
+    }
+    sd_evt_t* p_evt = &m_evts[m_evt_count++];
+    memset(p_evt, 0, sizeof(*p_evt));
+    p_evt->t_us = (t_us < m_now) ? m_now : t_us;
+    p_evt->seq = m_evt_seq++;
+    p_evt->type = type;
+    return p_evt;
+}
+
+
+/****************************************************************
+ * Function: evt_first()
+ * Description: Returns the index of the earliest queued event.
+****************************************************************/
+static int32_t evt_first(void) {
+    int32_t first = -1;
+    for (uint32_t i = 0; i < m_evt_count; i++) {
+        if (first < 0 || m_evts[i].t_us < m_evts[first].t_us ||
+            (m_evts[i].t_us == m_evts[first].t_us && m_evts[i].seq < m_evts[first].seq)) {
+            first = i;
+        }
+    }
+    return first;
+}
+
+
+/****************************************************************
+ * Function: ble_evt_push()
+ * Description: Queues a BLE event for the observers.
+****************************************************************/
+static ble_evt_t* ble_evt_push(uint64_t t_us, uint16_t evt_id) {
+    sd_evt_t* p_evt = evt_push(t_us, EVT_BLE);
+    p_evt->ble.evt.header.evt_id = evt_id;
+    p_evt->ble.evt.header.evt_len = sizeof(p_evt->ble);
+    return &p_evt->ble.evt;
+}
+
+
+/****************************************************************
+ * Function: ble_evt_dispatch()
+ * Description: Passes a BLE event to the observers in priority
+ *  order, as nrf_sdh_ble does.
+****************************************************************/
+extern nrf_sdh_ble_evt_observer_t const* const __start_sim_sdh_ble_observers[];
+extern nrf_sdh_ble_evt_observer_t const* const __stop_sim_sdh_ble_observers[];
+extern nrf_sdh_soc_evt_observer_t const* const __start_sim_sdh_soc_observers[];
+extern nrf_sdh_soc_evt_observer_t const* const __stop_sim_sdh_soc_observers[];
+
+static void ble_evt_dispatch(ble_evt_t const* p_evt) {
+    for (uint8_t prio = 0; prio < NRF_SDH_BLE_OBSERVER_PRIO_LEVELS; prio++) {
+        for (nrf_sdh_ble_evt_observer_t const* const* pp = __start_sim_sdh_ble_observers;
+             pp < __stop_sim_sdh_ble_observers; pp++) {
+            if ((*pp)->prio == prio) {
+                (*pp)->handler(p_evt, (*pp)->p_context);
+            }
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: soc_evt_dispatch()
+ * Description: Passes a SoC event to the observers.
+****************************************************************/
+static void soc_evt_dispatch(uint32_t evt_id) {
+    for (uint8_t prio = 0; prio < NRF_SDH_SOC_OBSERVER_PRIO_LEVELS; prio++) {
+        for (nrf_sdh_soc_evt_observer_t const* const* pp = __start_sim_sdh_soc_observers;
+             pp < __stop_sim_sdh_soc_observers; pp++) {
+            if ((*pp)->prio == prio) {
+                (*pp)->handler(evt_id, (*pp)->p_context);
+            }
+        }
+    }
+}
+
+
+/****************************************************************
+ * Function: rtc2_ticks()
+ * Description: Returns the absolute RTC2 tick count at a time.
+****************************************************************/
+static uint64_t rtc2_ticks(uint64_t t_us) {
+    if (!m_rtc2_running) {
+        return m_rtc2_ticks;
+    }
+    return (t_us - m_rtc2_start_us) * m_rtc2_freq / 1000000;
+}
+
+
+/****************************************************************
+ * Function: rtc2_tick_time()
+ * Description: Returns the time an absolute RTC2 tick starts.
+****************************************************************/
+static uint64_t rtc2_tick_time(uint64_t ticks) {
+    return m_rtc2_start_us + (ticks * 1000000 + m_rtc2_freq - 1) / m_rtc2_freq;
+}
+
+
+/****************************************************************
+ * Function: rtc_inten_latch()
+ * Description: Applies INTENSET/INTENCLR (and EVTEN) writes. A bit written to
+ *  both within one run counts as set: a spurious interrupt is
+ *  harmless, a lost one is not.
+****************************************************************/
+static void rtc_inten_latch(NRF_RTC_Type* p_rtc) {
+    p_rtc->INTEN &= ~p_rtc->INTENCLR;
+    p_rtc->INTEN |= p_rtc->INTENSET;
+    p_rtc->INTENSET = 0;
+    p_rtc->INTENCLR = 0;
+    p_rtc->EVTEN &= ~p_rtc->EVTENCLR;
+    p_rtc->EVTEN |= p_rtc->EVTENSET;
+    p_rtc->EVTENSET = 0;
+    p_rtc->EVTENCLR = 0;
+}
+
+
+/****************************************************************
+ * Function: saadc_tasks()
+ * Description: Runs the SAADC tasks written by code or PPI.
+****************************************************************/
+static void saadc_tasks(void) {
+    sim_saadc.INTEN &= ~sim_saadc.INTENCLR;
+    sim_saadc.INTEN |= sim_saadc.INTENSET;
+    sim_saadc.INTENSET = sim_saadc.INTENCLR = 0;
+    if (sim_saadc.TASKS_CALIBRATEOFFSET) {
+        sim_saadc.EVENTS_CALIBRATEDONE = 1;
+        m_saadc_pending |= (sim_saadc.INTEN & SAADC_INTENSET_CALIBRATEDONE_Msk) != 0;
+    }
+    if (sim_saadc.TASKS_START) {
+        sim_saadc.EVENTS_STARTED = 1;
+        m_saadc_armed = true;
+    }
+    if (sim_saadc.TASKS_SAMPLE && m_saadc_armed && m_saadc_end_us == SIM_NEVER && sim_saadc.ENABLE) {
+        m_saadc_end_us = m_now + SAADC_BURST_US;
+    }
+    sim_saadc.TASKS_CALIBRATEOFFSET = sim_saadc.TASKS_START = sim_saadc.TASKS_SAMPLE = 0;
+}
+
+
+/****************************************************************
+ * Function: ppi_fire()
+ * Description: Triggers the tasks connected to an event.
+****************************************************************/
+static void ppi_fire(const volatile void* p_event) {
+    for (uint32_t i = 0; i < PPI_CHANNELS; i++) {
+        if ((m_ppi_enabled & (1UL << i)) && m_ppi_eep[i] == p_event) {
+            *(volatile uint32_t*)m_ppi_tep[i] = 1;
+        }
+    }
+    saadc_tasks();
+}
+
+
+/****************************************************************
+ * Function: regs_refresh()
+ * Description: Applies the task writes of the code that ran at
+ *  m_seg_us, then moves the counters to the current time.
+****************************************************************/
+static void regs_refresh(void) {
+    // RTC2: tasks, then counter and overflow
+    if (sim_rtc2.TASKS_STOP) {
+        m_rtc2_ticks = rtc2_ticks(m_seg_us);
+        m_rtc2_running = false;
+    }
+    if (sim_rtc2.TASKS_CLEAR) {
+        m_rtc2_ticks = 0;
+        m_rtc2_start_us = m_seg_us;
+    }
+    if (sim_rtc2.TASKS_START && !m_rtc2_running) {
+        m_rtc2_freq = 32768 / (sim_rtc2.PRESCALER + 1);
+        m_rtc2_start_us = m_seg_us - m_rtc2_ticks * 1000000 / m_rtc2_freq;
+        m_rtc2_running = true;
+    }
+    sim_rtc2.TASKS_START = sim_rtc2.TASKS_STOP = sim_rtc2.TASKS_CLEAR = 0;
+    rtc_inten_latch(&sim_rtc2);
+    uint64_t ticks = rtc2_ticks(m_now);
+    if ((ticks >> 24) != (m_rtc2_ticks >> 24)) {
+        sim_rtc2.EVENTS_OVRFLW = 1;
+    }
+    if (m_rtc2_target != 0 && m_rtc2_ticks < m_rtc2_target && ticks >= m_rtc2_target) {
+        sim_rtc2.EVENTS_COMPARE[0] = 1;
+    }
+    m_rtc2_ticks = ticks;
+    sim_rtc2.COUNTER = ticks & RTC_COUNTER_MASK;
+
+    // RTC1 (app_timer) runs from power-on
+    sim_rtc1.COUNTER = (uint32_t)(m_now * APP_TIMER_FREQ / 1000000) & RTC_COUNTER_MASK;
+
+    // Button latency and boot timers (1 MHz); captures always read the
+    // current value
+    for (uint32_t t = 0; t < sizeof(m_timers) / sizeof(m_timers[0]); t++) {
+        timer_model_t* p = &m_timers[t];
+        if (p->p_regs->TASKS_STOP && p->running) {
+            p->value += m_seg_us - p->start_us;
+            p->running = false;
+        }
+        if (p->p_regs->TASKS_CLEAR) {
+            p->value = 0;
+            p->start_us = m_seg_us;
+        }
+        if (p->p_regs->TASKS_START && !p->running) {
+            p->start_us = m_seg_us;
+            p->running = true;
+        }
+        p->p_regs->TASKS_START = p->p_regs->TASKS_STOP = p->p_regs->TASKS_CLEAR = 0;
+        uint32_t value = p->value + (p->running ? (uint32_t)(m_now - p->start_us) : 0);
+        for (uint32_t i = 0; i < 6; i++) {
+            p->p_regs->CC[i] = value;
+        }
+    }
+    saadc_tasks();
+    m_seg_us = m_now;
+}
+
+
+/****************************************************************
+ * Function: rtc2_due()
+ * Description: Returns when the RTC2 interrupt fires next.
+****************************************************************/
+static uint64_t rtc2_due(void) {
+    rtc_inten_latch(&sim_rtc2);
+    if (m_rtc2_pending) {
+        return m_now;
+    }
+    if (!m_rtc2_running) {
+        return SIM_NEVER;
+    }
+    uint64_t due = SIM_NEVER;
+    m_rtc2_target = 0;
+    if (sim_rtc2.INTEN & RTC_INTENSET_COMPARE0_Msk) {
+        uint32_t distance = (sim_rtc2.CC[0] - sim_rtc2.COUNTER) & RTC_COUNTER_MASK;
+        m_rtc2_target = m_rtc2_ticks + (distance ? distance : RTC_COUNTER_MASK + 1);
+        due = rtc2_tick_time(m_rtc2_target);
+    }
+    if (sim_rtc2.INTEN & RTC_INTENSET_OVRFLW_Msk) {
+        uint64_t overflow = rtc2_tick_time(((m_rtc2_ticks >> 24) + 1) << 24);
+        due = (overflow < due) ? overflow : due;
+    }
+    return due;
+}
+
+
+/****************************************************************
+ * Function: saadc_due()
+ * Description: Returns when the next SAADC event happens: a
+ *  pending interrupt, the end of a burst or the RTC2 compare 1
+ *  that starts one through PPI.
+****************************************************************/
+static uint64_t saadc_due(void) {
+    if (m_saadc_pending) {
+        return m_now;
+    }
+    uint64_t due = m_saadc_end_us;
+    bool routed = false;
+    for (uint32_t i = 0; i < PPI_CHANNELS; i++) {
+        routed |= (m_ppi_enabled & (1UL << i)) && m_ppi_eep[i] == &sim_rtc2.EVENTS_COMPARE[1];
+    }
+    if (routed && m_rtc2_running && (sim_rtc2.EVTEN & RTC_EVTENSET_COMPARE1_Msk)) {
+        uint32_t distance = (sim_rtc2.CC[1] - sim_rtc2.COUNTER) & RTC_COUNTER_MASK;
+        uint64_t compare = rtc2_tick_time(m_rtc2_ticks + (distance ? distance : RTC_COUNTER_MASK + 1));
+        due = (compare < due) ? compare : due;
+    }
+    return due;
+}
+
+
+/****************************************************************
+ * Function: saadc_run()
+ * Description: Runs the SAADC event due now.
+****************************************************************/
+static void saadc_run(void) {
+    extern void SAADC_IRQHandler(void);
+    if (!m_saadc_pending && m_now >= m_saadc_end_us) {
+        // Burst done: one averaged result, END re-arms through PPI
+        int32_t mv = SUPPLY_MV + (int32_t)(rand_u32() % (2 * SUPPLY_NOISE_MV + 1)) - SUPPLY_NOISE_MV;
+        if (sim_saadc.RESULT.PTR != 0) {
+            *(int16_t*)sim_saadc.RESULT.PTR = (int16_t)(mv * 4096 / 3600);
+        }
+        m_saadc_end_us = SIM_NEVER;
+        m_saadc_armed = false;
+        sim_saadc.EVENTS_END = 1;
+        m_saadc_pending = (sim_saadc.INTEN & SAADC_INTENSET_END_Msk) != 0;
+        ppi_fire(&sim_saadc.EVENTS_END);
+    }
+    else if (!m_saadc_pending) {
+        sim_rtc2.EVENTS_COMPARE[1] = 1;
+        ppi_fire(&sim_rtc2.EVENTS_COMPARE[1]);
+    }
+    if (m_saadc_pending) {
+        m_saadc_pending = false;
+        SAADC_IRQHandler();
+    }
+}
+
+
+/****************************************************************
+ * Function: radio_notify()
+ * Description: Calls the radio notification handler.
+****************************************************************/
+static void radio_notify(bool active) {
+    m_radio_notified = active;
+    if (m_radio_handler != NULL) {
+        m_radio_handler(active);
+    }
+}
+
+
+/****************************************************************
+ * Function: adv_schedule()
+ * Description: Schedules an advertising event.
+****************************************************************/
+static void adv_schedule(uint64_t t_us) {
+    m_radio_event_us = t_us;
+    m_radio_phase = PHASE_NOTIFY;
+    m_radio_next_us = (t_us > m_now + RADIO_NOTIFICATION_US) ? t_us - RADIO_NOTIFICATION_US : m_now;
+}
+
+
+/****************************************************************
+ * Function: conn_schedule()
+ * Description: Schedules the connection event at an anchor.
+****************************************************************/
+static void conn_schedule(uint64_t anchor_us) {
+    uint64_t interval_us = (uint64_t)m_conn.interval * 1250;
+    while (anchor_us < m_now + RADIO_NOTIFICATION_US) {
+        anchor_us += interval_us;
+    }
+    m_radio_event_us = anchor_us;
+    m_radio_phase = PHASE_NOTIFY;
+    m_radio_next_us = anchor_us - RADIO_NOTIFICATION_US;
+}
+
+
+/****************************************************************
+ * Function: exchange_us()
+ * Description: Air time of one notification and its empty
+ *  acknowledgement.
+****************************************************************/
+static uint32_t exchange_us(uint16_t len) {
+    return (DATA_PDU_OVERHEAD + len) * 8 + T_IFS_US + EMPTY_PDU_US + T_IFS_US;
+}
+
+
+/****************************************************************
+ * Function: conn_event_run()
+ * Description: Sends queued notifications at the start of an
+ *  attended connection event. Returns the event duration.
+****************************************************************/
+static uint32_t conn_event_run(void) {
+    uint32_t duration = 2 * EMPTY_PDU_US + T_IFS_US;
+    uint32_t elapsed = 0;
+    m_conn.sent = 0;
+    while (m_hvn_count > 0) {
+        hvn_t const* p_hvn = &m_hvn[m_hvn_head];
+        uint32_t air = exchange_us(p_hvn->len);
+        if (elapsed + air > CONN_EVENT_US) {
+            break;
+        }
+        m_host->notify(m_dev, m_now + elapsed, p_hvn->handle, p_hvn->data, p_hvn->len);
+        elapsed += air;
+        m_hvn_head = (m_hvn_head + 1) % HVN_QUEUE_MAX;
+        m_hvn_count--;
+        m_conn.sent++;
+    }
+    return (elapsed > duration) ? elapsed : duration;
+}
+
+
+/****************************************************************
+ * Function: peer_write_apply()
+ * Description: Applies a write from the central and reports it.
+****************************************************************/
+static void peer_write_apply(peer_write_t const* p_write) {
+    attr_t* p_attr = &m_attrs[p_write->handle];
+    if (p_write->handle == 0 || p_write->handle >= m_attr_count) {
+        return;
+    }
+    ble_evt_t* p_evt;
+    if (p_attr->type == ATTR_VALUE && p_attr->deferred_write) {
+        p_evt = ble_evt_push(m_now, BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST);
+        p_evt->evt.gatts_evt.params.authorize_request.type = BLE_GATTS_AUTHORIZE_TYPE_WRITE;
+        ble_gatts_evt_write_t* p_req = &p_evt->evt.gatts_evt.params.authorize_request.request.write;
+        p_req->handle = p_write->handle;
+        p_req->len = p_write->len;
+        memcpy((uint8_t*)p_req + offsetof(ble_gatts_evt_write_t, data), p_write->data, p_write->len);
+    }
+    else {
+        if (p_attr->type == ATTR_CCCD) {
+            memcpy(p_attr->cccd, p_write->data, 2);
+        }
+        else if (p_attr->type == ATTR_VALUE && p_write->len <= p_attr->max_len) {
+            memcpy(p_attr->p_value, p_write->data, p_write->len);
+            p_attr->len = p_write->len;
+        }
+        p_evt = ble_evt_push(m_now, BLE_GATTS_EVT_WRITE);
+        ble_gatts_evt_write_t* p_req = &p_evt->evt.gatts_evt.params.write;
+        p_req->handle = p_write->handle;
+        p_req->uuid.uuid = p_attr->uuid;
+        p_req->uuid.type = p_attr->uuid_type;
+        p_req->len = p_write->len;
+        memcpy((uint8_t*)p_req + offsetof(ble_gatts_evt_write_t, data), p_write->data, p_write->len);
+    }
+    p_evt->evt.gatts_evt.conn_handle = CONN_HANDLE;
+}
+
+
+/****************************************************************
+ * Function: conn_event_end()
+ * Description: Completes an attended connection event: reports
+ *  sent notifications and applies what the central sent in it.
+ *  Returns false if the connection ended.
+****************************************************************/
+static bool conn_event_end(void) {
+    if (m_conn.sent > 0) {
+        ble_evt_t* p_evt = ble_evt_push(m_now, BLE_GATTS_EVT_HVN_TX_COMPLETE);
+        p_evt->evt.gatts_evt.conn_handle = CONN_HANDLE;
+        p_evt->evt.gatts_evt.params.hvn_tx_complete.count = m_conn.sent;
+    }
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < m_conn.write_count; i++) {
+        if (m_conn.writes[i].t_us <= m_radio_event_us) {
+            peer_write_apply(&m_conn.writes[i]);
+        }
+        else {
+            m_conn.writes[kept++] = m_conn.writes[i];
+        }
+    }
+    m_conn.write_count = kept;
+    if (m_conn.update_pending && m_radio_event_us >= m_conn.update_after_us) {
+        m_conn.update_pending = false;
+        m_conn.interval = m_conn.update.min_conn_interval;
+        m_conn.slave_latency = m_conn.update.slave_latency;
+        m_conn.sup_timeout = m_conn.update.conn_sup_timeout;
+        ble_evt_t* p_evt = ble_evt_push(m_now, BLE_GAP_EVT_CONN_PARAM_UPDATE);
+        p_evt->evt.gap_evt.conn_handle = CONN_HANDLE;
+        ble_gap_conn_params_t* p_params = &p_evt->evt.gap_evt.params.conn_param_update.conn_params;
+        p_params->min_conn_interval = p_params->max_conn_interval = m_conn.interval;
+        p_params->slave_latency = m_conn.slave_latency;
+        p_params->conn_sup_timeout = m_conn.sup_timeout;
+    }
+    if (m_conn.disconnect_pending && m_radio_event_us >= m_conn.disconnect_after_us) {
+        m_conn.disconnect_pending = false;
+        m_radio_mode = RADIO_IDLE;
+        m_hvn_count = 0;
+        m_conn.write_count = 0;
+        m_conn.update_pending = false;
+        ble_evt_t* p_evt = ble_evt_push(m_now, BLE_GAP_EVT_DISCONNECTED);
+        p_evt->evt.gap_evt.conn_handle = CONN_HANDLE;
+        p_evt->evt.gap_evt.params.disconnected.reason = BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION;
+        return false;
+    }
+    return true;
+}
+
+
+/****************************************************************
+ * Function: radio_run()
+ * Description: Advances the advertising or connection event
+ *  state machine by one phase.
+****************************************************************/
+static void radio_run(void) {
+    switch (m_radio_phase) {
+        case PHASE_NOTIFY:
+            if (m_radio_mode == RADIO_CONN && m_hvn_count == 0 &&
+                m_conn.skipped < m_conn.slave_latency) {
+                // Slave latency: nothing to send, sleep through this event
+                m_conn.skipped++;
+                conn_schedule(m_radio_event_us + (uint64_t)m_conn.interval * 1250);
+                return;
+            }
+            radio_notify(true);
+            m_radio_phase = PHASE_ON;
+            m_radio_next_us = m_radio_event_us;
+            break;
+        case PHASE_ON: {
+            uint32_t duration;
+            if (m_radio_mode == RADIO_ADV) {
+                uint32_t spacing = m_adv_pdu_us + ADV_LISTEN_US;
+                for (uint8_t i = 0; i < 3; i++) {
+                    m_host->adv_pdu(m_dev, m_now + i * spacing, SIM_ADV_CHANNEL + i, m_adv_pdu_us);
+                }
+                duration = 3 * spacing;
+            }
+            else {
+                m_conn.skipped = 0;
+                duration = conn_event_run();
+            }
+            m_radio_phase = PHASE_OFF;
+            m_radio_next_us = m_now + duration;
+            break;
+        }
+        case PHASE_OFF:
+            radio_notify(false);
+            if (m_radio_mode == RADIO_ADV) {
+                adv_schedule(m_radio_event_us + m_adv_interval_us + rand_u32() % (ADV_DELAY_MAX_US + 1));
+            }
+            else if (conn_event_end()) {
+                conn_schedule(m_radio_event_us + (uint64_t)m_conn.interval * 1250);
+            }
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: connect_run()
+ * Description: Ends advertising and opens the connection the
+ *  central requested.
+****************************************************************/
+static void connect_run(uint16_t interval) {
+    if (m_radio_mode != RADIO_ADV) {
+        return;
+    }
+    if (m_radio_notified) {
+        radio_notify(false);
+    }
+    m_radio_mode = RADIO_CONN;
+    m_conn.interval = interval;
+    m_conn.slave_latency = 0;
+    m_conn.sup_timeout = MSEC_TO_UNITS(4000, UNIT_10_MS);
+    m_conn.skipped = 0;
+    m_conn.id++;
+    m_hvn_head = m_hvn_count = 0;
+    for (uint16_t h = 1; h < m_attr_count; h++) {
+        memset(m_attrs[h].cccd, 0, 2);
+    }
+    conn_schedule(m_now + CONN_FIRST_EVENT_US);
+
+    ble_evt_t* p_evt = ble_evt_push(m_now, BLE_GAP_EVT_CONNECTED);
+    p_evt->evt.gap_evt.conn_handle = CONN_HANDLE;
+    ble_gap_conn_params_t* p_params = &p_evt->evt.gap_evt.params.connected.conn_params;
+    p_params->min_conn_interval = p_params->max_conn_interval = m_conn.interval;
+    p_params->slave_latency = m_conn.slave_latency;
+    p_params->conn_sup_timeout = m_conn.sup_timeout;
+
+    // ble_conn_params: ask for the preferred parameters if the central's differ
+    if (m_conn_params_init.max_conn_params_update_count > 0 &&
+        (m_conn.interval < m_ppcp.min_conn_interval || m_conn.interval > m_ppcp.max_conn_interval ||
+         m_conn.slave_latency != m_ppcp.slave_latency)) {
+        uint64_t delay_us = (uint64_t)m_conn_params_init.first_conn_params_update_delay * 1000000 / APP_TIMER_FREQ;
+        sd_evt_t* p_timer = evt_push(m_now + delay_us, EVT_CONN_PARAMS);
+        p_timer->interval = (uint16_t)m_conn.id;
+    }
+}
+
+
+/****************************************************************
+ * Function: event_run()
+ * Description: Handles one queued event.
+****************************************************************/
+static void event_run(sd_evt_t const* p_evt) {
+    switch (p_evt->type) {
+        case EVT_BLE:
+            ble_evt_dispatch(&p_evt->ble.evt);
+            break;
+        case EVT_SOC:
+            soc_evt_dispatch(p_evt->soc_evt);
+            break;
+        case EVT_FDS:
+            for (uint32_t i = 0; i < m_fds_handler_count; i++) {
+                m_fds_handlers[i](&p_evt->fds);
+            }
+            break;
+        case EVT_BUTTON_EDGE:
+            ppi_fire(&sim_gpiote.EVENTS_PORT);
+            break;
+        case EVT_BUTTON:
+            m_button_pushed = p_evt->button_action == APP_BUTTON_PUSH;
+            if (m_button_handler != NULL) {
+                m_button_handler(m_button_pin, p_evt->button_action);
+            }
+            break;
+        case EVT_CONNECT:
+            connect_run(p_evt->interval);
+            break;
+        case EVT_CONN_PARAMS:
+            // The central accepts; the new parameters apply at the instant
+            if (m_radio_mode == RADIO_CONN && p_evt->interval == (uint16_t)m_conn.id) {
+                m_conn.update = m_ppcp;
+                m_conn.update_pending = true;
+                m_conn.update_after_us = m_now + (uint64_t)CONN_UPDATE_INSTANT_EVENTS * m_conn.interval * 1250;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+
+/****************************************************************
+ * Function: sim_next_event()
+ * Description: Returns the time of the next device event.
+****************************************************************/
+static uint64_t sim_next_event(void) {
+    if (m_system_off) {
+        return SIM_NEVER;
+    }
+    uint64_t next = rtc2_due();
+    uint64_t saadc = saadc_due();
+    next = (saadc < next) ? saadc : next;
+    int32_t first = evt_first();
+    if (first >= 0 && m_evts[first].t_us < next) {
+        next = m_evts[first].t_us;
+    }
+    if (m_radio_mode != RADIO_IDLE && m_radio_next_us < next) {
+        next = m_radio_next_us;
+    }
+    return next;
+}
+
+
+/****************************************************************
+ * Function: sim_run_event()
+ * Description: Runs the next device event in interrupt context.
+****************************************************************/
+static void sim_run_event(void) {
+    extern void RTC2_IRQHandler(void);
+    uint64_t rtc2 = rtc2_due();
+    uint64_t saadc = saadc_due();
+    int32_t first = evt_first();
+    uint64_t queued = (first >= 0) ? m_evts[first].t_us : SIM_NEVER;
+    uint64_t radio = (m_radio_mode != RADIO_IDLE) ? m_radio_next_us : SIM_NEVER;
+
+    m_in_event = true;
+    if (saadc < radio && saadc < rtc2 && saadc < queued) {
+        m_irq = SAADC_IRQn;
+        m_now = saadc;
+        regs_refresh();
+        saadc_run();
+    }
+    else if (radio <= rtc2 && radio <= queued) {
+        m_irq = SWI1_EGU1_IRQn;
+        m_now = radio;
+        regs_refresh();
+        radio_run();
+    }
+    else if (rtc2 <= queued) {
+        m_irq = RTC2_IRQn;
+        m_now = rtc2;
+        regs_refresh();
+        m_rtc2_pending = false;
+        RTC2_IRQHandler();
+    }
+    else {
+        sd_evt_t evt = m_evts[first];
+        m_evts[first] = m_evts[--m_evt_count];
+        // app_button reports from the app_timer interrupt
+        m_irq = (evt.type == EVT_BUTTON) ? RTC1_IRQn : (evt.type == EVT_BUTTON_EDGE) ? GPIOTE_IRQn
+                                                                                   : SWI2_EGU2_IRQn;
+        m_now = evt.t_us;
+        regs_refresh();
+        event_run(&evt);
+    }
+    sim_dwt.CYCCNT += EVENT_CPU_US * CPU_MHZ;
+    m_in_event = false;
+}
+
+
+/****************************************************************
+ * Function: sim_init()
+ * Description: Binds the device to the host.
+****************************************************************/
+static void sim_init(sim_host_t const* p_host, void* p_dev, uint64_t power_on_us, uint32_t seed) {
+    m_host = p_host;
+    m_dev = p_dev;
+    m_rand = seed ? seed : 1;
+    m_now = m_seg_us = power_on_us;
+    sim_power.RESETREAS = 0;
+    // Interrupts the SDK sets up itself
+    m_irq_priority[RTC1_IRQn] = APP_IRQ_PRIORITY_LOW;
+    m_irq_priority[SWI2_EGU2_IRQn] = APP_IRQ_PRIORITY_LOWEST;
+    evt_push(power_on_us, EVT_POWER_ON);
+}
+
+
+/****************************************************************
+ * Function: sim_connect()
+ * Description: A CONNECT_IND for this device ended on air.
+****************************************************************/
+static void sim_connect(uint64_t t_us, uint16_t interval) {
+    evt_push(t_us, EVT_CONNECT)->interval = interval;
+}
+
+
+/****************************************************************
+ * Function: sim_disconnect()
+ * Description: The central terminates the connection.
+****************************************************************/
+static void sim_disconnect(uint64_t t_us) {
+    m_conn.disconnect_pending = true;
+    m_conn.disconnect_after_us = t_us;
+}
+
+
+/****************************************************************
+ * Function: sim_write()
+ * Description: The central writes an attribute.
+****************************************************************/
+static void sim_write(uint64_t t_us, uint16_t handle, uint8_t const* p_data, uint16_t len) {
+    if (m_conn.write_count >= PEER_WRITES_MAX || len > EVT_DATA_MAX) {
+        return;
+    }
+    peer_write_t* p_write = &m_conn.writes[m_conn.write_count++];
+    p_write->t_us = t_us;
+    p_write->handle = handle;
+    p_write->len = len;
+    memcpy(p_write->data, p_data, len);
+}
+
+
+/****************************************************************
+ * Function: sim_cccd_find()
+ * Description: Finds a notifying characteristic by 16-bit UUID.
+****************************************************************/
+static uint16_t sim_cccd_find(uint16_t uuid, uint16_t* p_value_handle) {
+    for (uint16_t h = 1; h < m_attr_count; h++) {
+        if (m_attrs[h].type == ATTR_VALUE && m_attrs[h].uuid == uuid && m_attrs[h].notify) {
+            *p_value_handle = h;
+            return m_attrs[h].cccd_handle;
+        }
+    }
+    return BLE_GATT_HANDLE_INVALID;
+}
+
+
+/****************************************************************
+ * Function: sim_button()
+ * Description: Presses and releases the button; app_button
+ *  reports each edge after its detection delay.
+****************************************************************/
+static void sim_button(uint64_t t_us, uint32_t hold_us) {
+    // A button wake from System OFF is a reset, which is not modelled
+    if (m_system_off) {
+        return;
+    }
+    evt_push(t_us, EVT_BUTTON_EDGE);
+    evt_push(t_us + hold_us, EVT_BUTTON_EDGE);
+    evt_push(t_us + m_button_delay_us, EVT_BUTTON)->button_action = APP_BUTTON_PUSH;
+    evt_push(t_us + hold_us + m_button_delay_us, EVT_BUTTON)->button_action = APP_BUTTON_RELEASE;
+}
+
+extern int sim_fw_main(void);
+
+__attribute__((visibility("default"))) sim_fw_t const sim_fw = {
+    .init = sim_init,
+    .main = sim_fw_main,
+    .next_event = sim_next_event,
+    .run_event = sim_run_event,
+    .connect = sim_connect,
+    .disconnect = sim_disconnect,
+    .write = sim_write,
+    .cccd_find = sim_cccd_find,
+    .button = sim_button
+};
+
+
+/****************************************************************
+ * Function: sleep_until()
+ * Description: Lets the main loop sleep until a time.
+****************************************************************/
+static void sleep_until(uint64_t t_us) {
+    if (t_us <= m_now) {
+        return;
+    }
+    evt_push(t_us, EVT_WAKE);
+    while (m_now < t_us) {
+        nrf_pwr_mgmt_run();
+    }
+}
+
+
+/***************************************
+ * MDK and platform
+***************************************/
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority) {
+    if (irq >= 0 && irq < IRQ_COUNT) {
+        m_irq_priority[irq] = (uint8_t)priority;
+    }
+}
+
+uint32_t NVIC_GetPriority(IRQn_Type irq) {
+    return (irq >= 0 && irq < IRQ_COUNT) ? m_irq_priority[irq] : 0;
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq) {}
+void NVIC_DisableIRQ(IRQn_Type irq) {}
+
+void NVIC_ClearPendingIRQ(IRQn_Type irq) {
+    if (irq == RTC2_IRQn) {
+        m_rtc2_pending = false;
+    }
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type irq) {
+    if (irq == RTC2_IRQn) {
+        m_rtc2_pending = true;
+    }
+}
+
+void NVIC_SystemReset(void) {
+    m_host->fault(m_dev, "NVIC_SystemReset");
+}
+
+uint32_t __get_IPSR(void) {
+    return m_in_event ? 16 + (uint32_t)m_irq : 0;
+}
+
+ret_code_t nrf_pwr_mgmt_init(void) {
+    return NRF_SUCCESS;
+}
+
+void nrf_pwr_mgmt_run(void) {
+    if (m_in_event) {
+        m_host->fault(m_dev, "nrf_pwr_mgmt_run() from interrupt context");
+    }
+    m_host->yield(m_dev);
+    regs_refresh();
+}
+
+ret_code_t nrf_drv_clock_init(void) {
+    return NRF_SUCCESS;
+}
+
+void nrf_drv_clock_lfclk_request(nrf_drv_clock_handler_item_t* p_handler_item) {
+    if (m_lfclk_ready_us == 0) {
+        m_lfclk_ready_us = m_now + LFCLK_START_US;
+    }
+}
+
+void bsp_board_init(uint32_t init_flags) {}
+void bsp_board_led_on(uint32_t led_idx) {}
+void bsp_board_led_off(uint32_t led_idx) {}
+void bsp_board_leds_off(void) {}
+
+uint32_t bsp_board_button_idx_to_pin(uint32_t button_idx) {
+    return m_button_pin;
+}
+
+void nrf_gpio_cfg_sense_input(uint32_t pin_number, uint32_t pull_config, uint32_t sense_config) {}
+
+ret_code_t app_button_init(app_button_cfg_t const* p_buttons, uint8_t button_count, uint32_t detection_delay) {
+    m_button_handler = p_buttons[0].button_handler;
+    m_button_pin = p_buttons[0].pin_no;
+    m_button_delay_us = (uint32_t)((uint64_t)detection_delay * 1000000 / APP_TIMER_FREQ);
+    return NRF_SUCCESS;
+}
+
+ret_code_t app_button_enable(void) {
+    return NRF_SUCCESS;
+}
+
+bool app_button_is_pushed(uint8_t button_id) {
+    return m_button_pushed;
+}
+
+ret_code_t app_timer_init(void) {
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(void) {
+    return sim_rtc1.COUNTER;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from) {
+    return (ticks_to - ticks_from) & RTC_COUNTER_MASK;
+}
+
+uint16_t crc16_compute(uint8_t const* p_data, uint32_t size, uint16_t const* p_crc) {
+    uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+    for (uint32_t i = 0; i < size; i++) {
+        crc = (uint8_t)(crc >> 8) | (crc << 8);
+        crc ^= p_data[i];
+        crc ^= (uint8_t)(crc & 0xFF) >> 4;
+        crc ^= (crc << 8) << 4;
+        crc ^= ((crc & 0xFF) << 4) << 1;
+    }
+    return crc;
+}
+
+// The host reads every write straight away, so an up buffer always has
+// its whole size free (less the byte that tells full from empty). Skip
+// mode drops a write that does not fit, as on the target
+unsigned SEGGER_RTT_GetAvailWriteSpace(unsigned BufferIndex) {
+    return (BufferIndex < SEGGER_RTT_CONFIG_MAX_NUM_UP_BUFFERS && m_rtt_up_size[BufferIndex] > 0) ?
+           m_rtt_up_size[BufferIndex] - 1 : SEGGER_RTT_CONFIG_BUFFER_SIZE_UP - 1;
+}
+
+unsigned SEGGER_RTT_Write(unsigned BufferIndex, const void* pBuffer, unsigned NumBytes) {
+    if (NumBytes > SEGGER_RTT_GetAvailWriteSpace(BufferIndex)) {
+        return 0;
+    }
+    m_host->rtt(m_dev, BufferIndex, pBuffer, NumBytes);
+    return NumBytes;
+}
+
+unsigned SEGGER_RTT_Read(unsigned BufferIndex, void* pBuffer, unsigned BufferSize) {
+    return 0;
+}
+
+int SEGGER_RTT_ConfigUpBuffer(unsigned BufferIndex, const char* sName, void* pBuffer,
+                              unsigned BufferSize, unsigned Flags) {
+    if (BufferIndex >= SEGGER_RTT_CONFIG_MAX_NUM_UP_BUFFERS) {
+        return -1;
+    }
+    m_rtt_up_size[BufferIndex] = BufferSize;
+    return 0;
+}
+
+
+/***************************************
+ * SoftDevice handler
+***************************************/
+ret_code_t nrf_sdh_enable_request(void) {
+    // sd_softdevice_enable() waits for the LFCLK
+    nrf_drv_clock_lfclk_request(NULL);
+    sleep_until(m_lfclk_ready_us);
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_sdh_ble_default_cfg_set(uint8_t conn_cfg_tag, uint32_t* p_ram_start) {
+    *p_ram_start = 0x20002b70;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_sdh_ble_enable(uint32_t* p_app_ram_start) {
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_power_ram_power_set(uint8_t index, uint32_t ram_powerset) {
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ppi_channel_assign(uint8_t channel_num, const volatile void* evt_endpoint,
+                               const volatile void* task_endpoint) {
+    if (channel_num >= PPI_CHANNELS) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_ppi_eep[channel_num] = evt_endpoint;
+    m_ppi_tep[channel_num] = task_endpoint;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ppi_channel_enable_set(uint32_t channel_enable_set_msk) {
+    m_ppi_enabled |= channel_enable_set_msk;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_temp_get(int32_t* p_temp) {
+    uint32_t phase = (uint32_t)((m_now % TEMP_PERIOD_US) * 4 * TEMP_SWING / TEMP_PERIOD_US);
+    *p_temp = TEMP_BASE + ((phase < 2 * TEMP_SWING) ? (int32_t)phase - TEMP_SWING
+                                                    : 3 * TEMP_SWING - (int32_t)phase);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_power_system_off(void) {
+    // Everything stops; the main loop never runs again
+    if (m_radio_notified) {
+        radio_notify(false);
+    }
+    m_radio_mode = RADIO_IDLE;
+    m_evt_count = 0;
+    m_ppi_enabled = 0;
+    m_saadc_pending = false;
+    m_system_off = true;
+    for (;;) {
+        m_host->yield(m_dev);
+    }
+}
+
+uint32_t ble_radio_notification_init(uint32_t irq_priority, uint8_t distance,
+                                     ble_radio_notification_evt_handler_t evt_handler) {
+    m_radio_handler = evt_handler;
+    m_irq_priority[SWI1_EGU1_IRQn] = (uint8_t)irq_priority;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_cfg_set(uint32_t cfg_id, ble_cfg_t const* p_cfg, uint32_t app_ram_base) {
+    if (cfg_id == BLE_CONN_CFG_GATTS) {
+        uint8_t size = p_cfg->conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size;
+        m_hvn_queue_size = (size > HVN_QUEUE_MAX) ? HVN_QUEUE_MAX : size;
+    }
+    return NRF_SUCCESS;
+}
+
+
+/***************************************
+ * GAP
+***************************************/
+uint32_t sd_ble_gap_device_name_set(ble_gap_conn_sec_mode_t const* p_write_perm,
+                                    uint8_t const* p_dev_name, uint16_t len) {
+    m_name_len = len;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_ppcp_set(ble_gap_conn_params_t const* p_conn_params) {
+    m_ppcp = *p_conn_params;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_set_configure(uint8_t* p_adv_handle, ble_gap_adv_data_t const* p_adv_data,
+                                      ble_gap_adv_params_t const* p_adv_params) {
+    // Data alone can be replaced while advertising
+    if (p_adv_params == NULL) {
+        m_adv_pdu_us = (ADV_PDU_OVERHEAD + p_adv_data->adv_data.len) * 8;
+        return NRF_SUCCESS;
+    }
+    if (m_radio_mode == RADIO_ADV) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    *p_adv_handle = 0;
+    m_adv_interval_us = p_adv_params->interval * UNIT_0_625_MS;
+    m_adv_pdu_us = (ADV_PDU_OVERHEAD + p_adv_data->adv_data.len) * 8;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_start(uint8_t adv_handle, uint8_t conn_cfg_tag) {
+    if (m_radio_mode != RADIO_IDLE || m_adv_interval_us == 0) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    m_radio_mode = RADIO_ADV;
+    adv_schedule(m_now + ADV_FIRST_DELAY_US + rand_u32() % (ADV_DELAY_MAX_US + 1));
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_adv_stop(uint8_t adv_handle) {
+    if (m_radio_mode != RADIO_ADV) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (m_radio_notified) {
+        radio_notify(false);
+    }
+    m_radio_mode = RADIO_IDLE;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_rssi_start(uint16_t conn_handle, uint8_t threshold_dbm, uint8_t skip_count) {
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_rssi_get(uint16_t conn_handle, int8_t* p_rssi, uint8_t* p_ch_index) {
+    if (m_radio_mode != RADIO_CONN || conn_handle != CONN_HANDLE) {
+        return 0x3002;                      // BLE_ERROR_INVALID_CONN_HANDLE
+    }
+    *p_rssi = (int8_t)(SIM_RSSI_DBM + (int32_t)(rand_u32() % (2 * SIM_RSSI_NOISE_DB + 1)) - SIM_RSSI_NOISE_DB);
+    *p_ch_index = (uint8_t)(rand_u32() % 37);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_qos_channel_survey_start(uint32_t interval_us) {
+    return NRF_SUCCESS;
+}
+
+ret_code_t ble_conn_params_init(ble_conn_params_init_t const* p_init) {
+    m_conn_params_init = *p_init;
+    return NRF_SUCCESS;
+}
+
+ret_code_t ble_advdata_encode(ble_advdata_t const* p_advdata, uint8_t* p_encoded_data, uint16_t* p_len) {
+    uint16_t len = 0;
+    if (p_advdata->flags) {
+        len += 3;
+    }
+    if (p_advdata->name_type == BLE_ADVDATA_FULL_NAME) {
+        len += 2 + m_name_len;
+    }
+    if (p_advdata->include_appearance) {
+        len += 4;
+    }
+    for (uint16_t i = 0; i < p_advdata->uuids_complete.uuid_cnt; i++) {
+        len += (p_advdata->uuids_complete.p_uuids[i].type >= BLE_UUID_TYPE_VENDOR_BEGIN) ? 16 : 2;
+    }
+    if (p_advdata->uuids_complete.uuid_cnt > 0) {
+        len += 2;
+    }
+    if (p_advdata->p_manuf_specific_data != NULL) {
+        len += 4 + p_advdata->p_manuf_specific_data->data.size;
+    }
+    if (len > *p_len) {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    memset(p_encoded_data, 0, len);
+    *p_len = len;
+    return NRF_SUCCESS;
+}
+
+
+/***************************************
+ * GATT server
+***************************************/
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const* p_vs_uuid, uint8_t* p_uuid_type) {
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN + m_vs_uuid_count++;
+    return NRF_SUCCESS;
+}
+
+/****************************************************************
+ * Function: attr_add()
+ * Description: Adds an attribute and returns its handle.
+****************************************************************/
+static uint16_t attr_add(attr_type_t type, uint16_t uuid, uint8_t uuid_type) {
+    if (m_attr_count >= ATTR_MAX) {
+        m_host->fault(m_dev, "attribute table full");
+    }
+    attr_t* p_attr = &m_attrs[m_attr_count];
+    memset(p_attr, 0, sizeof(*p_attr));
+    p_attr->type = type;
+    p_attr->uuid = uuid;
+    p_attr->uuid_type = uuid_type;
+    return m_attr_count++;
+}
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const* p_uuid, uint16_t* p_handle) {
+    *p_handle = attr_add(ATTR_SERVICE, p_uuid->uuid, p_uuid->type);
+    return NRF_SUCCESS;
+}
+
+uint32_t characteristic_add(uint16_t service_handle, ble_add_char_params_t* p_char_props,
+                            ble_gatts_char_handles_t* p_char_handle) {
+    memset(p_char_handle, 0, sizeof(*p_char_handle));
+    attr_add(ATTR_DECL, p_char_props->uuid, p_char_props->uuid_type);
+    uint16_t handle = attr_add(ATTR_VALUE, p_char_props->uuid, p_char_props->uuid_type);
+    attr_t* p_attr = &m_attrs[handle];
+    p_attr->notify = p_char_props->char_props.notify;
+    p_attr->deferred_write = p_char_props->is_defered_write;
+    p_attr->max_len = p_char_props->max_len;
+    p_attr->len = p_char_props->init_len;
+    if (p_char_props->is_value_user) {
+        p_attr->p_value = p_char_props->p_init_value;
+    }
+    else {
+        if (m_attr_arena_used + p_attr->max_len > ATTR_ARENA_SIZE) {
+            m_host->fault(m_dev, "attribute value space full");
+        }
+        p_attr->p_value = &m_attr_arena[m_attr_arena_used];
+        m_attr_arena_used += (p_attr->max_len + 3) & ~3U;
+        if (p_char_props->p_init_value != NULL) {
+            memcpy(p_attr->p_value, p_char_props->p_init_value, p_char_props->init_len);
+        }
+    }
+    p_char_handle->value_handle = handle;
+    if (p_char_props->char_props.notify || p_char_props->char_props.indicate) {
+        p_attr->cccd_handle = attr_add(ATTR_CCCD, 0x2902, BLE_UUID_TYPE_BLE);
+        p_char_handle->cccd_handle = p_attr->cccd_handle;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t* p_value) {
+    if (handle == 0 || handle >= m_attr_count || m_attrs[handle].type != ATTR_VALUE) {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    attr_t* p_attr = &m_attrs[handle];
+    if (p_value->offset + p_value->len > p_attr->max_len) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (p_value->p_value != NULL) {
+        memmove(p_attr->p_value + p_value->offset, p_value->p_value, p_value->len);
+    }
+    p_attr->len = p_value->offset + p_value->len;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const* p_hvx_params) {
+    uint16_t handle = p_hvx_params->handle;
+    if (m_radio_mode != RADIO_CONN || conn_handle != CONN_HANDLE) {
+        return 0x3002;                      // BLE_ERROR_INVALID_CONN_HANDLE
+    }
+    if (handle == 0 || handle >= m_attr_count || !m_attrs[handle].notify) {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    attr_t* p_attr = &m_attrs[handle];
+    if (!(m_attrs[p_attr->cccd_handle].cccd[0] & 0x01)) {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (m_hvn_count >= m_hvn_queue_size) {
+        return NRF_ERROR_RESOURCES;
+    }
+    uint16_t len = (p_hvx_params->p_len != NULL) ? *p_hvx_params->p_len : p_attr->len;
+    if (len > NRF_SDH_BLE_GATT_MAX_MTU_SIZE - 3) {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    hvn_t* p_hvn = &m_hvn[(m_hvn_head + m_hvn_count) % HVN_QUEUE_MAX];
+    p_hvn->handle = handle;
+    p_hvn->len = len;
+    // Notifying with data also updates the attribute value
+    if (p_hvx_params->p_data != NULL) {
+        memcpy(p_hvn->data, p_hvx_params->p_data, len);
+        sd_ble_gatts_value_set(conn_handle, handle, &(ble_gatts_value_t){.len = len, .p_value = p_hvn->data});
+    }
+    else {
+        memcpy(p_hvn->data, p_attr->p_value, len);
+    }
+    m_hvn_count++;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_rw_authorize_reply(uint16_t conn_handle,
+                                         ble_gatts_rw_authorize_reply_params_t const* p_rw_authorize_reply_params) {
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_ble_gatt_init(nrf_ble_gatt_t* p_gatt, void* evt_handler) {
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_ble_qwr_init(nrf_ble_qwr_t* p_qwr, nrf_ble_qwr_init_t const* p_qwr_init) {
+    p_qwr->conn_handle = BLE_CONN_HANDLE_INVALID;
+    return NRF_SUCCESS;
+}
+
+ret_code_t nrf_ble_qwr_conn_handle_assign(nrf_ble_qwr_t* p_qwr, uint16_t conn_handle) {
+    p_qwr->conn_handle = conn_handle;
+    return NRF_SUCCESS;
+}
+
+
+/***************************************
+ * L2CAP (no channels are opened by the central)
+***************************************/
+uint32_t sd_ble_l2cap_ch_setup(uint16_t conn_handle, uint16_t* p_local_cid,
+                               ble_l2cap_ch_setup_params_t const* p_params) {
+    return NRF_ERROR_INVALID_STATE;
+}
+
+uint32_t sd_ble_l2cap_ch_rx(uint16_t conn_handle, uint16_t local_cid, ble_data_t const* p_sdu_buf) {
+    return NRF_ERROR_INVALID_STATE;
+}
+
+uint32_t sd_ble_l2cap_ch_tx(uint16_t conn_handle, uint16_t local_cid, ble_data_t const* p_sdu_buf) {
+    return NRF_ERROR_INVALID_STATE;
+}
+
+uint32_t sd_ble_l2cap_ch_flow_control(uint16_t conn_handle, uint16_t local_cid, uint16_t credits,
+                                      uint16_t* p_credits) {
+    return NRF_ERROR_INVALID_STATE;
+}
+
+
+/***************************************
+ * FDS (one record, kept in RAM)
+***************************************/
+/****************************************************************
+ * Function: fds_evt_push()
+ * Description: Queues an FDS event and, for flash operations,
+ *  the SoC event the SoftDevice reports with it.
+****************************************************************/
+static void fds_evt_push(uint64_t t_us, fds_evt_id_t id, uint16_t file_id) {
+    sd_evt_t* p_evt = evt_push(t_us, EVT_FDS);
+    p_evt->fds.id = id;
+    p_evt->fds.result = NRF_SUCCESS;
+    p_evt->fds.write.file_id = file_id;
+    if (id != FDS_EVT_INIT) {
+        evt_push(t_us, EVT_SOC)->soc_evt = NRF_EVT_FLASH_OPERATION_SUCCESS;
+    }
+}
+
+ret_code_t fds_register(fds_cb_t cb) {
+    if (m_fds_handler_count >= FDS_HANDLERS_MAX) {
+        return NRF_ERROR_NO_MEM;
+    }
+    m_fds_handlers[m_fds_handler_count++] = cb;
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_init(void) {
+    fds_evt_push(m_now + FDS_INIT_US, FDS_EVT_INIT, 0);
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_gc(void) {
+    fds_evt_push(m_now + FLASH_WRITE_US, FDS_EVT_GC, 0);
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key, fds_record_desc_t* p_desc,
+                           fds_find_token_t* p_token) {
+    if (!m_fds_record_valid || m_fds_header.file_id != file_id || m_fds_header.record_key != record_key) {
+        return FDS_ERR_NOT_FOUND;
+    }
+    p_desc->record_id = m_fds_header.record_id;
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_open(fds_record_desc_t* p_desc, fds_flash_record_t* p_flash_record) {
+    p_flash_record->p_header = &m_fds_header;
+    p_flash_record->p_data = m_fds_record;
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_close(fds_record_desc_t* p_desc) {
+    return NRF_SUCCESS;
+}
+
+/****************************************************************
+ * Function: fds_record_store()
+ * Description: Replaces the record, completed by the given event.
+****************************************************************/
+static ret_code_t fds_record_store(fds_record_desc_t* p_desc, fds_record_t const* p_record, fds_evt_id_t id) {
+    uint32_t len = p_record->data.length_words * 4;
+    if (len > sizeof(m_fds_record)) {
+        return FDS_ERR_NO_SPACE_IN_FLASH;
+    }
+    memcpy(m_fds_record, p_record->data.p_data, len);
+    m_fds_header.file_id = p_record->file_id;
+    m_fds_header.record_key = p_record->key;
+    m_fds_header.length_words = p_record->data.length_words;
+    m_fds_header.record_id++;
+    m_fds_record_valid = true;
+    if (p_desc != NULL) {
+        p_desc->record_id = m_fds_header.record_id;
+    }
+    fds_evt_push(m_now + FLASH_WRITE_US, id, p_record->file_id);
+    return NRF_SUCCESS;
+}
+
+ret_code_t fds_record_write(fds_record_desc_t* p_desc, fds_record_t const* p_record) {
+    return fds_record_store(p_desc, p_record, FDS_EVT_WRITE);
+}
+
+ret_code_t fds_record_update(fds_record_desc_t* p_desc, fds_record_t const* p_record) {
+    return fds_record_store(p_desc, p_record, FDS_EVT_UPDATE);
+}
@@ -0,0 +1,302 @@
+#!/usr/bin/env python3
+"""*****************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: trace_export.py
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Trace viewer export. Converts trace_ring records into the
+ * Chrome trace event format (JSON), which chrome://tracing and
+ * ui.perfetto.dev open directly, with one track per interrupt priority and
+ * tracks for the main loop, the radio, flash operations, SoftDevice events
+ * and application events. A summary of handler run times goes to stderr.
+ *
+ *  Input is either the binary record stream of a timing build
+ *  (TRACE_RING_TIMING, RTT channel 1, e.g. saved with JLinkRTTLogger or
+ *  the simulator's -r option) or the text dump of RTT channel 0. Records
+ *  carry 24 bits of RTC1 ticks (APP_TIMER_CONFIG_RTC_FREQUENCY, 16384 Hz),
+ *  unwrapped here; handler slices start at their enter record and last the
+ *  DWT cycles of their exit record, so durations are exact while start
+ *  times have one tick of resolution. Slices on the same track are kept
+ *  from overlapping. Job addresses are named from the firmware ELF file
+ *  (--elf) with nm.
+*****************************************************************************"""
+
+import argparse
+import bisect
+import json
+import re
+import struct
+import subprocess
+import sys
+
+# Record types (trace_type_t)
+TYPES = ("?", "boot", "ble", "soc", "job", "rpc", "button", "error", "err_pc",
+         "err_info", "boot_us", "sys_off", "enter", "exit", "radio", "flash", "lost")
+(BOOT, BLE_EVT, SOC_EVT, JOB, RPC, BUTTON, ERROR, ERROR_PC, ERROR_INFO, BOOT_TIME,
+ SYSTEM_OFF, ENTER, EXIT, RADIO, FLASH, LOST) = range(1, len(TYPES))
+RECORD_FORMAT = "<II"
+TICKS_BITS = 24
+TRACE_PRIORITY_THREAD = 0xFF
+TRACE_FLASH_DONE = 0x80
+
+# Timed handlers (trace_handler_t)
+HANDLERS = {1: "ble_evt_handler", 2: "button_handler", 3: "radio_notification",
+            4: "job", 5: "RTC2_IRQHandler", 6: "SAADC_IRQHandler"}
+HANDLER_JOB = 4
+FLASH_OPS = {1: "fds write", 2: "fds update", 3: "fds gc"}
+# Common event ids (ble_gap.h, ble_gatts.h, nrf_soc.h)
+BLE_EVENTS = {0x10: "connected", 0x11: "disconnected", 0x12: "conn_param_update",
+              0x13: "sec_params_request", 0x1A: "conn_sec_update", 0x1B: "gap_timeout",
+              0x21: "phy_update_request", 0x22: "phy_update", 0x23: "data_length_update_request",
+              0x24: "data_length_update", 0x26: "adv_set_terminated", 0x50: "write",
+              0x51: "rw_authorize_request", 0x52: "sys_attr_missing", 0x55: "exchange_mtu_request",
+              0x57: "hvn_tx_complete"}
+SOC_EVENTS = {0: "hfclk_started", 1: "power_failure_warning", 2: "flash_success",
+              3: "flash_error", 4: "radio_blocked", 5: "radio_canceled",
+              6: "radio_signal_callback_invalid_return", 7: "radio_session_idle",
+              8: "radio_session_closed"}
+SOC_FLASH_EVENTS = (2, 3)
+
+# Tracks (thread ids); interrupt priorities 0-7 use their own number
+TID_MAIN = 8
+TID_RADIO = 10
+TID_FLASH = 11
+TID_SOFTDEVICE = 12
+TID_APP = 13
+TRACK_NAMES = {TID_MAIN: "main loop", TID_RADIO: "radio", TID_FLASH: "flash",
+               TID_SOFTDEVICE: "SoftDevice events", TID_APP: "application"}
+PID = 1
+
+DUMP_LINE = re.compile(r"^([0-9a-f]{8}) ([0-9a-f]{6}) (\S+) ([0-9a-f]{8})$")
+
+
+def read_binary(path):
+    """Reads the binary record stream."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) % struct.calcsize(RECORD_FORMAT):
+        print("trace_export: stream ends in a partial record", file=sys.stderr)
+        data = data[:len(data) - len(data) % struct.calcsize(RECORD_FORMAT)]
+    return list(struct.iter_unpack(RECORD_FORMAT, data))
+
+
+def read_text(path):
+    """Reads RTT dump lines; gaps in the record index become lost records."""
+    records = []
+    expected = None
+    with open(path, errors="replace") as f:
+        for line in f:
+            match = DUMP_LINE.match(line.strip())
+            if not match or match.group(3) not in TYPES:
+                continue
+            index, ticks = int(match.group(1), 16), int(match.group(2), 16)
+            if expected is not None and index > expected:
+                records.append(((LOST << TICKS_BITS) | ticks, index - expected))
+            if expected is None or index >= expected:
+                records.append(((TYPES.index(match.group(3)) << TICKS_BITS) | ticks,
+                                int(match.group(4), 16)))
+                expected = index + 1
+    return records
+
+
+def read_records(path, fmt):
+    """Reads records in the given or detected format."""
+    if fmt == "auto":
+        with open(path, "rb") as f:
+            head = f.read(64)
+        fmt = "text" if head and all(32 <= b < 127 or b in b"\r\n\t" for b in head) else "binary"
+    return read_binary(path) if fmt == "binary" else read_text(path)
+
+
+def load_symbols(elf, nm):
+    """Returns sorted (address, name) pairs of the ELF file's functions."""
+    try:
+        out = subprocess.run([nm, "-n", "--defined-only", elf], check=True,
+                             capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as err:
+        sys.exit("trace_export: %s: %s" % (nm, err))
+    symbols = []
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) == 3 and parts[1] in "tTwW":
+            symbols.append((int(parts[0], 16), parts[2]))
+    return symbols
+
+
+def symbol_name(symbols, address):
+    """Names a code address (Thumb bit cleared)."""
+    address &= ~1
+    if symbols:
+        i = bisect.bisect_right(symbols, (address, "\xff")) - 1
+        if i >= 0:
+            start, name = symbols[i]
+            return name if start == address else "%s+0x%x" % (name, address - start)
+    return "0x%08x" % address
+
+
+class Exporter:
+    """Turns records into trace events."""
+
+    def __init__(self, tick_hz, cpu_mhz, symbols):
+        self.tick_us = 1e6 / tick_hz
+        self.cpu_mhz = cpu_mhz
+        self.symbols = symbols
+        self.events = []
+        self.tracks = set()
+        self.ticks = None           # Unwrapped ticks of the latest record
+        self.boot_offset = 0        # Ticks of the timeline before this boot
+        self.stack = []             # Open handler slices, innermost last
+        self.track_end = {}         # End of the last slice per track (us)
+        self.radio_start = None
+        self.flash_start = {}
+        self.pending_job = None
+        self.pending_ble = None
+        self.stats = {}
+
+    def now(self, raw):
+        """Unwraps a tick stamp; records may be a few ticks out of order."""
+        if self.ticks is None:
+            self.ticks = raw
+        else:
+            delta = (raw - self.ticks) & ((1 << TICKS_BITS) - 1)
+            if delta >= 1 << (TICKS_BITS - 1):
+                delta -= 1 << TICKS_BITS
+            self.ticks += delta
+        return (self.boot_offset + self.ticks) * self.tick_us
+
+    def instant(self, ts, tid, name, args=None, scope="t"):
+        """Adds an instant event."""
+        self.tracks.add(tid)
+        event = {"ph": "i", "pid": PID, "tid": tid, "ts": ts, "name": name, "s": scope}
+        if args:
+            event["args"] = args
+        self.events.append(event)
+
+    def slice(self, ts, dur, tid, name, args=None):
+        """Adds a complete event, after the previous one on its track."""
+        self.tracks.add(tid)
+        ts = max(ts, self.track_end.get(tid, ts))
+        self.track_end[tid] = ts + dur
+        event = {"ph": "X", "pid": PID, "tid": tid, "ts": ts, "dur": dur, "name": name}
+        if args:
+            event["args"] = args
+        self.events.append(event)
+
+    def flush_job(self):
+        """Shows a job record that no timed slice picked up."""
+        if self.pending_job is not None:
+            ts, address = self.pending_job
+            self.instant(ts, TID_MAIN, symbol_name(self.symbols, address))
+            self.pending_job = None
+
+    def add(self, stamp, arg):
+        """Handles one record."""
+        kind, raw = stamp >> TICKS_BITS, stamp & ((1 << TICKS_BITS) - 1)
+        if kind == BOOT and self.ticks is not None:
+            # RTC1 restarts with the chip; continue the timeline after the last record
+            self.boot_offset += self.ticks + 1
+            self.ticks = None
+            self.stack.clear()
+            self.radio_start = None
+        ts = self.now(raw)
+        if kind != ENTER:
+            self.flush_job()
+
+        if kind == ENTER:
+            handler, priority, ipsr = arg >> 24, (arg >> 16) & 0xFF, arg & 0xFFFF
+            tid = TID_MAIN if priority == TRACE_PRIORITY_THREAD else priority & 7
+            name = HANDLERS.get(handler, "handler %d" % handler)
+            args = {"ipsr": ipsr} if ipsr else {}
+            if handler == HANDLER_JOB and self.pending_job is not None:
+                name = symbol_name(self.symbols, self.pending_job[1])
+                self.pending_job = None
+            elif handler == 1 and self.pending_ble is not None:
+                args["evt"] = self.pending_ble
+                self.pending_ble = None
+            self.stack.append((handler, ts, tid, name, args))
+        elif kind == EXIT:
+            handler, cycles = arg >> 24, arg & 0xFFFFFF
+            # Preemption nests, so the innermost open slice is the one ending
+            while self.stack and self.stack[-1][0] != handler:
+                self.stack.pop()
+            if self.stack:
+                _, start, tid, name, args = self.stack.pop()
+                dur = cycles / self.cpu_mhz
+                self.slice(start, dur, tid, name, args)
+                stat = self.stats.setdefault(name, [0, 0.0, 0.0])
+                stat[0] += 1
+                stat[1] += dur
+                stat[2] = max(stat[2], dur)
+        elif kind == JOB:
+            self.pending_job = (ts, arg)
+        elif kind == RADIO:
+            if arg and self.radio_start is None:
+                self.radio_start = ts
+            elif not arg and self.radio_start is not None:
+                self.slice(self.radio_start, ts - self.radio_start, TID_RADIO, "radio active")
+                self.radio_start = None
+        elif kind == FLASH:
+            op = arg & ~TRACE_FLASH_DONE
+            name = FLASH_OPS.get(op, "flash %d" % op)
+            if not arg & TRACE_FLASH_DONE:
+                self.flash_start[op] = ts
+            elif op in self.flash_start:
+                start = self.flash_start.pop(op)
+                self.slice(start, ts - start, TID_FLASH, name)
+        elif kind == BLE_EVT:
+            evt = arg & 0xFFFF
+            name = BLE_EVENTS.get(evt, "ble 0x%02x" % evt)
+            self.pending_ble = name
+            self.instant(ts, TID_SOFTDEVICE, name, {"conn_handle": arg >> 16})
+        elif kind == SOC_EVT:
+            name = SOC_EVENTS.get(arg, "soc %d" % arg)
+            self.instant(ts, TID_FLASH if arg in SOC_FLASH_EVENTS else TID_SOFTDEVICE, name)
+        elif kind in (BOOT, LOST):
+            self.instant(ts, TID_APP, TYPES[kind], {"arg": arg}, scope="g")
+        elif 0 < kind < len(TYPES):
+            self.instant(ts, TID_APP, TYPES[kind], {"arg": "0x%08x" % arg})
+
+    def trace(self):
+        """Returns the trace object with the track names."""
+        self.flush_job()
+        meta = [{"ph": "M", "pid": PID, "name": "process_name", "args": {"name": "nRF52840"}}]
+        for tid in sorted(self.tracks):
+            name = TRACK_NAMES.get(tid, "ISR priority %d" % tid)
+            meta.append({"ph": "M", "pid": PID, "tid": tid, "name": "thread_name",
+                         "args": {"name": name}})
+            meta.append({"ph": "M", "pid": PID, "tid": tid, "name": "thread_sort_index",
+                         "args": {"sort_index": tid}})
+        return {"traceEvents": meta + self.events, "displayTimeUnit": "ns"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Export trace_ring records for chrome://tracing or Perfetto.")
+    parser.add_argument("input", help="binary record stream or RTT text dump")
+    parser.add_argument("-o", "--output", default="-", help="JSON output file (default stdout)")
+    parser.add_argument("--format", choices=("auto", "binary", "text"), default="auto")
+    parser.add_argument("--elf", help="firmware ELF file to name jobs (nrf52840_xxaa.out)")
+    parser.add_argument("--nm", default="arm-none-eabi-nm", help="nm to read the ELF file with")
+    parser.add_argument("--tick-hz", type=float, default=16384.0, help="RTC1 tick rate")
+    parser.add_argument("--cpu-mhz", type=float, default=64.0, help="DWT cycle counter rate")
+    args = parser.parse_args()
+
+    records = read_records(args.input, args.format)
+    exporter = Exporter(args.tick_hz, args.cpu_mhz, load_symbols(args.elf, args.nm) if args.elf else [])
+    for stamp, arg in records:
+        exporter.add(stamp, arg)
+    trace = exporter.trace()
+    if args.output == "-":
+        json.dump(trace, sys.stdout)
+    else:
+        with open(args.output, "w") as f:
+            json.dump(trace, f)
+
+    print("%d records, %d events" % (len(records), len(trace["traceEvents"])), file=sys.stderr)
+    if exporter.stats:
+        print("%-28s %8s %10s %10s" % ("handler", "count", "mean us", "max us"), file=sys.stderr)
+        for name, (count, total, longest) in sorted(exporter.stats.items(), key=lambda s: -s[1][1]):
+            print("%-28s %8d %10.1f %10.1f" % (name, count, total / count, longest), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,402 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: trace_ring.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Post-mortem event trace.
+ *
+ *  The ring lives in the .noinit section, which the start-up code neither
+ *  loads nor clears, and RAM keeps its contents across every reset except
+ *  power-on. A magic number and a CRC over the header tell a retained ring
+ *  from random power-on RAM (or from a firmware build with another
+ *  layout). The write index is deliberately outside the CRC so that adding
+ *  a record is only a timestamp read, an LDREX/STREX increment and two
+ *  stores.
+ *
+ *  Timing builds (TRACE_RING_TIMING) add enter/exit records around the
+ *  handlers, with the active exception and its priority on entry and the
+ *  DWT cycles spent on exit, and radio notification records. The main
+ *  loop then streams every new record as it is, 8 bytes little endian, to
+ *  a second RTT channel in skip mode; records that were overwritten before
+ *  they could be sent are replaced by one TRACE_LOST record, so the host
+ *  always knows where the stream has holes. The stream starts with this
+ *  boot's TRACE_BOOT record.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "trace_ring.h"
+#include "nrf.h"
+#include "nrf_sdh_ble.h"
+#include "nrf_sdh_soc.h"
+#include "app_error.h"
+#include "crc16.h"
+#include "SEGGER_RTT.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Header magic ("TRCE") and layout version
+#define TRACE_MAGIC 0x45435254
+#define TRACE_VERSION 1
+// BLE and SoC priority values (record events before anyone handles them)
+#define TRACE_BLE_OBSERVER_PRIO 0
+#define TRACE_SOC_OBSERVER_PRIO 0
+// RTT terminal and the key that starts a dump
+#define TRACE_RTT_CHANNEL 0
+#define TRACE_RTT_DUMP_KEY 'd'
+// Longest RTT dump line
+#define TRACE_LINE_MAX 48
+// RTT stream buffer (records; a write takes at most one less, see
+// stream_process()) and the largest cycle count an exit record holds
+#define TRACE_STREAM_RECORDS 128
+#define TRACE_CYCLES_MAX 0xFFFFFF
+
+typedef struct {
+    // Header, covered by the CRC
+    uint32_t magic;
+    uint16_t version;
+    uint16_t capacity;
+    uint32_t boot_count;
+    uint32_t reset_reason;
+    uint16_t crc;
+    uint16_t reserved;
+    // Write index, free running
+    volatile uint32_t head;
+    trace_record_t records[TRACE_RING_SIZE];
+} trace_ring_t;
+
+static trace_ring_t m_ring __attribute__((section(".noinit")));
+// RTT dump progress (absolute record indexes)
+static uint32_t m_dump_next;
+static uint32_t m_dump_end;
+static bool m_dump_header;
+#if TRACE_RING_TIMING
+// Next record to stream (absolute record index)
+static uint32_t m_stream_next;
+static trace_record_t m_stream_buffer[TRACE_STREAM_RECORDS];
+#endif
+
+static char const* const m_type_names[] = {
+    "?", "boot", "ble", "soc", "job", "rpc", "button", "error", "err_pc", "err_info", "boot_us",
+    "sys_off", "enter", "exit", "radio", "flash"
+};
+
+
+/****************************************************************
+ * Function: header_crc()
+ * Description: Returns the CRC of the ring header.
+****************************************************************/
+static uint16_t header_crc(void) {
+    return crc16_compute((uint8_t const*)&m_ring, offsetof(trace_ring_t, crc), NULL);
+}
+
+
+/****************************************************************
+ * Function: trace_ring_init()
+ * Description: Keeps the ring if it survived the reset, clears it
+ *  otherwise, and records the boot. A retained ring is written to
+ *  RTT.
+****************************************************************/
+void trace_ring_init(void) {
+    uint32_t reason = NRF_POWER->RESETREAS;
+    bool retained = false;
+    // Write back to clear, so the next boot only sees its own reason
+    NRF_POWER->RESETREAS = reason;
+
+    if (m_ring.magic == TRACE_MAGIC && m_ring.crc == header_crc()) {
+        m_ring.boot_count++;
+        retained = m_ring.head != 0;
+    }
+    else {
+        memset(&m_ring, 0, sizeof(m_ring));
+        m_ring.magic = TRACE_MAGIC;
+        m_ring.version = TRACE_VERSION;
+        m_ring.capacity = TRACE_RING_SIZE;
+    }
+    m_ring.reset_reason = reason;
+    m_ring.crc = header_crc();
+
+    if (retained) {
+        trace_ring_rtt_dump();
+    }
+#if TRACE_RING_TIMING
+    SEGGER_RTT_ConfigUpBuffer(TRACE_RTT_STREAM_CHANNEL, "trace", m_stream_buffer,
+                              sizeof(m_stream_buffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+    m_stream_next = m_ring.head;
+#endif
+    trace_ring_add(TRACE_BOOT, reason);
+}
+
+
+/****************************************************************
+ * Function: trace_ring_add()
+ * Description: Claims the next record and fills it.
+****************************************************************/
+void trace_ring_add(trace_type_t type, uint32_t arg) {
+    uint32_t stamp = ((uint32_t)type << 24) | NRF_RTC1->COUNTER;
+    uint32_t index;
+    do {
+        index = __LDREXW(&m_ring.head);
+    } while (__STREXW(index + 1, &m_ring.head) != 0);
+    trace_record_t* p_record = &m_ring.records[index & (TRACE_RING_SIZE - 1)];
+    p_record->stamp = stamp;
+    p_record->arg = arg;
+}
+
+
+#if TRACE_RING_TIMING
+/****************************************************************
+ * Function: trace_ring_enter()
+ * Description: Records a handler entry with the active exception
+ *  number and its priority (TRACE_PRIORITY_THREAD in thread
+ *  mode).
+****************************************************************/
+uint32_t trace_ring_enter(trace_handler_t handler) {
+    uint32_t ipsr = __get_IPSR();
+    uint32_t priority = TRACE_PRIORITY_THREAD;
+    if (ipsr != 0) {
+        priority = NVIC_GetPriority((IRQn_Type)((int32_t)ipsr - 16)) & 0xFF;
+    }
+    trace_ring_add(TRACE_ENTER, ((uint32_t)handler << 24) | (priority << 16) | (ipsr & 0xFFFF));
+    return DWT->CYCCNT;
+}
+
+
+/****************************************************************
+ * Function: trace_ring_exit()
+ * Description: Records a handler exit with the cycles since the
+ *  mark (saturated).
+****************************************************************/
+void trace_ring_exit(trace_handler_t handler, uint32_t mark) {
+    uint32_t cycles = DWT->CYCCNT - mark;
+    if (cycles > TRACE_CYCLES_MAX) {
+        cycles = TRACE_CYCLES_MAX;
+    }
+    trace_ring_add(TRACE_EXIT, ((uint32_t)handler << 24) | cycles);
+}
+#endif
+
+
+/****************************************************************
+ * Function: trace_ring_info_get()
+ * Description: Returns the ring state.
+****************************************************************/
+void trace_ring_info_get(trace_ring_info_t* p_info) {
+    p_info->head = m_ring.head;
+    p_info->boot_count = m_ring.boot_count;
+    p_info->reset_reason = m_ring.reset_reason;
+    p_info->capacity = TRACE_RING_SIZE;
+}
+
+
+/****************************************************************
+ * Function: oldest()
+ * Description: Returns the absolute index of the oldest record
+ *  still in the ring.
+****************************************************************/
+static uint32_t oldest(uint32_t head) {
+    return (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+}
+
+
+/****************************************************************
+ * Function: trace_ring_read()
+ * Description: Copies records, oldest first.
+****************************************************************/
+uint32_t trace_ring_read(uint32_t index, trace_record_t* p_records, uint32_t max) {
+    uint32_t head = m_ring.head;
+    uint32_t first = oldest(head) + index;
+    uint32_t count = 0;
+    while (count < max && first + count < head) {
+        p_records[count] = m_ring.records[(first + count) & (TRACE_RING_SIZE - 1)];
+        count++;
+    }
+    return count;
+}
+
+
+/****************************************************************
+ * Function: trace_ring_rtt_dump()
+ * Description: Starts writing the ring, oldest record first.
+****************************************************************/
+void trace_ring_rtt_dump(void) {
+    m_dump_end = m_ring.head;
+    m_dump_next = oldest(m_dump_end);
+    m_dump_header = true;
+}
+
+
+/****************************************************************
+ * Function: hex_put()
+ * Description: Writes a value as fixed width hex; returns the
+ *  position after it.
+****************************************************************/
+static char* hex_put(char* p_out, uint32_t value, uint8_t digits) {
+    for (int8_t i = digits - 1; i >= 0; i--) {
+        p_out[i] = "0123456789abcdef"[value & 0xF];
+        value >>= 4;
+    }
+    return p_out + digits;
+}
+
+
+/****************************************************************
+ * Function: str_put()
+ * Description: Copies a string; returns the position after it.
+****************************************************************/
+static char* str_put(char* p_out, char const* p_str) {
+    while (*p_str) {
+        *p_out++ = *p_str++;
+    }
+    return p_out;
+}
+
+
+#if TRACE_RING_TIMING
+/****************************************************************
+ * Function: stream_process()
+ * Description: Sends the records added since the last call, in
+ *  runs up to the end of the ring. Records written by interrupts
+ *  are complete by the time the main loop sees the head. In skip
+ *  mode RTT drops a write that does not fit whole, and it never
+ *  has more than its size less one byte free, so every write is
+ *  capped at the space free.
+****************************************************************/
+static void stream_process(void) {
+    uint32_t head = m_ring.head;
+    uint32_t first = oldest(head);
+    if (m_stream_next < first) {
+        trace_record_t lost = {
+            .stamp = ((uint32_t)TRACE_LOST << 24) |
+                     TRACE_RECORD_TICKS(&m_ring.records[first & (TRACE_RING_SIZE - 1)]),
+            .arg = first - m_stream_next
+        };
+        if (SEGGER_RTT_Write(TRACE_RTT_STREAM_CHANNEL, &lost, sizeof(lost)) == 0) {
+            return;
+        }
+        m_stream_next = first;
+    }
+    while (m_stream_next < head) {
+        uint32_t index = m_stream_next & (TRACE_RING_SIZE - 1);
+        uint32_t count = head - m_stream_next;
+        uint32_t space = SEGGER_RTT_GetAvailWriteSpace(TRACE_RTT_STREAM_CHANNEL) / sizeof(trace_record_t);
+        if (count > TRACE_RING_SIZE - index) {
+            count = TRACE_RING_SIZE - index;
+        }
+        if (count > space) {
+            count = space;
+        }
+        if (count == 0 ||
+            SEGGER_RTT_Write(TRACE_RTT_STREAM_CHANNEL, &m_ring.records[index],
+                             count * sizeof(trace_record_t)) == 0) {
+            return;
+        }
+        m_stream_next += count;
+    }
+}
+#endif
+
+
+/****************************************************************
+ * Function: trace_ring_rtt_process()
+ * Description: Starts a dump on the dump key and writes dump
+ *  lines for as long as the RTT buffer takes whole lines (the
+ *  buffer is in skip mode, so nothing blocks without a host).
+ *  Timing builds stream new records first.
+****************************************************************/
+void trace_ring_rtt_process(void) {
+    char line[TRACE_LINE_MAX];
+    char* p;
+    char key;
+
+#if TRACE_RING_TIMING
+    stream_process();
+#endif
+    if (SEGGER_RTT_Read(TRACE_RTT_CHANNEL, &key, 1) == 1 && key == TRACE_RTT_DUMP_KEY) {
+        trace_ring_rtt_dump();
+    }
+    if (m_dump_header) {
+        // "trace boot <count> reset <reason> records <head>"
+        p = str_put(line, "trace boot ");
+        p = hex_put(p, m_ring.boot_count, 8);
+        p = str_put(p, " reset ");
+        p = hex_put(p, m_ring.reset_reason, 8);
+        p = str_put(p, " records ");
+        p = hex_put(p, m_dump_end, 8);
+        *p++ = '\n';
+        if (SEGGER_RTT_Write(TRACE_RTT_CHANNEL, line, p - line) == 0) {
+            return;
+        }
+        m_dump_header = false;
+    }
+    while (m_dump_next < m_dump_end) {
+        // Skip records overwritten since the dump started
+        if (m_dump_next < oldest(m_ring.head)) {
+            m_dump_next = oldest(m_ring.head);
+            continue;
+        }
+        trace_record_t record = m_ring.records[m_dump_next & (TRACE_RING_SIZE - 1)];
+        uint32_t type = TRACE_RECORD_TYPE(&record);
+        // "<index> <ticks> <type> <arg>"
+        p = hex_put(line, m_dump_next, 8);
+        *p++ = ' ';
+        p = hex_put(p, TRACE_RECORD_TICKS(&record), 6);
+        *p++ = ' ';
+        p = str_put(p, m_type_names[(type <= TRACE_FLASH) ? type : 0]);
+        *p++ = ' ';
+        p = hex_put(p, record.arg, 8);
+        *p++ = '\n';
+        if (SEGGER_RTT_Write(TRACE_RTT_CHANNEL, line, p - line) == 0) {
+            return;
+        }
+        m_dump_next++;
+    }
+}
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Records every BLE event.
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    // The connection handle is at the same offset in every event group
+    uint16_t conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    trace_ring_add(TRACE_BLE_EVT, ((uint32_t)conn_handle << 16) | p_ble_evt->header.evt_id);
+}
+
+
+/****************************************************************
+ * Function: soc_evt_handler()
+ * Description: Records every SoC event.
+****************************************************************/
+static void soc_evt_handler(uint32_t evt_id, void* p_context) {
+    trace_ring_add(TRACE_SOC_EVT, evt_id);
+}
+
+
+/****************************************************************
+ * Function: app_error_fault_handler()
+ * Description: Replaces the SDK's weak fault handler: records
+ *  the fault, then resets so the trace can be read back.
+****************************************************************/
+void app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info) {
+    __disable_irq();
+    trace_ring_add(TRACE_ERROR, id);
+    trace_ring_add(TRACE_ERROR_PC, pc);
+    if (id == NRF_FAULT_ID_SDK_ERROR) {
+        trace_ring_add(TRACE_ERROR_INFO, ((error_info_t const*)(uintptr_t)info)->err_code);
+    }
+    else {
+        trace_ring_add(TRACE_ERROR_INFO, info);
+    }
+    NVIC_SystemReset();
+}
+
+NRF_SDH_BLE_OBSERVER(m_trace_ble_observer, TRACE_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+NRF_SDH_SOC_OBSERVER(m_trace_soc_observer, TRACE_SOC_OBSERVER_PRIO, soc_evt_handler, NULL);
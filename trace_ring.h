@@ -0,0 +1,127 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: trace_ring.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Post-mortem event trace. A fixed-size ring of binary records
+ * in RAM that is not initialized at start-up, so the history leading up to
+ * a warm reset (error, watchdog, soft reset) is still there afterwards.
+ * It can be read back over BLE (RPC) or RTT. Timing builds also stream
+ * every record live over RTT for the host trace viewer export
+ * (tools/trace/trace_export.py).
+*******************************************************************************/
+#ifndef TRACE_RING_H__
+#define TRACE_RING_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// Records in the ring (power of two)
+#define TRACE_RING_SIZE 256
+// Handler timing: enter/exit and radio notification records, and a live
+// binary stream of all records on RTT channel TRACE_RTT_STREAM_CHANNEL.
+// Off by default, the timing records fill the ring many times faster
+#define TRACE_RING_TIMING 0
+#define TRACE_RTT_STREAM_CHANNEL 1
+// Priority recorded for handlers that run in thread mode (main loop)
+#define TRACE_PRIORITY_THREAD 0xFF
+
+// Record types
+typedef enum {
+    TRACE_BOOT = 1,                     // arg: reset reason (RESETREAS)
+    TRACE_BLE_EVT,                      // arg: connection handle << 16 | event id
+    TRACE_SOC_EVT,                      // arg: event id
+    TRACE_JOB,                          // arg: radio_sched job address
+    TRACE_RPC,                          // arg: request id << 8 | method
+    TRACE_BUTTON,                       // arg: pin << 8 | action
+    TRACE_ERROR,                        // arg: fault id
+    TRACE_ERROR_PC,                     // arg: program counter
+    TRACE_ERROR_INFO,                   // arg: error code (SDK errors) or info
+    TRACE_BOOT_TIME,                    // arg: main() to first advertisement in us
+    TRACE_SYSTEM_OFF,                   // arg: System OFF entries
+    TRACE_ENTER,                        // arg: handler << 24 | priority << 16 | IPSR
+    TRACE_EXIT,                         // arg: handler << 24 | CPU cycles since enter
+    TRACE_RADIO,                        // arg: 1 radio active, 0 inactive
+    TRACE_FLASH,                        // arg: FDS operation (trace_flash_op_t)
+    TRACE_LOST                          // Stream only; arg: records overwritten before sending
+} trace_type_t;
+
+// Timed handlers (TRACE_ENTER/TRACE_EXIT)
+typedef enum {
+    TRACE_HANDLER_BLE_EVT = 1,          // Application BLE event handler
+    TRACE_HANDLER_BUTTON,               // Button handler
+    TRACE_HANDLER_RADIO,                // Radio notification
+    TRACE_HANDLER_JOB,                  // radio_sched job (after its TRACE_JOB record)
+    TRACE_HANDLER_TIMER,                // Timer wheel RTC2 interrupt
+    TRACE_HANDLER_SAADC                 // Battery SAADC interrupt
+} trace_handler_t;
+
+// Flash operations (TRACE_FLASH), recorded when queued and again with
+// TRACE_FLASH_DONE set on the FDS event that completes them
+typedef enum {
+    TRACE_FLASH_WRITE = 1,
+    TRACE_FLASH_UPDATE,
+    TRACE_FLASH_GC
+} trace_flash_op_t;
+#define TRACE_FLASH_DONE 0x80
+
+// Record: type in the top byte of the stamp, RTC1 ticks below it
+typedef struct {
+    uint32_t stamp;
+    uint32_t arg;
+} trace_record_t;
+
+// Ring state
+typedef struct {
+    uint32_t head;                      // Records written since the ring was cleared
+    uint32_t boot_count;                // Warm resets the ring has survived
+    uint32_t reset_reason;              // RESETREAS of this boot
+    uint16_t capacity;
+} trace_ring_info_t;
+
+// Record accessors
+#define TRACE_RECORD_TYPE(p_record) ((p_record)->stamp >> 24)
+#define TRACE_RECORD_TICKS(p_record) ((p_record)->stamp & 0xFFFFFF)
+
+
+/***************************************
+ * Functions
+***************************************/
+// Validates or clears the ring and records the boot (call first in main)
+void trace_ring_init(void);
+// Adds a record (any context)
+void trace_ring_add(trace_type_t type, uint32_t arg);
+// Returns the ring state
+void trace_ring_info_get(trace_ring_info_t* p_info);
+// Copies up to max records, index counted from the oldest one; returns the count
+uint32_t trace_ring_read(uint32_t index, trace_record_t* p_records, uint32_t max);
+// Starts writing the ring to RTT
+void trace_ring_rtt_dump(void);
+// Writes pending dump lines (and streamed records) while RTT has room; call
+// from the main loop
+void trace_ring_rtt_process(void);
+#if TRACE_RING_TIMING
+// Records a handler entry; returns the mark for trace_ring_exit()
+uint32_t trace_ring_enter(trace_handler_t handler);
+// Records the handler exit with the cycles spent since the mark
+void trace_ring_exit(trace_handler_t handler, uint32_t mark);
+#else
+static inline uint32_t trace_ring_enter(trace_handler_t handler) {
+    return 0;
+}
+
+static inline void trace_ring_exit(trace_handler_t handler, uint32_t mark) {
+}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TRACE_RING_H__
@@ -0,0 +1,632 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: tx_sched.c
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Notification transmit scheduler.
+ *
+ *  The SoftDevice sends notifications of a link strictly in the order they
+ *  were queued, so priorities have to be applied before sd_ble_gatts_hvx().
+ *  Notifications wait here in one FIFO per class and link, and a class is
+ *  only handed more while the link has fewer than its limit in the
+ *  SoftDevice queue: telemetry and bulk can never fill it, so an urgent
+ *  notification is queued the moment it arrives behind at most
+ *  TX_SCHED_INFLIGHT_TELEMETRY others. Within a class, links are served by
+ *  deficit round robin with a quantum of one full notification so a busy
+ *  link cannot starve the others.
+ *
+ *  The choice is made inside the critical region: records are moved to the
+ *  link's in flight list there and counted as unsent. sd_ble_gatts_hvx() is
+ *  called after the region is left, by one context at a time, for the
+ *  unsent records in order. A record the SoftDevice refuses for lack of
+ *  room goes back to the head of its queue, with the ones chosen after it.
+ *
+ *  With slave latency the peripheral only has to attend every
+ *  (latency + 1)th connection event, but anything in the SoftDevice queue
+ *  makes it attend the next one. Telemetry and bulk are therefore held
+ *  back on such links while nothing is in flight, and released from the
+ *  radio notification that precedes the next radio event: an event the
+ *  peripheral attends anyway, because of the latency anchor, peer data or
+ *  an urgent notification. Urgent notifications are never held, and once
+ *  anything is in flight the next event is attended regardless, so held
+ *  notifications join it.
+*******************************************************************************/
+
+/***************************************
+ * Libraries/Modules
+***************************************/
+#include <string.h>
+#include "tx_sched.h"
+#include "nrf_sdh_ble.h"
+#include "app_util_platform.h"
+#include "app_timer.h"
+#include "app_ticks.h"
+#include "app_pools.h"
+#include "ble_diag.h"
+#include "radio_sched.h"
+
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// BLE priority value
+#define TX_SCHED_BLE_OBSERVER_PRIO 2
+// Bytes a link may send per round within a class
+#define TX_SCHED_QUANTUM APP_POOL_NOTIF_SIZE
+
+// Queued notification (one g_event_pool block)
+typedef struct tx_record_s {
+    struct tx_record_s* p_next;
+    uint8_t* p_data;                // Payload block, NULL for in place
+    uint32_t queued;                // app_timer ticks
+    uint16_t value_handle;
+    uint8_t len;
+    uint8_t cls;
+} tx_record_t;
+STATIC_ASSERT(sizeof(tx_record_t) <= APP_POOL_EVENT_SIZE);
+
+typedef struct {
+    tx_record_t* p_head;
+    tx_record_t* p_tail;
+    uint8_t count;
+} tx_fifo_t;
+
+typedef struct {
+    uint16_t conn_handle;
+    tx_fifo_t queue[TX_SCHED_CLASS_COUNT];
+    tx_fifo_t inflight;             // In the SoftDevice queue, in send order
+    uint8_t unsent;                 // Last records of inflight not handed over yet
+    uint16_t deficit[TX_SCHED_CLASS_COUNT];
+    uint16_t interval;              // Connection interval, 1.25 ms units
+    uint16_t slave_latency;
+} tx_link_t;
+
+static const uint8_t m_inflight_max[TX_SCHED_CLASS_COUNT] = {
+    TX_SCHED_INFLIGHT_URGENT, TX_SCHED_INFLIGHT_TELEMETRY, TX_SCHED_INFLIGHT_BULK
+};
+static const uint8_t m_queued_max[TX_SCHED_CLASS_COUNT] = {
+    TX_SCHED_QUEUED_URGENT, TX_SCHED_QUEUED_TELEMETRY, TX_SCHED_QUEUED_BULK
+};
+
+static tx_link_t m_links[NRF_SDH_BLE_TOTAL_LINK_COUNT];
+// Link to start the next round of each class with
+static uint8_t m_rr[TX_SCHED_CLASS_COUNT];
+static tx_sched_stats_t m_stats[TX_SCHED_CLASS_COUNT];
+static tx_sched_batch_stats_t m_batch_stats;
+// Set while held notifications may go to the SoftDevice
+static bool m_release;
+// Record being handed to the SoftDevice, and whether its link went away
+// meanwhile (the sender frees it then)
+static tx_record_t* m_sending;
+static bool m_sending_flushed;
+
+
+/****************************************************************
+ * Function: fifo_push()
+ * Description: Appends a record to a FIFO.
+****************************************************************/
+static void fifo_push(tx_fifo_t* p_fifo, tx_record_t* p_record) {
+    p_record->p_next = NULL;
+    if (p_fifo->p_tail != NULL) {
+        p_fifo->p_tail->p_next = p_record;
+    }
+    else {
+        p_fifo->p_head = p_record;
+    }
+    p_fifo->p_tail = p_record;
+    p_fifo->count++;
+}
+
+
+/****************************************************************
+ * Function: fifo_pop()
+ * Description: Removes and returns the oldest record of a FIFO,
+ *  or NULL if it is empty.
+****************************************************************/
+static tx_record_t* fifo_pop(tx_fifo_t* p_fifo) {
+    tx_record_t* p_record = p_fifo->p_head;
+    if (p_record != NULL) {
+        p_fifo->p_head = p_record->p_next;
+        if (p_fifo->p_head == NULL) {
+            p_fifo->p_tail = NULL;
+        }
+        p_fifo->count--;
+    }
+    return p_record;
+}
+
+
+/****************************************************************
+ * Function: fifo_push_head()
+ * Description: Puts a record back at the head of a FIFO.
+****************************************************************/
+static void fifo_push_head(tx_fifo_t* p_fifo, tx_record_t* p_record) {
+    p_record->p_next = p_fifo->p_head;
+    p_fifo->p_head = p_record;
+    if (p_fifo->p_tail == NULL) {
+        p_fifo->p_tail = p_record;
+    }
+    p_fifo->count++;
+}
+
+
+/****************************************************************
+ * Function: fifo_split()
+ * Description: Detaches the records of a FIFO from index on and
+ *  returns the first of them, still linked to each other.
+****************************************************************/
+static tx_record_t* fifo_split(tx_fifo_t* p_fifo, uint8_t index) {
+    if (index >= p_fifo->count) {
+        return NULL;
+    }
+    if (index == 0) {
+        tx_record_t* p_first = p_fifo->p_head;
+        p_fifo->p_head = NULL;
+        p_fifo->p_tail = NULL;
+        p_fifo->count = 0;
+        return p_first;
+    }
+    tx_record_t* p_last = p_fifo->p_head;
+    for (uint8_t i = 1; i < index; i++) {
+        p_last = p_last->p_next;
+    }
+    tx_record_t* p_first = p_last->p_next;
+    p_last->p_next = NULL;
+    p_fifo->p_tail = p_last;
+    p_fifo->count = index;
+    return p_first;
+}
+
+
+/****************************************************************
+ * Function: record_free()
+ * Description: Returns a record and its payload to their pools.
+****************************************************************/
+static void record_free(tx_record_t* p_record) {
+    block_pool_free(&g_notif_pool, p_record->p_data);
+    block_pool_free(&g_event_pool, p_record);
+}
+
+
+/****************************************************************
+ * Function: link_find()
+ * Description: Returns the state of a connection, or NULL if the
+ *  connection is not tracked.
+****************************************************************/
+static tx_link_t* link_find(uint16_t conn_handle) {
+    for (uint32_t i = 0; i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++) {
+        if (m_links[i].conn_handle == conn_handle) {
+            return &m_links[i];
+        }
+    }
+    return NULL;
+}
+
+
+/****************************************************************
+ * Function: link_flush()
+ * Description: Drops everything queued or in flight on a link
+ *  and releases it.
+****************************************************************/
+static void link_flush(tx_link_t* p_link) {
+    tx_record_t* p_record;
+    for (uint32_t cls = 0; cls < TX_SCHED_CLASS_COUNT; cls++) {
+        while ((p_record = fifo_pop(&p_link->queue[cls])) != NULL) {
+            m_stats[cls].dropped++;
+            m_stats[cls].err_last = BLE_ERROR_INVALID_CONN_HANDLE;
+            record_free(p_record);
+        }
+    }
+    while ((p_record = fifo_pop(&p_link->inflight)) != NULL) {
+        m_stats[p_record->cls].dropped++;
+        m_stats[p_record->cls].err_last = BLE_ERROR_INVALID_CONN_HANDLE;
+        if (p_record == m_sending) {
+            m_sending_flushed = true;
+        }
+        else {
+            record_free(p_record);
+        }
+    }
+    memset(p_link, 0, sizeof(*p_link));
+    p_link->conn_handle = BLE_CONN_HANDLE_INVALID;
+}
+
+
+/****************************************************************
+ * Function: record_send()
+ * Description: Hands a record to the SoftDevice. Called outside
+ *  the critical region.
+****************************************************************/
+static uint32_t record_send(uint16_t conn_handle, tx_record_t const* p_record) {
+    ble_gatts_hvx_params_t params;
+    uint16_t len = p_record->len;
+    memset(&params, 0, sizeof(params));
+    params.type = BLE_GATT_HVX_NOTIFICATION;
+    params.handle = p_record->value_handle;
+    params.p_data = p_record->p_data;
+    params.p_len = &len;
+    return sd_ble_gatts_hvx(conn_handle, &params);
+}
+
+
+/****************************************************************
+ * Function: records_unsend()
+ * Description: Returns the unsent records of a link to the heads
+ *  of their queues, in their original order.
+****************************************************************/
+static void records_unsend(tx_link_t* p_link) {
+    tx_record_t* p_records[TX_SCHED_SD_QUEUE_SIZE];
+    uint8_t count = 0;
+    tx_record_t* p_record = fifo_split(&p_link->inflight, p_link->inflight.count - p_link->unsent);
+    while (p_record != NULL && count < TX_SCHED_SD_QUEUE_SIZE) {
+        p_records[count++] = p_record;
+        p_record = p_record->p_next;
+    }
+    while (count > 0) {
+        p_record = p_records[--count];
+        fifo_push_head(&p_link->queue[p_record->cls], p_record);
+        p_link->deficit[p_record->cls] = TX_SCHED_QUANTUM;
+    }
+    p_link->unsent = 0;
+}
+
+
+/****************************************************************
+ * Function: class_held()
+ * Description: Returns true if a class has to wait for the next
+ *  attended connection event on a link.
+****************************************************************/
+static bool class_held(tx_link_t const* p_link, uint32_t cls) {
+#if TX_SCHED_BATCH_ENABLED
+    return cls != TX_SCHED_URGENT && p_link->slave_latency > 0 &&
+           p_link->inflight.count == 0 && !m_release;
+#else
+    return false;
+#endif
+}
+
+
+/****************************************************************
+ * Function: pump()
+ * Description: Chooses the queued notifications to hand to the
+ *  SoftDevice: classes in priority order, links of a class by
+ *  deficit round robin. Called with the critical region held;
+ *  send_pending() sends them once it is left.
+****************************************************************/
+static void pump(void) {
+    for (uint32_t cls = 0; cls < TX_SCHED_CLASS_COUNT; cls++) {
+        bool progress;
+        do {
+            progress = false;
+            for (uint32_t n = 0; n < NRF_SDH_BLE_TOTAL_LINK_COUNT; n++) {
+                tx_link_t* p_link = &m_links[(m_rr[cls] + n) % NRF_SDH_BLE_TOTAL_LINK_COUNT];
+                tx_fifo_t* p_queue = &p_link->queue[cls];
+                if (p_queue->p_head == NULL) {
+                    p_link->deficit[cls] = 0;
+                    continue;
+                }
+                if (p_link->inflight.count >= m_inflight_max[cls] || class_held(p_link, cls)) {
+                    continue;
+                }
+                p_link->deficit[cls] += TX_SCHED_QUANTUM;
+                while (p_queue->p_head != NULL &&
+                       p_queue->p_head->len <= p_link->deficit[cls] &&
+                       p_link->inflight.count < m_inflight_max[cls]) {
+                    tx_record_t* p_record = fifo_pop(p_queue);
+                    p_link->deficit[cls] -= p_record->len;
+                    fifo_push(&p_link->inflight, p_record);
+                    p_link->unsent++;
+                    progress = true;
+                }
+                if (p_queue->p_head == NULL) {
+                    p_link->deficit[cls] = 0;
+                }
+            }
+            m_rr[cls] = (m_rr[cls] + 1) % NRF_SDH_BLE_TOTAL_LINK_COUNT;
+        } while (progress);
+    }
+}
+
+
+/****************************************************************
+ * Function: send_pending()
+ * Description: Hands the records pump() chose to the SoftDevice,
+ *  outside the critical region. Only one context sends at a
+ *  time; one that interrupts it leaves its records to it. The
+ *  SoftDevice copies the payload, so its block is released once
+ *  it has been taken.
+****************************************************************/
+static void send_pending(void) {
+    for (;;) {
+        tx_link_t* p_link = NULL;
+        tx_record_t* p_record = NULL;
+        uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+        CRITICAL_REGION_ENTER();
+        for (uint32_t i = 0; m_sending == NULL && i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++) {
+            if (m_links[i].unsent > 0) {
+                p_link = &m_links[i];
+                p_record = p_link->inflight.p_head;
+                for (uint8_t n = p_link->inflight.count - p_link->unsent; n > 0; n--) {
+                    p_record = p_record->p_next;
+                }
+                conn_handle = p_link->conn_handle;
+                m_sending = p_record;
+                m_sending_flushed = false;
+            }
+        }
+        CRITICAL_REGION_EXIT();
+        if (p_record == NULL) {
+            return;
+        }
+
+        uint32_t err_code = record_send(conn_handle, p_record);
+        ble_diag_on_hvx(conn_handle, err_code);
+
+        CRITICAL_REGION_ENTER();
+        m_sending = NULL;
+        if (m_sending_flushed) {
+            // Link gone meanwhile, already counted as dropped
+            record_free(p_record);
+        }
+        else if (err_code == NRF_SUCCESS) {
+            p_link->unsent--;
+            block_pool_free(&g_notif_pool, p_record->p_data);
+            p_record->p_data = NULL;
+        }
+        else if (err_code == NRF_ERROR_RESOURCES) {
+            // SoftDevice queue full after all, retry on completion
+            records_unsend(p_link);
+        }
+        else {
+            // Notifications disabled or link going down: drop it and
+            // let the ones behind it take its place
+            records_unsend(p_link);
+            fifo_pop(&p_link->queue[p_record->cls]);
+            m_stats[p_record->cls].dropped++;
+            m_stats[p_record->cls].err_last = err_code;
+            record_free(p_record);
+            pump();
+        }
+        CRITICAL_REGION_EXIT();
+    }
+}
+
+
+/****************************************************************
+ * Function: on_tx_complete()
+ * Description: Retires completed notifications, oldest first,
+ *  and refills the SoftDevice queue.
+****************************************************************/
+static void on_tx_complete(tx_link_t* p_link, uint8_t count) {
+    uint32_t now = app_timer_cnt_get();
+    tx_record_t* p_record;
+    while (count-- > 0 && (p_record = fifo_pop(&p_link->inflight)) != NULL) {
+        tx_sched_stats_t* p_stats = &m_stats[p_record->cls];
+        uint32_t latency_us = APP_TICKS_TO_US(app_timer_cnt_diff_compute(now, p_record->queued));
+        p_stats->sent++;
+        p_stats->bytes += p_record->len;
+        p_stats->latency_sum_us += latency_us;
+        if (latency_us > p_stats->latency_max_us) {
+            p_stats->latency_max_us = latency_us;
+        }
+        record_free(p_record);
+    }
+    pump();
+}
+
+
+#if TX_SCHED_BATCH_ENABLED
+/****************************************************************
+ * Function: events_saved()
+ * Description: Counts the connection events that sending the
+ *  held notifications of a link on arrival would have added:
+ *  one per connection interval that saw an arrival, except the
+ *  interval ending with the event they are released into.
+****************************************************************/
+static uint32_t events_saved(tx_link_t const* p_link, uint32_t now) {
+    uint32_t interval_ticks = APP_TICKS_FROM_US((uint32_t)p_link->interval * 1250);
+    uint32_t intervals = 0;
+    if (interval_ticks == 0) {
+        return 0;
+    }
+    for (uint32_t cls = TX_SCHED_URGENT + 1; cls < TX_SCHED_CLASS_COUNT; cls++) {
+        for (tx_record_t const* p_record = p_link->queue[cls].p_head; p_record != NULL; p_record = p_record->p_next) {
+            uint32_t age = app_timer_cnt_diff_compute(now, p_record->queued) / interval_ticks;
+            if (age > 0) {
+                intervals |= 1UL << ((age < 31) ? age : 31);
+            }
+        }
+    }
+    return __builtin_popcount(intervals);
+}
+
+
+/****************************************************************
+ * Function: radio_listener()
+ * Description: Releases held notifications ahead of a radio
+ *  event.
+****************************************************************/
+static void radio_listener(bool radio_active) {
+    if (!radio_active) {
+        return;
+    }
+    uint32_t now = app_timer_cnt_get();
+    bool held = false;
+    CRITICAL_REGION_ENTER();
+    for (uint32_t i = 0; i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++) {
+        tx_link_t* p_link = &m_links[i];
+        // Only links holding back, not those waiting for completions
+        if (p_link->conn_handle == BLE_CONN_HANDLE_INVALID || p_link->slave_latency == 0 ||
+            p_link->inflight.count > 0) {
+            continue;
+        }
+        for (uint32_t cls = TX_SCHED_URGENT + 1; cls < TX_SCHED_CLASS_COUNT; cls++) {
+            held |= p_link->queue[cls].p_head != NULL;
+        }
+        m_batch_stats.events_saved += events_saved(p_link, now);
+    }
+    if (held) {
+        m_batch_stats.releases++;
+        m_release = true;
+        pump();
+        m_release = false;
+    }
+    CRITICAL_REGION_EXIT();
+    send_pending();
+}
+#endif
+
+
+/****************************************************************
+ * Function: ble_evt_handler()
+ * Description: Tracks links and notification completions.
+ *  BLE_GAP_EVT_CONNECTED           - Start scheduling the link
+ *  BLE_GAP_EVT_CONN_PARAM_UPDATE   - Track the slave latency
+ *  BLE_GAP_EVT_DISCONNECTED        - Drop what is left
+ *  BLE_GATTS_EVT_HVN_TX_COMPLETE   - Refill the SoftDevice queue
+****************************************************************/
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+    uint16_t conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    tx_link_t* p_link;
+    CRITICAL_REGION_ENTER();
+    switch (p_ble_evt->header.evt_id) {
+        case BLE_GAP_EVT_CONNECTED:
+            p_link = link_find(BLE_CONN_HANDLE_INVALID);
+            if (p_link != NULL) {
+                p_link->conn_handle = conn_handle;
+                p_link->interval = p_ble_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval;
+                p_link->slave_latency = p_ble_evt->evt.gap_evt.params.connected.conn_params.slave_latency;
+            }
+            break;
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+            p_link = link_find(conn_handle);
+            if (p_link != NULL) {
+                p_link->interval = p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval;
+                p_link->slave_latency = p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params.slave_latency;
+                // Latency may have gone to zero, release what is held
+                pump();
+            }
+            break;
+        case BLE_GAP_EVT_DISCONNECTED:
+            p_link = link_find(conn_handle);
+            if (p_link != NULL) {
+                link_flush(p_link);
+            }
+            break;
+        case BLE_GATTS_EVT_HVN_TX_COMPLETE:
+            p_link = link_find(p_ble_evt->evt.gatts_evt.conn_handle);
+            if (p_link != NULL) {
+                on_tx_complete(p_link, p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count);
+            }
+            break;
+    }
+    CRITICAL_REGION_EXIT();
+    send_pending();
+}
+
+
+/****************************************************************
+ * Function: tx_sched_init()
+ * Description: Marks all links free and listens for radio
+ *  events to release held notifications.
+****************************************************************/
+void tx_sched_init(void) {
+    for (uint32_t i = 0; i < NRF_SDH_BLE_TOTAL_LINK_COUNT; i++) {
+        memset(&m_links[i], 0, sizeof(m_links[i]));
+        m_links[i].conn_handle = BLE_CONN_HANDLE_INVALID;
+    }
+#if TX_SCHED_BATCH_ENABLED
+    radio_sched_listener_add(radio_listener);
+#endif
+}
+
+
+/****************************************************************
+ * Function: tx_sched_notify()
+ * Description: Queues a notification and sends it straight away
+ *  if its class has room in the SoftDevice queue. May be called
+ *  from any application interrupt priority.
+****************************************************************/
+uint32_t tx_sched_notify(uint16_t conn_handle, uint16_t value_handle, tx_sched_class_t cls,
+                         uint8_t* p_block, uint16_t len) {
+    uint32_t err_code = NRF_SUCCESS;
+    if (cls >= TX_SCHED_CLASS_COUNT || len > APP_POOL_NOTIF_SIZE) {
+        block_pool_free(&g_notif_pool, p_block);
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    CRITICAL_REGION_ENTER();
+    tx_link_t* p_link = (conn_handle == BLE_CONN_HANDLE_INVALID) ? NULL : link_find(conn_handle);
+    tx_record_t* p_record = NULL;
+    if (p_link == NULL) {
+        err_code = BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    else if (p_link->queue[cls].count >= m_queued_max[cls]) {
+        err_code = NRF_ERROR_RESOURCES;
+    }
+    else {
+        p_record = block_pool_alloc(&g_event_pool);
+        if (p_record == NULL) {
+            err_code = NRF_ERROR_NO_MEM;
+        }
+    }
+    if (p_record != NULL) {
+        p_record->p_data = p_block;
+        p_record->queued = app_timer_cnt_get();
+        p_record->value_handle = value_handle;
+        p_record->len = (uint8_t)len;
+        p_record->cls = (uint8_t)cls;
+        fifo_push(&p_link->queue[cls], p_record);
+        m_stats[cls].queued++;
+        if (class_held(p_link, cls)) {
+            m_stats[cls].held++;
+        }
+        pump();
+    }
+    else {
+        m_stats[cls].dropped++;
+        m_stats[cls].err_last = err_code;
+        block_pool_free(&g_notif_pool, p_block);
+    }
+    CRITICAL_REGION_EXIT();
+    send_pending();
+    return err_code;
+}
+
+
+/****************************************************************
+ * Function: tx_sched_room()
+ * Description: Returns true if tx_sched_notify() would find room
+ *  in the link's queue of a class.
+****************************************************************/
+bool tx_sched_room(uint16_t conn_handle, tx_sched_class_t cls) {
+    bool room = false;
+    if (cls >= TX_SCHED_CLASS_COUNT || conn_handle == BLE_CONN_HANDLE_INVALID) {
+        return false;
+    }
+    CRITICAL_REGION_ENTER();
+    tx_link_t const* p_link = link_find(conn_handle);
+    room = p_link != NULL && p_link->queue[cls].count < m_queued_max[cls];
+    CRITICAL_REGION_EXIT();
+    return room;
+}
+
+
+/****************************************************************
+ * Function: tx_sched_stats_get()
+ * Description: Returns the statistics of a class.
+****************************************************************/
+tx_sched_stats_t const* tx_sched_stats_get(tx_sched_class_t cls) {
+    return &m_stats[cls];
+}
+
+
+/****************************************************************
+ * Function: tx_sched_batch_stats_get()
+ * Description: Returns the batching statistics.
+****************************************************************/
+tx_sched_batch_stats_t const* tx_sched_batch_stats_get(void) {
+    return &m_batch_stats;
+}
+
+NRF_SDH_BLE_OBSERVER(m_tx_sched_observer, TX_SCHED_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
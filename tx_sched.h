@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * Project: nRF52840 Tech Demo (Server)
+ * File: tx_sched.h
+ * Author: Michael Barnes
+ * Last Modified: 10/17/26
+ * Description: Notification transmit scheduler. Notifications are queued by
+ * priority class and fed to the SoftDevice TX queue so urgent input always
+ * goes ahead of telemetry and bulk data, with deficit round robin between
+ * connections inside a class.
+*******************************************************************************/
+#ifndef TX_SCHED_H__
+#define TX_SCHED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/***************************************
+ * Definitions/Constants
+***************************************/
+// SoftDevice notification queue size per link (set in main.c)
+#define TX_SCHED_SD_QUEUE_SIZE 4
+// Notifications a link may have in the SoftDevice queue for a class to be
+// handed more; urgent input always finds a free entry and waits behind at
+// most three others (TX_SCHED_INFLIGHT_TELEMETRY)
+#define TX_SCHED_INFLIGHT_URGENT TX_SCHED_SD_QUEUE_SIZE
+#define TX_SCHED_INFLIGHT_TELEMETRY (TX_SCHED_SD_QUEUE_SIZE - 1)
+#define TX_SCHED_INFLIGHT_BULK 2
+// Notifications a class may have waiting per link
+#define TX_SCHED_QUEUED_URGENT 4
+#define TX_SCHED_QUEUED_TELEMETRY 4
+#define TX_SCHED_QUEUED_BULK 4
+// Hold telemetry and bulk on links with slave latency until the next
+// connection event the peripheral attends anyway
+#define TX_SCHED_BATCH_ENABLED 1
+
+// Priority classes, highest first
+typedef enum {
+    TX_SCHED_URGENT,
+    TX_SCHED_TELEMETRY,
+    TX_SCHED_BULK,
+    TX_SCHED_CLASS_COUNT
+} tx_sched_class_t;
+
+// Per-class statistics
+typedef struct {
+    uint32_t queued;
+    uint32_t sent;                  // Completed on air
+    uint32_t dropped;               // Refused (queue full) or rejected
+    uint32_t err_last;              // Why the last one was dropped
+    uint32_t bytes;                 // Payload bytes completed
+    uint32_t latency_max_us;        // Queued-to-completed latency
+    uint32_t latency_sum_us;
+    uint32_t held;                  // Held for a connection event (batching)
+} tx_sched_stats_t;
+
+// Batching statistics
+typedef struct {
+    uint32_t releases;              // Radio events that released held notifications
+    uint32_t events_saved;          // Connection events sending them at once would have added
+} tx_sched_batch_stats_t;
+
+
+/***************************************
+ * Functions
+***************************************/
+// Registers the BLE observer and the radio listener (call after radio_sched_init)
+void tx_sched_init(void);
+// Queues a notification. p_block is a g_notif_pool block holding the
+// payload and is owned by the scheduler from here on; NULL sends the
+// attribute value in place (user memory values). Returns NRF_SUCCESS, or
+// why it was dropped: NRF_ERROR_INVALID_PARAM, BLE_ERROR_INVALID_CONN_HANDLE
+// (link not connected), NRF_ERROR_RESOURCES (class queue full) or
+// NRF_ERROR_NO_MEM (no event record)
+uint32_t tx_sched_notify(uint16_t conn_handle, uint16_t value_handle, tx_sched_class_t cls,
+                     uint8_t* p_block, uint16_t len);
+// Returns true if the link's queue of a class has room for a notification
+bool tx_sched_room(uint16_t conn_handle, tx_sched_class_t cls);
+// Returns the statistics of a class
+tx_sched_stats_t const* tx_sched_stats_get(tx_sched_class_t cls);
+// Returns the batching statistics
+tx_sched_batch_stats_t const* tx_sched_batch_stats_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TX_SCHED_H__